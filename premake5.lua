@@ -173,7 +173,7 @@ workspace 'StudyBox_CV'
     location 'build'
     flags 'FatalWarnings'
     startproject 'StudyBox_CV'
-    configurations { 'Debug', 'Release', 'Test' }
+    configurations { 'Debug', 'Release', 'Test', 'Bench' }
     targetdir 'bin/%{cfg.platform}/%{cfg.buildcfg}'
 
     platforms 'x64'
@@ -182,7 +182,7 @@ workspace 'StudyBox_CV'
     filter 'debug'
         flags 'Symbols'
         defines 'DEBUG'
-    filter 'release or test'
+    filter 'release or test or bench'
         optimize 'On'
         defines 'NDEBUG'
 
@@ -208,6 +208,10 @@ workspace 'StudyBox_CV'
             flags 'ExcludeFromBuild'
         filter { 'test', 'files:**main.cpp' }
             flags 'ExcludeFromBuild'
+        filter { 'not bench', 'files:**/bench/** or files:**mainbench.cpp' }
+            flags 'ExcludeFromBuild'
+        filter { 'bench', 'files:**main.cpp' }
+            flags 'ExcludeFromBuild'
         filter '*'
 
         if action.os.type() == 'windows' then
@@ -220,7 +224,7 @@ workspace 'StudyBox_CV'
                     'ssleay32',
                     'libtesseract'
                 }
-            filter 'release or test'
+            filter 'release or test or bench'
                 links {
                     'opencv_world310',
                 }
@@ -243,29 +247,29 @@ workspace 'StudyBox_CV'
             }
 
             libdirs {
-                'build/packages/opencv3.1.1.0/build/native/lib/%{cfg.platform}/v'..toolset..'/%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg}',
+                'build/packages/opencv3.1.1.0/build/native/lib/%{cfg.platform}/v'..toolset..'/%{cfg.buildcfg == "Debug" and "Debug" or "Release"}',
                 'build/packages/boost_unit_test_framework-vc'..toolset..'.1.60.0.0/lib/native/address-model-%{string.sub(cfg.platform, -2)}/lib',
-                'build/packages/leptonica-vc'..toolset..'.1.73/lib/native/%{cfg.platform == "Win32" and "x86" or "x64"}/%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg}',
-                'build/packages/tesseract-vc'..toolset..'.3.04/lib/native/%{cfg.platform == "Win32" and "x86" or "x64"}/%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg}',
-                'build/packages/openssl.v140.windesktop.msvcstl.dyn.rt-dyn.%{cfg.platform == "Win32" and "x86" or "x64"}.1.0.2.0/lib/native/v'..toolset..'/windesktop/msvcstl/dyn/rt-dyn/%{cfg.platform == "Win32" and "x86" or "x64"}/%{string.lower(cfg.buildcfg == "Test" and "Release" or cfg.buildcfg)}'
+                'build/packages/leptonica-vc'..toolset..'.1.73/lib/native/%{cfg.platform == "Win32" and "x86" or "x64"}/%{cfg.buildcfg == "Debug" and "Debug" or "Release"}',
+                'build/packages/tesseract-vc'..toolset..'.3.04/lib/native/%{cfg.platform == "Win32" and "x86" or "x64"}/%{cfg.buildcfg == "Debug" and "Debug" or "Release"}',
+                'build/packages/openssl.v140.windesktop.msvcstl.dyn.rt-dyn.%{cfg.platform == "Win32" and "x86" or "x64"}.1.0.2.0/lib/native/v'..toolset..'/windesktop/msvcstl/dyn/rt-dyn/%{cfg.platform == "Win32" and "x86" or "x64"}/%{string.lower(cfg.buildcfg == "Debug" and "Debug" or "Release")}'
             }
             debugenvs {
                 'PATH=%PATH%;'..
-                '../packages/opencv3.1.redist.1.0/build/native/bin/%{cfg.platform}/v'..toolset..'/%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg};'..
+                '../packages/opencv3.1.redist.1.0/build/native/bin/%{cfg.platform}/v'..toolset..'/%{cfg.buildcfg == "Debug" and "Debug" or "Release"};'..
                 '../packages/boost_unit_test_framework-vc'..toolset..'.1.60.0.0/lib/native/address-model-%{string.sub(cfg.platform, -2)}/lib;'..
-                '../packages/leptonica-vc'..toolset..'.1.73/lib/native/%{cfg.platform == "Win32" and "x86" or "x64"}/%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg};'..
-                '../packages/tesseract-vc'..toolset..'.3.04/lib/native/%{cfg.platform == "Win32" and "x86" or "x64"}/%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg};'..
-                '../packages/openssl.v140.windesktop.msvcstl.dyn.rt-dyn.%{cfg.platform == "Win32" and "x86" or "x64"}.1.0.2.0/lib/native/v'..toolset..'/windesktop/msvcstl/dyn/rt-dyn/%{cfg.platform == "Win32" and "x86" or "x64"}/%{string.lower(cfg.buildcfg == "Test" and "Release" or cfg.buildcfg)}'
+                '../packages/leptonica-vc'..toolset..'.1.73/lib/native/%{cfg.platform == "Win32" and "x86" or "x64"}/%{cfg.buildcfg == "Debug" and "Debug" or "Release"};'..
+                '../packages/tesseract-vc'..toolset..'.3.04/lib/native/%{cfg.platform == "Win32" and "x86" or "x64"}/%{cfg.buildcfg == "Debug" and "Debug" or "Release"};'..
+                '../packages/openssl.v140.windesktop.msvcstl.dyn.rt-dyn.%{cfg.platform == "Win32" and "x86" or "x64"}.1.0.2.0/lib/native/v'..toolset..'/windesktop/msvcstl/dyn/rt-dyn/%{cfg.platform == "Win32" and "x86" or "x64"}/%{string.lower(cfg.buildcfg == "Debug" and "Debug" or "Release")}'
             }
 
             filter 'test'
                 postbuildcommands {
-                    'xcopy /Y "$(SolutionDir)packages\\opencv3.1.redist.1.0\\build\\native\\bin\\%{cfg.platform}\\v'..toolset..'\\%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg}\\opencv_world310.dll" "$(TargetDir)"',
+                    'xcopy /Y "$(SolutionDir)packages\\opencv3.1.redist.1.0\\build\\native\\bin\\%{cfg.platform}\\v'..toolset..'\\%{cfg.buildcfg == "Debug" and "Debug" or "Release"}\\opencv_world310.dll" "$(TargetDir)"',
                     'xcopy /Y "$(SolutionDir)packages\\boost_unit_test_framework-vc'..toolset..'.1.60.0.0\\lib\\native\\address-model-%{string.sub(cfg.platform, -2)}\\lib\\boost_unit_test_framework-vc'..toolset..'-mt-1_60.dll" "$(TargetDir)"',
-                    'xcopy /Y "$(SolutionDir)packages\\leptonica-vc'..toolset..'.1.73\\lib\\native\\%{cfg.platform == "Win32" and "x86" or "x64"}\\%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg}\\liblept.dll" "$(TargetDir)"',
-                    'xcopy /Y "$(SolutionDir)packages\\tesseract-vc'..toolset..'.3.04\\lib\\native\\%{cfg.platform == "Win32" and "x86" or "x64"}\\%{cfg.buildcfg == "Test" and "Release" or cfg.buildcfg}\\libtesseract.dll" "$(TargetDir)"',
-                    'xcopy /Y "$(SolutionDir)packages\\openssl.v'..toolset..'.windesktop.msvcstl.dyn.rt-dyn.%{cfg.platform == "Win32" and "x86" or "x64"}.1.0.2.0\\lib\\native\\v'..toolset..'\\windesktop\\msvcstl\\dyn\\rt-dyn\\%{cfg.platform == "Win32" and "x86" or "x64"}\\%{string.lower(cfg.buildcfg == "Test" and "Release" or cfg.buildcfg)}\\libeay32.dll" "$(TargetDir)"',
-                    'xcopy /Y "$(SolutionDir)packages\\openssl.v'..toolset..'.windesktop.msvcstl.dyn.rt-dyn.%{cfg.platform == "Win32" and "x86" or "x64"}.1.0.2.0\\lib\\native\\v'..toolset..'\\windesktop\\msvcstl\\dyn\\rt-dyn\\%{cfg.platform == "Win32" and "x86" or "x64"}\\%{string.lower(cfg.buildcfg == "Test" and "Release" or cfg.buildcfg)}\\ssleay32.dll" "$(TargetDir)"',
+                    'xcopy /Y "$(SolutionDir)packages\\leptonica-vc'..toolset..'.1.73\\lib\\native\\%{cfg.platform == "Win32" and "x86" or "x64"}\\%{cfg.buildcfg == "Debug" and "Debug" or "Release"}\\liblept.dll" "$(TargetDir)"',
+                    'xcopy /Y "$(SolutionDir)packages\\tesseract-vc'..toolset..'.3.04\\lib\\native\\%{cfg.platform == "Win32" and "x86" or "x64"}\\%{cfg.buildcfg == "Debug" and "Debug" or "Release"}\\libtesseract.dll" "$(TargetDir)"',
+                    'xcopy /Y "$(SolutionDir)packages\\openssl.v'..toolset..'.windesktop.msvcstl.dyn.rt-dyn.%{cfg.platform == "Win32" and "x86" or "x64"}.1.0.2.0\\lib\\native\\v'..toolset..'\\windesktop\\msvcstl\\dyn\\rt-dyn\\%{cfg.platform == "Win32" and "x86" or "x64"}\\%{string.lower(cfg.buildcfg == "Debug" and "Debug" or "Release")}\\libeay32.dll" "$(TargetDir)"',
+                    'xcopy /Y "$(SolutionDir)packages\\openssl.v'..toolset..'.windesktop.msvcstl.dyn.rt-dyn.%{cfg.platform == "Win32" and "x86" or "x64"}.1.0.2.0\\lib\\native\\v'..toolset..'\\windesktop\\msvcstl\\dyn\\rt-dyn\\%{cfg.platform == "Win32" and "x86" or "x64"}\\%{string.lower(cfg.buildcfg == "Debug" and "Debug" or "Release")}\\ssleay32.dll" "$(TargetDir)"',
                     '"$(TargetDir)\\$(TargetName).exe" --result_code=no --report_level=short'
                 }
 
@@ -324,6 +328,8 @@ premake.override(premake.main, 'postAction', function(base)
         builds = { 'release' }
     elseif _OPTIONS['build'] == 'test' or _OPTIONS['test'] then
         builds = { 'test' }
+    elseif _OPTIONS['build'] == 'bench' then
+        builds = { 'bench' }
     end
 
     local runs = nil
@@ -331,6 +337,8 @@ premake.override(premake.main, 'postAction', function(base)
         runs = 'Release'
     elseif _OPTIONS['run'] == 'test' or _OPTIONS['test'] then
         runs = 'Test'
+    elseif _OPTIONS['run'] == 'bench' then
+        runs = 'Bench'
     end
 
     if setups then
@@ -381,7 +389,8 @@ newoption {
     allowed = {
         { 'all', 'All' },
         { 'app', 'Application' },
-        { 'test', 'Test' }
+        { 'test', 'Test' },
+        { 'bench', 'Benchmark' }
     }
 }
 
@@ -396,7 +405,8 @@ newoption {
     description = 'Runs specified target',
     allowed = {
         { 'app', 'Application' },
-        { 'test', 'Test' }
+        { 'test', 'Test' },
+        { 'bench', 'Benchmark' }
     }
 }
 
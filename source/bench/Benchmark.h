@@ -0,0 +1,43 @@
+#ifndef PATR_BENCHMARK_H
+#define PATR_BENCHMARK_H
+
+#include <map>
+#include <string>
+#include <ostream>
+#include <functional>
+
+/// Przestrzeń narzędzi do pomiarów wydajności.
+/**
+ * Benchmarki rejestrowane są statycznie makrem PATR_BENCHMARK
+ * i uruchamiane przez cel Bench (mainbench.cpp).
+ */
+namespace Bench {
+
+/// Funkcja przeprowadzająca pomiar, wyniki wypisuje na podany strumień.
+typedef std::function<void(std::ostream&)> BenchmarkFunction;
+
+/// Zwraca kolekcję zarejestrowanych benchmarków.
+inline std::map<std::string, BenchmarkFunction>& Registry()
+{
+    static std::map<std::string, BenchmarkFunction> registry;
+    return registry;
+}
+
+/// Rejestruje benchmark podczas inicjalizacji statycznej.
+struct Registrar
+{
+    Registrar(const std::string& name, BenchmarkFunction function)
+    {
+        Registry()[name] = std::move(function);
+    }
+};
+
+} // namespace Bench
+
+/// Definiuje i rejestruje benchmark o danej nazwie.
+#define PATR_BENCHMARK(name) \
+    static void name(std::ostream&); \
+    static Bench::Registrar name##Registrar(#name, name); \
+    static void name(std::ostream& out)
+
+#endif // PATR_BENCHMARK_H
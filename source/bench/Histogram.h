@@ -0,0 +1,113 @@
+#ifndef PATR_HISTOGRAM_H
+#define PATR_HISTOGRAM_H
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+namespace Bench {
+
+/// Histogram wartości o stałej precyzji względnej (w stylu HdrHistogram).
+/**
+ * Wartości dzielone są na przedziały kolejnych potęg dwójki, a każdy z nich na 2^precision
+ * równych podprzedziałów, więc błąd odczytanego percentyla nie przekracza 2^-precision wartości
+ * niezależnie od jej rzędu wielkości. Wartości mniejsze od 2^(precision + 1) zapisywane są dokładnie.
+ * Zapis nie alokuje pamięci, a histogramy poszczególnych wątków można scalać.
+ */
+class Histogram
+{
+public:
+    /**
+     * @param highest - największa rozróżniana wartość, większe zapisywane są jako highest.
+     * @param precision - liczba bitów podprzedziału, 7 daje błąd poniżej 1%.
+     */
+    explicit Histogram(std::uint64_t highest = 60000000, unsigned precision = 7)
+        : highest(highest), precision(precision), counts(index(highest) + 1), total(0),
+          lowestValue(std::numeric_limits<std::uint64_t>::max()), highestValue(0), sum(0)
+    {
+    }
+
+    /// Zapisuje count wystąpień wartości.
+    void record(std::uint64_t value, std::uint64_t count = 1)
+    {
+        value = std::min(value, highest);
+        counts[index(value)] += count;
+        total += count;
+        lowestValue = std::min(lowestValue, value);
+        highestValue = std::max(highestValue, value);
+        sum += static_cast<double>(value) * count;
+    }
+
+    /// Dodaje wartości innego histogramu o tych samych parametrach.
+    void merge(const Histogram& other)
+    {
+        for (std::size_t i = 0; i < counts.size() && i < other.counts.size(); ++i)
+            counts[i] += other.counts[i];
+        total += other.total;
+        lowestValue = std::min(lowestValue, other.lowestValue);
+        highestValue = std::max(highestValue, other.highestValue);
+        sum += other.sum;
+    }
+
+    /// Zwraca najmniejszą wartość, od której nie jest większe percentile % zapisanych wartości.
+    /**
+     * Wynikiem jest górna granica podprzedziału, ograniczona największą zapisaną wartością.
+     */
+    std::uint64_t percentile(double percentile) const
+    {
+        if (total == 0)
+            return 0;
+
+        auto target = static_cast<std::uint64_t>(std::ceil(std::min(percentile, 100.0) / 100.0 * total));
+        target = std::max<std::uint64_t>(target, 1);
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < counts.size(); ++i)
+        {
+            seen += counts[i];
+            if (seen >= target)
+                return std::min(highestEquivalent(i), highestValue);
+        }
+        return highestValue;
+    }
+
+    /// Zwraca liczbę zapisanych wartości.
+    std::uint64_t count() const { return total; }
+    /// Zwraca najmniejszą zapisaną wartość lub 0 dla pustego histogramu.
+    std::uint64_t min() const { return total ? lowestValue : 0; }
+    /// Zwraca największą zapisaną wartość.
+    std::uint64_t max() const { return highestValue; }
+    /// Zwraca średnią zapisanych wartości.
+    double mean() const { return total ? sum / total : 0.0; }
+
+private:
+    /// Zwraca indeks licznika dla wartości: przesunięcie przedziału i najstarsze bity wartości.
+    std::size_t index(std::uint64_t value) const
+    {
+        unsigned shift = 0;
+        while ((value >> shift) >> (precision + 1))
+            ++shift;
+        return (static_cast<std::size_t>(shift) << precision) + static_cast<std::size_t>(value >> shift);
+    }
+
+    /// Zwraca największą wartość zapisywaną pod danym indeksem.
+    std::uint64_t highestEquivalent(std::size_t index) const
+    {
+        auto shift = static_cast<unsigned>(std::max<std::size_t>(index >> precision, 1) - 1);
+        auto top = static_cast<std::uint64_t>(index - (static_cast<std::size_t>(shift) << precision));
+        return (top << shift) + (std::uint64_t(1) << shift) - 1;
+    }
+
+    std::uint64_t highest;
+    unsigned precision;
+    std::vector<std::uint64_t> counts;
+    std::uint64_t total;
+    std::uint64_t lowestValue;
+    std::uint64_t highestValue;
+    double sum;
+};
+
+} // namespace Bench
+
+#endif // PATR_HISTOGRAM_H
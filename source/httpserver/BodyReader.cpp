@@ -0,0 +1,332 @@
+#include "ServerUtilities.h"
+#include "Predef.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+
+#if defined(PATR_OS_UNIX)
+#    include <unistd.h>
+#endif // defined(PATR_OS_UNIX)
+
+namespace {
+
+    /// Największa rezerwacja pamięci ciała przed jego odebraniem - rozmiar bufora odczytu połączenia.
+    const std::size_t InitialReserve = 8192U;
+
+    /// Porównuje łańcuchy znaków bez względu na wielkość liter.
+    bool EqualsIgnoreCase(const std::string& left, const std::string& right)
+    {
+        return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin(),
+            [](char l, char r) { return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r)); });
+    }
+
+    /// Wyszukuje nagłówek o danej nazwie bez względu na wielkość liter.
+    Http::HeaderContainer::iterator FindHeader(Http::HeaderContainer& headers, const std::string& name)
+    {
+        return std::find_if(headers.begin(), headers.end(), [&name](const Http::Header& header) { return EqualsIgnoreCase(header.first, name); });
+    }
+
+    /// Odczytuje długość ciała, zwraca false dla wartości niebędących liczbą dziesiętną.
+    bool ParseLength(const std::string& value, std::size_t& length)
+    {
+        auto begin = value.find_first_not_of(" \t"), end = value.find_last_not_of(" \t");
+        if (begin == std::string::npos)
+            return false;
+
+        length = 0;
+        for (auto i = begin; i <= end; ++i)
+        {
+            if (!std::isdigit(static_cast<unsigned char>(value[i])))
+                return false;
+            if (length > (std::numeric_limits<std::size_t>::max() - 9) / 10)
+                length = std::numeric_limits<std::size_t>::max(); // i tak przekracza każdy limit.
+            else
+                length = length * 10 + (value[i] - '0');
+        }
+        return true;
+    }
+
+    /// Zwraca wartość cyfry szesnastkowej lub -1.
+    int HexValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    /// Tworzy plik tymczasowy w podanym katalogu, ścieżka usuwana jest wraz z ostatnim właścicielem.
+    std::FILE* CreateTemporary(const std::string& directory, std::shared_ptr<const std::string>& path)
+    {
+        auto remove = [](const std::string* name)
+        {
+            std::remove(name->c_str());
+            delete name;
+        };
+
+#if defined(PATR_OS_WINDOWS)
+        auto name = _tempnam(directory.empty() ? nullptr : directory.c_str(), "patr");
+        if (!name)
+            return nullptr;
+        auto file = std::fopen(name, "w+b");
+        if (file)
+            path.reset(new std::string(name), remove);
+        std::free(name);
+        return file;
+#elif defined(PATR_OS_UNIX)
+        auto base = directory;
+        if (base.empty())
+        {
+            auto environment = std::getenv("TMPDIR");
+            base = environment ? environment : "/tmp";
+        }
+        std::string name = base + "/patr-body-XXXXXX";
+        auto handle = ::mkstemp(&name[0]);
+        if (handle == -1)
+            return nullptr;
+        auto file = ::fdopen(handle, "w+b");
+        if (!file)
+        {
+            ::close(handle);
+            std::remove(name.c_str());
+            return nullptr;
+        }
+        path.reset(new std::string(name), remove);
+        return file;
+#endif
+    }
+}
+
+Http::BodyLimits::BodyLimits(std::size_t maxSize, std::size_t spillThreshold) : maxSize(maxSize), spillThreshold(spillThreshold)
+{
+}
+
+Http::BodyReader::BodyReader(const BodyLimits& limits) : limits(limits), file(nullptr)
+{
+    reset();
+}
+
+Http::BodyReader::~BodyReader()
+{
+    reset();
+}
+
+Http::BodyReader::Result Http::BodyReader::start(Request& request)
+{
+    reset();
+
+    auto& headers = request.headerCollection;
+    auto encoding = FindHeader(headers, "Transfer-Encoding");
+    if (encoding != headers.end())
+    {
+        if (!EqualsIgnoreCase(encoding->second, "chunked"))
+            return Result::Unsupported; // Pozostałe kodowania wymagałyby dekompresji.
+        chunked = true;
+    }
+    else
+    {
+        auto length = FindHeader(headers, "Content-Length");
+        if (length != headers.end() && !ParseLength(length->second, remaining))
+            return Result::Bad;
+        if (remaining > limits.maxSize)
+            return Result::TooLarge; // Odrzuć przed odebraniem ciała.
+    }
+
+    if (limits.sink)
+        request.sink = limits.sink(request);
+
+    if (!request.sink && !chunked)
+        request.content.reserve((std::min)(remaining, InitialReserve)); // Content-Length nie może wymusić alokacji bez danych.
+
+    return Result::Good;
+}
+
+std::pair<Http::BodyReader::Result, char*> Http::BodyReader::read(char* begin, char* end, Request& request)
+{
+    if (chunked)
+        return readChunked(begin, end, request);
+
+    auto size = (std::min)(remaining, static_cast<std::size_t>(end - begin));
+    auto result = store(begin, size, request);
+    if (result != Result::Good)
+        return std::make_pair(result, end);
+
+    remaining -= size;
+    if (remaining > 0)
+        return std::make_pair(Result::Indeterminate, end);
+    return std::make_pair(complete(request), begin + size);
+}
+
+void Http::BodyReader::reset()
+{
+    if (file)
+        std::fclose(file);
+    file = nullptr;
+    chunked = false;
+    state = ChunkState::Size;
+    remaining = 0;
+    received = 0;
+    digits = false;
+    spillFailed = false;
+}
+
+Http::BodyReader::Result Http::BodyReader::store(const char* data, std::size_t size, Request& request)
+{
+    if (size == 0)
+        return Result::Good;
+
+    received += size;
+    if (received > limits.maxSize)
+        return Result::TooLarge;
+
+    if (request.sink)
+        return request.sink->write(data, size) ? Result::Good : Result::Bad;
+
+    if (!file && !spillFailed && limits.spillThreshold && received > limits.spillThreshold)
+        spillFailed = !spill(request); // W przypadku niepowodzenia ciało pozostaje w pamięci.
+
+    if (file)
+        return std::fwrite(data, 1, size, file) == size ? Result::Good : Result::Failed; // Brak miejsca na dysku.
+
+    request.content.append(data, size);
+    return Result::Good;
+}
+
+bool Http::BodyReader::spill(Request& request)
+{
+    std::shared_ptr<const std::string> path;
+    file = CreateTemporary(limits.spillDirectory, path);
+    if (!file)
+        return false;
+
+    if (std::fwrite(request.content.data(), 1, request.content.size(), file) != request.content.size())
+    {
+        std::fclose(file); // Plik usuwany jest wraz z path.
+        file = nullptr;
+        return false;
+    }
+
+    request.file = path;
+    BodyType().swap(request.content); // Zwolnij pamięć.
+    return true;
+}
+
+std::pair<Http::BodyReader::Result, char*> Http::BodyReader::readChunked(char* begin, char* end, Request& request)
+{
+    while (begin != end)
+    {
+        switch (state)
+        {
+        case ChunkState::Size:
+        {
+            auto value = HexValue(*begin);
+            if (value >= 0)
+            {
+                if (limits.maxSize < static_cast<std::size_t>(value) || remaining > (limits.maxSize - value) / 16)
+                    return std::make_pair(Result::TooLarge, end); // Rozmiar przekracza limit przed odebraniem kawałka.
+                remaining = remaining * 16 + value;
+                digits = true;
+            }
+            else if (!digits)
+            {
+                return std::make_pair(Result::Bad, end);
+            }
+            else if (*begin == ';' || *begin == ' ' || *begin == '\t')
+            {
+                state = ChunkState::Extension;
+            }
+            else if (*begin == '\r')
+            {
+                state = ChunkState::SizeNewline;
+            }
+            else
+            {
+                return std::make_pair(Result::Bad, end);
+            }
+            ++begin;
+            break;
+        }
+        case ChunkState::Extension: // Rozszerzenia kawałków są pomijane.
+            if (*begin == '\r')
+                state = ChunkState::SizeNewline;
+            else if (*begin == '\n')
+                return std::make_pair(Result::Bad, end);
+            ++begin;
+            break;
+        case ChunkState::SizeNewline:
+            if (*begin++ != '\n')
+                return std::make_pair(Result::Bad, end);
+            state = remaining ? ChunkState::Data : ChunkState::TrailerStart;
+            break;
+        case ChunkState::Data:
+        {
+            auto size = (std::min)(remaining, static_cast<std::size_t>(end - begin));
+            auto result = store(begin, size, request);
+            if (result != Result::Good)
+                return std::make_pair(result, end);
+            begin += size;
+            remaining -= size;
+            if (!remaining)
+                state = ChunkState::DataCr;
+            break;
+        }
+        case ChunkState::DataCr:
+            if (*begin++ != '\r')
+                return std::make_pair(Result::Bad, end);
+            state = ChunkState::DataNewline;
+            break;
+        case ChunkState::DataNewline:
+            if (*begin++ != '\n')
+                return std::make_pair(Result::Bad, end);
+            state = ChunkState::Size;
+            digits = false;
+            break;
+        case ChunkState::TrailerStart: // Nagłówki końcowe są pomijane.
+            state = *begin++ == '\r' ? ChunkState::LastNewline : ChunkState::Trailer;
+            break;
+        case ChunkState::Trailer:
+            if (*begin++ == '\r')
+                state = ChunkState::TrailerNewline;
+            break;
+        case ChunkState::TrailerNewline:
+            if (*begin++ != '\n')
+                return std::make_pair(Result::Bad, end);
+            state = ChunkState::TrailerStart;
+            break;
+        case ChunkState::LastNewline:
+            if (*begin++ != '\n')
+                return std::make_pair(Result::Bad, end);
+            return std::make_pair(complete(request), begin);
+        }
+    }
+    return std::make_pair(Result::Indeterminate, end);
+}
+
+Http::BodyReader::Result Http::BodyReader::complete(Request& request)
+{
+    if (file)
+    {
+        auto failed = std::fclose(file) != 0;
+        file = nullptr;
+        if (failed)
+            return Result::Failed;
+    }
+
+    if (chunked) // Ciało jest już zdekodowane.
+    {
+        auto& headers = request.headerCollection;
+        headers.erase(FindHeader(headers, "Transfer-Encoding"));
+        auto length = FindHeader(headers, "Content-Length");
+        if (length != headers.end())
+            length->second = std::to_string(received);
+        else
+            headers.push_back(Header("Content-Length", std::to_string(received)));
+    }
+
+    return Result::Good;
+}
@@ -0,0 +1,90 @@
+#include "Server.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+    /// Waga średniego opóźnienia we wzroście opóźnienia bazowego.
+    /**
+     * Bazowe opóźnienie rośnie powoli za średnim, więc stała kolejka (np. stała liczba klientów
+     * w pętli zamkniętej) staje się nową bazą, a limit maleje jedynie przy narastającym opóźnieniu.
+     * Spadek średniego opóźnienia obniża bazę z wagą AverageWeight.
+     */
+    constexpr double BaselineWeight = 0.002;
+    /// Waga nowej wartości limitu względem poprzedniej.
+    constexpr double Smoothing = 0.2;
+    /// Waga pomiaru w średnim opóźnieniu.
+    constexpr double AverageWeight = 0.02;
+
+    double Seconds(Http::ConcurrencyLimit::Clock::duration duration)
+    {
+        return std::chrono::duration<double>(duration).count();
+    }
+
+    Http::ConcurrencyLimit::Clock::duration Duration(double seconds)
+    {
+        return std::chrono::duration_cast<Http::ConcurrencyLimit::Clock::duration>(std::chrono::duration<double>(seconds));
+    }
+}
+
+Http::ConcurrencyLimit::ConcurrencyLimit(std::size_t initial, std::size_t minimum, std::size_t maximum, double tolerance) :
+    minimum(static_cast<double>(std::max<std::size_t>(minimum, 1))),
+    maximum(static_cast<double>(std::max(maximum, std::max<std::size_t>(minimum, 1)))),
+    tolerance(std::max(tolerance, 1.0)),
+    limit(std::min(std::max(static_cast<double>(initial), this->minimum), this->maximum)),
+    inFlight(0),
+    rejected(0),
+    baseline(0),
+    average(0)
+{
+}
+
+bool Http::ConcurrencyLimit::acquire()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (inFlight >= static_cast<std::size_t>(limit))
+    {
+        ++rejected;
+        return false;
+    }
+    ++inFlight;
+    return true;
+}
+
+void Http::ConcurrencyLimit::release(Clock::duration duration)
+{
+    auto latency = std::max(Seconds(duration), 1e-6);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto utilized = inFlight * 2 >= static_cast<std::size_t>(limit);
+    --inFlight;
+
+    average = average ? average + (latency - average) * AverageWeight : latency;
+    baseline = baseline ? baseline + (average - baseline) * (average > baseline ? BaselineWeight : AverageWeight) : average;
+
+    if (!utilized)
+        return; // Limit nie jest wykorzystywany - opóźnienie nie świadczy o jego wartości.
+
+    auto gradient = std::max(0.5, std::min(1.0, tolerance * baseline / average));
+    auto target = limit * gradient + std::sqrt(limit); // Pierwiastek pozwala badać wzrost przepustowości.
+    limit = std::min(maximum, std::max(minimum, limit * (1 - Smoothing) + target * Smoothing));
+}
+
+void Http::ConcurrencyLimit::cancel()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    --inFlight;
+}
+
+std::size_t Http::ConcurrencyLimit::retryAfter() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<std::size_t>(std::max(1.0, std::ceil(average)));
+}
+
+Http::ConcurrencyLimit::Statistics Http::ConcurrencyLimit::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return Statistics{ static_cast<std::size_t>(limit), inFlight, rejected, Duration(baseline), Duration(average) };
+}
@@ -0,0 +1,253 @@
+#include "Socket.h"
+#include "Predef.h"
+
+#if defined(PATR_OS_LINUX)
+
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+namespace {
+    /// Maksymalna liczba zdarzeń odbieranych jednym wywołaniem epoll_wait.
+    constexpr int MaxEvents = 256;
+}
+
+struct Tcp::EpollStreamService::EpollStreamServicePimpl
+{
+    /// Stan obiektu zarejestrowanego w epoll, wskazywany przez epoll_event::data.
+    struct Registration
+    {
+        SocketService* socket;
+        AcceptorService* acceptor;
+        bool readable; //< Od ostatniego zbocza gniazdo nie zostało opróżnione.
+        bool writable;
+    };
+
+    EpollStreamServicePimpl();
+    ~EpollStreamServicePimpl();
+
+    /// Wywołuje oczekujące zadania, dopóki gniazdo pozostaje gotowe.
+    void dispatch(Registration* registration);
+    /// Rejestruje akceptor w epoll, jeżeli nie został już zarejestrowany.
+    void attach(AcceptorService* acceptor);
+
+    int epoll;
+    bool running;
+    bool wakeupRegistered;
+    std::unordered_map<SocketService*, std::unique_ptr<Registration>> registrations;
+    std::vector<std::unique_ptr<Registration>> acceptors;
+    /// Rejestracje usunięte przez remove() - zwalniane po obsłużeniu pending, przed kolejnym epoll_wait.
+    std::vector<std::unique_ptr<Registration>> released;
+    /// Gotowe gniazda, do których kolejek trafiły nowe zadania.
+    std::vector<Registration*> pending;
+    std::array<epoll_event, MaxEvents> events;
+};
+
+Tcp::EpollStreamService::EpollStreamServicePimpl::EpollStreamServicePimpl() : epoll(::epoll_create1(EPOLL_CLOEXEC)), running(false), wakeupRegistered(false)
+{
+    if (epoll == -1)
+        throw PlatformError("epoll_create1 failed (" + std::to_string(errno) + ')');
+}
+
+Tcp::EpollStreamService::EpollStreamServicePimpl::~EpollStreamServicePimpl()
+{
+    ::close(epoll);
+}
+
+void Tcp::EpollStreamService::EpollStreamServicePimpl::dispatch(Registration* registration)
+{
+    while (registration->socket && (registration->readable || registration->socket->buffered()) && registration->socket->pendingRead())
+    {
+        // edge-triggered - czytaj do wyczerpania danych, które sygnalizuje WouldBlock.
+        if (registration->socket->readReady() == SocketService::WouldBlock)
+        {
+            registration->readable = false;
+            break;
+        }
+    }
+
+    while (registration->socket && registration->writable && registration->socket->pendingWrite())
+    {
+        if (registration->socket->writeReady() <= 0)
+            registration->writable = false;
+    }
+}
+
+void Tcp::EpollStreamService::EpollStreamServicePimpl::attach(AcceptorService* acceptor)
+{
+    auto registered = std::any_of(acceptors.begin(), acceptors.end(), [acceptor](const std::unique_ptr<Registration>& registration) {
+        return registration->acceptor == acceptor;
+    });
+    if (registered || acceptor->getHandle() == -1)
+        return; // Ponowne EPOLL_CTL_ADD zakończyłoby się EEXIST, a akceptor bez uchwytu rejestrowany jest przez listen().
+
+    // Akceptor przyjmuje jedno połączenie na wywołanie, stąd level-triggered.
+    auto registration = std::unique_ptr<Registration>(new Registration{ nullptr, acceptor, false, false });
+    auto event = epoll_event();
+    event.events = EPOLLIN;
+    event.data.ptr = registration.get();
+    if (::epoll_ctl(epoll, EPOLL_CTL_ADD, acceptor->getHandle(), &event) == -1)
+        throw ServiceError("epoll_ctl failed (" + std::to_string(errno) + ')');
+    acceptors.push_back(std::move(registration));
+}
+
+Tcp::EpollStreamService::EpollStreamService() : pimpl(new EpollStreamServicePimpl())
+{
+}
+
+Tcp::EpollStreamService::~EpollStreamService()
+{
+}
+
+int Tcp::EpollStreamService::run()
+{
+    for (auto acceptor : acceptors)
+        pimpl->attach(acceptor);
+
+    if (!pimpl->wakeupRegistered)
+    {
+        auto event = epoll_event();
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr; // wyróżnia uchwyt wybudzenia spośród rejestracji.
+        if (::epoll_ctl(pimpl->epoll, EPOLL_CTL_ADD, wakeupHandle(), &event) == -1)
+            throw ServiceError("epoll_ctl failed (" + std::to_string(errno) + ')');
+        pimpl->wakeupRegistered = true;
+    }
+
+    pimpl->running = true;
+
+    while (!stopped())
+    {
+        for (std::size_t i = 0; i < pimpl->pending.size(); ++i) // dispatch może dopisywać kolejne elementy.
+            pimpl->dispatch(pimpl->pending[i]);
+        pimpl->pending.clear();
+        pimpl->released.clear();
+
+        auto timeout = timers.timeout(TimerWheel::Clock::now());
+
+        auto result = ::epoll_wait(pimpl->epoll, pimpl->events.data(), MaxEvents, timeout);
+        if (result < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw ServiceError("epoll_wait failed (" + std::to_string(errno) + ')');
+        }
+
+        for (int i = 0; i < result; ++i)
+        {
+            auto registration = static_cast<EpollStreamServicePimpl::Registration*>(pimpl->events[i].data.ptr);
+            auto events = pimpl->events[i].events;
+
+            if (!registration)
+            {
+                runPosted();
+                continue;
+            }
+
+            if (registration->acceptor)
+            {
+                registration->acceptor->acceptReady();
+                continue;
+            }
+
+            if (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+                registration->readable = true;
+            if (events & (EPOLLOUT | EPOLLHUP | EPOLLERR))
+                registration->writable = true;
+
+            pimpl->dispatch(registration);
+        }
+
+        timers.expire(TimerWheel::Clock::now());
+    }
+
+    pimpl->running = false;
+    pimpl->pending.clear();
+    pimpl->released.clear();
+
+    // shutdown() usuwa gniazdo z kolekcji, a handlery mogą zwolnić także inne gniazda - kopia mogłaby je wskazywać.
+    while (!sockets.empty())
+    {
+        (*sockets.begin())->shutdown();
+    }
+
+    return signal ? signal->get() : 0;
+}
+
+void Tcp::EpollStreamService::add(SocketService* service)
+{
+    auto registration = std::unique_ptr<EpollStreamServicePimpl::Registration>(
+        new EpollStreamServicePimpl::Registration{ service, nullptr, false, false });
+
+    auto event = epoll_event();
+    event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    event.data.ptr = registration.get();
+    if (::epoll_ctl(pimpl->epoll, EPOLL_CTL_ADD, service->getHandle(), &event) == -1)
+        throw ServiceError("epoll_ctl failed (" + std::to_string(errno) + ')');
+
+    StreamServiceInterface::add(service);
+    pimpl->registrations[service] = std::move(registration);
+}
+
+void Tcp::EpollStreamService::remove(SocketService* service)
+{
+    StreamServiceInterface::remove(service);
+
+    auto found = pimpl->registrations.find(service);
+    if (found == pimpl->registrations.end())
+        return;
+
+    ::epoll_ctl(pimpl->epoll, EPOLL_CTL_DEL, service->getHandle(), nullptr); // deskryptor mógł zostać już zamknięty.
+    found->second->socket = nullptr; // zdarzenia z bieżącej iteracji mogą wciąż wskazywać na rejestrację.
+    // Rejestracja mogła trafić do pending również poza run() (update()) - zwalniana jest przed kolejnym epoll_wait.
+    pimpl->released.push_back(std::move(found->second));
+    pimpl->registrations.erase(found);
+}
+
+void Tcp::EpollStreamService::add(AcceptorService* service)
+{
+    StreamServiceInterface::add(service);
+    if (pimpl->running)
+        pimpl->attach(service); // pozostałe akceptory rejestrowane są w run(), gdy znane są ich uchwyty.
+}
+
+void Tcp::EpollStreamService::remove(AcceptorService* service)
+{
+    StreamServiceInterface::remove(service);
+
+    auto& acceptors = pimpl->acceptors;
+    auto found = std::find_if(acceptors.begin(), acceptors.end(), [service](const std::unique_ptr<EpollStreamServicePimpl::Registration>& registration) {
+        return registration->acceptor == service;
+    });
+    if (found == acceptors.end())
+        return;
+
+    ::epoll_ctl(pimpl->epoll, EPOLL_CTL_DEL, service->getHandle(), nullptr);
+    (*found)->acceptor = nullptr;
+    if (pimpl->running)
+        pimpl->released.push_back(std::move(*found));
+    acceptors.erase(found);
+}
+
+void Tcp::EpollStreamService::update(SocketService* service)
+{
+    auto found = pimpl->registrations.find(service);
+    if (found == pimpl->registrations.end())
+        return;
+
+    auto registration = found->second.get();
+    if (((registration->readable || service->buffered()) && service->pendingRead()) || (registration->writable && service->pendingWrite()))
+        pimpl->pending.push_back(registration);
+}
+
+std::unique_ptr<Tcp::ServiceFactory> Tcp::EpollStreamService::getFactory()
+{
+    return std::unique_ptr<ServiceFactory>(new StreamServiceFactory(*this));
+}
+
+#endif // defined(PATR_OS_LINUX)
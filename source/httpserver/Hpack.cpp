@@ -0,0 +1,491 @@
+#include "ServerUtilities.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace {
+
+    /// Tablica statyczna HPACK (RFC 7541, dodatek A).
+    const Http::Header StaticTable[] = {
+        { ":authority", "" },
+        { ":method", "GET" },
+        { ":method", "POST" },
+        { ":path", "/" },
+        { ":path", "/index.html" },
+        { ":scheme", "http" },
+        { ":scheme", "https" },
+        { ":status", "200" },
+        { ":status", "204" },
+        { ":status", "206" },
+        { ":status", "304" },
+        { ":status", "400" },
+        { ":status", "404" },
+        { ":status", "500" },
+        { "accept-charset", "" },
+        { "accept-encoding", "gzip, deflate" },
+        { "accept-language", "" },
+        { "accept-ranges", "" },
+        { "accept", "" },
+        { "access-control-allow-origin", "" },
+        { "age", "" },
+        { "allow", "" },
+        { "authorization", "" },
+        { "cache-control", "" },
+        { "content-disposition", "" },
+        { "content-encoding", "" },
+        { "content-language", "" },
+        { "content-length", "" },
+        { "content-location", "" },
+        { "content-range", "" },
+        { "content-type", "" },
+        { "cookie", "" },
+        { "date", "" },
+        { "etag", "" },
+        { "expect", "" },
+        { "expires", "" },
+        { "from", "" },
+        { "host", "" },
+        { "if-match", "" },
+        { "if-modified-since", "" },
+        { "if-none-match", "" },
+        { "if-range", "" },
+        { "if-unmodified-since", "" },
+        { "last-modified", "" },
+        { "link", "" },
+        { "location", "" },
+        { "max-forwards", "" },
+        { "proxy-authenticate", "" },
+        { "proxy-authorization", "" },
+        { "range", "" },
+        { "referer", "" },
+        { "refresh", "" },
+        { "retry-after", "" },
+        { "server", "" },
+        { "set-cookie", "" },
+        { "strict-transport-security", "" },
+        { "transfer-encoding", "" },
+        { "user-agent", "" },
+        { "vary", "" },
+        { "via", "" },
+        { "www-authenticate", "" }
+    };
+
+    constexpr std::size_t StaticSize = sizeof(StaticTable) / sizeof(StaticTable[0]);
+
+    /// Narzut rozmiaru wpisu tablicy dynamicznej.
+    constexpr std::size_t EntryOverhead = 32;
+
+    /// Wartości dłuższe od podanej nie są dodawane do tablicy dynamicznej - wyparłyby z niej pozostałe wpisy.
+    constexpr std::size_t MaxIndexedValue = 256;
+
+    /// Symbol kończący łańcuch (EOS), niedozwolony w kodowanych danych.
+    constexpr int EndOfString = 256;
+
+    /// Długości kodu Huffmana HPACK kolejnych symboli (RFC 7541, dodatek B), ostatni to EOS.
+    /**
+     * Kod jest kanoniczny - kody wynikają z długości (uporządkowanych według długości i symbolu).
+     */
+    const unsigned char CodeLengths[EndOfString + 1] = {
+        13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+        28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+        6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+        5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+        13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+        7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+        15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+        6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+        20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+        24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+        22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+        21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+        26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+        19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+        20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+        26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+        30
+    };
+
+    /// Kod Huffmana HPACK w postaci kanonicznej.
+    struct HuffmanCode
+    {
+        static constexpr int MaxLength = 30;
+
+        HuffmanCode() : count(), first(), offset()
+        {
+            for (int symbol = 0; symbol <= EndOfString; ++symbol)
+                ++count[CodeLengths[symbol]];
+
+            std::uint32_t code = 0;
+            std::uint16_t index = 0;
+            for (int length = 1; length <= MaxLength; ++length)
+            {
+                code = (code + count[length - 1]) << 1;
+                first[length] = code;
+                offset[length] = index;
+                index = static_cast<std::uint16_t>(index + count[length]);
+            }
+
+            auto next = offset;
+            for (int symbol = 0; symbol <= EndOfString; ++symbol) // symbole tej samej długości otrzymują kolejne kody.
+            {
+                auto length = CodeLengths[symbol];
+                codes[symbol] = first[length] + (next[length] - offset[length]);
+                symbols[next[length]++] = static_cast<std::uint16_t>(symbol);
+            }
+        }
+
+        std::array<std::uint32_t, EndOfString + 1> codes;
+        std::array<std::uint16_t, EndOfString + 1> symbols; //< Symbole uporządkowane według kodów.
+        std::array<std::uint16_t, MaxLength + 1> count; //< Liczba kodów danej długości.
+        std::array<std::uint32_t, MaxLength + 1> first; //< Pierwszy kod danej długości.
+        std::array<std::uint16_t, MaxLength + 1> offset; //< Pozycja pierwszego symbolu danej długości w symbols.
+    };
+
+    const HuffmanCode& Huffman()
+    {
+        static const HuffmanCode code;
+        return code;
+    }
+
+    /// Dekoduje łańcuch zakodowany kodem Huffmana.
+    /**
+     * Dopełnienie ostatniego bajtu musi być krótsze od 8 bitów i składać się z jedynek (przedrostka EOS).
+     */
+    bool DecodeHuffman(const unsigned char* data, std::size_t size, std::string& out)
+    {
+        const auto& code = Huffman();
+        std::uint32_t value = 0;
+        int length = 0;
+        for (auto end = data + size; data != end; ++data)
+        {
+            for (int bit = 7; bit >= 0; --bit)
+            {
+                value = (value << 1) | ((*data >> bit) & 1);
+                if (++length > HuffmanCode::MaxLength)
+                    return false;
+
+                auto index = value - code.first[length];
+                if (index < code.count[length])
+                {
+                    auto symbol = code.symbols[code.offset[length] + index];
+                    if (symbol == EndOfString)
+                        return false;
+                    out += static_cast<char>(symbol);
+                    value = 0;
+                    length = 0;
+                }
+            }
+        }
+        return length < 8 && value == (1U << length) - 1;
+    }
+
+    /// Zwraca długość łańcucha zakodowanego kodem Huffmana w bajtach.
+    std::size_t HuffmanLength(const std::string& value)
+    {
+        std::size_t bits = 0;
+        for (auto c : value)
+            bits += CodeLengths[static_cast<unsigned char>(c)];
+        return (bits + 7) / 8;
+    }
+
+    void EncodeHuffman(const std::string& value, std::string& out)
+    {
+        const auto& code = Huffman();
+        std::uint64_t bits = 0;
+        int pending = 0;
+        for (auto c : value)
+        {
+            auto symbol = static_cast<unsigned char>(c);
+            bits = (bits << CodeLengths[symbol]) | code.codes[symbol];
+            pending += CodeLengths[symbol];
+            while (pending >= 8)
+            {
+                pending -= 8;
+                out += static_cast<char>(bits >> pending);
+            }
+            bits &= (std::uint64_t(1) << pending) - 1;
+        }
+        if (pending > 0) // dopełnienie przedrostkiem EOS.
+            out += static_cast<char>((bits << (8 - pending)) | ((1U << (8 - pending)) - 1));
+    }
+
+    /// Koduje liczbę z przedrostkiem o długości prefix bitów, flags zajmują pozostałe bity pierwszego bajtu.
+    void EncodeInteger(std::uint64_t value, int prefix, unsigned char flags, std::string& out)
+    {
+        const std::uint64_t max = (1U << prefix) - 1;
+        if (value < max)
+        {
+            out += static_cast<char>(flags | value);
+            return;
+        }
+        out += static_cast<char>(flags | max);
+        for (value -= max; value >= 128; value /= 128)
+            out += static_cast<char>(value % 128 + 128);
+        out += static_cast<char>(value);
+    }
+
+    /// Dekoduje liczbę z przedrostkiem o długości prefix bitów.
+    bool DecodeInteger(const unsigned char*& data, const unsigned char* end, int prefix, std::uint64_t& value)
+    {
+        if (data == end)
+            return false;
+
+        const std::uint64_t max = (1U << prefix) - 1;
+        value = *data++ & max;
+        if (value < max)
+            return true;
+
+        for (int shift = 0; shift <= 28; shift += 7) // dłuższe wartości nie mieszczą się w żadnym z ograniczeń.
+        {
+            if (data == end)
+                return false;
+            auto byte = *data++;
+            value += static_cast<std::uint64_t>(byte & 127) << shift;
+            if (!(byte & 128))
+                return true;
+        }
+        return false;
+    }
+
+    bool DecodeString(const unsigned char*& data, const unsigned char* end, std::string& out)
+    {
+        if (data == end)
+            return false;
+
+        auto huffman = (*data & 0x80) != 0;
+        std::uint64_t length;
+        if (!DecodeInteger(data, end, 7, length) || length > static_cast<std::uint64_t>(end - data))
+            return false;
+
+        auto begin = data;
+        data += length;
+        if (!huffman)
+        {
+            out.assign(begin, data);
+            return true;
+        }
+        out.clear();
+        out.reserve(length * 8 / 5); // najkrótszy kod ma 5 bitów.
+        return DecodeHuffman(begin, static_cast<std::size_t>(length), out);
+    }
+
+    void EncodeString(const std::string& value, std::string& out)
+    {
+        auto length = HuffmanLength(value);
+        if (length < value.size())
+        {
+            EncodeInteger(length, 7, 0x80, out);
+            EncodeHuffman(value, out);
+        }
+        else
+        {
+            EncodeInteger(value.size(), 7, 0x00, out);
+            out += value;
+        }
+    }
+
+    /// Sprawdza czy nagłówek powtarza się między odpowiedziami na tyle, by dodać go do tablicy dynamicznej.
+    bool Indexable(const Http::Header& header)
+    {
+        static const char* const varying[] = { "content-length", "date", "etag", "last-modified", "set-cookie", "retry-after", "age", "expires" };
+        return header.second.size() <= MaxIndexedValue && std::none_of(std::begin(varying), std::end(varying),
+            [&header](const char* name) { return header.first == name; });
+    }
+
+    std::size_t EntrySize(const Http::Header& header)
+    {
+        return header.first.size() + header.second.size() + EntryOverhead;
+    }
+}
+
+Http::HpackTable::HpackTable(std::size_t capacity) : size(0), maxSize(capacity)
+{
+}
+
+const Http::Header* Http::HpackTable::at(std::size_t index) const
+{
+    if (index == 0)
+        return nullptr;
+    if (index <= StaticSize)
+        return &StaticTable[index - 1];
+    index -= StaticSize + 1;
+    return index < entries.size() ? &entries[index] : nullptr;
+}
+
+std::pair<std::size_t, bool> Http::HpackTable::find(const Header& header) const
+{
+    std::size_t named = 0;
+    for (std::size_t i = 0; i < StaticSize; ++i)
+    {
+        if (StaticTable[i].first != header.first)
+            continue;
+        if (StaticTable[i].second == header.second)
+            return std::make_pair(i + 1, true);
+        if (!named)
+            named = i + 1;
+    }
+    for (std::size_t i = 0; i < entries.size(); ++i)
+    {
+        if (entries[i].first != header.first)
+            continue;
+        if (entries[i].second == header.second)
+            return std::make_pair(StaticSize + 1 + i, true);
+        if (!named)
+            named = StaticSize + 1 + i;
+    }
+    return std::make_pair(named, false);
+}
+
+void Http::HpackTable::insert(Header header)
+{
+    auto entry = EntrySize(header);
+    if (entry > maxSize) // zbyt duży wpis opróżnia tablicę.
+    {
+        entries.clear();
+        size = 0;
+        return;
+    }
+    size += entry;
+    entries.push_front(std::move(header));
+    evict();
+}
+
+void Http::HpackTable::resize(std::size_t capacity)
+{
+    maxSize = capacity;
+    evict();
+}
+
+std::size_t Http::HpackTable::capacity() const
+{
+    return maxSize;
+}
+
+void Http::HpackTable::evict()
+{
+    while (size > maxSize)
+    {
+        size -= EntrySize(entries.back());
+        entries.pop_back();
+    }
+}
+
+Http::HpackDecoder::HpackDecoder(std::size_t maxTableSize) : table(maxTableSize), maxTableSize(maxTableSize)
+{
+}
+
+bool Http::HpackDecoder::decode(const char* data, std::size_t size, HeaderContainer& headers)
+{
+    bool exceeded;
+    return decode(data, size, headers, std::numeric_limits<std::size_t>::max(), std::numeric_limits<std::size_t>::max(), exceeded);
+}
+
+bool Http::HpackDecoder::decode(const char* data, std::size_t size, HeaderContainer& headers, std::size_t maxListSize, std::size_t maxCount, bool& exceeded)
+{
+    std::size_t listSize = 0, count = 0;
+    exceeded = false;
+    auto accept = [&](const Header& header)
+    {
+        if (exceeded)
+            return false;
+        listSize += EntrySize(header);
+        count += header.first.empty() || header.first[0] != ':';
+        if (listSize <= maxListSize && count <= maxCount)
+            return true;
+        exceeded = true;
+        headers.clear(); // Zapytanie zostanie odrzucone - dalsze nagłówki nie są przechowywane.
+        return false;
+    };
+
+    auto begin = reinterpret_cast<const unsigned char*>(data);
+    auto end = begin + size;
+    auto fields = false; // zmiana rozmiaru tablicy może wystąpić wyłącznie przed nagłówkami.
+    while (begin != end)
+    {
+        auto byte = *begin;
+        std::uint64_t index;
+        if (byte & 0x80) // nagłówek z tablicy.
+        {
+            if (!DecodeInteger(begin, end, 7, index))
+                return false;
+            auto header = table.at(static_cast<std::size_t>(index));
+            if (!header)
+                return false;
+            if (accept(*header))
+                headers.push_back(*header);
+            fields = true;
+            continue;
+        }
+        if ((byte & 0xe0) == 0x20) // zmiana rozmiaru tablicy dynamicznej.
+        {
+            if (fields || !DecodeInteger(begin, end, 5, index) || index > maxTableSize)
+                return false;
+            table.resize(static_cast<std::size_t>(index));
+            continue;
+        }
+
+        auto indexing = (byte & 0xc0) == 0x40; // w przeciwnym razie literał bez indeksowania lub nigdy nieindeksowany.
+        if (!DecodeInteger(begin, end, indexing ? 6 : 4, index))
+            return false;
+        Header header;
+        if (index)
+        {
+            auto named = table.at(static_cast<std::size_t>(index));
+            if (!named)
+                return false;
+            header.first = named->first;
+        }
+        else if (!DecodeString(begin, end, header.first))
+            return false;
+        if (!DecodeString(begin, end, header.second))
+            return false;
+
+        if (indexing)
+            table.insert(header);
+        if (accept(header))
+            headers.push_back(std::move(header));
+        fields = true;
+    }
+    return true;
+}
+
+Http::HpackEncoder::HpackEncoder(std::size_t maxTableSize) : table(std::min<std::size_t>(maxTableSize, 4096U)), maxTableSize(maxTableSize), resized(maxTableSize < 4096U)
+{
+}
+
+void Http::HpackEncoder::setMaxTableSize(std::size_t size)
+{
+    auto capacity = std::min(size, maxTableSize);
+    if (capacity == table.capacity())
+        return;
+    table.resize(capacity);
+    resized = true;
+}
+
+void Http::HpackEncoder::encode(const HeaderContainer& headers, std::string& block)
+{
+    if (resized)
+    {
+        EncodeInteger(table.capacity(), 5, 0x20, block);
+        resized = false;
+    }
+
+    for (const auto& header : headers)
+    {
+        auto found = table.find(header);
+        if (found.second)
+        {
+            EncodeInteger(found.first, 7, 0x80, block);
+            continue;
+        }
+
+        auto indexed = Indexable(header);
+        EncodeInteger(found.first, indexed ? 6 : 4, indexed ? 0x40 : 0x00, block);
+        if (!found.first)
+            EncodeString(header.first, block);
+        EncodeString(header.second, block);
+        if (indexed)
+            table.insert(header);
+    }
+}
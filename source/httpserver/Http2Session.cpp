@@ -0,0 +1,761 @@
+#include "ServerUtilities.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+    /// Typy ramek HTTP/2.
+    enum FrameType : std::uint8_t
+    {
+        Data = 0x0,
+        Headers = 0x1,
+        Priority = 0x2,
+        ResetStream = 0x3,
+        Settings = 0x4,
+        PushPromise = 0x5,
+        Ping = 0x6,
+        GoAway = 0x7,
+        WindowUpdate = 0x8,
+        Continuation = 0x9
+    };
+
+    /// Flagi ramek, Ack dotyczy ramek SETTINGS i PING.
+    enum FrameFlag : std::uint8_t
+    {
+        EndStream = 0x1,
+        Ack = 0x1,
+        EndHeaders = 0x4,
+        Padded = 0x8,
+        PriorityFlag = 0x20
+    };
+
+    /// Identyfikatory parametrów ramki SETTINGS.
+    enum Setting : std::uint16_t
+    {
+        HeaderTableSize = 0x1,
+        EnablePush = 0x2,
+        MaxConcurrentStreams = 0x3,
+        InitialWindowSize = 0x4,
+        MaxFrameSize = 0x5,
+        MaxHeaderListSize = 0x6
+    };
+
+    constexpr std::size_t FrameHeaderSize = 9;
+    /// Domyślny rozmiar ramki, serwer nie ogłasza większego.
+    constexpr std::size_t DefaultFrameSize = 16384;
+    constexpr std::size_t LargestFrameSize = (1 << 24) - 1;
+    /// Początkowe okno kontroli przepływu zdefiniowane przez protokół.
+    constexpr std::int64_t DefaultWindow = 65535;
+    constexpr std::int64_t LargestWindow = 0x7fffffff;
+    /// Okno ogłaszane klientowi dla połączenia i strumieni - ciało zapytania (np. obraz) nie oczekuje na WINDOW_UPDATE po każdych 64 KiB.
+    constexpr std::int64_t LocalWindow = 1 << 20;
+
+    /// Pozostała część wstępu połączenia, następująca po zapytaniu PRI * HTTP/2.0.
+    const std::string PrefaceTail = "SM\r\n\r\n";
+
+    std::uint32_t ReadUint32(const char* data)
+    {
+        auto bytes = reinterpret_cast<const unsigned char*>(data);
+        return (std::uint32_t(bytes[0]) << 24) | (std::uint32_t(bytes[1]) << 16) | (std::uint32_t(bytes[2]) << 8) | bytes[3];
+    }
+
+    void AppendUint32(std::string& out, std::uint32_t value)
+    {
+        out += static_cast<char>(value >> 24);
+        out += static_cast<char>(value >> 16);
+        out += static_cast<char>(value >> 8);
+        out += static_cast<char>(value);
+    }
+
+    void AppendSetting(std::string& out, Setting setting, std::uint32_t value)
+    {
+        out += static_cast<char>(setting >> 8);
+        out += static_cast<char>(setting);
+        AppendUint32(out, value);
+    }
+
+    std::string Lowercase(std::string name)
+    {
+        std::transform(name.begin(), name.end(), name.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+        return name;
+    }
+
+    /// Zwraca nazwę nagłówka w zapisie HTTP/1 (content-type - Content-Type).
+    std::string Canonical(std::string name)
+    {
+        auto upper = true;
+        for (auto& c : name)
+        {
+            if (upper)
+                c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            upper = c == '-';
+        }
+        return name;
+    }
+
+    /// Sprawdza czy nagłówek dotyczy wyłącznie połączenia HTTP/1 - nie może wystąpić w HTTP/2.
+    bool ConnectionSpecific(const std::string& name)
+    {
+        return name == "connection" || name == "keep-alive" || name == "proxy-connection" || name == "transfer-encoding" || name == "upgrade";
+    }
+}
+
+Http::Http2Session::Http2Session(Writer writer, Dispatcher dispatcher, const BodyLimits& bodyLimits, const RequestLimits& limits, std::uint32_t maxStreams) :
+    writer(std::move(writer)),
+    dispatcher(std::move(dispatcher)),
+    bodyLimits(bodyLimits),
+    limits(limits),
+    maxStreams(maxStreams),
+    preface(0),
+    configured(false),
+    lastStream(0),
+    headerStream(0),
+    headerEnd(false),
+    sendWindow(DefaultWindow),
+    receiveWindow(LocalWindow),
+    initialWindow(DefaultWindow),
+    maxFrame(DefaultFrameSize),
+    closing(false),
+    failed(false),
+    peerClosing(false),
+    released(0)
+{
+    std::string settings;
+    AppendSetting(settings, MaxConcurrentStreams, maxStreams);
+    AppendSetting(settings, InitialWindowSize, static_cast<std::uint32_t>(LocalWindow));
+    AppendSetting(settings, MaxHeaderListSize, static_cast<std::uint32_t>(std::min<std::size_t>(limits.maxHeaderSize, LargestWindow)));
+    write(Settings, 0, 0, settings.data(), settings.size());
+
+    std::string increment; // okno połączenia zmieniane jest wyłącznie przez WINDOW_UPDATE.
+    AppendUint32(increment, static_cast<std::uint32_t>(LocalWindow - DefaultWindow));
+    write(WindowUpdate, 0, 0, increment.data(), increment.size());
+}
+
+bool Http::Http2Session::consume(const char* begin, const char* end)
+{
+    if (failed)
+        return false;
+
+    while (preface < PrefaceTail.size() && begin != end)
+    {
+        if (*begin++ != PrefaceTail[preface++])
+        {
+            fail(Error::Protocol);
+            flush();
+            return false;
+        }
+    }
+
+    auto buffered = !input.empty(); // niekompletna ramka łączona jest z nowymi danymi.
+    if (buffered)
+    {
+        input.append(begin, end);
+        begin = input.data();
+        end = begin + input.size();
+    }
+
+    auto good = true;
+    while (good && static_cast<std::size_t>(end - begin) >= FrameHeaderSize)
+    {
+        auto bytes = reinterpret_cast<const unsigned char*>(begin);
+        std::size_t size = (std::size_t(bytes[0]) << 16) | (std::size_t(bytes[1]) << 8) | bytes[2];
+        if (size > DefaultFrameSize)
+        {
+            good = fail(Error::FrameSize);
+            break;
+        }
+        if (static_cast<std::size_t>(end - begin) < FrameHeaderSize + size)
+            break;
+
+        good = frame(bytes[3], bytes[4], ReadUint32(begin + 5) & 0x7fffffff, begin + FrameHeaderSize, size);
+        begin += FrameHeaderSize + size;
+    }
+
+    if (!good)
+        input.clear();
+    else if (buffered)
+        input.erase(0, begin - input.data());
+    else
+        input.assign(begin, end);
+    flush();
+    return good;
+}
+
+void Http::Http2Session::respond(std::uint32_t stream, const Response& response)
+{
+    auto found = streams.find(stream);
+    if (found == streams.end() || found->second.responded)
+    {
+        flush();
+        return;
+    }
+
+    auto streaming = response.streaming();
+    HeaderContainer headers;
+    headers.reserve(response.headers.size() + 2);
+    headers.push_back(Header(":status", std::to_string(static_cast<int>(response.status()))));
+    auto length = false;
+    for (const auto& header : response.headers)
+    {
+        auto name = Lowercase(header.first);
+        if (ConnectionSpecific(name))
+            continue;
+        length = length || name == "content-length";
+        headers.push_back(Header(std::move(name), header.second));
+    }
+    if (!streaming && !length && !response.body().empty())
+        headers.push_back(Header("content-length", std::to_string(response.body().size())));
+
+    std::string block;
+    encoder.encode(headers, block);
+
+    auto& current = found->second;
+    current.responded = true;
+    current.streamed = streaming;
+    if (!streaming && response.body().empty())
+    {
+        writeHeaders(stream, block, true);
+        complete(found);
+    }
+    else
+    {
+        writeHeaders(stream, block, false);
+        if (!streaming)
+        {
+            current.pending = response.body();
+            current.ended = true;
+        }
+        transmit(stream);
+    }
+    flush();
+}
+
+void Http::Http2Session::data(std::uint32_t stream, std::string data, bool end)
+{
+    auto found = streams.find(stream);
+    if (found == streams.end())
+    {
+        released += data.size(); // strumień przerwany przez klienta.
+    }
+    else
+    {
+        auto& current = found->second;
+        current.pending.erase(0, current.offset);
+        current.offset = 0;
+        if (current.pending.empty())
+            current.pending = std::move(data);
+        else
+            current.pending += data;
+        current.ended = end;
+        transmit(stream);
+    }
+    flush();
+}
+
+void Http::Http2Session::reset(std::uint32_t stream)
+{
+    if (streams.count(stream))
+        abort(stream, Error::Internal);
+    flush();
+}
+
+void Http::Http2Session::goAway()
+{
+    if (closing || failed)
+        return;
+
+    closing = true;
+    std::string payload;
+    AppendUint32(payload, lastStream); // strumienie do lastStream zostaną obsłużone.
+    AppendUint32(payload, static_cast<std::uint32_t>(Error::NoError));
+    write(GoAway, 0, 0, payload.data(), payload.size());
+    flush();
+}
+
+bool Http::Http2Session::idle() const
+{
+    return streams.empty();
+}
+
+bool Http::Http2Session::receiving() const
+{
+    return headerStream || std::any_of(streams.begin(), streams.end(), [](const std::pair<const std::uint32_t, Stream>& stream) { return !stream.second.received; });
+}
+
+bool Http::Http2Session::finished() const
+{
+    return failed || ((closing || peerClosing) && streams.empty());
+}
+
+bool Http::Http2Session::frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size)
+{
+    if (!configured && type != Settings)
+        return fail(Error::Protocol); // wstęp klienta kończy się ramką SETTINGS.
+    if (headerStream && (type != Continuation || stream != headerStream))
+        return fail(Error::Protocol); // blok nagłówków nie może zostać przerwany inną ramką.
+
+    switch (type)
+    {
+    case Data:
+        return onData(flags, stream, payload, size);
+    case Headers:
+        return onHeaders(flags, stream, payload, size);
+    case Priority: // priorytety nie wpływają na kolejność odpowiedzi.
+        if (!stream)
+            return fail(Error::Protocol);
+        if (size != 5)
+            abort(stream, Error::FrameSize);
+        return true;
+    case ResetStream:
+    {
+        if (!stream || stream > lastStream)
+            return fail(Error::Protocol);
+        if (size != 4)
+            return fail(Error::FrameSize);
+        auto found = streams.find(stream);
+        if (found != streams.end())
+            close(found);
+        return true;
+    }
+    case Settings:
+        return onSettings(flags, stream, payload, size);
+    case PushPromise:
+        return fail(Error::Protocol);
+    case Ping:
+        if (stream)
+            return fail(Error::Protocol);
+        if (size != 8)
+            return fail(Error::FrameSize);
+        if (!(flags & Ack))
+            write(Ping, Ack, 0, payload, size);
+        return true;
+    case GoAway:
+        if (stream)
+            return fail(Error::Protocol);
+        if (size < 8)
+            return fail(Error::FrameSize);
+        peerClosing = true;
+        return true;
+    case WindowUpdate:
+        return onWindowUpdate(stream, payload, size);
+    case Continuation:
+    {
+        if (!headerStream)
+            return fail(Error::Protocol);
+        headerBlock.append(payload, size);
+        if (headerBlock.size() > limits.maxHeaderSize + DefaultFrameSize)
+            return fail(Error::EnhanceYourCalm);
+        if (!(flags & EndHeaders))
+            return true;
+        headerStream = 0;
+        return headers(stream, headerEnd);
+    }
+    default:
+        return true; // nieznane typy ramek są pomijane.
+    }
+}
+
+bool Http::Http2Session::onData(std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size)
+{
+    if (!stream || stream > lastStream)
+        return fail(Error::Protocol);
+
+    receiveWindow -= size; // okno obejmuje również dopełnienie.
+    if (receiveWindow < 0)
+        return fail(Error::FlowControl);
+    if (receiveWindow <= LocalWindow / 2)
+    {
+        std::string increment;
+        AppendUint32(increment, static_cast<std::uint32_t>(LocalWindow - receiveWindow));
+        write(WindowUpdate, 0, 0, increment.data(), increment.size());
+        receiveWindow = LocalWindow;
+    }
+
+    auto data = payload;
+    auto length = size;
+    if (flags & Padded)
+    {
+        if (!size || static_cast<unsigned char>(payload[0]) >= size)
+            return fail(Error::Protocol);
+        data = payload + 1;
+        length = size - 1 - static_cast<unsigned char>(payload[0]);
+    }
+
+    auto found = streams.find(stream);
+    if (found == streams.end())
+        return true; // dane wysłane przed odebraniem RST_STREAM są pomijane.
+
+    auto& current = found->second;
+    if (current.received)
+    {
+        abort(stream, Error::StreamClosed);
+        return true;
+    }
+    current.receiveWindow -= size;
+    if (current.receiveWindow < 0)
+    {
+        abort(stream, Error::FlowControl);
+        return true;
+    }
+    if (current.request.content.size() + length > bodyLimits.maxSize)
+    {
+        reject(stream, ResponseStatus::RequestEntityTooLarge);
+        return true;
+    }
+    current.request.content.append(data, length);
+
+    if (flags & EndStream)
+    {
+        current.received = true;
+        dispatcher(stream, std::move(current.request));
+    }
+    else if (current.receiveWindow <= LocalWindow / 2)
+    {
+        std::string increment;
+        AppendUint32(increment, static_cast<std::uint32_t>(LocalWindow - current.receiveWindow));
+        write(WindowUpdate, 0, stream, increment.data(), increment.size());
+        current.receiveWindow = LocalWindow;
+    }
+    return true;
+}
+
+bool Http::Http2Session::onHeaders(std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size)
+{
+    if (!stream || stream % 2 == 0)
+        return fail(Error::Protocol); // strumienie klienta mają nieparzyste identyfikatory.
+
+    std::size_t skip = 0, padding = 0;
+    if (flags & Padded)
+    {
+        if (!size)
+            return fail(Error::FrameSize);
+        padding = static_cast<unsigned char>(payload[0]);
+        skip = 1;
+    }
+    if (flags & PriorityFlag)
+        skip += 5;
+    if (skip + padding > size)
+        return fail(Error::Protocol);
+
+    headerBlock.assign(payload + skip, size - skip - padding);
+    headerEnd = (flags & EndStream) != 0;
+    if (flags & EndHeaders)
+        return headers(stream, headerEnd);
+
+    headerStream = stream;
+    return headerBlock.size() <= limits.maxHeaderSize + DefaultFrameSize || fail(Error::EnhanceYourCalm);
+}
+
+bool Http::Http2Session::onSettings(std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size)
+{
+    if (stream)
+        return fail(Error::Protocol);
+    if (flags & Ack)
+        return size == 0 || fail(Error::FrameSize);
+    if (size % 6)
+        return fail(Error::FrameSize);
+
+    for (std::size_t offset = 0; offset < size; offset += 6)
+    {
+        auto setting = static_cast<std::uint16_t>((static_cast<unsigned char>(payload[offset]) << 8) | static_cast<unsigned char>(payload[offset + 1]));
+        auto value = ReadUint32(payload + offset + 2);
+        switch (setting)
+        {
+        case HeaderTableSize:
+            encoder.setMaxTableSize(value);
+            break;
+        case EnablePush:
+            if (value > 1)
+                return fail(Error::Protocol);
+            break;
+        case InitialWindowSize:
+            if (value > LargestWindow)
+                return fail(Error::FlowControl);
+            for (auto& current : streams) // zmiana dotyczy również otwartych strumieni, ich okna mogą stać się ujemne.
+            {
+                current.second.sendWindow += value - initialWindow;
+                if (current.second.sendWindow > LargestWindow)
+                    return fail(Error::FlowControl);
+            }
+            initialWindow = value;
+            break;
+        case MaxFrameSize:
+            if (value < DefaultFrameSize || value > LargestFrameSize)
+                return fail(Error::Protocol);
+            maxFrame = value;
+            break;
+        default: // pozostałe ustawienia dotyczą wyłącznie klienta.
+            break;
+        }
+    }
+
+    configured = true;
+    write(Settings, Ack, 0, nullptr, 0);
+    transmit();
+    return true;
+}
+
+bool Http::Http2Session::onWindowUpdate(std::uint32_t stream, const char* payload, std::size_t size)
+{
+    if (size != 4)
+        return fail(Error::FrameSize);
+
+    auto increment = ReadUint32(payload) & 0x7fffffff;
+    if (!stream)
+    {
+        if (!increment)
+            return fail(Error::Protocol);
+        sendWindow += increment;
+        if (sendWindow > LargestWindow)
+            return fail(Error::FlowControl);
+        transmit();
+        return true;
+    }
+
+    if (stream > lastStream)
+        return fail(Error::Protocol);
+    auto found = streams.find(stream);
+    if (found == streams.end())
+        return true;
+    if (!increment)
+    {
+        abort(stream, Error::Protocol);
+        return true;
+    }
+    found->second.sendWindow += increment;
+    if (found->second.sendWindow > LargestWindow)
+    {
+        abort(stream, Error::FlowControl);
+        return true;
+    }
+    transmit(stream);
+    return true;
+}
+
+bool Http::Http2Session::headers(std::uint32_t stream, bool end)
+{
+    HeaderContainer decoded;
+    bool exceeded;
+    auto decodedBlock = decoder.decode(headerBlock.data(), headerBlock.size(), decoded, limits.maxHeaderSize, limits.maxHeaderCount, exceeded); // również dla pomijanych strumieni.
+    headerBlock.clear();
+    if (!decodedBlock)
+        return fail(Error::Compression);
+
+    auto found = streams.find(stream);
+    if (found != streams.end()) // nagłówki końcowe są pomijane.
+    {
+        if (found->second.received)
+            abort(stream, Error::StreamClosed);
+        else if (!end)
+            abort(stream, Error::Protocol);
+        else
+        {
+            found->second.received = true;
+            dispatcher(stream, std::move(found->second.request));
+        }
+        return true;
+    }
+    if (stream <= lastStream)
+        return true; // strumień zamknięty przez serwer.
+
+    lastStream = stream;
+    if (closing)
+        return true; // strumienie otwarte po GOAWAY nie są obsługiwane.
+    if (streams.size() >= maxStreams)
+    {
+        abort(stream, Error::RefusedStream);
+        return true;
+    }
+
+    auto& current = streams.emplace(stream, Stream()).first->second;
+    current.sendWindow = initialWindow;
+    current.receiveWindow = LocalWindow;
+    current.received = end;
+
+    if (exceeded)
+    {
+        reject(stream, ResponseStatus::RequestHeaderFieldsTooLarge);
+        return true;
+    }
+    if (!request(std::move(decoded), current.request))
+    {
+        abort(stream, Error::Protocol);
+        return true;
+    }
+
+    if (end)
+        dispatcher(stream, std::move(current.request));
+    return true;
+}
+
+bool Http::Http2Session::request(HeaderContainer headers, Request& request) const
+{
+    std::string scheme, authority, cookie;
+    auto regular = false;
+    for (auto& header : headers)
+    {
+        const auto& name = header.first;
+        if (std::any_of(name.begin(), name.end(), [](char c) { return std::isupper(static_cast<unsigned char>(c)); }))
+            return false;
+
+        if (!name.empty() && name[0] == ':')
+        {
+            std::string* target = nullptr;
+            if (name == ":method")
+                target = &request.requestLine.method;
+            else if (name == ":path")
+                target = &request.requestLine.uri.raw();
+            else if (name == ":scheme")
+                target = &scheme;
+            else if (name == ":authority")
+                target = &authority;
+            if (regular || !target || !target->empty()) // nieznany, powtórzony lub następujący po nagłówkach.
+                return false;
+            *target = std::move(header.second);
+            continue;
+        }
+
+        regular = true;
+        if (ConnectionSpecific(name) || (name == "te" && header.second != "trailers"))
+            return false;
+        if (name == "cookie") // ciasteczka mogą zostać podzielone na kilka pól.
+        {
+            cookie += (cookie.empty() ? "" : "; ") + header.second;
+            continue;
+        }
+        request.headerCollection.push_back(Header(Canonical(std::move(header.first)), std::move(header.second)));
+    }
+    if (request.requestLine.method.empty() || request.requestLine.uri.raw().empty() || scheme.empty())
+        return false;
+
+    if (!cookie.empty())
+        request.headerCollection.push_back(Header("Cookie", std::move(cookie)));
+    auto host = std::any_of(request.headerCollection.begin(), request.headerCollection.end(), [](const Header& header) { return header.first == "Host"; });
+    if (!authority.empty() && !host)
+        request.headerCollection.push_back(Header("Host", std::move(authority)));
+    request.requestLine.version = Version{ 2, 0 };
+    return true;
+}
+
+void Http::Http2Session::reject(std::uint32_t stream, ResponseStatus status)
+{
+    respond(stream, Response(status, "", ""));
+}
+
+void Http::Http2Session::transmit(std::uint32_t stream)
+{
+    auto found = streams.find(stream);
+    if (found == streams.end() || !found->second.responded)
+        return;
+
+    auto& current = found->second;
+    for (;;)
+    {
+        auto remaining = current.pending.size() - current.offset;
+        auto window = std::max<std::int64_t>(std::min(sendWindow, current.sendWindow), 0);
+        auto size = std::min(std::min(remaining, static_cast<std::size_t>(window)), maxFrame);
+        auto last = current.ended && size == remaining; // pusta ramka END_STREAM nie wymaga okna.
+        if (!size && !last)
+            return;
+
+        write(Data, last ? EndStream : 0, stream, current.pending.data() + current.offset, size);
+        current.offset += size;
+        sendWindow -= size;
+        current.sendWindow -= size;
+        if (current.streamed)
+            released += size;
+        if (current.offset == current.pending.size())
+        {
+            current.pending.clear();
+            current.offset = 0;
+        }
+        if (last)
+        {
+            complete(found);
+            return;
+        }
+    }
+}
+
+void Http::Http2Session::transmit()
+{
+    for (auto current = streams.begin(); current != streams.end();)
+        transmit((current++)->first); // strumień może zostać zamknięty.
+}
+
+void Http::Http2Session::complete(std::map<std::uint32_t, Stream>::iterator stream)
+{
+    if (stream->second.received)
+        close(stream);
+    else
+        abort(stream->first, Error::NoError); // odpowiedź wysłano przed końcem zapytania.
+}
+
+void Http::Http2Session::close(std::map<std::uint32_t, Stream>::iterator stream)
+{
+    if (stream->second.streamed)
+        released += stream->second.pending.size() - stream->second.offset;
+    streams.erase(stream);
+}
+
+void Http::Http2Session::abort(std::uint32_t stream, Error error)
+{
+    std::string payload;
+    AppendUint32(payload, static_cast<std::uint32_t>(error));
+    write(ResetStream, 0, stream, payload.data(), payload.size());
+
+    auto found = streams.find(stream);
+    if (found != streams.end())
+        close(found);
+}
+
+bool Http::Http2Session::fail(Error error)
+{
+    if (!failed)
+    {
+        failed = true;
+        std::string payload;
+        AppendUint32(payload, lastStream);
+        AppendUint32(payload, static_cast<std::uint32_t>(error));
+        write(GoAway, 0, 0, payload.data(), payload.size());
+    }
+    return false;
+}
+
+void Http::Http2Session::write(std::uint8_t type, std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size)
+{
+    output += static_cast<char>(size >> 16);
+    output += static_cast<char>(size >> 8);
+    output += static_cast<char>(size);
+    output += static_cast<char>(type);
+    output += static_cast<char>(flags);
+    AppendUint32(output, stream);
+    if (size)
+        output.append(payload, size);
+}
+
+void Http::Http2Session::writeHeaders(std::uint32_t stream, const std::string& block, bool end)
+{
+    std::size_t offset = 0;
+    do
+    {
+        auto size = std::min(block.size() - offset, maxFrame);
+        auto last = offset + size == block.size();
+        std::uint8_t flags = (last ? EndHeaders : 0) | (!offset && end ? EndStream : 0);
+        write(offset ? Continuation : Headers, flags, stream, block.data() + offset, size);
+        offset += size;
+    } while (offset < block.size());
+}
+
+void Http::Http2Session::flush()
+{
+    if (output.empty() && !released)
+        return;
+
+    std::string frames;
+    frames.swap(output);
+    auto bytes = released;
+    released = 0;
+    writer(std::move(frames), bytes);
+}
@@ -9,4 +9,8 @@
 #    define PATR_OS_UNIX
 #endif
 
+#if defined(__linux__) || defined(__linux) || defined(linux)
+#    define PATR_OS_LINUX
+#endif
+
 #endif // PATR_PREDEF_H
\ No newline at end of file
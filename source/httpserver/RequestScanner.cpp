@@ -0,0 +1,372 @@
+#include "ServerUtilities.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__AVX2__)
+#    include <immintrin.h>
+#    define PATR_SCAN_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    include <emmintrin.h>
+#    define PATR_SCAN_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#    include <intrin.h>
+#endif // defined(_MSC_VER)
+
+namespace {
+
+    /// Zwraca pozycję najmłodszego ustawionego bitu niezerowej maski.
+    int CountTrailingZeros(unsigned mask)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(mask);
+#endif
+    }
+
+    bool IsControl(char c)
+    {
+        return (c >= 0 && c <= 31) || (c == 127);
+    }
+
+    /// Tablica znaków dozwolonych w metodzie i nazwie nagłówka (zgodna z RequestParser).
+    struct TokenTable
+    {
+        TokenTable()
+        {
+            const char special[] = "()<>@,;:\\\"/[]?={} \t";
+            for (int c = 0; c < 256; ++c)
+                value[c] = c < 128 && !IsControl(static_cast<char>(c)) && !std::strchr(special, c);
+            value[0] = false; // strchr odnajduje kończący znak zerowy.
+        }
+
+        bool value[256];
+    };
+
+    const TokenTable Tokens;
+
+    bool IsToken(char c)
+    {
+        return Tokens.value[static_cast<unsigned char>(c)];
+    }
+
+    /// Wyszukuje pierwsze wystąpienie znaku w [begin, end), zwraca end w przypadku braku.
+    const char* Find(const char* begin, const char* end, char c)
+    {
+#if defined(PATR_SCAN_AVX2)
+        auto needle = _mm256_set1_epi8(c);
+        for (; end - begin >= 32; begin += 32)
+        {
+            auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+            auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+            if (mask)
+                return begin + CountTrailingZeros(mask);
+        }
+#elif defined(PATR_SCAN_SSE2)
+        auto needle = _mm_set1_epi8(c);
+        for (; end - begin >= 16; begin += 16)
+        {
+            auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+            if (mask)
+                return begin + CountTrailingZeros(mask);
+        }
+#endif
+        while (begin != end && *begin != c)
+            ++begin;
+        return begin;
+    }
+
+    /// Wyszukuje pierwszy znak kontrolny w [begin, end), zwraca end w przypadku braku.
+    const char* FindControl(const char* begin, const char* end)
+    {
+#if defined(PATR_SCAN_AVX2)
+        auto space = _mm256_set1_epi8(' '), negative = _mm256_set1_epi8(-1), del = _mm256_set1_epi8(127);
+        for (; end - begin >= 32; begin += 32)
+        {
+            auto block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+            auto control = _mm256_and_si256(_mm256_cmpgt_epi8(space, block), _mm256_cmpgt_epi8(block, negative)); // 0 <= c < 32
+            control = _mm256_or_si256(control, _mm256_cmpeq_epi8(block, del));
+            auto mask = static_cast<unsigned>(_mm256_movemask_epi8(control));
+            if (mask)
+                return begin + CountTrailingZeros(mask);
+        }
+#elif defined(PATR_SCAN_SSE2)
+        auto space = _mm_set1_epi8(' '), negative = _mm_set1_epi8(-1), del = _mm_set1_epi8(127);
+        for (; end - begin >= 16; begin += 16)
+        {
+            auto block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+            auto control = _mm_and_si128(_mm_cmplt_epi8(block, space), _mm_cmpgt_epi8(block, negative)); // 0 <= c < 32
+            control = _mm_or_si128(control, _mm_cmpeq_epi8(block, del));
+            auto mask = static_cast<unsigned>(_mm_movemask_epi8(control));
+            if (mask)
+                return begin + CountTrailingZeros(mask);
+        }
+#endif
+        while (begin != end && !IsControl(*begin))
+            ++begin;
+        return begin;
+    }
+
+    /// Odczytuje liczbę dziesiętną złożoną z co najmniej jednej cyfry.
+    bool ParseNumber(const char*& begin, const char* end, int& number)
+    {
+        if (begin == end || *begin < '0' || *begin > '9')
+            return false;
+
+        number = 0;
+        while (begin != end && *begin >= '0' && *begin <= '9')
+            number = number * 10 + *begin++ - '0';
+        return true;
+    }
+}
+
+std::string Http::Slice::str() const
+{
+    return std::string(data, size);
+}
+
+bool Http::Slice::equals(const char* text) const
+{
+    for (std::size_t i = 0; i < size; ++i)
+        if (text[i] == '\0' || text[i] != data[i])
+            return false;
+    return text[size] == '\0';
+}
+
+Http::RequestLimits::RequestLimits(std::size_t maxRequestLine, std::size_t maxHeaderSize, std::size_t maxHeaderCount, int headerTimeout, int bodyTimeout, std::size_t minRate) :
+    maxRequestLine(maxRequestLine),
+    maxHeaderSize(maxHeaderSize),
+    maxHeaderCount(maxHeaderCount),
+    headerTimeout(headerTimeout),
+    bodyTimeout(bodyTimeout),
+    minRate(minRate)
+{
+}
+
+Http::RequestScanner::RequestScanner(const RequestLimits& limits) : limits(limits)
+{
+    reset();
+}
+
+std::pair<Http::RequestScanner::Result, char*> Http::RequestScanner::parse(char* begin, char* end)
+{
+    if (buffer.empty()) // Nagłówek w całości w buforze połączenia - brak kopiowania.
+    {
+        auto result = scan(begin, static_cast<std::size_t>(end - begin));
+        if (result == Result::Good)
+        {
+            origin = begin;
+            return std::make_pair(result, begin + length);
+        }
+        if (result == Result::Indeterminate)
+            buffer.assign(begin, end); // Pozycje przetworzonych linii pozostają aktualne.
+        return std::make_pair(result, end);
+    }
+
+    auto previous = buffer.size();
+    buffer.insert(buffer.end(), begin, end);
+    auto result = scan(buffer.data(), buffer.size());
+    if (result == Result::Good)
+    {
+        origin = buffer.data();
+        return std::make_pair(result, begin + (length - previous)); // Pozostałe dane należą do ciała zapytania.
+    }
+    return std::make_pair(result, end);
+}
+
+void Http::RequestScanner::assign(Request& request) const
+{
+    request.requestLine.method.assign(origin + methodSpan.offset, methodSpan.size);
+    request.requestLine.uri.raw().assign(origin + uriSpan.offset, uriSpan.size);
+    request.requestLine.version = requestVersion;
+
+    request.headerCollection.clear();
+    request.headerCollection.reserve(headerSpans.size());
+    for (const auto& header : headerSpans)
+    {
+        request.headerCollection.emplace_back(
+            std::string(origin + header.first.offset, header.first.size),
+            std::string(origin + header.second.offset, header.second.size));
+    }
+}
+
+void Http::RequestScanner::reset()
+{
+    buffer.clear();
+    origin = nullptr;
+    scanned = 0;
+    searched = 0;
+    length = 0;
+    lineParsed = false;
+    headerBegin = 0;
+    error = ResponseStatus::BadRequest;
+    methodSpan = uriSpan = Span{ 0, 0 };
+    requestVersion = Version{ 0, 0 };
+    headerSpans.clear();
+}
+
+Http::ResponseStatus Http::RequestScanner::status() const
+{
+    return error;
+}
+
+Http::RequestScanner::Slice Http::RequestScanner::method() const
+{
+    return slice(methodSpan);
+}
+
+Http::RequestScanner::Slice Http::RequestScanner::uri() const
+{
+    return slice(uriSpan);
+}
+
+Http::Version Http::RequestScanner::version() const
+{
+    return requestVersion;
+}
+
+std::vector<Http::RequestScanner::HeaderSlice> Http::RequestScanner::headers() const
+{
+    std::vector<HeaderSlice> result;
+    result.reserve(headerSpans.size());
+    for (const auto& header : headerSpans)
+        result.push_back(std::make_pair(slice(header.first), slice(header.second)));
+    return result;
+}
+
+Http::RequestScanner::Result Http::RequestScanner::scan(char* base, std::size_t size)
+{
+    for (;;)
+    {
+        auto from = (std::max)(scanned, searched);
+        auto newline = static_cast<std::size_t>(Find(base + from, base + size, '\n') - base);
+        if (newline == size)
+        {
+            // Niezakończona linia może zawierać jeszcze jedynie znak CR.
+            if (!lineParsed && size - scanned > limits.maxRequestLine + 1)
+                return reject(ResponseStatus::RequestUriTooLarge);
+            if (lineParsed && size - headerBegin > limits.maxHeaderSize + 1)
+                return reject(ResponseStatus::RequestHeaderFieldsTooLarge);
+            searched = size; // Kolejne wywołanie przeszuka jedynie nowe dane.
+            return Result::Indeterminate;
+        }
+
+        if (newline == scanned || base[newline - 1] != '\r') // Każda linia kończy się CRLF.
+            return Result::Bad;
+
+        auto lineEnd = newline - 1;
+        if (!lineParsed)
+        {
+            if (lineEnd - scanned > limits.maxRequestLine)
+                return reject(ResponseStatus::RequestUriTooLarge);
+            if (!requestLine(base, scanned, lineEnd))
+                return Result::Bad;
+            lineParsed = true;
+            headerBegin = newline + 1;
+        }
+        else if (lineEnd == scanned) // Pusta linia kończy nagłówek.
+        {
+            length = newline + 1;
+            return Result::Good;
+        }
+        else if (newline + 1 - headerBegin > limits.maxHeaderSize)
+        {
+            return reject(ResponseStatus::RequestHeaderFieldsTooLarge);
+        }
+        else if (!headerLine(base, scanned, lineEnd))
+        {
+            return Result::Bad;
+        }
+        else if (headerSpans.size() > limits.maxHeaderCount)
+        {
+            return reject(ResponseStatus::RequestHeaderFieldsTooLarge);
+        }
+
+        scanned = newline + 1;
+    }
+}
+
+bool Http::RequestScanner::requestLine(char* base, std::size_t begin, std::size_t end)
+{
+    const char* line = base + begin;
+    const char* last = base + end;
+
+    auto methodEnd = Find(line, last, ' ');
+    if (methodEnd == line || methodEnd == last || !std::all_of(line, methodEnd, IsToken))
+        return false;
+
+    auto uriBegin = methodEnd + 1;
+    auto uriEnd = Find(uriBegin, last, ' ');
+    if (uriEnd == last || FindControl(uriBegin, uriEnd) != uriEnd)
+        return false;
+
+    auto version = uriEnd + 1;
+    if (last - version < 5 || std::memcmp(version, "HTTP/", 5) != 0)
+        return false;
+    version += 5;
+
+    if (!ParseNumber(version, last, requestVersion.major) || version == last || *version++ != '.')
+        return false;
+    if (!ParseNumber(version, last, requestVersion.minor) || version != last)
+        return false;
+
+    methodSpan = Span{ begin, static_cast<std::size_t>(methodEnd - line) };
+    uriSpan = Span{ static_cast<std::size_t>(uriBegin - base), static_cast<std::size_t>(uriEnd - uriBegin) };
+    return true;
+}
+
+bool Http::RequestScanner::headerLine(char* base, std::size_t begin, std::size_t end)
+{
+    char* line = base + begin;
+    char* last = base + end;
+
+    if (*line == ' ' || *line == '\t') // Kontynuacja wartości poprzedniego nagłówka.
+    {
+        if (headerSpans.empty())
+            return false;
+
+        while (line != last && (*line == ' ' || *line == '\t'))
+            ++line;
+        if (FindControl(line, last) != last)
+            return false;
+
+        auto& value = headerSpans.back().second;
+        auto appended = static_cast<std::size_t>(last - line);
+        std::memmove(base + value.offset + value.size, line, appended); // Scala wartość w miejscu, przed bieżącą linią.
+        value.size += appended;
+        return true;
+    }
+
+    const char* name = line;
+    auto nameEnd = Find(name, last, ':');
+    if (nameEnd == name || nameEnd == last || !std::all_of(name, nameEnd, IsToken))
+        return false;
+    if (last - nameEnd < 2 || nameEnd[1] != ' ')
+        return false;
+
+    auto value = nameEnd + 2;
+    if (FindControl(value, last) != last)
+        return false;
+
+    headerSpans.push_back(std::make_pair(
+        Span{ begin, static_cast<std::size_t>(nameEnd - name) },
+        Span{ static_cast<std::size_t>(value - base), static_cast<std::size_t>(last - value) }));
+    return true;
+}
+
+Http::RequestScanner::Slice Http::RequestScanner::slice(const Span& span) const
+{
+    return Slice{ origin + span.offset, span.size };
+}
+
+Http::RequestScanner::Result Http::RequestScanner::reject(ResponseStatus status)
+{
+    error = status;
+    return Result::Bad;
+}
@@ -0,0 +1,141 @@
+#include "Socket.h"
+
+#include <algorithm>
+
+#include "Predef.h"
+
+#if defined(PATR_OS_WINDOWS)
+#    include <winsock2.h>
+#    include <ws2tcpip.h>
+#elif defined(PATR_OS_UNIX)
+#    include <sys/types.h>
+#    include <sys/socket.h>
+#    include <netdb.h>
+#else
+#    error "Unrecognised OS"
+#endif
+
+Tcp::Resolver::Resolver(std::chrono::seconds ttl, std::chrono::seconds negativeTtl, std::size_t capacity, Lookup lookup) :
+    ttl(ttl),
+    negativeTtl(negativeTtl),
+    capacity(std::max<std::size_t>(capacity, 1)),
+    lookup(std::move(lookup)),
+    counters()
+{
+}
+
+Tcp::Resolver::Result Tcp::Resolver::resolve(const std::string& host, const std::string& port)
+{
+    auto key = host + ':' + port;
+    std::shared_future<Result> cached;
+    std::promise<Result> promise;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto now = Clock::now();
+        auto entry = entries.find(key);
+        if (entry != entries.end() && now < entry->second.expires)
+        {
+            if (entry->second.expires == Clock::time_point::max())
+                ++counters.coalesced;
+            else
+                ++counters.hits;
+            cached = entry->second.result;
+        }
+        else
+        {
+            if (entry == entries.end())
+                evict(now);
+            auto& pending = entries[key];
+            pending.result = promise.get_future().share();
+            pending.expires = Clock::time_point::max();
+            ++counters.lookups;
+        }
+    }
+
+    // Oczekiwanie na trwające rozwiązanie odbywa się poza blokadą, zapamiętane niepowodzenie zgłaszane jest ponownie.
+    if (cached.valid())
+        return cached.get();
+
+    auto complete = [this, &key](std::chrono::seconds validity)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto entry = entries.find(key);
+        if (entry != entries.end())
+            entry->second.expires = Clock::now() + validity;
+    };
+
+    try
+    {
+        auto result = lookup(host, port);
+        promise.set_value(result);
+        complete(ttl);
+        return result;
+    }
+    catch (...)
+    {
+        promise.set_exception(std::current_exception());
+        complete(negativeTtl);
+        throw;
+    }
+}
+
+void Tcp::Resolver::evict(Clock::time_point now)
+{
+    for (auto entry = entries.begin(); entry != entries.end();)
+    {
+        if (entry->second.expires <= now)
+            entry = entries.erase(entry);
+        else
+            ++entry;
+    }
+
+    while (entries.size() >= capacity)
+    {
+        auto earliest = std::min_element(entries.begin(), entries.end(),
+            [](const std::pair<const std::string, Entry>& a, const std::pair<const std::string, Entry>& b) { return a.second.expires < b.second.expires; });
+        if (earliest->second.expires == Clock::time_point::max())
+            break; // wszystkie wpisy są w trakcie rozwiązywania.
+        entries.erase(earliest);
+    }
+}
+
+void Tcp::Resolver::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto entry = entries.begin(); entry != entries.end();)
+    {
+        // Trwające rozwiązania pozostają, aby oczekujące na nie zapytania nie zostały powtórzone.
+        if (entry->second.expires != Clock::time_point::max())
+            entry = entries.erase(entry);
+        else
+            ++entry;
+    }
+}
+
+Tcp::Resolver::Statistics Tcp::Resolver::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+Tcp::Resolver::Result Tcp::Resolver::SystemLookup(const std::string& host, const std::string& port)
+{
+    auto hints = addrinfo();
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo* addresses = nullptr;
+    auto result = getaddrinfo(host.c_str(), port.c_str(), &hints, &addresses);
+    if (result != 0)
+    {
+        std::string errinfo = "getaddrinfo failed: ";
+        //errinfo += gai_strerror(result);
+        throw EndpointError(errinfo + host);
+    }
+    return Result(addresses, freeaddrinfo);
+}
+
+Tcp::Resolver& Tcp::Resolver::Shared()
+{
+    static Resolver resolver;
+    return resolver;
+}
@@ -5,32 +5,223 @@
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <cctype>
+#include <deque>
+#include <exception>
+#include <array>
+#include <condition_variable>
+
+#if defined(PATR_OS_UNIX)
+#    include <signal.h>
+#    include <cstdlib>
+#    include <fcntl.h>
+#    include <unistd.h>
+extern char** environ;
+#endif // defined(PATR_OS_UNIX)
 
 namespace {
 
-    std::map<Http::Response::Status, std::string> StockResponse = {
-    { Http::Response::Status::Ok, "HTTP/1.0 200 OK\r\n" },
-    { Http::Response::Status::Created, "HTTP/1.0 201 Created\r\n" },
-    { Http::Response::Status::Accepted, "HTTP/1.0 202 Accepted\r\n" },
-    { Http::Response::Status::NoContent, "HTTP/1.0 204 No Content\r\n" },
-    { Http::Response::Status::MultipleChoices, "HTTP/1.0 300 Multiple Choices\r\n" },
-    { Http::Response::Status::MovedPermanently, "HTTP/1.0 301 Moved Permanently\r\n" },
-    { Http::Response::Status::Found, "HTTP/1.0 302 Found\r\n" },
-    { Http::Response::Status::NotModified, "HTTP/1.0 304 Not Modified\r\n" },
-    { Http::Response::Status::BadRequest, "HTTP/1.0 400 Bad request\r\n" },
-    { Http::Response::Status::Unauthorized, "HTTP/1.0 401 Unauthorized\r\n" },
-    { Http::Response::Status::Forbidden, "HTTP/1.0 403 Forbidden\r\n" },
-    { Http::Response::Status::NotFound, "HTTP/1.0 404 Not Found\r\n" },
-    { Http::Response::Status::RequestTimeout, "HTTP/1.0 408 Request Timeout\r\n" },
-    { Http::Response::Status::InternalServerError, "HTTP/1.0 500 Internal Server Error\r\n" },
-    { Http::Response::Status::NotImplemented, "HTTP/1.0 501 Not Implemented\r\n" },
-    { Http::Response::Status::BadGateway, "HTTP/1.0 502 Bad Gateway\r\n" },
-    { Http::Response::Status::ServiceUnavailable, "HTTP/1.0 503 Service Unavailable\r\n" }
+    /// Zwraca opis statusu zgodny z RFC 7231, pusty dla kodów spoza Http::ResponseStatus.
+    const char* ReasonPhrase(int code)
+    {
+        switch (static_cast<Http::Response::Status>(code))
+        {
+        case Http::Response::Status::Continue: return "Continue";
+        case Http::Response::Status::SwitchingProtocols: return "Switching Protocols";
+        case Http::Response::Status::Ok: return "OK";
+        case Http::Response::Status::Created: return "Created";
+        case Http::Response::Status::Accepted: return "Accepted";
+        case Http::Response::Status::NonAuthoritativeInformation: return "Non-Authoritative Information";
+        case Http::Response::Status::NoContent: return "No Content";
+        case Http::Response::Status::ResetContent: return "Reset Content";
+        case Http::Response::Status::PartialContent: return "Partial Content";
+        case Http::Response::Status::MultipleChoices: return "Multiple Choices";
+        case Http::Response::Status::MovedPermanently: return "Moved Permanently";
+        case Http::Response::Status::Found: return "Found";
+        case Http::Response::Status::SeeOther: return "See Other";
+        case Http::Response::Status::NotModified: return "Not Modified";
+        case Http::Response::Status::UseProxy: return "Use Proxy";
+        case Http::Response::Status::TemporaryRedirect: return "Temporary Redirect";
+        case Http::Response::Status::BadRequest: return "Bad request";
+        case Http::Response::Status::Unauthorized: return "Unauthorized";
+        case Http::Response::Status::PaymentRequired: return "Payment Required";
+        case Http::Response::Status::Forbidden: return "Forbidden";
+        case Http::Response::Status::NotFound: return "Not Found";
+        case Http::Response::Status::MethodNotAllowed: return "Method Not Allowed";
+        case Http::Response::Status::NotAcceptable: return "Not Acceptable";
+        case Http::Response::Status::ProxyAuthenticationRequired: return "Proxy Authentication Required";
+        case Http::Response::Status::RequestTimeout: return "Request Timeout";
+        case Http::Response::Status::Conflict: return "Conflict";
+        case Http::Response::Status::Gone: return "Gone";
+        case Http::Response::Status::LengthRequired: return "Length Required";
+        case Http::Response::Status::PreconditionFailed: return "Precondition Failed";
+        case Http::Response::Status::RequestEntityTooLarge: return "Request Entity Too Large";
+        case Http::Response::Status::RequestUriTooLarge: return "Request-URI Too Large";
+        case Http::Response::Status::UnsupportedMediaType: return "Unsupported Media Type";
+        case Http::Response::Status::RequestedRangeNotSatisfiable: return "Requested Range Not Satisfiable";
+        case Http::Response::Status::ExpectationFailed: return "Expectation Failed";
+        case Http::Response::Status::RequestHeaderFieldsTooLarge: return "Request Header Fields Too Large";
+        case Http::Response::Status::InternalServerError: return "Internal Server Error";
+        case Http::Response::Status::NotImplemented: return "Not Implemented";
+        case Http::Response::Status::BadGateway: return "Bad Gateway";
+        case Http::Response::Status::ServiceUnavailable: return "Service Unavailable";
+        case Http::Response::Status::GatewayTimeout: return "Gateway Timeout";
+        case Http::Response::Status::HttpVersionNotSupported: return "HTTP Version Not Supported";
+        }
+        return "";
+    }
+
+    /// Statyczna tablica linii statusu indeksowana kodem odpowiedzi.
+    /**
+     * Linie tworzone są jednokrotnie, kolejne odpowiedzi jedynie wskazują na nie w sekwencji buforów.
+     */
+    class StatusLines
+    {
+    public:
+        static constexpr int First = 100;
+        static constexpr int Last = 599;
+
+        StatusLines()
+        {
+            for (int code = First; code <= Last; ++code)
+                lines[code - First] = "HTTP/1.1 " + std::to_string(code) + ' ' + ReasonPhrase(code) + Http::CRLF;
+        }
+
+        const std::string& operator[](Http::Response::Status status) const
+        {
+            auto code = static_cast<int>(status);
+            return lines[(code < First || code > Last ? static_cast<int>(Http::Response::Status::InternalServerError) : code) - First];
+        }
+
+    private:
+        std::array<std::string, Last - First + 1> lines;
+    };
+
+    const StatusLines StatusLine;
+
+    /// Statyczna tablica kompletnych odpowiedzi bez ciała, wysyłanych przed zamknięciem połączenia.
+    /**
+     * Pozwala odrzucić zapytanie bez tworzenia obiektu Http::Response i alokacji.
+     */
+    class StockResponses
+    {
+    public:
+        StockResponses()
+        {
+            for (int code = StatusLines::First; code <= StatusLines::Last; ++code)
+            {
+                responses[code - StatusLines::First] = StatusLine[static_cast<Http::Response::Status>(code)]
+                    + "Content-Length: 0" + Http::CRLF + "Connection: close" + Http::CRLF + Http::CRLF;
+            }
+        }
+
+        const std::string& operator[](Http::Response::Status status) const
+        {
+            auto code = static_cast<int>(status);
+            return responses[(code < StatusLines::First || code > StatusLines::Last ? static_cast<int>(Http::Response::Status::InternalServerError) : code) - StatusLines::First];
+        }
+
+    private:
+        std::array<std::string, StatusLines::Last - StatusLines::First + 1> responses;
     };
 
+    const StockResponses StockResponse;
+
     Tcp::ConstBuffer MakeBuffer(Http::Response::Status status)
     {
-        return Tcp::MakeBuffer(const_cast<const std::string&>(StockResponse[status]));
+        return Tcp::MakeBuffer(StatusLine[status]);
+    }
+
+    /// Porównuje nazwy nagłówków bez względu na wielkość liter.
+    bool HeaderEquals(const std::string& left, const std::string& right)
+    {
+        return left.size() == right.size() && std::equal(left.begin(), left.end(), right.begin(),
+            [](char l, char r) { return std::tolower(static_cast<unsigned char>(l)) == std::tolower(static_cast<unsigned char>(r)); });
+    }
+
+    /// Sprawdza czy nagłówek o danej nazwie zawiera token (bez względu na wielkość liter).
+    bool HeaderContains(const Http::HeaderContainer& headers, const std::string& name, const std::string& token)
+    {
+        for (const auto& header : headers)
+        {
+            if (!HeaderEquals(header.first, name))
+                continue;
+
+            std::string value(header.second);
+            std::transform(value.begin(), value.end(), value.begin(), [](char c) { return static_cast<char>(std::tolower(static_cast<unsigned char>(c))); });
+            if (value.find(token) != std::string::npos)
+                return true;
+        }
+        return false;
+    }
+
+    /// Sprawdza czy nagłówek o danej nazwie występuje w kolekcji.
+    bool HasHeader(const Http::HeaderContainer& headers, const std::string& name)
+    {
+        return std::any_of(headers.begin(), headers.end(), [&name](const Http::Header& header) { return HeaderEquals(header.first, name); });
+    }
+
+    /// Pula buforów odczytu wspólna dla połączeń wszystkich serwisów.
+    /**
+     * Pula nie jest zwalniana - połączenia mogą istnieć dłużej niż obiekty statyczne.
+     */
+    Utility::MemoryPool& BufferPool()
+    {
+        static auto pool = new Utility::MemoryPool(sizeof(Http::Connection::BufferType), 32);
+        return *pool;
+    }
+
+    /// Największa liczba niewysłanych bajtów odpowiedzi strumieniowej, powyżej której producent jest wstrzymywany.
+    constexpr std::size_t StreamWindow = 256 * 1024;
+
+    /// Zwraca nagłówek części ciała w kodowaniu chunked.
+    std::string ChunkHeader(std::size_t size)
+    {
+        std::ostringstream header;
+        header << std::hex << size << Http::CRLF;
+        return header.str();
+    }
+
+    /// Zwraca status odpowiedzi dla ciała zapytania odrzuconego przez Http::BodyReader.
+    Http::Response::Status BodyStatus(Http::BodyReader::Result result)
+    {
+        switch (result)
+        {
+        case Http::BodyReader::Result::TooLarge:
+            return Http::Response::Status::RequestEntityTooLarge;
+        case Http::BodyReader::Result::Unsupported:
+            return Http::Response::Status::NotImplemented;
+        case Http::BodyReader::Result::Failed:
+            return Http::Response::Status::InternalServerError;
+        default:
+            return Http::Response::Status::BadRequest;
+        }
+    }
+
+    /// Zwraca czas pozostały do terminu w [ms], co najmniej 1 - wartość 0 wyłączyłaby timeout.
+    int Remaining(Tcp::TimerWheel::TimePoint deadline)
+    {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Tcp::TimerWheel::Clock::now()).count();
+        return static_cast<int>(std::max<decltype(remaining)>(remaining, 1));
+    }
+
+    /// Sprawdza czy zapytanie jest pierwszą częścią wstępu połączenia HTTP/2 (PRI * HTTP/2.0).
+    bool IsPreface(const Http::Request& request)
+    {
+        return request.method() == "PRI" && request.uri().raw() == "*" && request.version() == "2.0" && request.headers().empty();
+    }
+
+    /// Sprawdza czy klient oczekuje utrzymania połączenia.
+    /**
+     * HTTP/1.1 utrzymuje połączenie, chyba że podano Connection: close,
+     * HTTP/1.0 wyłącznie po podaniu Connection: keep-alive.
+     */
+    bool KeepAliveRequested(const Http::Request& request)
+    {
+        auto version = request.version();
+        if (version == "1.0" || version == "0.9")
+            return HeaderContains(request.headers(), "Connection", "keep-alive");
+        return !HeaderContains(request.headers(), "Connection", "close");
     }
 }
 
@@ -38,32 +229,189 @@ namespace Http {
 
 struct Connection::ConnectionPimpl
 {
-    ConnectionPimpl(Tcp::Socket socket) : socket(std::move(socket))
+    /// Odczytane zapytanie oczekujące na odpowiedź.
+    struct Pending
+    {
+        Request request;
+        bool keepAlive;
+        bool bad; //< Zapytanie odrzucone - odpowiedź o statusie status.
+        Response::Status status;
+    };
+
+    ConnectionPimpl(Tcp::Socket socket, const KeepAlive& keepAlive, const BodyLimits& bodyLimits, const RequestLimits& limits) :
+        socket(std::move(socket)),
+        scanner(limits),
+        bodyReader(bodyLimits),
+        bodyLimits(bodyLimits),
+        keepAlive(keepAlive),
+        limits(limits),
+        requests(0),
+        timeout(Tcp::SocketService::DefaultTimeout),
+        deadline(Tcp::TimerWheel::Clock::now() + std::chrono::milliseconds(limits.headerTimeout)),
+        timer(0),
+        timedOut(false),
+        body(false),
+        partial(false),
+        busy(false),
+        corked(false),
+        closed(false),
+        draining(false),
+        aborted(false),
+        queued(0),
+        offset(0),
+        writing(false),
+        streamEnd(false),
+        streamKeepAlive(false),
+        buffer(nullptr)
     {
     }
 
+    ~ConnectionPimpl()
+    {
+        BufferPool().deallocate(buffer, sizeof(Connection::BufferType));
+    }
+
+    /// Stan połączeń przydzielany jest z puli, zamiast osobno dla każdego połączenia.
+    static Utility::MemoryPool& Pool();
+
+    /// Zwraca czas na odbiór bieżącej części zapytania HTTP/1 w [ms] lub 0, jeżeli żadne zapytanie nie jest odbierane.
+    int requestTimeout() const
+    {
+        if (session || timedOut)
+            return 0;
+        if (body)
+            return limits.bodyTimeout;
+        return partial || !requests ? limits.headerTimeout : 0;
+    }
+
+    static void* operator new(std::size_t size)
+    {
+        return Pool().allocate(size);
+    }
+
+    static void operator delete(void* block, std::size_t size)
+    {
+        Pool().deallocate(block, size);
+    }
+
     Tcp::Socket socket;
-    RequestParser parser;
+    RequestScanner scanner;
+    BodyReader bodyReader;
     Request request;
+    BodyLimits bodyLimits;
+    KeepAlive keepAlive;
+    RequestLimits limits;
+    std::size_t requests; //< Liczba odczytanych zapytań.
+    int timeout; //< Obecny czas bezczynności gniazda w [ms].
+    Tcp::TimerWheel::TimePoint deadline; //< Termin odbioru nagłówka lub ciała bieżącego zapytania.
+    Tcp::TimerWheel::TimerId timer; //< Oczekiwanie serwisu na termin odbioru zapytania, 0 jeżeli nie zostało zlecone.
+    Tcp::TimerWheel::TimePoint armed; //< Chwila, na którą zlecono oczekiwanie timer.
+    bool timedOut; //< Upłynął termin odbioru zapytania - wysyłana jest odpowiedź 408, a dalsze dane są pomijane.
+    bool body; //< Odczytywane jest ciało zapytania.
+    bool partial; //< Odczytano część kolejnego zapytania.
+    bool busy; //< Zapytanie z początku kolejki jest obsługiwane lub wysyłane.
+    bool corked; //< Na gnieździe ustawiono Tcp::Option::Cork.
+    bool closed; //< Połączenie zostało wyrejestrowane.
+    std::atomic<bool> draining; //< Połączenie zostanie zamknięte po obsłużeniu odczytanych zapytań.
+
+    /// Chroni kolejkę zapytań oraz stan odpowiedzi strumieniowej współdzielone z wątkami obsługującymi zapytania.
+    std::mutex mutex;
+    std::deque<Pending> pending;
+    std::condition_variable drained; //< Powiadamia producenta o wysłaniu części odpowiedzi.
+    bool aborted; //< Połączenie zamknięto w trakcie odpowiedzi strumieniowej.
+    std::size_t queued; //< Liczba przekazanych, lecz niewysłanych bajtów odpowiedzi strumieniowej.
+
+    /// Część odpowiedzi oczekująca na wysłanie.
+    struct Outgoing
+    {
+        std::shared_ptr<const std::string> data;
+        std::size_t released; //< Bajty queued zwalniane po zapisaniu części do gniazda.
+    };
+
+    /// Części odpowiedzi strumieniowej oczekujące na wysłanie, dostępne wyłącznie z wątku serwisu.
+    std::deque<Outgoing> outbox;
+    std::size_t offset; //< Pozycja w pierwszej części kolejki outbox.
+    bool writing; //< Trwa zapis odpowiedzi lub jej części.
+    bool streamEnd; //< Producent zakończył działanie - po opróżnieniu kolejki odpowiedź jest wysłana.
+    bool streamKeepAlive; //< Połączenie pozostaje otwarte po odpowiedzi strumieniowej.
+
+    char* buffer; //< Bufor odczytu z puli BufferPool, nullptr poza odczytem.
+    std::unique_ptr<Http2Session> session; //< Sesja HTTP/2, dostępna wyłącznie z wątku serwisu.
 };
 
-struct Server::ServerPimpl
+Utility::MemoryPool& Connection::ConnectionPimpl::Pool()
+{
+    static auto pool = new Utility::MemoryPool(sizeof(ConnectionPimpl), 64);
+    return *pool;
+}
+
+struct Server::Reactor
 {
-    ServerPimpl(ServicePtr service) : 
+    Reactor(ServicePtr service, Tcp::SslContext* tls) :
         service(std::move(service)),
-        acceptor(*this->service),
-        signals(*this->service)
+        acceptor(tls
+            ? std::unique_ptr<Tcp::AcceptorInterface>(new Tcp::SslAcceptorImplementation(*this->service, *tls))
+            : this->service->getFactory()->getImplementation())
     {
     }
 
     Server::ServicePtr service;
     Tcp::Acceptor acceptor;
+};
+
+struct Server::ServerPimpl
+{
+    ServerPimpl(std::vector<ServicePtr> services, TlsPtr tls) :
+        tls(std::move(tls)),
+        signals(*services.front())
+    {
+        for (auto& service : services)
+            reactors.emplace_back(new Reactor(std::move(service), this->tls.get()));
+    }
+
+    TlsPtr tls; //< Kontekst współdzielony przez akceptory wszystkich serwisów.
+    std::vector<std::unique_ptr<Reactor>> reactors; //< Pierwszy serwis obsługuje sygnały i działa na wątku run().
     Tcp::SignalSet signals;
+    KeepAlive keepAlive;
+    BodyLimits bodyLimits;
+    RequestLimits requestLimits;
+    SocketOptions socketOptions;
+    std::chrono::milliseconds drainTimeout = std::chrono::milliseconds(30000); //< Czas na dokończenie obsługi po sygnale.
+    bool draining = false; //< Wywołano drain(), dostępne wyłącznie z wątku pierwszego serwisu.
+    std::vector<int> inherited; //< Gniazda nasłuchujące przekazane przez proces nadrzędny.
 };
 
 }
 
-Http::Connection::Connection(Tcp::Socket socket, HandlerStrategy& handler) : pimpl(new ConnectionPimpl(std::move(socket))), globalHandler(handler)
+Http::KeepAlive::KeepAlive(int timeout, std::size_t maxRequests, bool cork, int sendTimeout) :
+    timeout(timeout),
+    maxRequests(maxRequests),
+    cork(cork),
+    sendTimeout(sendTimeout)
+{
+}
+
+Http::SocketOptions::SocketOptions(int backlog, bool noDelay, int deferAccept, int receiveBuffer, int sendBuffer, int fastOpen) :
+    backlog(backlog),
+    noDelay(noDelay),
+    deferAccept(deferAccept),
+    receiveBuffer(receiveBuffer),
+    sendBuffer(sendBuffer),
+    fastOpen(fastOpen)
+{
+}
+
+Http::Connection::Connection(Tcp::Socket socket, HandlerStrategy& handler, const KeepAlive& keepAlive) : Connection(std::move(socket), handler, keepAlive, BodyLimits())
+{
+}
+
+Http::Connection::Connection(Tcp::Socket socket, HandlerStrategy& handler, const KeepAlive& keepAlive, const BodyLimits& limits) : Connection(std::move(socket), handler, keepAlive, limits, RequestLimits())
+{
+}
+
+Http::Connection::Connection(Tcp::Socket socket, HandlerStrategy& handler, const KeepAlive& keepAlive, const BodyLimits& limits, const RequestLimits& requestLimits) :
+    pimpl(new ConnectionPimpl(std::move(socket), keepAlive, limits, requestLimits)),
+    globalHandler(handler)
 {
 }
 
@@ -73,6 +421,7 @@ Http::Connection::~Connection()
 
 void Http::Connection::start()
 {
+    updateTimeout(); // Pierwsze zapytanie musi zostać odebrane w czasie RequestLimits::headerTimeout od przyjęcia.
     read();
 }
 
@@ -81,143 +430,719 @@ void Http::Connection::stop()
     pimpl->socket.close();
 }
 
+void Http::Connection::drain()
+{
+    auto self = shared_from_this();
+    pimpl->draining = true;
+    pimpl->socket.getService().post([this, self]
+    {
+        if (pimpl->session)
+        {
+            pimpl->session->goAway(); // Klient nie otworzy kolejnych strumieni, przyjęte zostaną obsłużone.
+            deliver();
+            return;
+        }
+        // Nowe połączenie pozostaje otwarte do pierwszego zapytania - klient mógł je już wysłać.
+        if (!pimpl->busy && !pimpl->partial && !pimpl->body && pimpl->requests > 0)
+            finish();
+    });
+}
+
+Http::Connection::PoolOccupancy Http::Connection::occupancy()
+{
+    return PoolOccupancy{ BufferPool().statistics(), ConnectionPimpl::Pool().statistics() };
+}
+
 void Http::Connection::read()
 {
     auto self = shared_from_this();
-    pimpl->socket.asyncReadSome(Tcp::MakeBuffer(buffer),
+    pimpl->socket.asyncReadSome([this] { return Tcp::Buffer(acquireBuffer(), static_cast<int>(sizeof(BufferType))); },
         [this, self](int ec, std::size_t bytes)
     {
         if (!ec) // Nie wykryto błędu.
         {
-            RequestParser::Result result;
-            auto it = buffer.begin();
-            std::tie(result, it) = pimpl->parser.parse(buffer.begin(), buffer.begin() + bytes, pimpl->request);
-            if (result == RequestParser::Result::Good) // Zapytanie sparsowane poprawnie.
+            auto proceed = consume(pimpl->buffer, pimpl->buffer + bytes);
+            releaseBuffer(); // Zapytanie nie wskazuje na bufor po przetworzeniu danych.
+            if (proceed)
+                read(); // Czytaj dalej.
+        }
+        else
+        {
+            releaseBuffer();
+            finish(); // Termin odbioru zapytania obsługuje expired() - błąd odczytu kończy połączenie bez odpowiedzi.
+        }
+    }
+    );
+}
+
+char* Http::Connection::acquireBuffer()
+{
+    if (!pimpl->buffer)
+        pimpl->buffer = static_cast<char*>(BufferPool().allocate(sizeof(BufferType)));
+    return pimpl->buffer;
+}
+
+void Http::Connection::releaseBuffer()
+{
+    BufferPool().deallocate(pimpl->buffer, sizeof(BufferType));
+    pimpl->buffer = nullptr;
+}
+
+bool Http::Connection::consume(char* begin, char* end)
+{
+    if (pimpl->timedOut)
+        return false; // Połączenie zostanie zamknięte po wysłaniu odpowiedzi 408.
+    if (pimpl->session)
+    {
+        auto receiving = pimpl->session->receiving();
+        auto proceed = pimpl->session->consume(begin, end);
+        if (!receiving) // Termin liczony jest od otwarcia pierwszego niezakończonego strumienia.
+            pimpl->deadline = Tcp::TimerWheel::Clock::now() + std::chrono::milliseconds(pimpl->limits.bodyTimeout);
+        else if (pimpl->limits.minRate)
+            pimpl->deadline += std::chrono::microseconds(static_cast<long long>(end - begin) * 1000000 / static_cast<long long>(pimpl->limits.minRate));
+        deliver();
+        updateTimeout();
+        return proceed && !pimpl->closed;
+    }
+
+    while (begin != end)
+    {
+        if (!pimpl->partial && pimpl->requests > 0) // Termin pierwszego zapytania liczony jest od przyjęcia połączenia.
+            pimpl->deadline = Tcp::TimerWheel::Clock::now() + std::chrono::milliseconds(pimpl->limits.headerTimeout);
+        pimpl->partial = true;
+
+        if (!pimpl->body)
+        {
+            RequestScanner::Result result;
+            std::tie(result, begin) = pimpl->scanner.parse(begin, end);
+            if (result == RequestScanner::Result::Bad) // Zapytanie sparsowane niepoprawnie lub przekraczające ograniczenia.
             {
-                if (pimpl->parser.fill(it, buffer.begin() + bytes, pimpl->request)) // Zacznij czyta? cia?o.
-                {
-                    write(); // Jeżeli ciało nie zostało wykryte, przejdź do odpowiedzi.
-                }
-                else
-                {
-                    readBody(); // W przeciwnym wypadku wywołaj kolejne asynchroniczne czytanie ciała.
-                }
+                reject(pimpl->scanner.status());
+                return false;
             }
-            else if (result == RequestParser::Result::Bad) // Zapytanie sparsowane niepoprawnie.
+            if (result == RequestScanner::Result::Indeterminate)
+                break;
+            pimpl->scanner.assign(pimpl->request); // Wycinki wskazują na bufor, który zostanie nadpisany.
+            if (!pimpl->requests && IsPreface(pimpl->request))
+                return upgrade(begin, end); // Pozostałe dane należą do sesji HTTP/2.
+
+            auto started = pimpl->bodyReader.start(pimpl->request);
+            if (started != BodyReader::Result::Good)
             {
-                globalHandler.respond(pimpl->socket, Response::Status::BadRequest); // Od razu odpowiedz klientowi.
-                pimpl->socket.shutdown();
-                pimpl->socket.close(); // Zamknij gniazdo.
-                globalHandler.stop(shared_from_this());
+                reject(BodyStatus(started));
+                return false;
             }
-            else
+            pimpl->body = true; // Zapytanie sparsowane poprawnie, zacznij czytać ciało.
+            pimpl->deadline = Tcp::TimerWheel::Clock::now() + std::chrono::milliseconds(pimpl->limits.bodyTimeout);
+        }
+
+        BodyReader::Result result;
+        auto from = begin;
+        std::tie(result, begin) = pimpl->bodyReader.read(begin, end, pimpl->request); // Pozostałe dane należą do kolejnego zapytania.
+        if (pimpl->limits.minRate)
+            pimpl->deadline += std::chrono::microseconds(static_cast<long long>(begin - from) * 1000000 / static_cast<long long>(pimpl->limits.minRate));
+        else if (begin != from) // bodyTimeout jest wtedy czasem bezczynności między odczytami.
+            pimpl->deadline = Tcp::TimerWheel::Clock::now() + std::chrono::milliseconds(pimpl->limits.bodyTimeout);
+        if (result == BodyReader::Result::Indeterminate)
+            break;
+        if (result != BodyReader::Result::Good)
+        {
+            reject(BodyStatus(result));
+            return false;
+        }
+
+        if (!dispatch())
+            return false;
+    }
+
+    updateTimeout();
+    return true;
+}
+
+bool Http::Connection::dispatch()
+{
+    ++pimpl->requests;
+    auto keepAlive = pimpl->requests < pimpl->keepAlive.maxRequests && KeepAliveRequested(pimpl->request) && !pimpl->draining;
+
+    {
+        std::lock_guard<std::mutex> lock(pimpl->mutex);
+        pimpl->pending.push_back(ConnectionPimpl::Pending{ std::move(pimpl->request), keepAlive, false, Response::Status::Ok });
+    }
+    if (!pimpl->busy)
+    {
+        pimpl->busy = true;
+        write(); // W przeciwnym wypadku zapytanie zostanie obsłużone po wysłaniu poprzednich odpowiedzi.
+    }
+
+    pimpl->request = Request();
+    pimpl->scanner.reset();
+    pimpl->body = false;
+    pimpl->partial = false;
+
+    if (!keepAlive)
+        updateTimeout(); // Odczyt zostaje zakończony, połączenie zostanie zamknięte po wysłaniu odpowiedzi.
+    return keepAlive;
+}
+
+void Http::Connection::reject(Response::Status status)
+{
+    if (!pimpl->busy)
+    {
+        pimpl->busy = true;
+        sendStock(status, 0); // Od razu odpowiedz klientowi, bez blokowania wątku serwisu.
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(pimpl->mutex);
+    pimpl->pending.push_back(ConnectionPimpl::Pending{ Request(), false, true, status }); // Odpowiedz po poprzednich zapytaniach.
+}
+
+void Http::Connection::sendStock(Response::Status status, std::size_t offset)
+{
+    if (pimpl->closed)
+        return;
+
+    const auto& response = StockResponse[status];
+    auto self = shared_from_this();
+    pimpl->writing = true;
+    pimpl->socket.asyncWriteSome(Tcp::ConstBuffer(response.data() + offset, static_cast<int>(response.size() - offset)),
+        [this, self, status, offset](int ec, int bytes)
+    {
+        pimpl->writing = false;
+        if (!ec && bytes >= 0 && offset + bytes < StockResponse[status].size())
+            sendStock(status, offset + bytes); // Zapisano część odpowiedzi.
+        else
+            finish(); // Błąd zapisu (np. klient zerwał połączenie) kończy wyłącznie to połączenie.
+    }
+    );
+    updateTimeout();
+}
+
+bool Http::Connection::upgrade(char* begin, char* end)
+{
+    pimpl->request = Request();
+    pimpl->scanner.reset();
+    pimpl->partial = false;
+    pimpl->session.reset(new Http2Session(
+        [this](std::string frames, std::size_t released)
+        {
+            if (!frames.empty()) // Części ciała zwalniane są po zapisaniu ramek, a nie po ich utworzeniu.
+                pimpl->outbox.push_back(ConnectionPimpl::Outgoing{ std::make_shared<const std::string>(std::move(frames)), released });
+            else if (released) // Kolejka przerwanego strumienia nie zostanie wysłana.
             {
-                read(); // Czytaj dalej.
+                std::lock_guard<std::mutex> lock(pimpl->mutex);
+                pimpl->queued -= released;
+                pimpl->drained.notify_all();
+            }
+        },
+        [this](std::uint32_t stream, Request request) { handle(stream, std::move(request)); },
+        pimpl->bodyLimits, pimpl->limits));
+
+    auto proceed = consume(begin, end); // Wysyła również ustawienia serwera.
+    if (proceed && pimpl->draining)
+    {
+        pimpl->session->goAway(); // Strumienie odczytane wraz ze wstępem zostaną obsłużone.
+        deliver();
+    }
+    return proceed;
+}
+
+void Http::Connection::handle(std::uint32_t stream, Request request)
+{
+    auto self = shared_from_this();
+    auto shared = std::make_shared<Request>(std::move(request));
+    globalHandler.handle(
+        [this, self, stream, shared](HandlerStrategy::RequestHandler handler)
+        {
+            auto response = std::make_shared<Response>(handler(*shared));
+            if (response->streaming())
+            {
+                this->stream(stream, response);
+                return;
             }
+            pimpl->socket.getService().post([this, self, stream, response]
+            {
+                if (pimpl->closed)
+                    return;
+                pimpl->session->respond(stream, *response);
+                deliver();
+                updateTimeout();
+            });
         }
-        else
+    );
+}
+
+void Http::Connection::write()
+{
+    auto self = shared_from_this();
+    globalHandler.handle(
+        [this, self](HandlerStrategy::RequestHandler handler)
         {
-            try
+            ConnectionPimpl::Pending current;
+            bool last;
+            {
+                std::lock_guard<std::mutex> lock(pimpl->mutex);
+                current = std::move(pimpl->pending.front());
+                pimpl->pending.pop_front();
+                last = pimpl->pending.empty();
+            }
+
+            auto response = current.bad ? Response(current.status, "", "") : handler(current.request);
+            if (last && pimpl->draining)
+                current.keepAlive = false; // Serwer kończy działanie - klient nie powinien wysyłać kolejnych zapytań.
+            auto persistentByDefault = !current.bad && current.request.version() != "1.0" && current.request.version() != "0.9";
+            auto streaming = response.streaming();
+            auto chunked = streaming && persistentByDefault; // Starsi klienci odczytują ciało do zamknięcia połączenia.
+            if (streaming && !chunked)
+                current.keepAlive = false;
+
+            if (chunked)
+                response.headers.push_back(Header("Transfer-Encoding", "chunked"));
+            if (current.keepAlive)
             {
-                if (ec > 1)
-                    globalHandler.respond(pimpl->socket, Response::Status::RequestTimeout);
+                if (!streaming && !HasHeader(response.headers, "Content-Length"))
+                    response.headers.push_back(Header("Content-Length", std::to_string(response.body().length())));
+                if (!persistentByDefault)
+                    response.headers.push_back(Header("Connection", "keep-alive"));
             }
-            catch (const Tcp::SendError&)
+            else if (persistentByDefault || current.bad || streaming)
             {
+                response.headers.push_back(Header("Connection", "close"));
+            }
 
+            auto prepared = std::make_shared<Response>(std::move(response));
+            if (streaming)
+            {
+                stream(prepared, chunked, current.keepAlive);
+                return;
             }
-            pimpl->socket.shutdown();
-            globalHandler.stop(shared_from_this());
+            auto keepAlive = current.keepAlive;
+            pimpl->socket.getService().post([this, self, prepared, keepAlive]
+            {
+                cork();
+                send(prepared, 0, keepAlive); // Wątek obsługujący jest zwalniany przed wysłaniem odpowiedzi.
+            });
+        }
+    );
+}
+
+void Http::Connection::send(std::shared_ptr<Response> response, std::size_t offset, bool keepAlive)
+{
+    if (pimpl->closed)
+        return;
+
+    auto buffers = response->buffers();
+    Tcp::Consume(buffers, offset);
+    auto remaining = Tcp::BufferSize(buffers);
+
+    auto self = shared_from_this();
+    pimpl->writing = true;
+    pimpl->socket.asyncWriteSome(buffers,
+        [this, self, response, offset, remaining, keepAlive](int ec, int bytes)
+    {
+        pimpl->writing = false;
+        if (ec || bytes < 0)
+        {
+            finish();
+            return;
+        }
+
+        if (static_cast<std::size_t>(bytes) < remaining)
+            send(response, offset + bytes, keepAlive); // Zapisano część odpowiedzi.
+        else
+            sent(keepAlive);
+    }
+    );
+    updateTimeout();
+}
+
+void Http::Connection::stream(std::shared_ptr<Response> response, bool chunked, bool keepAlive)
+{
+    push(response->raw()); // Status i nagłówki, ciało odpowiedzi strumieniowej jest puste.
+
+    ResponseStream stream([this, chunked](const char* data, std::size_t size)
+    {
+        if (!chunked)
+            return push(std::string(data, size));
+
+        auto chunk = ChunkHeader(size);
+        chunk.reserve(chunk.size() + size + 2);
+        chunk.append(data, size);
+        chunk += CRLF;
+        return push(std::move(chunk));
+    });
+
+    try
+    {
+        response->produce(stream);
+        if (chunked)
+            push(std::string("0") + CRLF + CRLF); // Ostatnia część, brak nagłówków końcowych.
+    }
+    catch (...)
+    {
+        keepAlive = false; // Brak ostatniej części - klient rozpozna przerwaną odpowiedź po zamknięciu połączenia.
+    }
+
+    auto self = shared_from_this();
+    pimpl->socket.getService().post([this, self, keepAlive]
+    {
+        pimpl->streamEnd = true;
+        pimpl->streamKeepAlive = keepAlive;
+        deliver();
+    });
+}
+
+void Http::Connection::stream(std::uint32_t id, std::shared_ptr<Response> response)
+{
+    auto self = shared_from_this();
+    pimpl->socket.getService().post([this, self, id, response]
+    {
+        if (pimpl->closed)
+            return;
+        pimpl->session->respond(id, *response); // Nagłówki, części ciała przekazywane są przez push().
+        deliver();
+    });
+
+    ResponseStream stream([this, id](const char* data, std::size_t size) { return push(std::string(data, size), id); });
+    auto completed = true;
+    try
+    {
+        response->produce(stream);
+    }
+    catch (...)
+    {
+        completed = false; // Klient rozpozna przerwaną odpowiedź po RST_STREAM.
+    }
+
+    pimpl->socket.getService().post([this, self, id, completed]
+    {
+        if (pimpl->closed)
+            return;
+        if (completed)
+            pimpl->session->data(id, std::string(), true);
+        else
+            pimpl->session->reset(id);
+        deliver();
+        updateTimeout();
+    });
+}
+
+bool Http::Connection::push(std::string data, std::uint32_t id)
+{
+    {
+        std::unique_lock<std::mutex> lock(pimpl->mutex);
+        pimpl->drained.wait(lock, [this] { return pimpl->queued < StreamWindow || pimpl->aborted; });
+        if (pimpl->aborted)
+            return false;
+        pimpl->queued += data.size();
+    }
+
+    auto self = shared_from_this();
+    auto chunk = std::make_shared<std::string>(std::move(data));
+    pimpl->socket.getService().post([this, self, chunk, id]
+    {
+        if (!pimpl->session)
+            pimpl->outbox.push_back(ConnectionPimpl::Outgoing{ chunk, chunk->size() });
+        else if (!pimpl->closed)
+            pimpl->session->data(id, std::move(*chunk), false); // Sesja zwalnia część po podziale na ramki.
+        deliver();
+    });
+    return true;
+}
+
+void Http::Connection::deliver()
+{
+    if (pimpl->closed || pimpl->writing)
+        return;
+
+    if (pimpl->outbox.empty())
+    {
+        if (pimpl->session && pimpl->session->finished())
+            finish();
+        if (pimpl->streamEnd)
+        {
+            pimpl->streamEnd = false;
+            sent(pimpl->streamKeepAlive);
+        }
+        updateTimeout();
+        return;
+    }
+
+    Tcp::ConstBufferSequence buffers; // Oczekujące części wysyłane są jednym zapisem.
+    for (const auto& chunk : pimpl->outbox)
+        buffers.push_back(Tcp::MakeBuffer(*chunk.data));
+    Tcp::Consume(buffers, pimpl->offset);
+
+    pimpl->writing = true;
+    auto self = shared_from_this();
+    pimpl->socket.asyncWriteSome(buffers, [this, self](int ec, int bytes)
+    {
+        pimpl->writing = false;
+        if (ec || bytes < 0)
+        {
+            finish();
+            return;
+        }
+
+        std::size_t released = 0;
+        auto written = pimpl->offset + bytes;
+        while (!pimpl->outbox.empty() && written >= pimpl->outbox.front().data->size())
+        {
+            written -= pimpl->outbox.front().data->size();
+            released += pimpl->outbox.front().released;
+            pimpl->outbox.pop_front();
+        }
+        pimpl->offset = written;
+
+        if (released)
+        {
+            std::lock_guard<std::mutex> lock(pimpl->mutex);
+            pimpl->queued -= released;
+            pimpl->drained.notify_all();
+        }
+        deliver();
+    });
+    updateTimeout();
+}
+
+void Http::Connection::cork()
+{
+    if (!pimpl->keepAlive.cork || pimpl->corked)
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(pimpl->mutex);
+        if (pimpl->pending.empty())
+            return; // Pojedyncza odpowiedź wysyłana jest jednym wywołaniem writev.
+    }
+
+    try
+    {
+        pimpl->socket.setOption(Tcp::Option::Cork(true));
+        pimpl->corked = true;
+    }
+    catch (const Tcp::SocketOptionError&)
+    {
+        pimpl->keepAlive.cork = false; // Platforma lub gniazdo nie obsługuje opcji.
+    }
+}
+
+void Http::Connection::uncork()
+{
+    if (!pimpl->corked)
+        return;
+
+    pimpl->corked = false;
+    try
+    {
+        pimpl->socket.setOption(Tcp::Option::Cork(false)); // Wypycha zaległe segmenty.
+    }
+    catch (const Tcp::SocketOptionError&)
+    {
+    }
+}
+
+void Http::Connection::sent(bool keepAlive)
+{
+    if (!keepAlive)
+    {
+        uncork();
+        finish();
+        return;
+    }
+
+    bool empty;
+    {
+        std::lock_guard<std::mutex> lock(pimpl->mutex);
+        empty = pimpl->pending.empty();
+    }
+    if (empty)
+    {
+        uncork();
+        if (pimpl->draining)
+        {
+            finish();
+            return;
         }
+        pimpl->busy = false;
+    }
+    else
+        write(); // Kolejne zapytanie potokowe.
+
+    updateTimeout();
+}
+
+void Http::Connection::finish()
+{
+    if (pimpl->closed)
+        return;
+
+    pimpl->closed = true;
+    if (pimpl->timer)
+        pimpl->socket.getService().cancel(pimpl->timer);
+    pimpl->timer = 0;
+    {
+        std::lock_guard<std::mutex> lock(pimpl->mutex);
+        pimpl->aborted = true; // Wstrzymany producent odpowiedzi strumieniowej zostaje zwolniony.
+        pimpl->drained.notify_all();
+    }
+    pimpl->socket.shutdown();
+    globalHandler.stop(shared_from_this());
+}
+
+void Http::Connection::updateTimeout()
+{
+    const auto& limits = pimpl->limits;
+    auto timeout = pimpl->keepAlive.timeout;
+    auto scheduled = false; // Czas liczony jest do terminu, a nie od ostatniego odczytu.
+    if (pimpl->session && pimpl->session->receiving())
+    {
+        timeout = limits.bodyTimeout; // Strumienie nieprzekazane handlerowi podlegają terminom jak ciało zapytania.
+        scheduled = limits.minRate > 0;
+    }
+    else if (pimpl->session)
+        timeout = pimpl->session->idle() ? timeout : 0; // Czas obsługi strumieni nie jest ograniczony.
+    else if (pimpl->requestTimeout() > 0)
+    {
+        watch(); // Po upływie terminu wysyłana jest odpowiedź 408, więc gniazdo nie może zostać zamknięte przez serwis.
+        timeout = 0;
+    }
+    else if (pimpl->body || pimpl->partial || !pimpl->requests)
+        timeout = 0; // Termin odbioru zapytania został wyłączony.
+    else if (pimpl->busy)
+        timeout = 0; // Czas obsługi zapytania nie jest ograniczony.
+
+    if (scheduled && timeout > 0)
+        timeout = Remaining(pimpl->deadline);
+    if (!timeout && pimpl->writing)
+        timeout = pimpl->keepAlive.sendTimeout; // Zapis odpowiedzi musi postępować, nawet gdy czas jej obsługi nie jest ograniczony.
+    if (timeout != pimpl->timeout || scheduled)
+    {
+        pimpl->socket.setTimeout(timeout);
+        pimpl->timeout = timeout;
     }
-    );
 }
 
-void Http::Connection::readBody()
+void Http::Connection::watch()
 {
-    auto self = shared_from_this();
-    pimpl->socket.asyncReadSome(Tcp::MakeBuffer(buffer),
-        [this, self](int ec, std::size_t bytes)
+    if (pimpl->timer && pimpl->armed <= pimpl->deadline)
+        return; // Przesunięty termin sprawdzany jest ponownie po upływie zleconego.
+
+    auto& service = pimpl->socket.getService();
+    if (pimpl->timer)
+        service.cancel(pimpl->timer);
+    pimpl->armed = pimpl->deadline;
+    std::weak_ptr<Connection> weak = shared_from_this();
+    pimpl->timer = service.asyncWait(pimpl->deadline, [weak]
     {
-        if (!ec)
-        {
-            if (pimpl->parser.fill(buffer.begin(), buffer.begin() + bytes, pimpl->request))
-            {
-                write();
-            }
-            else
-            {
-                readBody();
-            }
-        }
-        else
-        {
-            try
-            {
-                globalHandler.respond(pimpl->socket, Response::Status::RequestTimeout);
-            }
-            catch (const Tcp::SendError&)
-            {
-
-            }
-            pimpl->socket.shutdown();
-            globalHandler.stop(shared_from_this());
-        }
-    }
-    );
+        if (auto self = weak.lock())
+            self->expired();
+    });
 }
 
-void Http::Connection::write()
+void Http::Connection::expired()
 {
-    auto self = shared_from_this();
-    globalHandler.handle(
-        [this, self](HandlerStrategy::RequestHandler handler)
-        {
-            try
-            {
-                pimpl->socket.write(Tcp::MakeBuffer(handler(pimpl->request).raw()));
-            }
-            catch (const Tcp::SendError&)
-            {
-                return;
-            }
-        }
-    );
-    pimpl->socket.shutdown();
-    globalHandler.stop(shared_from_this());
+    pimpl->timer = 0;
+    if (pimpl->closed || pimpl->requestTimeout() <= 0)
+        return; // Zapytanie zostało odebrane przed upływem terminu.
+    if (pimpl->deadline > Tcp::TimerWheel::Clock::now())
+    {
+        watch(); // Klient przesłał dane wydłużające termin.
+        return;
+    }
+
+    pimpl->timedOut = true;
+    if (pimpl->busy)
+    {
+        finish(); // Odpowiedź 408 nie może wyprzedzić odpowiedzi na poprzednie zapytania potokowe.
+        return;
+    }
+    pimpl->busy = true;
+    sendStock(Response::Status::RequestTimeout, 0); // Bez blokowania wątku serwisu, jak odrzucone zapytania.
 }
 
-Http::ThreadedHandlerStrategy::ThreadedHandlerStrategy(RequestHandler handler, std::size_t maxRequests, std::size_t nThreads) : handler(handler), pool(nThreads ? nThreads : std::thread::hardware_concurrency(), maxRequests)
+Http::ThreadedHandlerStrategy::ThreadedHandlerStrategy(RequestHandler handler, std::size_t maxRequests, std::size_t nThreads) :
+    handler(handler),
+    nThreads(std::max<std::size_t>(nThreads ? nThreads : std::thread::hardware_concurrency(), 1)),
+    limit(4 * this->nThreads, this->nThreads, std::max(maxRequests, this->nThreads)),
+    pool(this->nThreads, maxRequests),
+    draining(false)
 {
 }
 
 void Http::ThreadedHandlerStrategy::handle(ConnectionResponse response)
 {
-    if (!pool.add(std::bind(response, handler)))
+    if (!limit.acquire())
     {
-        response([](const Request&)
+        shed(response);
+        return;
+    }
+
+    auto start = ConcurrencyLimit::Clock::now(); // Opóźnienie obejmuje czas oczekiwania w kolejce.
+    if (!pool.add([this, response, start]
         {
-            return Response(Response::Status::InternalServerError, "", "");
-        });
+            response(handler);
+            limit.release(ConcurrencyLimit::Clock::now() - start);
+        }))
+    {
+        limit.cancel();
+        shed(response);
     }
 }
 
-void Http::ThreadedHandlerStrategy::respond(Tcp::Socket& socket, Response::Status stockResponse)
+void Http::ThreadedHandlerStrategy::shed(const ConnectionResponse& response)
 {
-    socket.write(MakeBuffer(stockResponse));
+    auto retryAfter = std::to_string(limit.retryAfter());
+    response([retryAfter](const Request&)
+    {
+        Response rejected(Response::Status::ServiceUnavailable, "", "");
+        rejected.headers.push_back(Header("Retry-After", retryAfter));
+        return rejected;
+    });
+}
+
+Http::ConcurrencyLimit::Statistics Http::ThreadedHandlerStrategy::admission() const
+{
+    return limit.statistics();
 }
 
 void Http::ThreadedHandlerStrategy::start(ConnectionPtr connection)
 {
-    connections.insert(connection);
+    bool drain;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        connections.insert(connection);
+        drain = draining;
+    }
     connection->start();
+    if (drain)
+        connection->drain(); // Połączenie przyjęte przed zamknięciem akceptora.
 }
 
 void Http::ThreadedHandlerStrategy::stop(ConnectionPtr connection)
 {
+    std::lock_guard<std::mutex> lock(mutex);
     connections.erase(connection);
 }
 
+void Http::ThreadedHandlerStrategy::drain()
+{
+    std::vector<ConnectionPtr> current;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        draining = true;
+        current.assign(connections.begin(), connections.end());
+    }
+    for (auto& connection : current)
+        connection->drain();
+}
+
+std::size_t Http::ThreadedHandlerStrategy::active() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return connections.size();
+}
+
 Http::Response::Response(Response::Status code, const BodyType & content, const MediaType & mediaType) : responseStatus(code), response(content)
 {
     if (content.length() > 0) // w przypadku braku ciała nie uzupełniaj nagłówków.
@@ -229,13 +1154,71 @@ Http::Response::Response(Response::Status code, const BodyType & content, const
 
 std::string Http::Response::raw() const
 {
+    auto slices = buffers();
     std::string retval;
-    retval += MakeBuffer(responseStatus).first;
+    retval.reserve(Tcp::BufferSize(slices));
+    for (const auto& slice : slices)
+        retval.append(slice.first, slice.second);
+
+    return retval;
+}
+
+Http::Response::Response(Response::Status code, const MediaType & mediaType, Producer producer) : responseStatus(code), producer(std::move(producer))
+{
+    headers.push_back(Header("Content-Type", mediaType));
+}
+
+bool Http::Response::streaming() const
+{
+    return static_cast<bool>(producer);
+}
+
+void Http::Response::produce(ResponseStream& stream) const
+{
+    if (producer)
+        producer(stream);
+    else
+        stream.write(response);
+}
+
+Http::ResponseStream::ResponseStream(Sink sink) : sink(std::move(sink)), open(true)
+{
+}
+
+bool Http::ResponseStream::write(const char* data, std::size_t size)
+{
+    if (open && size > 0)
+        open = sink(data, size);
+    return open;
+}
+
+bool Http::ResponseStream::write(const std::string& data)
+{
+    return write(data.data(), data.size());
+}
+
+bool Http::ResponseStream::good() const
+{
+    return open;
+}
+
+Http::Response::BufferSequence Http::Response::buffers() const
+{
+    static const std::string separator = HEADER_SEPARATOR, newline = CRLF;
+
+    BufferSequence retval;
+    retval.reserve(headers.size() * 4 + 3);
+    retval.push_back(MakeBuffer(responseStatus));
     for (const auto& header : headers)
     {
-        retval += header.first + HEADER_SEPARATOR + header.second + CRLF;
+        retval.push_back(Tcp::MakeBuffer(header.first));
+        retval.push_back(Tcp::MakeBuffer(separator));
+        retval.push_back(Tcp::MakeBuffer(header.second));
+        retval.push_back(Tcp::MakeBuffer(newline));
     }
-    retval += CRLF + response;
+    retval.push_back(Tcp::MakeBuffer(newline));
+    if (!response.empty())
+        retval.push_back(Tcp::MakeBuffer(response));
 
     return retval;
 }
@@ -245,6 +1228,11 @@ Http::Response::Status Http::Response::status() const
     return responseStatus;
 }
 
+const Http::BodyType& Http::Response::body() const
+{
+    return response;
+}
+
 Http::RequestParser::RequestParser() : state(MethodStart)
 {
 }
@@ -610,6 +1598,17 @@ const Http::BodyType& Http::Request::body() const
     return content;
 }
 
+const std::string& Http::Request::bodyFile() const
+{
+    static const std::string none;
+    return file ? *file : none;
+}
+
+const std::shared_ptr<Http::BodySink>& Http::Request::bodySink() const
+{
+    return sink;
+}
+
 bool Http::Uri::Decode(const std::string & in, std::string& out)
 {
     out.clear();
@@ -746,22 +1745,164 @@ std::vector<std::string> Http::Uri::segments() const
     return results;
 }
 
-Http::Server::Server(const std::string& host, const std::string& port, ServicePtr service, StrategyPtr globalHandler) :
-    pimpl(new ServerPimpl(std::move(service))),
+Http::UriView::UriView(const Uri& uri) :
+    UriView(uri.raw().data(), uri.raw().size())
+{
+}
+
+Http::UriView::UriView(const char* data, std::size_t size) :
+    data(data),
+    size(static_cast<std::size_t>(std::find(data, data + size, '#') - data))
+{
+    pathSize = static_cast<std::size_t>(std::find(data, data + this->size, '?') - data);
+}
+
+Http::Slice Http::UriView::path() const
+{
+    return Slice{ data, pathSize };
+}
+
+Http::Slice Http::UriView::query() const
+{
+    if (pathSize == size)
+        return Slice{ data + size, 0 };
+    return Slice{ data + pathSize + 1, size - pathSize - 1 };
+}
+
+bool Http::UriView::segment(std::size_t& position, Slice& segment) const
+{
+    if (position == 0 && pathSize > 0 && data[0] == '/')
+        position = 1;
+    else if (position > pathSize)
+        return false;
+
+    auto end = std::find(data + position, data + pathSize, '/');
+    segment = Slice{ data + position, static_cast<std::size_t>(end - data) - position };
+    position = static_cast<std::size_t>(end - data) + 1; // pozycja za separatorem, pathSize + 1 po ostatnim segmencie.
+    return true;
+}
+
+bool Http::UriView::parameter(std::size_t& position, Slice& name, Slice& value) const
+{
+    auto query = this->query();
+    auto end = query.data + query.size;
+    for (auto begin = query.data + position; begin < end; begin = query.data + position)
+    {
+        auto next = std::find(begin, end, '&');
+        position = static_cast<std::size_t>(next - query.data) + 1;
+        if (next == begin)
+            continue;
+
+        auto separator = std::find(begin, next, '=');
+        name = Slice{ begin, static_cast<std::size_t>(separator - begin) };
+        value = separator == next ? Slice{ next, 0 } : Slice{ separator + 1, static_cast<std::size_t>(next - separator) - 1 };
+        return true;
+    }
+    return false;
+}
+
+bool Http::UriView::parameter(const char* name, Slice& value) const
+{
+    std::size_t position = 0;
+    Slice current;
+    while (parameter(position, current, value))
+        if (current.equals(name))
+            return true;
+    return false;
+}
+
+namespace {
+
+std::vector<Http::Server::ServicePtr> BuildServices(const Http::Server::ServiceBuilder& builder, std::size_t count)
+{
+    std::vector<Http::Server::ServicePtr> services;
+    for (std::size_t i = 0; i < (std::max)(count, std::size_t(1)); ++i)
+        services.push_back(builder());
+    return services;
+}
+
+std::vector<Http::Server::ServicePtr> SingleService(Http::Server::ServicePtr service)
+{
+    std::vector<Http::Server::ServicePtr> services;
+    services.push_back(std::move(service));
+    return services;
+}
+
+/// Blokuje sygnały na bieżącym wątku, aby trafiały do wątku pierwszego serwisu.
+void BlockSignals()
+{
+#if defined(PATR_OS_UNIX)
+    sigset_t signals;
+    sigfillset(&signals);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif // defined(PATR_OS_UNIX)
+}
+
+/// Okres sprawdzania liczby otwartych połączeń podczas drain() w [ms].
+constexpr int DrainPollInterval = 20;
+
+/// Pierwszy deskryptor gniazd przekazywanych nowemu procesowi (zgodnie z aktywacją gniazd systemd).
+constexpr int ListenHandlesStart = 3;
+
+/// Zwraca gniazda nasłuchujące przekazane przez proces nadrzędny.
+/**
+ * LISTEN_FDS określa liczbę kolejnych deskryptorów od ListenHandlesStart, o ile LISTEN_PID
+ * wskazuje na bieżący proces. Zmienne są usuwane, aby gniazd nie przejął kolejny serwer.
+ */
+std::vector<int> InheritedListeners()
+{
+    std::vector<int> handles;
+#if defined(PATR_OS_UNIX)
+    auto pid = std::getenv("LISTEN_PID");
+    auto count = std::getenv("LISTEN_FDS");
+    if (!pid || !count || std::strtol(pid, nullptr, 10) != ::getpid())
+        return handles;
+
+    for (int handle = ListenHandlesStart; handle < ListenHandlesStart + std::atoi(count); ++handle)
+    {
+        ::fcntl(handle, F_SETFD, FD_CLOEXEC);
+        handles.push_back(handle);
+    }
+    ::unsetenv("LISTEN_PID");
+    ::unsetenv("LISTEN_FDS");
+#endif // defined(PATR_OS_UNIX)
+    return handles;
+}
+
+/// Zamyka przekazane gniazda, dla których zabrakło serwisów.
+void CloseListeners(std::vector<int>& handles)
+{
+#if defined(PATR_OS_UNIX)
+    for (auto handle : handles)
+        ::close(handle);
+#endif // defined(PATR_OS_UNIX)
+    handles.clear();
+}
+
+}
+
+Http::Server::Server(const std::string& host, const std::string& port, ServicePtr service, StrategyPtr globalHandler, TlsPtr tls) :
+    pimpl(new ServerPimpl(SingleService(std::move(service)), std::move(tls))),
     globalHandler(std::move(globalHandler))//(handler)
 {
-    pimpl->signals.add(SIGINT); // nie wspierane na Windows
-    pimpl->signals.add(SIGTERM);
-#if defined(SIGQUIT)
-    pimpl->signals.add(SIGQUIT);
-#endif // defined(SIGQUIT)
+    handleSignals();
 
-    Tcp::Endpoint endpoint = this->pimpl->service->getFactory()->resolve(host, port);
-    pimpl->acceptor.open(endpoint.protocol());
-    pimpl->acceptor.setOption(Tcp::Option::ReuseAddress(true));
-    pimpl->acceptor.bind(endpoint.address());
-    pimpl->acceptor.listen(50);
-    accept();
+    pimpl->inherited = InheritedListeners();
+    listen(*pimpl->reactors.front(), host, port, false);
+    CloseListeners(pimpl->inherited);
+}
+
+Http::Server::Server(const std::string& host, const std::string& port, ServiceBuilder builder, std::size_t nReactors, StrategyPtr globalHandler, TlsPtr tls) :
+    pimpl(new ServerPimpl(BuildServices(builder, nReactors ? nReactors : std::thread::hardware_concurrency()), std::move(tls))),
+    globalHandler(std::move(globalHandler))
+{
+    handleSignals();
+
+    pimpl->inherited = InheritedListeners();
+    auto reusePort = pimpl->reactors.size() > 1;
+    for (auto& reactor : pimpl->reactors)
+        listen(*reactor, host, port, reusePort);
+    CloseListeners(pimpl->inherited);
 }
 
 Http::Server::Server(const std::string & host, const std::string & port, RequestHandler handler, ServicePtr service)
@@ -770,24 +1911,292 @@ Http::Server::Server(const std::string & host, const std::string & port, Request
 }
 
 Http::Server::Server(const std::string & host, const std::string & port, RequestHandler handler)
-    : Server(host, port, ServicePtr(new Tcp::StreamService()), StrategyPtr(new ThreadedHandlerStrategy(std::move(handler))))
+    : Server(host, port, DefaultService(), StrategyPtr(new ThreadedHandlerStrategy(std::move(handler))))
+{
+}
+
+Http::Server::Server(const std::string& host, const std::string& port, RequestHandler handler, std::size_t nReactors, ServiceBuilder builder)
+    : Server(host, port, std::move(builder), nReactors, StrategyPtr(new ThreadedHandlerStrategy(std::move(handler))))
+{
+}
+
+Http::Server::Server(const std::string& host, const std::string& port, RequestHandler handler, TlsPtr tls, std::size_t nReactors, ServiceBuilder builder)
+    : Server(host, port, std::move(builder), nReactors, StrategyPtr(new ThreadedHandlerStrategy(std::move(handler))), std::move(tls))
 {
 }
 
 Http::Server::~Server()
 {
+    globalHandler.reset(); // wątki strategii kończą zadania, przekazując ostatnie odpowiedzi serwisom.
+    for (auto& reactor : pimpl->reactors)
+        reactor->service->discardPosted(); // odpowiedzi zleconych po zakończeniu run() nie można już wysłać.
 }
 
 int Http::Server::run()
 {
-    return pimpl->service->run();
+    auto& reactors = pimpl->reactors;
+    std::vector<std::thread> threads;
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    for (std::size_t i = 1; i < reactors.size(); ++i)
+    {
+        auto service = reactors[i]->service.get();
+        threads.emplace_back([this, service, &error, &errorMutex]
+        {
+            BlockSignals();
+            try
+            {
+                service->run();
+            }
+            catch (...)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    error = std::current_exception();
+                }
+                stop(); // pozostałe serwisy nie powinny działać bez jednego z nich.
+            }
+        });
+    }
+
+    int result = 0;
+    try
+    {
+        result = reactors.front()->service->run();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(errorMutex);
+        error = std::current_exception();
+    }
+
+    for (std::size_t i = 1; i < reactors.size(); ++i)
+        reactors[i]->service->stop();
+    for (auto& thread : threads)
+        thread.join();
+
+    if (error)
+        std::rethrow_exception(error);
+    return result;
+}
+
+void Http::Server::stop()
+{
+    pimpl->reactors.front()->service->stop();
+}
+
+void Http::Server::drain(std::chrono::milliseconds timeout)
+{
+    pimpl->reactors.front()->service->post([this, timeout]
+    {
+        if (pimpl->draining)
+            return;
+        pimpl->draining = true;
+
+        for (auto& reactor : pimpl->reactors)
+        {
+            auto acceptor = &reactor->acceptor;
+            reactor->service->post([acceptor] { acceptor->close(); }); // akceptor należy do wątku swojego serwisu.
+        }
+        globalHandler->drain();
+        awaitDrained(std::chrono::steady_clock::now() + timeout);
+    });
+}
+
+void Http::Server::setDrainTimeout(std::chrono::milliseconds timeout)
+{
+    pimpl->drainTimeout = timeout;
+}
+
+int Http::Server::restart(const std::vector<std::string>& arguments)
+{
+#if defined(PATR_OS_UNIX)
+    if (arguments.empty())
+        throw std::invalid_argument("restart requires a program path");
+
+    std::vector<int> listeners;
+    for (auto& reactor : pimpl->reactors)
+    {
+        auto handle = reactor->acceptor.getHandle();
+        if (handle != -1)
+            listeners.push_back(handle); // gniazda są nieblokujące - oba procesy mogą zostać wybudzone dla jednego połączenia.
+    }
+    if (listeners.empty())
+        throw Tcp::PlatformError("no listening sockets to hand over");
+
+    // Po fork() proces potomny może wywoływać wyłącznie funkcje async-signal-safe - wszystko przygotowywane jest wcześniej.
+    std::vector<char*> argv;
+    for (auto& argument : arguments)
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    argv.push_back(nullptr);
+
+    auto count = "LISTEN_FDS=" + std::to_string(listeners.size());
+    auto pid = "LISTEN_PID=" + std::string(20, '\0');
+    std::vector<char*> envp;
+    for (auto variable = environ; *variable; ++variable)
+    {
+        if (std::string(*variable).compare(0, 7, "LISTEN_") != 0)
+            envp.push_back(*variable);
+    }
+    envp.push_back(&count[0]);
+    envp.push_back(&pid[0]);
+    envp.push_back(nullptr);
+
+    std::vector<int> moved(listeners.size());
+    auto first = ListenHandlesStart + static_cast<int>(listeners.size());
+    auto maxHandle = static_cast<int>(::sysconf(_SC_OPEN_MAX));
+
+    auto child = ::fork();
+    if (child == -1)
+        throw Tcp::PlatformError("fork failed (" + std::to_string(errno) + ')');
+
+    if (child == 0)
+    {
+        for (std::size_t i = 0; i < listeners.size(); ++i)
+            moved[i] = ::fcntl(listeners[i], F_DUPFD, first); // poza docelowym zakresem, aby nie nadpisać kolejnego gniazda.
+        for (std::size_t i = 0; i < moved.size(); ++i)
+            ::dup2(moved[i], ListenHandlesStart + static_cast<int>(i)); // dup2 usuwa FD_CLOEXEC.
+        for (auto handle = first; handle < maxHandle; ++handle)
+            ::close(handle);
+
+        char digits[20];
+        int length = 0;
+        for (auto value = ::getpid(); value > 0; value /= 10)
+            digits[length++] = static_cast<char>('0' + value % 10);
+        auto out = &pid[11];
+        while (length > 0)
+            *out++ = digits[--length];
+
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigprocmask(SIG_SETMASK, &signals, nullptr); // maska wątku wywołującego jest dziedziczona przez execve.
+        ::execve(argv[0], argv.data(), envp.data());
+        ::_exit(127);
+    }
+
+    drain(pimpl->drainTimeout);
+    return static_cast<int>(child);
+#else
+    (void)arguments;
+    throw Tcp::NotImplemented("listening socket handover requires a Unix platform");
+#endif // defined(PATR_OS_UNIX)
+}
+
+void Http::Server::setKeepAlive(const KeepAlive& keepAlive)
+{
+    pimpl->keepAlive = keepAlive;
+}
+
+void Http::Server::setBodyLimits(const BodyLimits& limits)
+{
+    pimpl->bodyLimits = limits;
+}
+
+void Http::Server::setRequestLimits(const RequestLimits& limits)
+{
+    pimpl->requestLimits = limits;
+}
+
+void Http::Server::setSocketOptions(const SocketOptions& options)
+{
+    pimpl->socketOptions = options;
+    for (auto& reactor : pimpl->reactors)
+    {
+        if (reactor->acceptor.getHandle() == -1)
+            continue;
+        configure(*reactor);
+        reactor->acceptor.listen(options.backlog);
+    }
+}
+
+Http::Server::ServicePtr Http::Server::DefaultService()
+{
+    return ServicePtr(new Tcp::StreamService());
+}
+
+Http::Server::ServicePtr Http::Server::UringService()
+{
+#if defined(PATR_OS_LINUX)
+    if (Tcp::UringStreamService::Supported())
+        return ServicePtr(new Tcp::UringStreamService());
+    return ServicePtr(new Tcp::EpollStreamService());
+#else
+    return DefaultService();
+#endif // defined(PATR_OS_LINUX)
+}
+
+void Http::Server::listen(Reactor& reactor, const std::string& host, const std::string& port, bool reusePort)
+{
+    if (!pimpl->inherited.empty())
+    {
+        reactor.acceptor.assign(pimpl->inherited.front());
+        pimpl->inherited.erase(pimpl->inherited.begin());
+        configure(reactor);
+        reactor.acceptor.listen(pimpl->socketOptions.backlog);
+        accept(reactor);
+        return;
+    }
+
+    Tcp::Endpoint endpoint = reactor.service->getFactory()->resolve(host, port);
+    reactor.acceptor.open(endpoint.protocol());
+    reactor.acceptor.setOption(Tcp::Option::ReuseAddress(true));
+    if (reusePort)
+        reactor.acceptor.setOption(Tcp::Option::ReusePort(true));
+    configure(reactor); // rozmiar bufora odbiorczego wpływa na skalowanie okna ogłaszane w SYN.
+    reactor.acceptor.bind(endpoint.address());
+    reactor.acceptor.listen(pimpl->socketOptions.backlog);
+    accept(reactor);
+}
+
+void Http::Server::handleSignals()
+{
+    pimpl->signals.add(SIGINT); // nie wspierane na Windows
+    pimpl->signals.add(SIGTERM);
+#if defined(SIGQUIT)
+    pimpl->signals.add(SIGQUIT);
+#endif // defined(SIGQUIT)
+
+    pimpl->reactors.front()->service->setSignalHandler([this](int)
+    {
+        if (pimpl->draining || pimpl->drainTimeout.count() == 0)
+            stop(); // Kolejny sygnał przerywa oczekiwanie na zakończenie połączeń.
+        else
+            drain(pimpl->drainTimeout);
+    });
+}
+
+void Http::Server::awaitDrained(std::chrono::steady_clock::time_point deadline)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (globalHandler->active() == 0 || now >= deadline)
+    {
+        stop();
+        return;
+    }
+    auto next = (std::min)(deadline, now + std::chrono::milliseconds(DrainPollInterval));
+    pimpl->reactors.front()->service->asyncWait(next, [this, deadline] { awaitDrained(deadline); });
+}
+
+void Http::Server::configure(Reactor& reactor)
+{
+    auto& options = pimpl->socketOptions;
+    reactor.acceptor.setOption(Tcp::Option::NoDelay(options.noDelay));
+    if (options.receiveBuffer > 0)
+        reactor.acceptor.setOption(Tcp::Option::ReceiveBuffer(options.receiveBuffer));
+    if (options.sendBuffer > 0)
+        reactor.acceptor.setOption(Tcp::Option::SendBuffer(options.sendBuffer));
+    if (options.deferAccept > 0)
+        reactor.acceptor.setOption(Tcp::Option::DeferAccept(options.deferAccept));
+    if (options.fastOpen > 0)
+        reactor.acceptor.setOption(Tcp::Option::FastOpen(options.fastOpen));
 }
 
-void Http::Server::accept()
+void Http::Server::accept(Reactor& reactor)
 {
-    pimpl->acceptor.asyncAccept([this](Tcp::Socket socket)
+    reactor.acceptor.asyncAccept([this, &reactor](Tcp::Socket socket)
     {
-        globalHandler->start(std::make_shared<Connection>(std::move(socket), *globalHandler));
-        accept();
+        globalHandler->start(std::make_shared<Connection>(std::move(socket), *globalHandler, pimpl->keepAlive, pimpl->bodyLimits, pimpl->requestLimits));
+        accept(reactor);
     });
 }
@@ -2,12 +2,16 @@
 #define PATR_SERVER_H
 
 #include <memory>
+#include <functional>
+#include <string>
+#include <cstdint>
 
 #include <array>
 #include <queue>
 #include <vector>
 #include <unordered_set>
 
+#include <chrono>
 #include <thread>
 #include <atomic>
 #include <condition_variable>
@@ -16,11 +20,13 @@
 //#include "Socket.h"
 
 #include "../utility/ThreadPool.h"
+#include "../utility/MemoryPool.h"
 
 namespace Tcp {
 
 class Socket;
 class StreamServiceInterface;
+class SslContext;
 }
 
 /// Przestrzeń klas i funkcji oraz stałych związanych z działaniem serwera HTTP.
@@ -37,40 +43,187 @@ class Response;
 class Request;
 
 class HandlerStrategy;
+struct BodyLimits;
+struct RequestLimits;
+
+/// Ustawienia trwałych połączeń HTTP/1.1.
+struct KeepAlive
+{
+    KeepAlive(int timeout = 5000, std::size_t maxRequests = 100, bool cork = false, int sendTimeout = 30000);
+
+    /// Czas bezczynności połączenia pomiędzy zapytaniami w [ms].
+    int timeout;
+    /// Maksymalna liczba zapytań na jednym połączeniu, wartości 0 i 1 wyłączają keep-alive.
+    std::size_t maxRequests;
+    /// Łączy odpowiedzi na zapytania potokowe w pełne segmenty TCP (TCP_CORK).
+    /**
+     * Gniazdo pozostaje zakorkowane, dopóki w kolejce oczekują kolejne odpowiedzi.
+     */
+    bool cork;
+    /// Czas w [ms], po którym połączenie jest zamykane, jeżeli zapis odpowiedzi nie postępuje.
+    /**
+     * Ogranicza wyłącznie zapis - czas obsługi zapytania przez handler nie jest ograniczony.
+     * Wartość 0 wyłącza ograniczenie.
+     */
+    int sendTimeout;
+};
+
+/// Ustawienia gniazd nasłuchujących serwera.
+/**
+ * Opcje ustawiane są na akceptorach, a przyjęte połączenia dziedziczą TCP_NODELAY
+ * oraz rozmiary buforów. Wartość 0 pozostawia ustawienie systemowe.
+ */
+struct SocketOptions
+{
+    SocketOptions(int backlog = 1024, bool noDelay = true, int deferAccept = 0, int receiveBuffer = 0, int sendBuffer = 0, int fastOpen = 0);
+
+    /// Długość kolejki oczekujących połączeń, ograniczana przez system (np. net.core.somaxconn).
+    int backlog;
+    /// Wyłącza algorytm Nagle'a (TCP_NODELAY).
+    bool noDelay;
+    /// Czas oczekiwania na pierwsze dane klienta przed wybudzeniem akceptora w [s] (TCP_DEFER_ACCEPT).
+    int deferAccept;
+    /// Rozmiary buforów gniazd w bajtach (SO_RCVBUF, SO_SNDBUF).
+    int receiveBuffer;
+    int sendBuffer;
+    /// Długość kolejki połączeń TCP Fast Open.
+    int fastOpen;
+};
 
 /// Klasa enkapsulująca połączenie z klientem.
 /**
- * Odpowiedzialna za odczytanie zapytania i wywołanie odpowiedzi.
+ * Odpowiedzialna za odczytanie zapytań i wywołanie odpowiedzi.
+ * Połączenie pozostaje otwarte zgodnie z nagłówkiem Connection (HTTP/1.1 domyślnie keep-alive),
+ * a kolejne zapytania mogą być przesyłane potokowo - odpowiedzi wysyłane są w kolejności zapytań.
+ * Połączenie rozpoczęte wstępem HTTP/2 (h2c z wcześniejszą wiedzą) obsługuje Http2Session - zapytania
+ * jego strumieni obsługiwane są współbieżnie przez strategię, a odpowiedzi wysyłane w kolejności ich gotowości.
  */
 class Connection : public std::enable_shared_from_this<Connection>
 {
 public:
     typedef std::array<char, 8192> BufferType;
 
+    /// Zajętość pul pamięci współdzielonych przez połączenia.
+    struct PoolOccupancy
+    {
+        Utility::MemoryPool::Statistics buffers; //< Bufory odczytu, przydzielane wyłącznie na czas odczytu.
+        Utility::MemoryPool::Statistics connections; //< Stan połączeń.
+    };
+
     /// Tworzy nowe połączenie dla gniazda oraz klasy obsługującej zapytanie.
     /**
      * Klasa obsługująca zapytanie ma rolę menedżera.
      */
-    Connection(Tcp::Socket socket, HandlerStrategy& handler);
+    Connection(Tcp::Socket socket, HandlerStrategy& handler, const KeepAlive& keepAlive = KeepAlive());
+    /// Tworzy nowe połączenie o podanych ograniczeniach ciała zapytań.
+    Connection(Tcp::Socket socket, HandlerStrategy& handler, const KeepAlive& keepAlive, const BodyLimits& limits);
+    /// Tworzy nowe połączenie o podanych ograniczeniach ciała oraz nagłówka zapytań.
+    Connection(Tcp::Socket socket, HandlerStrategy& handler, const KeepAlive& keepAlive, const BodyLimits& limits, const RequestLimits& requestLimits);
     ~Connection();
 
     /// Otwiera połączenie.
     void start();
     /// Zamyka połączenie.
     void stop();
+    /// Kończy połączenie po obsłużeniu odczytanych zapytań, może zostać wywołana z dowolnego wątku.
+    /**
+     * Bezczynne połączenie jest zamykane od razu, a pozostałe po wysłaniu ostatniej
+     * odpowiedzi z nagłówkiem Connection: close.
+     */
+    void drain();
+
+    /// Zwraca zajętość pul pamięci wszystkich połączeń.
+    /**
+     * Bezczynne połączenia keep-alive nie zajmują bufora odczytu.
+     */
+    static PoolOccupancy occupancy();
 
 private:
-    /// Odczytuje część nagłówkową zapytania HTTP.
+    /// Odczytuje kolejną porcję danych z gniazda.
     /**
-     * W przypadku niepoprawności może wcześniej zakończyć połączenie z
-     * komunikatem Bad Request.
+     * Bufor pobierany jest z puli dopiero przy gotowości gniazda i zwracany po przetworzeniu danych.
      */
     void read();
-    /// Dokonuje odczytu ciała zapytania HTTP.
-    void readBody();
+    /// Pobiera bufor odczytu o rozmiarze BufferType z puli.
+    char* acquireBuffer();
+    /// Zwraca bufor odczytu do puli.
+    void releaseBuffer();
+    /// Parsuje odczytane dane, mogące zawierać kilka zapytań.
+    /**
+     * W przypadku niepoprawności może wcześniej zakończyć połączenie z
+     * komunikatem Bad Request, a dla zbyt dużego ciała - Request Entity Too Large.
+     * Nagłówek przekraczający RequestLimits otrzymuje odpowiedź 414 lub 431.
+     * @return true, jeżeli należy kontynuować odczyt.
+     */
+    bool consume(char* begin, char* end);
+    /// Przekazuje odczytane zapytanie do kolejki odpowiedzi.
+    /**
+     * @return true, jeżeli połączenie pozostaje otwarte.
+     */
+    bool dispatch();
+    /// Odpowiada na odrzucone zapytanie podanym statusem i kończy połączenie.
+    void reject(ResponseStatus status);
+    /// Asynchronicznie wysyła od podanej pozycji gotową odpowiedź bez ciała, po czym kończy połączenie.
+    void sendStock(ResponseStatus status, std::size_t offset);
+    /// Przełącza połączenie na HTTP/2 po odczytaniu pierwszej części wstępu (PRI * HTTP/2.0).
+    /**
+     * @return true, jeżeli należy kontynuować odczyt.
+     */
+    bool upgrade(char* begin, char* end);
+    /// Przekazuje zapytanie strumienia HTTP/2 do funkcji obsługującej.
+    void handle(std::uint32_t stream, Request request);
+    /// Przekazuje pierwsze oczekujące zapytanie do funkcji obsługującej.
+    /**
+     * Funkcja obsługująca wykonywana jest przez strategię, a gotowa odpowiedź
+     * przekazywana z powrotem do wątku serwisu.
+     */
     void write();
-
-    BufferType buffer;
+    /// Asynchronicznie wysyła odpowiedź od podanej pozycji na wątku serwisu.
+    /**
+     * Linia statusu, nagłówki i ciało zapisywane są jedną sekwencją buforów, bez scalania.
+     */
+    void send(std::shared_ptr<Response> response, std::size_t offset, bool keepAlive);
+    /// Wysyła odpowiedź strumieniową, wywołując jej producenta na bieżącym wątku.
+    /**
+     * Części ciała przekazywane są do wątku serwisu, a producent jest wstrzymywany,
+     * gdy liczba niewysłanych bajtów przekroczy ograniczenie.
+     * @param chunked części ciała kodowane są zgodnie z Transfer-Encoding: chunked.
+     */
+    void stream(std::shared_ptr<Response> response, bool chunked, bool keepAlive);
+    /// Wysyła odpowiedź strumieniową na strumieniu HTTP/2, wywołując jej producenta na bieżącym wątku.
+    void stream(std::uint32_t id, std::shared_ptr<Response> response);
+    /// Przekazuje część odpowiedzi strumieniowej do wysłania.
+    /**
+     * @param id strumień HTTP/2, 0 dla odpowiedzi HTTP/1.
+     * @return false, jeżeli połączenie zostało zamknięte.
+     */
+    bool push(std::string data, std::uint32_t id = 0);
+    /// Wysyła oczekujące części odpowiedzi strumieniowej lub ramki HTTP/2 na wątku serwisu.
+    /**
+     * Zamyka połączenie po wysłaniu ostatnich ramek zakończonej sesji HTTP/2.
+     */
+    void deliver();
+    /// Wstrzymuje wysyłanie niepełnych segmentów, jeżeli oczekują kolejne odpowiedzi.
+    void cork();
+    /// Wypycha wstrzymane segmenty po wysłaniu ostatniej oczekującej odpowiedzi.
+    void uncork();
+    /// Kończy obsługę wysłanej odpowiedzi i przechodzi do kolejnego zapytania.
+    void sent(bool keepAlive);
+    /// Wyrejestrowuje połączenie z serwisu i strategii.
+    void finish();
+    /// Dostosowuje czas bezczynności gniazda do stanu połączenia.
+    /**
+     * Termin odbioru zapytania HTTP/1 nadzoruje watch(), a gniazdo pozostaje otwarte do wysłania odpowiedzi 408.
+     * W trakcie zapisu, który nie podlega innemu ograniczeniu, czas wynosi KeepAlive::sendTimeout.
+     */
+    void updateTimeout();
+    /// Zleca serwisowi oczekiwanie na termin odbioru bieżącego zapytania.
+    void watch();
+    /// Wywoływana przez serwis po upływie terminu - odpowiada 408 i kończy połączenie.
+    /**
+     * Termin jest przesuwany leniwie, jak w Tcp::SocketService - jeżeli został wydłużony, oczekiwanie jest zlecane ponownie.
+     */
+    void expired();
 
     HandlerStrategy& globalHandler;
     struct ConnectionPimpl;
@@ -100,40 +253,118 @@ public:
      * Sposób wywołania funkcji leży po stronie implementacji.
      */
     virtual void handle(ConnectionResponse response) = 0;
-    /// Bezpośrednio wysyła odpowiedź do gniazda.
-    virtual void respond(Tcp::Socket& socket, ResponseStatus stockResponse) = 0;
 
     /// Uruchamia połączenie.
     virtual void start(ConnectionPtr connection) = 0;
     /// Kończy połączenie.
     virtual void stop(ConnectionPtr connection) = 0;
+
+    /// Kończy otwarte oraz nowe połączenia po obsłużeniu przyjętych zapytań.
+    virtual void drain() {}
+    /// Zwraca liczbę otwartych połączeń.
+    virtual std::size_t active() const { return 0; }
+};
+
+
+
+/// Adaptacyjny limit liczby jednocześnie przyjętych zapytań.
+/**
+ * Limit dostosowywany jest gradientowo do średniego opóźnienia: dopóki nie przekracza ono
+ * tolerance-krotności opóźnienia bazowego (powoli nadążającego za średnim), limit rośnie
+ * o pierwiastek ze swojej wartości, a w przeciwnym razie maleje proporcjonalnie do wzrostu opóźnienia.
+ * Ustalona kolejka nie zmniejsza limitu - jedynie narastające opóźnienie.
+ * Długość kolejki, a wraz z nią opóźnienie przyjętych zapytań, pozostaje ograniczona również przy przeciążeniu.
+ * Klasa jest bezpieczna wielowątkowo.
+ */
+class ConcurrencyLimit
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    /// Stan ograniczenia.
+    struct Statistics
+    {
+        std::size_t limit; //< Obecny limit zapytań.
+        std::size_t inFlight; //< Liczba przyjętych, nieobsłużonych zapytań.
+        std::size_t rejected; //< Liczba odrzuconych zapytań.
+        Clock::duration baseline; //< Opóźnienie bazowe.
+        Clock::duration latency; //< Średnie opóźnienie (wykładnicza średnia ruchoma).
+    };
+
+    /// Tworzy limit o wartości początkowej initial, zmieniający się w przedziale [minimum, maximum].
+    ConcurrencyLimit(std::size_t initial, std::size_t minimum, std::size_t maximum, double tolerance = 2.0);
+
+    /// Przyjmuje zapytanie, jeżeli nie przekracza limitu.
+    /**
+     * @return false, jeżeli zapytanie należy odrzucić.
+     */
+    bool acquire();
+    /// Kończy obsługę przyjętego zapytania i aktualizuje limit zmierzonym opóźnieniem.
+    void release(Clock::duration latency);
+    /// Kończy przyjęte zapytanie bez pomiaru opóźnienia (np. gdy nie zostało obsłużone).
+    void cancel();
+    /// Zwraca sugerowany czas ponowienia odrzuconego zapytania w sekundach (nagłówek Retry-After).
+    std::size_t retryAfter() const;
+    /// Zwraca obecny stan ograniczenia.
+    Statistics statistics() const;
+
+private:
+    mutable std::mutex mutex;
+    const double minimum;
+    const double maximum;
+    const double tolerance;
+    double limit;
+    std::size_t inFlight;
+    std::size_t rejected;
+    double baseline; //< Opóźnienie bazowe w [s], 0 przed pierwszym pomiarem.
+    double average; //< Średnie opóźnienie w [s].
 };
 
 
 
 /// Klasa odpowiedzialna za strategię podziału zadań na ograniczoną liczbę wątków.
+/**
+ * Liczba przyjętych zapytań ograniczana jest przez ConcurrencyLimit - zapytania ponad limit
+ * odrzucane są natychmiast odpowiedzią Service Unavailable z nagłówkiem Retry-After,
+ * zamiast oczekiwać w kolejce puli wątków.
+ */
 class ThreadedHandlerStrategy : public HandlerStrategy
 {
 public:
     /// Tworzy obiekt obsługujący kolejkę maxRequests zapytań za pomocą podanej funkcji na nThreads wątkach.
     /**
+     * Limit przyjętych zapytań startuje od czterokrotności liczby wątków i przy przeciążeniu maleje
+     * co najwyżej do liczby wątków, tak aby każdy z nich miał zadanie. Górną granicą jest maxRequests,
+     * lecz nie mniej niż liczba wątków.
      * @param nThreads wartość 0 ustawia liczbę wątków równą wykrytej liczbie procesorów.
      */
     ThreadedHandlerStrategy(RequestHandler handler, std::size_t maxRequests = 5000U,  std::size_t nThreads = 0U);
 
     /// Przekazuje zadanie do oddzielnego wątku.
     void handle(ConnectionResponse response) override;
-    /// Odpowiada na głównym wątku.
-    void respond(Tcp::Socket& socket, ResponseStatus stockResponse) override;
 
     /// Implementuje HandlerStrategy.
     void start(ConnectionPtr connection) override;
     void stop(ConnectionPtr connection) override;
+    /// Zadania w kolejce puli wątków są wykonywane, a połączenia zamykane po ich odpowiedziach.
+    void drain() override;
+    std::size_t active() const override;
+
+    /// Zwraca stan kontroli przyjmowania zapytań.
+    ConcurrencyLimit::Statistics admission() const;
 
 private:
+    /// Odpowiada Service Unavailable z sugerowanym czasem ponowienia.
+    void shed(const ConnectionResponse& response);
+
+    /// Chroni zbiór połączeń współdzielony przez wątki serwisów.
+    mutable std::mutex mutex;
     std::unordered_set<ConnectionPtr> connections;
     RequestHandler handler;
+    std::size_t nThreads;
+    ConcurrencyLimit limit;
     ConnectionPool pool;
+    bool draining; //< Nowe połączenia kończone są po pierwszym zapytaniu, chroniona przez mutex.
 };
 
 
@@ -142,6 +373,13 @@ private:
 /**
  * Za jej pomocą użytkownik może ustalić strategię 
  * rozdzielania zadań oraz serwis demultipleksacji połączeń.
+ * Serwer może działać na kilku serwisach jednocześnie - każdy z nich ma własny
+ * wątek i akceptor nasłuchujący na wspólnym porcie (SO_REUSEPORT), a jądro
+ * rozdziela między nie nowe połączenia.
+ * Podanie kontekstu serwera Tcp::SslContext włącza TLS - wszystkie serwisy współdzielą
+ * wtedy jego pamięć sesji.
+ * Na systemach Unix serwer przejmuje gniazda nasłuchujące przekazane przez proces nadrzędny
+ * (zmienne LISTEN_FDS i LISTEN_PID) zamiast otwierać nowe - zob. restart().
  */
 class Server
 {
@@ -149,11 +387,21 @@ public:
     typedef HandlerStrategy::RequestHandler RequestHandler;
     typedef std::unique_ptr<Tcp::StreamServiceInterface> ServicePtr;
     typedef std::unique_ptr<HandlerStrategy> StrategyPtr;
+    typedef std::function<ServicePtr()> ServiceBuilder;
+    typedef std::shared_ptr<Tcp::SslContext> TlsPtr;
     /// Tworzy nowy obiekt na danym adresie i porcie.
     /**
      * Daje największe możliwości dostosowania.
+     * @param tls kontekst serwera TLS, nullptr oznacza połączenia bez szyfrowania.
+     */
+    Server(const std::string& host, const std::string& port, ServicePtr service, StrategyPtr globalHandler, TlsPtr tls = nullptr);
+    /// Tworzy nowy obiekt obsługujący połączenia na nReactors serwisach.
+    /**
+     * @param builder tworzy kolejne serwisy, każdy z nich działa na oddzielnym wątku.
+     * @param nReactors wartość 0 ustawia liczbę serwisów równą wykrytej liczbie procesorów.
+     * Dla więcej niż jednego serwisu wymagana jest obsługa SO_REUSEPORT.
      */
-    Server(const std::string& host, const std::string& port, ServicePtr service, StrategyPtr globalHandler);
+    Server(const std::string& host, const std::string& port, ServiceBuilder builder, std::size_t nReactors, StrategyPtr globalHandler, TlsPtr tls = nullptr);
     /// Tworzy nowy obiekt z zadaną funkcją odpowiadającą na zapytania.
     /**
      * @param handler funkcja lub obiekt funkcyjny obsługujący argument Http::Request i zwracający Http::Response.
@@ -161,17 +409,76 @@ public:
      */
     Server(const std::string& host, const std::string& port, RequestHandler handler, ServicePtr service);
     Server(const std::string& host, const std::string& port, RequestHandler handler);
+    Server(const std::string& host, const std::string& port, RequestHandler handler, std::size_t nReactors, ServiceBuilder builder = DefaultService);
+    /// Tworzy nowy obiekt przyjmujący połączenia TLS.
+    Server(const std::string& host, const std::string& port, RequestHandler handler, TlsPtr tls, std::size_t nReactors = 1, ServiceBuilder builder = DefaultService);
     ~Server();
     /// Uruchamia serwer.
     /**
-     * Serwer będzie działać do czasu otrzymania sygnału przerwania systemowego.
-     * Zwraca 0 w przypadku złapania wyjątku, w przeciwnym razie nie wraca.
+     * Serwer będzie działać do czasu wywołania stop() lub zakończenia drain(), które
+     * następuje również po otrzymaniu sygnału przerwania systemowego. Dodatkowe serwisy
+     * uruchamiane są na nowych wątkach, pierwszy na wątku wywołującym.
+     * @return wartość otrzymanego sygnału lub 0.
      */
     int run();
+    /// Kończy działanie run(), może zostać wywołana z dowolnego wątku.
+    void stop();
+    /// Łagodnie kończy działanie run(), może zostać wywołana z dowolnego wątku.
+    /**
+     * Serwer przestaje przyjmować połączenia i zamyka bezczynne, a przyjęte zapytania
+     * (również oczekujące w kolejce strategii) obsługuje do końca. run() kończy działanie
+     * po zamknięciu wszystkich połączeń, lecz nie później niż po upływie timeout.
+     */
+    void drain(std::chrono::milliseconds timeout);
+    /// Ustawia czas na dokończenie obsługi połączeń po otrzymaniu sygnału.
+    /**
+     * Domyślnie 30 s, wartość 0 kończy działanie natychmiast.
+     * Kolejny sygnał w trakcie kończenia działania przerywa je natychmiast.
+     */
+    void setDrainTimeout(std::chrono::milliseconds timeout);
+    /// Uruchamia nowy proces serwera, przekazując mu gniazda nasłuchujące, i kończy działanie bieżącego.
+    /**
+     * Nowy proces przejmuje gniazda wraz z kolejką oczekujących połączeń, więc żadne z nich nie zostaje
+     * utracone, a bieżący dokańcza obsługę otwartych połączeń jak w drain(). Nowy serwer powinien
+     * mieć co najmniej tyle serwisów co bieżący. Dostępne wyłącznie na systemach Unix.
+     * @param arguments ścieżka programu oraz jego argumenty.
+     * @return identyfikator nowego procesu.
+     */
+    int restart(const std::vector<std::string>& arguments);
+    /// Ustawia parametry trwałych połączeń dla nowych połączeń.
+    void setKeepAlive(const KeepAlive& keepAlive);
+    /// Ustawia ograniczenia ciała zapytań dla nowych połączeń.
+    void setBodyLimits(const BodyLimits& limits);
+    /// Ustawia ograniczenia nagłówka oraz czasu odbioru zapytań dla nowych połączeń.
+    void setRequestLimits(const RequestLimits& limits);
+    /// Ustawia opcje gniazd nasłuchujących.
+    /**
+     * Konstruktor otwiera akceptory z domyślnymi opcjami - zmiana dotyczy otwartych akceptorów,
+     * a długość kolejki zmieniana jest ponownym wywołaniem listen().
+     */
+    void setSocketOptions(const SocketOptions& options);
+
+    /// Tworzy domyślny serwis Tcp::StreamService.
+    static ServicePtr DefaultService();
+    /// Tworzy serwis Tcp::UringStreamService, może zostać przekazana jako builder.
+    /**
+     * Jeżeli jądro nie obsługuje io_uring, tworzy Tcp::EpollStreamService, a poza Linuksem DefaultService().
+     */
+    static ServicePtr UringService();
 
 private:
+    struct Reactor;
+
+    /// Otwiera akceptor serwisu na podanym adresie.
+    void listen(Reactor& reactor, const std::string& host, const std::string& port, bool reusePort);
+    /// Ustawia opcje gniazda akceptora serwisu.
+    void configure(Reactor& reactor);
     /// asynchronicznie akceptuje połączenie.
-    void accept();
+    void accept(Reactor& reactor);
+    /// Rejestruje sygnały kończące działanie serwera.
+    void handleSignals();
+    /// Kończy działanie run() po zamknięciu wszystkich połączeń lub w chwili deadline.
+    void awaitDrained(std::chrono::steady_clock::time_point deadline);
 
     struct ServerPimpl;
     std::unique_ptr<ServerPimpl> pimpl;
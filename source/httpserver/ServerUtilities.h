@@ -4,10 +4,19 @@
 #include <unordered_map>
 #include <string>
 #include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
 
 
 namespace Http {
 
+enum class ResponseStatus;
+
 /// Stała określająca nową linie wykorzystywaną przez HTTP.
 constexpr auto CRLF = "\r\n";
 /// Separator nagłówków HTTP.
@@ -16,6 +25,18 @@ constexpr auto HEADER_SEPARATOR = ": ";
 
 
 
+/// Wycinek bufora, odpowiednik string_view.
+struct Slice
+{
+    const char* data;
+    std::size_t size;
+
+    /// Kopiuje wycinek do nowego łańcucha znaków.
+    std::string str() const;
+    /// Porównuje zawartość wycinka z łańcuchem znaków zakończonym zerem.
+    bool equals(const char* text) const;
+};
+
 /// Klasa określająca URI.
 /**
 * Pozwala na dekodowanie, tokenizację i segmentację oraz szeregowanie
@@ -66,6 +87,50 @@ private:
     std::string uri;
 };
 
+/// Widok URI dzielący go na ścieżkę i argumenty zapytania GET bez alokacji pamięci.
+/**
+* Alternatywa dla Uri::segments() i Uri::query(), które tworzą kopie elementów.
+* Wycinki wskazują na łańcuch URI i pozostają ważne do czasu jego modyfikacji
+* lub zniszczenia. Elementy nie są dekodowane.
+*/
+class UriView
+{
+public:
+    /// Tworzy widok podanego URI.
+    UriView(const Uri& uri);
+    /// Tworzy widok URI zawartego w [data, data + size).
+    UriView(const char* data, std::size_t size);
+
+    /// Zwraca ścieżkę bez argumentów GET.
+    Slice path() const;
+    /// Zwraca argumenty GET (bez znaku '?'), pusty wycinek w przypadku ich braku.
+    Slice query() const;
+    /// Odczytuje kolejny segment ścieżki.
+    /**
+    * Iterację rozpoczyna position równe 0. Początkowy znak '/' jest pomijany,
+    * więc dla /foo/bar segmentami są foo i bar, a dla /foo/ - foo i pusty segment.
+    * @return false, jeżeli nie ma kolejnych segmentów.
+    */
+    bool segment(std::size_t& position, Slice& segment) const;
+    /// Odczytuje kolejny argument GET w postaci nazwa=wartość.
+    /**
+    * Iterację rozpoczyna position równe 0. Argumenty rozdzielone są '&',
+    * argument bez znaku '=' ma pustą wartość, a puste argumenty są pomijane.
+    * @return false, jeżeli nie ma kolejnych argumentów.
+    */
+    bool parameter(std::size_t& position, Slice& name, Slice& value) const;
+    /// Wyszukuje pierwszy argument GET o podanej nazwie.
+    /**
+    * @return false, jeżeli argument nie występuje w zapytaniu.
+    */
+    bool parameter(const char* name, Slice& value) const;
+
+private:
+    const char* data;
+    std::size_t pathSize; //< Długość ścieżki, pozycja znaku '?'.
+    std::size_t size;
+};
+
 
 
 /// Typ wykorzystywany jako ciało dokumentu HTTP.
@@ -107,6 +172,74 @@ typedef std::vector<Header> HeaderContainer;
 
 
 
+class Request;
+
+/// Odbiorca ciała zapytania dostarczany przez użytkownika.
+/**
+* Pozwala przetwarzać duże ciała (np. przesyłane obrazy) w trakcie odbioru,
+* bez przechowywania ich w pamięci. Wywoływany na wątku serwisu.
+*/
+class BodySink
+{
+public:
+    virtual ~BodySink() = default;
+
+    /// Przyjmuje kolejny fragment ciała.
+    /**
+    * @return false przerywa odbiór - klient otrzymuje odpowiedź Bad Request.
+    */
+    virtual bool write(const char* data, std::size_t size) = 0;
+};
+
+
+
+/// Ograniczenia oraz sposób przechowywania ciała zapytania.
+struct BodyLimits
+{
+    /// Tworzy odbiorcę ciała dla zapytania o odczytanym nagłówku, nullptr oznacza domyślne przechowywanie.
+    typedef std::function<std::shared_ptr<BodySink>(const Request&)> SinkFactory;
+
+    BodyLimits(std::size_t maxSize = 32U * 1024U * 1024U, std::size_t spillThreshold = 0U);
+
+    /// Maksymalny rozmiar ciała w bajtach, większe zapytania otrzymują odpowiedź 413.
+    std::size_t maxSize;
+    /// Rozmiar, powyżej którego ciało zapisywane jest do pliku tymczasowego, 0 wyłącza zapis.
+    std::size_t spillThreshold;
+    /// Katalog plików tymczasowych, pusty oznacza katalog systemowy.
+    std::string spillDirectory;
+    SinkFactory sink;
+};
+
+/// Ograniczenia nagłówka zapytania oraz czasu jego odbioru.
+/**
+* Chronią serwer przed klientami przesyłającymi zapytanie bardzo powoli lub
+* w nadmiernym rozmiarze. Naruszenie kończy połączenie odpowiedzią 414, 431 lub 408.
+*/
+struct RequestLimits
+{
+    RequestLimits(std::size_t maxRequestLine = 8192U, std::size_t maxHeaderSize = 32U * 1024U, std::size_t maxHeaderCount = 100U,
+        int headerTimeout = 10000, int bodyTimeout = 30000, std::size_t minRate = 500U);
+
+    /// Maksymalna długość linii zapytania w bajtach, dłuższe otrzymują odpowiedź 414.
+    std::size_t maxRequestLine;
+    /// Maksymalny rozmiar linii nagłówków w bajtach (bez linii zapytania), większe otrzymują odpowiedź 431.
+    std::size_t maxHeaderSize;
+    /// Maksymalna liczba nagłówków, większa otrzymuje odpowiedź 431.
+    std::size_t maxHeaderCount;
+    /// Czas na odbiór nagłówka w [ms], liczony od przyjęcia połączenia lub pierwszego znaku kolejnego zapytania.
+    int headerTimeout;
+    /// Czas na odbiór ciała w [ms], liczony od końca nagłówka.
+    int bodyTimeout;
+    /// Minimalna średnia prędkość odbioru ciała w [B/s].
+    /**
+    * Każde odebrane minRate bajtów wydłuża termin odbioru ciała o sekundę. Wartość 0
+    * wyłącza termin - bodyTimeout jest wtedy czasem bezczynności między odczytami.
+    */
+    std::size_t minRate;
+};
+
+
+
 /// Klasa określająca zapytanie HTTP.
 class Request
 {
@@ -123,6 +256,14 @@ public:
     const HeaderContainer& headers() const;
     /// Zwraca ciało dokumentu.
     const BodyType& body() const;
+    /// Zwraca ścieżkę pliku tymczasowego zawierającego ciało dokumentu.
+    /**
+    * Niepusta, jeżeli ciało przekroczyło BodyLimits::spillThreshold - body() jest wtedy puste.
+    * Plik usuwany jest wraz z ostatnią kopią zapytania.
+    */
+    const std::string& bodyFile() const;
+    /// Zwraca odbiorcę, któremu przekazano ciało dokumentu (lub nullptr).
+    const std::shared_ptr<BodySink>& bodySink() const;
 
 private:
     /// Posiada informacje szczegółowe o główynm wierszu.
@@ -135,8 +276,13 @@ private:
 
     HeaderContainer headerCollection;
     BodyType content;
+    std::shared_ptr<const std::string> file;
+    std::shared_ptr<BodySink> sink;
 
     friend class RequestParser;
+    friend class RequestScanner;
+    friend class BodyReader;
+    friend class Http2Session;
 };
 
 
@@ -186,16 +332,16 @@ public:
     {
         std::size_t max = contentLength(request);
 
-        if (request.content.length() == max)
-            return true;
+        if (request.content.empty())
+            request.content.reserve(max);
 
-        while (begin != end)
-        {
-            request.content += *begin++;
-            if (request.content.length() == max)
-                return true;
-        }
-        return false;
+        auto missing = max - request.content.length();
+        auto available = static_cast<std::size_t>(std::distance(begin, end));
+        if (available > missing)
+            std::advance(end, -static_cast<std::ptrdiff_t>(available - missing));
+        request.content.append(begin, end);
+
+        return request.content.length() == max;
     }
 
     void reset();
@@ -232,6 +378,258 @@ private:
     } state;
 };
 
+/// Parser nagłówka zapytania HTTP wyszukujący separatory wektorowo.
+/**
+* Alternatywa dla RequestParser o tej samej gramatyce. Zamiast przetwarzać
+* kolejne znaki, wyszukuje końce linii, spacje i dwukropki instrukcjami SSE2
+* (AVX2, jeżeli są dostępne przy kompilacji) i zapamiętuje fragmenty nagłówka
+* jako wycinki (Slice) bufora połączenia, bez kopiowania. Jedynie nagłówek
+* podzielony między odczyty jest kopiowany do wewnętrznego bufora.
+* Błędy zgłaszane są z dokładnością do linii - niepoprawna linia zostaje
+* odrzucona po odczytaniu jej zakończenia. Przekroczenie RequestLimits wykrywane
+* jest także w niezakończonej linii, więc bufor nie rośnie ponad ograniczenia.
+*/
+class RequestScanner
+{
+public:
+    typedef RequestParser::Result Result;
+
+    typedef Http::Slice Slice;
+
+    /// Nagłówek w postaci wycinków bufora.
+    typedef std::pair<Slice /* name */, Slice /* value */> HeaderSlice;
+
+    /// Tworzy nowy obiekt o podanych ograniczeniach nagłówka.
+    RequestScanner(const RequestLimits& limits = RequestLimits());
+
+    /// Przeprowadza parsowanie nagłówka zapytania zawartego w [begin, end).
+    /**
+    * Bufor może zostać zmodyfikowany - kontynuacje nagłówków są w nim
+    * scalane z poprzednią wartością. Wycinki pozostają ważne do następnego
+    * wywołania parse() lub reset() oraz dopóki dane bufora nie zostaną nadpisane.
+    * @return wynik oraz pozycję za ostatnim znakiem nagłówka (Good) lub end.
+    */
+    std::pair<Result, char*> parse(char* begin, char* end);
+    /// Przepisuje sparsowany nagłówek do zapytania.
+    /**
+    * Każde pole alokowane jest jednokrotnie z docelowym rozmiarem.
+    */
+    void assign(Request& request) const;
+    /// Przygotowuje obiekt do parsowania kolejnego zapytania.
+    void reset();
+    /// Zwraca status odpowiedzi dla nagłówka odrzuconego wynikiem Result::Bad.
+    /**
+    * RequestUriTooLarge lub RequestHeaderFieldsTooLarge po przekroczeniu ograniczeń, w pozostałych przypadkach BadRequest.
+    */
+    ResponseStatus status() const;
+
+    /// Zwracają wycinki sparsowanego nagłówka, ważne po zwróceniu Result::Good.
+    Slice method() const;
+    Slice uri() const;
+    Version version() const;
+    std::vector<HeaderSlice> headers() const;
+
+private:
+    /// Położenie fragmentu względem początku nagłówka.
+    struct Span
+    {
+        std::size_t offset, size;
+    };
+
+    /// Przetwarza kompletne linie bufora od pozycji scanned.
+    Result scan(char* base, std::size_t size);
+    /// Sprawdza linię zapytania [begin, end) bez znaku CR.
+    bool requestLine(char* base, std::size_t begin, std::size_t end);
+    /// Sprawdza linię nagłówka [begin, end) bez znaku CR.
+    bool headerLine(char* base, std::size_t begin, std::size_t end);
+    /// Tworzy wycinek z położenia względem początku nagłówka.
+    Slice slice(const Span& span) const;
+    /// Odrzuca nagłówek z podanym statusem odpowiedzi.
+    Result reject(ResponseStatus status);
+
+    RequestLimits limits;
+    std::vector<char> buffer; //< Nagłówek podzielony między odczyty.
+    const char* origin; //< Początek nagłówka po zwróceniu Result::Good.
+    std::size_t scanned; //< Początek pierwszej nieprzetworzonej linii.
+    std::size_t searched; //< Pozycja, do której wyszukano końca linii.
+    std::size_t length; //< Długość nagłówka wraz z pustą linią.
+    bool lineParsed; //< Linia zapytania została przetworzona.
+    std::size_t headerBegin; //< Początek pierwszej linii nagłówka.
+    ResponseStatus error; //< Status odpowiedzi dla odrzuconego nagłówka.
+
+    Span methodSpan, uriSpan;
+    Version requestVersion;
+    std::vector<std::pair<Span, Span>> headerSpans;
+};
+
+/// Odbiera ciało zapytania zgodnie z nagłówkami Content-Length lub Transfer-Encoding: chunked.
+/**
+* Dane kopiowane są blokami, a dla Content-Length rezerwowany jest jedynie pierwszy blok - dalsza pamięć przydzielana jest wraz z danymi.
+* Po przekroczeniu BodyLimits::spillThreshold ciało zapisywane jest do pliku tymczasowego,
+* a jeżeli BodyLimits::sink utworzy odbiorcę - przekazywane jest bezpośrednio do niego.
+* Ciało przesłane kawałkami jest dekodowane, a nagłówek Transfer-Encoding zastępowany
+* nagłówkiem Content-Length.
+*/
+class BodyReader
+{
+public:
+    /// Wynik odbioru.
+    enum class Result
+    {
+        Good, //< Odebrano całe ciało.
+        Bad, //< Niepoprawny nagłówek lub kodowanie ciała.
+        Indeterminate, //< Ciało nie zostało jeszcze w całości odebrane.
+        TooLarge, //< Ciało przekracza BodyLimits::maxSize.
+        Unsupported, //< Nieobsługiwane Transfer-Encoding.
+        Failed //< Błąd zapisu ciała do pliku tymczasowego (np. brak miejsca na dysku).
+    };
+
+    /// Tworzy nowy obiekt o podanych ograniczeniach.
+    BodyReader(const BodyLimits& limits = BodyLimits());
+    BodyReader(const BodyReader&) = delete;
+    BodyReader& operator=(const BodyReader&) = delete;
+    ~BodyReader();
+
+    /// Ustala sposób przesyłania ciała na podstawie nagłówków zapytania.
+    /**
+    * Zbyt duże ciało o znanej długości odrzucane jest przed jego odbiorem.
+    */
+    Result start(Request& request);
+    /// Odbiera ciało z danych [begin, end).
+    /**
+    * @return wynik oraz pozycję za ostatnim znakiem ciała (Good) lub end.
+    */
+    std::pair<Result, char*> read(char* begin, char* end, Request& request);
+    /// Przygotowuje obiekt do odbioru kolejnego ciała.
+    void reset();
+
+private:
+    /// Przekazuje fragment ciała do pamięci, pliku lub odbiorcy.
+    Result store(const char* data, std::size_t size, Request& request);
+    /// Przenosi odebraną część ciała do pliku tymczasowego, zwraca false, jeżeli pliku nie udało się utworzyć lub zapisać.
+    bool spill(Request& request);
+    /// Dekoduje ciało przesłane kawałkami.
+    std::pair<Result, char*> readChunked(char* begin, char* end, Request& request);
+    /// Kończy odbiór ciała.
+    Result complete(Request& request);
+
+    /// Stany dekodera Transfer-Encoding: chunked.
+    enum class ChunkState
+    {
+        Size,
+        Extension,
+        SizeNewline,
+        Data,
+        DataCr,
+        DataNewline,
+        TrailerStart,
+        Trailer,
+        TrailerNewline,
+        LastNewline
+    };
+
+    BodyLimits limits;
+    bool chunked;
+    ChunkState state;
+    std::size_t remaining; //< Pozostała długość ciała lub bieżącego kawałka.
+    std::size_t received; //< Liczba odebranych znaków ciała.
+    bool digits; //< Odczytano cyfrę rozmiaru kawałka.
+    bool spillFailed; //< Nie udało się utworzyć lub zapisać pliku tymczasowego - ciało pozostaje w pamięci.
+    std::FILE* file;
+};
+
+/// Tablica nagłówków HPACK (RFC 7541) - statyczna oraz dynamiczna kontekstu kompresji.
+/**
+* Indeksy 1-61 wskazują na tablicę statyczną, kolejne na wpisy dynamiczne od najnowszego.
+* Rozmiar wpisu liczony jest jako długość nazwy i wartości powiększona o 32 bajty.
+*/
+class HpackTable
+{
+public:
+    /// Tworzy tablicę, której wpisy dynamiczne nie przekroczą capacity bajtów.
+    explicit HpackTable(std::size_t capacity = 4096U);
+
+    /// Zwraca nagłówek o podanym indeksie lub nullptr dla indeksu spoza tablicy.
+    const Header* at(std::size_t index) const;
+    /// Wyszukuje nagłówek w tablicy.
+    /**
+    * @return indeks nagłówka o tej samej nazwie (0, jeżeli nie występuje) oraz czy zgadza się również wartość.
+    */
+    std::pair<std::size_t, bool> find(const Header& header) const;
+    /// Dodaje wpis, usuwając najstarsze ponad pojemność tablicy.
+    void insert(Header header);
+    /// Zmienia pojemność tablicy.
+    void resize(std::size_t capacity);
+    /// Zwraca pojemność tablicy.
+    std::size_t capacity() const;
+
+private:
+    /// Usuwa najstarsze wpisy do czasu zmieszczenia się w pojemności.
+    void evict();
+
+    std::deque<Header> entries; //< Wpisy dynamiczne, najnowszy na początku.
+    std::size_t size; //< Rozmiar wpisów dynamicznych.
+    std::size_t maxSize;
+};
+
+/// Dekoder bloków nagłówków HTTP/2 (HPACK).
+/**
+* Obsługuje łańcuchy kodowane kodem Huffmana oraz zmiany rozmiaru tablicy dynamicznej.
+*/
+class HpackDecoder
+{
+public:
+    /// Tworzy dekoder, którego tablica nie może przekroczyć maxTableSize (SETTINGS_HEADER_TABLE_SIZE).
+    HpackDecoder(std::size_t maxTableSize = 4096U);
+
+    /// Dekoduje kompletny blok nagłówków, dołączając nagłówki do headers.
+    /**
+    * Blok dekodowany jest w całości również wtedy, gdy zapytanie zostanie odrzucone,
+    * aby tablica dynamiczna pozostała zgodna z tablicą kodera.
+    * @return false w przypadku błędu kompresji - połączenie należy zakończyć.
+    */
+    bool decode(const char* data, std::size_t size, HeaderContainer& headers);
+    /// Dekoduje kompletny blok nagłówków, ograniczając rozmiar listy (jak SETTINGS_MAX_HEADER_LIST_SIZE) i liczbę nagłówków.
+    /**
+    * Po przekroczeniu maxListSize lub maxCount nagłówków (bez pseudo-nagłówków) headers jest opróżniane,
+    * a reszta bloku aktualizuje jedynie tablicę dynamiczną - krótkie odwołania do dużych wpisów tablicy
+    * nie mogą zwielokrotnić zajmowanej pamięci.
+    * @param exceeded - przyjmuje wartość true, jeżeli przekroczono ograniczenia.
+    * @return false w przypadku błędu kompresji - połączenie należy zakończyć.
+    */
+    bool decode(const char* data, std::size_t size, HeaderContainer& headers, std::size_t maxListSize, std::size_t maxCount, bool& exceeded);
+
+private:
+    HpackTable table;
+    std::size_t maxTableSize;
+};
+
+/// Koder bloków nagłówków HTTP/2 (HPACK).
+/**
+* Powtarzające się nagłówki zastępowane są indeksem tablicy, a łańcuchy kodowane kodem
+* Huffmana, jeżeli skraca to ich zapis. Wartości zmieniające się z każdą odpowiedzią
+* (np. content-length) nie są dodawane do tablicy dynamicznej.
+*/
+class HpackEncoder
+{
+public:
+    /// Tworzy koder o pojemności tablicy maxTableSize.
+    HpackEncoder(std::size_t maxTableSize = 4096U);
+
+    /// Ustawia pojemność tablicy ogłoszoną przez dekoder, zmiana zapisywana jest na początku kolejnego bloku.
+    void setMaxTableSize(std::size_t size);
+    /// Koduje nagłówki, dołączając blok do block.
+    /**
+    * Nazwy nagłówków muszą być zapisane małymi literami.
+    */
+    void encode(const HeaderContainer& headers, std::string& block);
+
+private:
+    HpackTable table;
+    std::size_t maxTableSize;
+    bool resized; //< Zmiana pojemności oczekuje na zapisanie w bloku.
+};
+
 /// Lista możliwych statusów odpowiedzi wraz z odpowiadającymi kodami.
 enum class ResponseStatus
 {
@@ -276,6 +674,7 @@ enum class ResponseStatus
     UnsupportedMediaType = 415,
     RequestedRangeNotSatisfiable = 416,
     ExpectationFailed = 417,
+    RequestHeaderFieldsTooLarge = 431,
 
     /* Server Error */
     InternalServerError = 500,
@@ -287,20 +686,74 @@ enum class ResponseStatus
 };
 
 
+/// Strumień, do którego funkcja obsługująca zapisuje kolejne części ciała odpowiedzi.
+/**
+ * Części wysyłane są w trakcie działania funkcji - dla HTTP/1.1 kodowaniem chunked,
+ * dla starszych klientów jako ciało zakończone zamknięciem połączenia.
+ */
+class ResponseStream
+{
+public:
+    /// Funkcja przekazująca część ciała do połączenia, zwraca false po jego zamknięciu.
+    typedef std::function<bool(const char*, std::size_t)> Sink;
+
+    explicit ResponseStream(Sink sink);
+
+    /// Wysyła kolejną część ciała.
+    /**
+     * Blokuje wywołanie, jeżeli klient nie nadąża z odbiorem wcześniejszych części.
+     * Puste części są pomijane.
+     * @return false, jeżeli połączenie zostało zamknięte - dalsze części nie zostaną wysłane.
+     */
+    bool write(const char* data, std::size_t size);
+    bool write(const std::string& data);
+    /// Zwraca, czy połączenie przyjmuje kolejne części.
+    bool good() const;
+
+private:
+    Sink sink;
+    bool open;
+};
+
 /// Klasa odpowiedzi HTTP.
 class Response
 {
 public:
 
     using Status = ResponseStatus;
+    /// Sekwencja buforów zgodna z Tcp::ConstBufferSequence.
+    typedef std::vector<std::pair<const char*, int>> BufferSequence;
+    /// Funkcja generująca ciało odpowiedzi strumieniowej.
+    typedef std::function<void(ResponseStream&)> Producer;
 
     /// Tworzy odpowiedź z danym kodem i ciałem o podanym typie mediów.
     Response(ResponseStatus code, const BodyType& content, const MediaType& mediaType);
+    /// Tworzy odpowiedź strumieniową, której ciało generowane jest w trakcie wysyłania.
+    /**
+     * Status i nagłówki wysyłane są przed wywołaniem producer, który zapisuje ciało do strumienia.
+     * Producent wykonywany jest na wątku funkcji obsługującej zapytanie.
+     */
+    Response(ResponseStatus code, const MediaType& mediaType, Producer producer);
 
     /// Zwraca odpowiedź w formie, jaka zostanie wysłana do klienta.
     std::string raw() const;
+    /// Zwraca odpowiedź jako sekwencję buforów do zapisu jednym wywołaniem writev.
+    /**
+     * Linia statusu pochodzi ze statycznej tablicy, pozostałe bufory wskazują na nagłówki
+     * i ciało odpowiedzi - pozostają ważne do czasu modyfikacji lub zniszczenia obiektu.
+     */
+    BufferSequence buffers() const;
     /// Zwraca status odpowiedzi.
     ResponseStatus status() const;
+    /// Zwraca ciało odpowiedzi.
+    const BodyType& body() const;
+    /// Zwraca, czy ciało odpowiedzi generowane jest strumieniowo.
+    bool streaming() const;
+    /// Zapisuje ciało odpowiedzi do strumienia.
+    /**
+     * Dla odpowiedzi niestrumieniowych zapisuje całe ciało jednorazowo.
+     */
+    void produce(ResponseStream& stream) const;
 
     /// Posiada nagłówki możliwe do modyfikacji w zależności od potrzeb.
     /**
@@ -311,9 +764,156 @@ public:
 private:
     ResponseStatus responseStatus;
     std::string response;
+    Producer producer;
 };
 
 
+/// Sesja HTTP/2 (RFC 7540) po stronie serwera, niezależna od gniazda.
+/**
+* Sesja rozpoczyna się od drugiej części wstępu połączenia (SM) - pierwsza jest poprawnym
+* zapytaniem HTTP/1 (PRI * HTTP/2.0), odczytywanym przez RequestScanner. Sesja odczytuje ramki,
+* dekoduje nagłówki i przekazuje kompletne zapytania strumieni funkcji dispatcher, a odpowiedzi
+* dzieli na ramki zgodnie z oknami kontroli przepływu klienta - ciała oczekują w kolejkach strumieni
+* na WINDOW_UPDATE. Ramki do wysłania przekazywane są funkcji writer.
+* Ciało zapytania przechowywane jest w pamięci i ograniczone BodyLimits::maxSize, a zdekodowany
+* nagłówek - RequestLimits::maxHeaderSize i maxHeaderCount. Metody należy wywoływać z jednego wątku.
+*/
+class Http2Session
+{
+public:
+    /// Przekazuje ramki do wysłania oraz liczbę bajtów ciał przekazanych przez data(), które opuściły kolejki strumieni.
+    typedef std::function<void(std::string frames, std::size_t released)> Writer;
+    /// Przekazuje kompletne zapytanie strumienia.
+    typedef std::function<void(std::uint32_t stream, Request request)> Dispatcher;
+
+    /// Kody błędów ramek RST_STREAM i GOAWAY.
+    enum class Error : std::uint32_t
+    {
+        NoError = 0x0,
+        Protocol = 0x1,
+        Internal = 0x2,
+        FlowControl = 0x3,
+        SettingsTimeout = 0x4,
+        StreamClosed = 0x5,
+        FrameSize = 0x6,
+        RefusedStream = 0x7,
+        Cancel = 0x8,
+        Compression = 0x9,
+        Connect = 0xa,
+        EnhanceYourCalm = 0xb
+    };
+
+    /// Tworzy sesję przyjmującą jednocześnie maxStreams strumieni i zapisuje ustawienia serwera.
+    Http2Session(Writer writer, Dispatcher dispatcher, const BodyLimits& bodyLimits = BodyLimits(),
+        const RequestLimits& limits = RequestLimits(), std::uint32_t maxStreams = 100U);
+
+    /// Przetwarza odebrane dane.
+    /**
+    * @return false, jeżeli wystąpił błąd połączenia - zapisano GOAWAY i należy zakończyć odczyt.
+    */
+    bool consume(const char* begin, const char* end);
+    /// Wysyła odpowiedź na zapytanie strumienia, pomijając nagłówki właściwe dla HTTP/1.
+    /**
+    * Dla odpowiedzi strumieniowej wysyła wyłącznie nagłówki - ciało przekazywane jest przez data().
+    * Odpowiedzi na strumienie przerwane przez klienta są pomijane.
+    */
+    void respond(std::uint32_t stream, const Response& response);
+    /// Wysyła część ciała odpowiedzi strumieniowej, end kończy strumień.
+    void data(std::uint32_t stream, std::string data, bool end);
+    /// Przerywa strumień (RST_STREAM), np. po błędzie producenta odpowiedzi.
+    void reset(std::uint32_t stream);
+    /// Łagodnie kończy sesję (GOAWAY) - przyjęte strumienie zostają obsłużone, a nowe odrzucone.
+    void goAway();
+    /// Zwraca, czy sesja nie ma otwartych strumieni.
+    bool idle() const;
+    /// Zwraca, czy klient nie zakończył bloku nagłówków lub zapytania któregoś ze strumieni.
+    bool receiving() const;
+    /// Zwraca, czy sesja została zakończona - połączenie należy zamknąć po wysłaniu ramek.
+    bool finished() const;
+
+private:
+    /// Stan strumienia.
+    struct Stream
+    {
+        Request request;
+        std::int64_t sendWindow; //< Okno kontroli przepływu klienta.
+        std::int64_t receiveWindow; //< Okno ogłoszone klientowi.
+        std::string pending; //< Niewysłana część ciała odpowiedzi.
+        std::size_t offset; //< Pozycja pierwszego niewysłanego bajtu pending.
+        bool received; //< Klient zakończył zapytanie (END_STREAM).
+        bool responded; //< Wysłano nagłówki odpowiedzi.
+        bool ended; //< Ciało odpowiedzi jest kompletne - po pending następuje END_STREAM.
+        bool streamed; //< Ciało przekazywane jest przez data().
+    };
+
+    /// Przetwarza kompletną ramkę.
+    /**
+    * @return false, jeżeli wystąpił błąd połączenia.
+    */
+    bool frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size);
+    bool onData(std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size);
+    bool onHeaders(std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size);
+    bool onSettings(std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size);
+    bool onWindowUpdate(std::uint32_t stream, const char* payload, std::size_t size);
+    /// Dekoduje kompletny blok nagłówków i otwiera strumień lub kończy go nagłówkami końcowymi.
+    bool headers(std::uint32_t stream, bool end);
+    /// Tworzy zapytanie z pseudo-nagłówków i nagłówków bloku.
+    /**
+    * @return false dla niepoprawnego zapytania (błąd strumienia PROTOCOL_ERROR).
+    */
+    bool request(HeaderContainer headers, Request& request) const;
+    /// Odrzuca zapytanie strumienia odpowiedzią o podanym statusie.
+    void reject(std::uint32_t stream, ResponseStatus status);
+    /// Wysyła ciało strumienia w granicach okien kontroli przepływu.
+    void transmit(std::uint32_t stream);
+    /// Wysyła ciała wszystkich strumieni, np. po powiększeniu okna połączenia.
+    void transmit();
+    /// Zamyka strumień po wysłaniu END_STREAM - przed końcem zapytania przerywając jego odbiór.
+    void complete(std::map<std::uint32_t, Stream>::iterator stream);
+    /// Usuwa strumień, zwalniając jego kolejkę.
+    void close(std::map<std::uint32_t, Stream>::iterator stream);
+    /// Przerywa strumień ramką RST_STREAM.
+    void abort(std::uint32_t stream, Error error);
+    /// Kończy sesję błędem połączenia.
+    /**
+    * @return zawsze false.
+    */
+    bool fail(Error error);
+    /// Zapisuje ramkę do bufora wyjściowego.
+    void write(std::uint8_t type, std::uint8_t flags, std::uint32_t stream, const char* payload, std::size_t size);
+    /// Zapisuje blok nagłówków w ramkach HEADERS i CONTINUATION.
+    void writeHeaders(std::uint32_t stream, const std::string& block, bool end);
+    /// Przekazuje zapisane ramki funkcji writer.
+    void flush();
+
+    Writer writer;
+    Dispatcher dispatcher;
+    BodyLimits bodyLimits;
+    RequestLimits limits;
+    std::uint32_t maxStreams;
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+
+    std::map<std::uint32_t, Stream> streams;
+    std::string input; //< Niekompletna ramka z poprzedniego odczytu.
+    std::size_t preface; //< Liczba odczytanych znaków wstępu połączenia.
+    bool configured; //< Odebrano pierwszą ramkę SETTINGS klienta.
+    std::uint32_t lastStream; //< Największy identyfikator strumienia otwartego przez klienta.
+    std::uint32_t headerStream; //< Strumień bloku nagłówków oczekującego na CONTINUATION lub 0.
+    bool headerEnd; //< Blok nagłówków kończy zapytanie (END_STREAM).
+    std::string headerBlock;
+    std::int64_t sendWindow; //< Okno kontroli przepływu połączenia klienta.
+    std::int64_t receiveWindow; //< Okno połączenia ogłoszone klientowi.
+    std::int64_t initialWindow; //< SETTINGS_INITIAL_WINDOW_SIZE klienta.
+    std::size_t maxFrame; //< SETTINGS_MAX_FRAME_SIZE klienta.
+    bool closing; //< Wysłano GOAWAY - nowe strumienie są pomijane.
+    bool failed; //< Wystąpił błąd połączenia.
+    bool peerClosing; //< Klient wysłał GOAWAY.
+
+    std::string output; //< Ramki oczekujące na przekazanie do writer.
+    std::size_t released; //< Bajty data() usunięte z kolejek od ostatniego wywołania writer.
+};
+
 } // namespace Http
 
 #endif // PATR_SERVER_UTILITIES_H
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <cassert>
 #include <errno.h>
 #include <sstream>
+#include <array>
 
 #include "Predef.h"
 
@@ -14,11 +15,19 @@
 #    include <mutex>
 #elif defined(PATR_OS_UNIX)
 #    include <unistd.h>
+#    include <fcntl.h>
 #    include <sys/types.h>
 #    include <sys/socket.h>
 #    include <netdb.h>
 #    include <arpa/inet.h>
 #    include <netinet/in.h>
+#    include <netinet/tcp.h>
+#    include <sys/uio.h>
+#    include <poll.h>
+#    include <climits>
+#    if defined(PATR_OS_LINUX)
+#        include <sys/eventfd.h>
+#    endif // defined(PATR_OS_LINUX)
 #else
 #    error "Unrecognised OS"
 #endif
@@ -29,6 +38,46 @@
 #include <openssl/conf.h>
 
 namespace {
+#if defined(PATR_OS_UNIX)
+#    if defined(IOV_MAX)
+    constexpr std::size_t MaxBuffers = IOV_MAX;
+#    else
+    constexpr std::size_t MaxBuffers = 16; // minimalna wartość wymagana przez POSIX.
+#    endif
+
+    /// Wypełnia tablicę iovec niepustymi buforami sekwencji, zwraca ich liczbę.
+    template <typename Sequence>
+    std::size_t FillVectors(const Sequence& buffers, std::vector<iovec>& vectors)
+    {
+        vectors.clear();
+        for (const auto& buffer : buffers)
+        {
+            if (buffer.second <= 0)
+                continue;
+            if (vectors.size() == MaxBuffers)
+                break; // pozostałe bufory zostaną zapisane kolejnym wywołaniem.
+            vectors.push_back(iovec{ const_cast<char*>(buffer.first), static_cast<std::size_t>(buffer.second) });
+        }
+        return vectors.size();
+    }
+#elif defined(PATR_OS_WINDOWS)
+    /// Wypełnia tablicę WSABUF niepustymi buforami sekwencji, zwraca ich liczbę.
+    template <typename Sequence>
+    DWORD FillVectors(const Sequence& buffers, std::vector<WSABUF>& vectors)
+    {
+        vectors.clear();
+        for (const auto& buffer : buffers)
+        {
+            if (buffer.second > 0)
+                vectors.push_back(WSABUF{ static_cast<ULONG>(buffer.second), const_cast<char*>(buffer.first) });
+        }
+        return static_cast<DWORD>(vectors.size());
+    }
+#endif
+
+    /// Największy łączny rozmiar małych buforów scalanych przed zapisem TLS.
+    constexpr int CoalesceLimit = 16 * 1024;
+
     int GetLastSocketError()
     {
 #if defined(PATR_OS_WINDOWS)
@@ -37,6 +86,172 @@ namespace {
         return errno;
 #endif
     }
+
+    /// Tworzy parę połączonych uchwytów, z których pierwszy służy do odczytu.
+    /**
+     * Na Windows select obsługuje wyłącznie gniazda, stąd połączenie przez interfejs pętli zwrotnej.
+     * Na Linuksie oba uchwyty wskazują na jeden licznik eventfd - wybudzenie nie zajmuje bufora potoku,
+     * a jego opróżnienie wymaga jednego odczytu.
+     */
+    void MakeWakeupPair(Tcp::Service::HandleType handles[2])
+    {
+#if defined(PATR_OS_WINDOWS)
+        auto listener = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        auto address = sockaddr_in();
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int length = sizeof address;
+        if (listener == INVALID_SOCKET
+            || ::bind(listener, reinterpret_cast<sockaddr*>(&address), length) == SOCKET_ERROR
+            || ::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == SOCKET_ERROR
+            || ::listen(listener, 1) == SOCKET_ERROR)
+        {
+            ::closesocket(listener);
+            throw Tcp::PlatformError("failed to create wakeup socket (" + std::to_string(GetLastSocketError()) + ')');
+        }
+        auto writer = ::socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+        if (writer == INVALID_SOCKET || ::connect(writer, reinterpret_cast<sockaddr*>(&address), length) == SOCKET_ERROR)
+        {
+            ::closesocket(listener);
+            throw Tcp::PlatformError("failed to connect wakeup socket (" + std::to_string(GetLastSocketError()) + ')');
+        }
+        auto reader = ::accept(listener, nullptr, nullptr);
+        ::closesocket(listener);
+        u_long nonBlocking = 1;
+        ::ioctlsocket(reader, FIONBIO, &nonBlocking);
+        ::ioctlsocket(writer, FIONBIO, &nonBlocking);
+        handles[0] = static_cast<Tcp::Service::HandleType>(reader);
+        handles[1] = static_cast<Tcp::Service::HandleType>(writer);
+#elif defined(PATR_OS_LINUX)
+        handles[0] = handles[1] = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (handles[0] == -1)
+            throw Tcp::PlatformError("eventfd failed (" + std::to_string(errno) + ')');
+#elif defined(PATR_OS_UNIX)
+        if (::pipe(handles) == -1)
+            throw Tcp::PlatformError("pipe failed (" + std::to_string(errno) + ')');
+        for (int i = 0; i < 2; ++i)
+        {
+            ::fcntl(handles[i], F_SETFL, ::fcntl(handles[i], F_GETFL) | O_NONBLOCK);
+            ::fcntl(handles[i], F_SETFD, FD_CLOEXEC);
+        }
+#endif
+    }
+
+    void CloseHandle(Tcp::Service::HandleType handle)
+    {
+#if defined(PATR_OS_WINDOWS)
+        ::closesocket(handle);
+#elif defined(PATR_OS_UNIX)
+        ::close(handle);
+#endif
+    }
+
+    /// Przełącza gniazdo w tryb nieblokujący.
+    void SetNonBlocking(Tcp::Service::HandleType handle)
+    {
+#if defined(PATR_OS_WINDOWS)
+        u_long nonBlocking = 1;
+        ::ioctlsocket(handle, FIONBIO, &nonBlocking);
+#elif defined(PATR_OS_UNIX)
+        ::fcntl(handle, F_SETFL, ::fcntl(handle, F_GETFL) | O_NONBLOCK);
+#endif
+    }
+
+    /// Zwraca, czy operacja na gnieździe nieblokującym zakończyła się z braku gotowości.
+    bool WouldBlockError(int error)
+    {
+#if defined(PATR_OS_WINDOWS)
+        return error == WSAEWOULDBLOCK;
+#elif defined(PATR_OS_UNIX)
+        return error == EAGAIN || error == EWOULDBLOCK;
+#endif
+    }
+
+    /// Czeka na gotowość gniazda do odczytu lub zapisu.
+    /**
+     * Pozwala zachować blokującą semantykę synchronicznych operacji na gniazdach nieblokujących.
+     */
+    void WaitReady(Tcp::Service::HandleType handle, bool write)
+    {
+#if defined(PATR_OS_WINDOWS)
+        WSAPOLLFD descriptor = { static_cast<SOCKET>(handle), static_cast<SHORT>(write ? POLLWRNORM : POLLRDNORM), 0 };
+        ::WSAPoll(&descriptor, 1, -1);
+#elif defined(PATR_OS_UNIX)
+        pollfd descriptor = { handle, static_cast<short>(write ? POLLOUT : POLLIN), 0 };
+        while (::poll(&descriptor, 1, -1) == -1 && errno == EINTR)
+            ;
+#endif
+    }
+
+    /// Zwraca, czy nieblokujące connect() nawiązuje połączenie w tle.
+    bool ConnectPending(int error)
+    {
+#if defined(PATR_OS_WINDOWS)
+        return error == WSAEWOULDBLOCK;
+#elif defined(PATR_OS_UNIX)
+        return error == EINPROGRESS;
+#endif
+    }
+
+    /// Rozpoczyna nieblokujące połączenie z pierwszym adresem, który nie odrzucił go od razu.
+    /**
+     * @throw Tcp::EndpointError, jeżeli żadne połączenie nie zostało rozpoczęte.
+     */
+    Tcp::Service::HandleType ConnectNonBlocking(addrinfo* addresses)
+    {
+        for (auto s = addresses; s != nullptr; s = s->ai_next)
+        {
+            auto fd = ::socket(s->ai_family, s->ai_socktype, s->ai_protocol);
+            if (fd == -1)
+                continue;
+
+            SetNonBlocking(static_cast<Tcp::Service::HandleType>(fd));
+            if (::connect(fd, s->ai_addr, (int)s->ai_addrlen) == 0 || ConnectPending(GetLastSocketError()))
+                return static_cast<Tcp::Service::HandleType>(fd);
+            CloseHandle(static_cast<Tcp::Service::HandleType>(fd));
+        }
+
+        throw Tcp::EndpointError("failed to connnect to endpoint");
+    }
+
+    /// Zwraca, czy nieudane accept() można ponowić przy kolejnym wybudzeniu.
+    /**
+     * Dotyczy gniazd współdzielonych z innym procesem oraz połączeń zerwanych przed przyjęciem.
+     */
+    bool AcceptRetryable(int error)
+    {
+#if defined(PATR_OS_WINDOWS)
+        return error == WSAEWOULDBLOCK || error == WSAECONNRESET || error == WSAEINTR;
+#elif defined(PATR_OS_UNIX)
+        return error == EAGAIN || error == EWOULDBLOCK || error == ECONNABORTED || error == EINTR;
+#endif
+    }
+
+    /// Identyfikator kontekstu sesji serwera, wymagany do wznawiania sesji z pamięci serwera.
+    const unsigned char SessionContext[] = "patr-httpserver";
+
+    /// Największa liczba serwerów, których sesje pamięta kontekst klienta.
+    constexpr std::size_t MaxClientSessions = 1024;
+
+    /// Zwalnia klucz pamięci sesji przypisany do połączenia klienta.
+    void FreeSessionKey(void*, void* key, CRYPTO_EX_DATA*, int, long, void*)
+    {
+        delete static_cast<std::string*>(key);
+    }
+
+    /// Zwraca indeks danych połączenia przechowujących klucz pamięci sesji (host:port).
+    int SessionKeyIndex()
+    {
+        static const int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, FreeSessionKey);
+        return index;
+    }
+
+    /// Zwraca, czy host jest adresem IP - SNI przyjmuje wyłącznie nazwy.
+    bool IsAddressLiteral(const std::string& host)
+    {
+        unsigned char address[16];
+        return ::inet_pton(AF_INET, host.c_str(), address) == 1 || ::inet_pton(AF_INET6, host.c_str(), address) == 1;
+    }
 }
 
 struct Tcp::StreamService::StreamServicePimpl
@@ -46,6 +261,9 @@ struct Tcp::StreamService::StreamServicePimpl
 
     fd_set readFdsMaster;
     fd_set readFds;
+    fd_set writeFds;
+    /// Gotowe gniazda bieżącego wybudzenia wraz z ich uchwytami, wielokrotnie wykorzystywany bufor.
+    std::vector<std::pair<SocketService*, Service::HandleType>> ready;
 };
 
 Tcp::StreamService::StreamServicePimpl::StreamServicePimpl() : readFdsMaster()
@@ -89,34 +307,48 @@ int Tcp::StreamService::run()
         FD_SET(service->getHandle(), &readFdsMaster);
     }
 
-    while (!signal || !signal->received())
+    for (auto& service : sockets)
     {
-        auto start = std::chrono::high_resolution_clock::now();
-        int timeSinceLastUpdate = 0;
+        FD_SET(service->getHandle(), &readFdsMaster);
+    }
 
+    FD_SET(wakeupHandle(), &readFdsMaster);
+
+    while (!stopped())
+    {
         fd_set& readFds = pimpl->readFds;
+        fd_set& writeFds = pimpl->writeFds;
 
-        auto result = select(start, timeSinceLastUpdate);
+        auto result = select();
         if (result < 0)
-            break;
+            continue; // przerwane przez sygnał - stopped() zdecyduje o zakończeniu.
 
 
-        if (signal->received())
+        if (stopped())
             break;
 
-        for (auto socket = sockets.begin(); socket != sockets.end();)
+        // Handlery mogą zamknąć dowolne gniazdo (shutdown() usuwa je z kolekcji), dlatego gotowe gniazda
+        // kopiowane są przed wywołaniami, a przed każdym z nich sprawdzane, czy nadal są zarejestrowane.
+        auto& ready = pimpl->ready;
+        ready.clear();
+        for (auto socket : sockets)
         {
-            auto next = socket;
-            ++next;
-            if (FD_ISSET((*socket)->getHandle(), &readFds))
-            {
-                const_cast<SocketService*>(*socket)->readReady();
-            }
-            else
-            {
-                const_cast<SocketService*>(*socket)->updateRemainingTime(timeSinceLastUpdate);
-            }
-            socket = next;
+            auto handle = socket->getHandle();
+            if (result > 0 && (FD_ISSET(handle, &writeFds) || FD_ISSET(handle, &readFds)))
+                ready.emplace_back(socket, handle);
+        }
+
+        auto registered = [this](const std::pair<SocketService*, Service::HandleType>& socket)
+        {
+            auto found = sockets.find(socket.first);
+            return found != sockets.end() && (*found)->getHandle() == socket.second;
+        };
+        for (auto& socket : ready)
+        {
+            if (FD_ISSET(socket.second, &writeFds) && registered(socket))
+                socket.first->writeReady();
+            if (FD_ISSET(socket.second, &readFds) && registered(socket))
+                socket.first->readReady();
         }
 
         for (auto& acceptor : acceptors)
@@ -126,14 +358,20 @@ int Tcp::StreamService::run()
                 const_cast<AcceptorService*>(acceptor)->acceptReady();
             }
         }
+
+        if (FD_ISSET(wakeupHandle(), &readFds))
+            runPosted();
+
+        timers.expire(TimerWheel::Clock::now());
     }
 
-    for (auto& socket : sockets)
+    // shutdown() usuwa gniazdo z kolekcji, a handlery mogą zwolnić także inne gniazda - kopia mogłaby je wskazywać.
+    while (!sockets.empty())
     {
-        const_cast<SocketService*>(socket)->shutdown();
+        const_cast<SocketService*>(*sockets.begin())->shutdown();
     }
 
-    return signal->get();
+    return signal ? signal->get() : 0;
 }
 
 void Tcp::StreamService::add(SocketService* service)
@@ -148,61 +386,65 @@ void Tcp::StreamService::remove(SocketService * service)
     FD_CLR(service->getHandle(), &pimpl->readFdsMaster);
 }
 
+void Tcp::StreamService::remove(AcceptorService* service)
+{
+    StreamServiceInterface::remove(service);
+    FD_CLR(service->getHandle(), &pimpl->readFdsMaster);
+}
+
 std::unique_ptr<Tcp::ServiceFactory> Tcp::StreamService::getFactory()
 {
     return std::unique_ptr<ServiceFactory>(new StreamServiceFactory(*this));
 }
 
-int Tcp::StreamService::select(const std::chrono::high_resolution_clock::time_point& start, int& timeSinceLastUpdate)
+int Tcp::StreamService::select()
 {
-    for (;;)
-    {
-        auto& readFds = pimpl->readFds;
-        readFds = pimpl->readFdsMaster;
-        int result = (*acceptors.rbegin())->getHandle();
-
-        if (!sockets.empty())
-            result = (std::max)((*sockets.rbegin())->getHandle(), result);
-
-        auto comp = [](const SocketService* left, const SocketService* right) { return left->remainingTime() < right->remainingTime(); };
-
-        std::set<SocketService*, decltype(comp)> timevals(comp);
-        timevals.insert(sockets.begin(), sockets.end());
+    auto& readFds = pimpl->readFds;
+    auto& writeFds = pimpl->writeFds;
+    readFds = pimpl->readFdsMaster;
+    FD_ZERO(&writeFds);
+    int result = wakeupHandle();
 
-        while (!timevals.empty() && (*timevals.begin())->remainingTime() <= 0)
-            timevals.erase(timevals.begin());
-
-        auto remainingTime = timevals.empty() ? 0 : (*timevals.begin())->remainingTime() - timeSinceLastUpdate;
-        auto timeout = timeval();
-        timeout.tv_sec = remainingTime / 1000;
-        timeout.tv_usec = (remainingTime * 1000) % 1000000;
-
-        int retval = 0;
+    if (!acceptors.empty())
+        result = (std::max)((*acceptors.rbegin())->getHandle(), result);
+    std::vector<Service::HandleType> buffered; // dane odebrane przez implementację nie oznaczą deskryptora jako gotowego.
+    for (auto& socket : sockets)
+    {
+        result = (std::max)(socket->getHandle(), result);
+        if (socket->pendingWrite())
+            FD_SET(socket->getHandle(), &writeFds);
+        if (socket->pendingRead() && socket->buffered())
+            buffered.push_back(socket->getHandle());
+    }
 
-        if (remainingTime > 0)
-            retval = ::select(result + 1, &readFds, nullptr, nullptr, &timeout);
-        else
-            retval = ::select(result + 1, &readFds, nullptr, nullptr, nullptr); // w przypadku braku oczekujących gniazd, blokuj bez przerwy.
+    auto remainingTime = buffered.empty() ? timers.timeout(TimerWheel::Clock::now()) : 0;
+    auto timeout = timeval();
+    timeout.tv_sec = remainingTime / 1000;
+    timeout.tv_usec = (remainingTime * 1000) % 1000000;
 
-        if (retval < 0)
-        {
-            if (signal->received())
-                return retval;
-            throw ServiceError("select failed");
-        }
+    int retval = 0;
 
-        auto stop = std::chrono::high_resolution_clock::now();
-        timeSinceLastUpdate += (int)std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+    if (remainingTime >= 0)
+        retval = ::select(result + 1, &readFds, &writeFds, nullptr, &timeout);
+    else
+        retval = ::select(result + 1, &readFds, &writeFds, nullptr, nullptr); // w przypadku braku oczekujących zdarzeń, blokuj bez przerwy.
 
-        if (retval != 0)
-            return retval; // nie został przekroczony czas oczekiwania.
+    if (retval < 0)
+    {
+        if (signal && signal->received())
+            return retval;
+        throw ServiceError("select failed");
+    }
 
-        while (!timevals.empty() && (*timevals.begin())->remainingTime() <= timeSinceLastUpdate)
+    for (auto handle : buffered)
+    {
+        if (!FD_ISSET(handle, &readFds))
         {
-            (*timevals.begin())->updateRemainingTime(timeSinceLastUpdate); // gniazdo przekroczyło swój czas oczekiwania.
-            timevals.erase(timevals.begin());
+            FD_SET(handle, &readFds);
+            ++retval;
         }
     }
+    return retval;
 }
 
 Tcp::Service::HandleType Tcp::Service::getHandle() const
@@ -253,7 +495,8 @@ int Tcp::SocketImplementation::read(BufferType & buffer)
     while (total < buffer.second) {
         Buffer b(buffer.first + total, bytesleft);
         n = readSome(b);
-        if (n == -1) { break; }
+        if (n == SocketService::WouldBlock) { WaitReady(handle(), false); continue; }
+        if (n <= 0) { break; }
         total += n;
         bytesleft -= n;
     }
@@ -276,8 +519,10 @@ int Tcp::SocketImplementation::readSome(BufferType & buffer)
         if (val != WSAETIMEDOUT && val != WSAEINPROGRESS && val != WSAEWOULDBLOCK)
             throw ReceiveError("recv failed");
 #endif
+        if (WouldBlockError(val))
+            return SocketService::WouldBlock;
     }
-    return result;
+    return static_cast<int>(result);
 }
 
 int Tcp::SocketImplementation::write(const ConstBufferType & buffer)
@@ -298,12 +543,143 @@ int Tcp::SocketImplementation::write(const ConstBufferType & buffer)
 
 int Tcp::SocketImplementation::writeSome(const ConstBufferType & buffer)
 {
-    auto result = ::send(handle(), buffer.first, buffer.second, 0);
+    int flags = 0;
+#if defined(MSG_NOSIGNAL)
+    flags |= MSG_NOSIGNAL; // zapis do połączenia zamkniętego przez drugą stronę (np. z puli klienta) zgłasza SendError.
+#endif
+    auto result = ::send(handle(), buffer.first, buffer.second, flags);
+    while (result == -1 && WouldBlockError(GetLastSocketError()))
+    {
+        WaitReady(handle(), true);
+        result = ::send(handle(), buffer.first, buffer.second, flags);
+    }
     if (result == -1)
     {
         throw SendError("send failed");
     }
-    return result;
+    return static_cast<int>(result);
+}
+
+int Tcp::SocketImplementation::tryWriteSome(const ConstBufferType & buffer)
+{
+#if defined(PATR_OS_UNIX)
+    int flags = MSG_DONTWAIT;
+#    if defined(MSG_NOSIGNAL)
+    flags |= MSG_NOSIGNAL; // zamknięte połączenie zgłaszane jest błędem zamiast SIGPIPE.
+#    endif
+    auto result = ::send(handle(), buffer.first, buffer.second, flags);
+    if (result == -1)
+    {
+        auto val = errno;
+        if (val == EWOULDBLOCK || val == EAGAIN || val == EINTR)
+            return 0;
+        throw SendError("send failed (" + std::to_string(val) + ')');
+    }
+    return static_cast<int>(result);
+#elif defined(PATR_OS_WINDOWS)
+    return writeSome(buffer);
+#endif
+}
+
+int Tcp::SocketImplementation::readSome(const BufferSequenceType& buffers)
+{
+#if defined(PATR_OS_UNIX)
+    std::vector<iovec> vectors;
+    if (!FillVectors(buffers, vectors))
+        return 0;
+    auto message = msghdr();
+    message.msg_iov = vectors.data();
+    message.msg_iovlen = vectors.size();
+    auto result = ::recvmsg(handle(), &message, 0);
+    if (result == -1)
+    {
+        auto val = errno;
+        if (val != EWOULDBLOCK && val != ECONNREFUSED && val != EAGAIN)
+            throw ReceiveError("recvmsg failed");
+        if (WouldBlockError(val))
+            return SocketService::WouldBlock;
+    }
+    return static_cast<int>(result);
+#elif defined(PATR_OS_WINDOWS)
+    std::vector<WSABUF> vectors;
+    auto count = FillVectors(buffers, vectors);
+    if (!count)
+        return 0;
+    DWORD received = 0, flags = 0;
+    if (::WSARecv(handle(), vectors.data(), count, &received, &flags, nullptr, nullptr) == SOCKET_ERROR)
+    {
+        auto val = WSAGetLastError();
+        if (val != WSAETIMEDOUT && val != WSAEINPROGRESS && val != WSAEWOULDBLOCK)
+            throw ReceiveError("WSARecv failed");
+        return WouldBlockError(val) ? SocketService::WouldBlock : -1;
+    }
+    return static_cast<int>(received);
+#endif
+}
+
+int Tcp::SocketImplementation::writeSome(const ConstBufferSequenceType& buffers)
+{
+#if defined(PATR_OS_UNIX)
+    std::vector<iovec> vectors;
+    if (!FillVectors(buffers, vectors))
+        return 0;
+    auto message = msghdr();
+    message.msg_iov = vectors.data();
+    message.msg_iovlen = vectors.size();
+    int flags = 0;
+#    if defined(MSG_NOSIGNAL)
+    flags |= MSG_NOSIGNAL;
+#    endif
+    auto result = ::sendmsg(handle(), &message, flags);
+    while (result == -1 && WouldBlockError(errno))
+    {
+        WaitReady(handle(), true);
+        result = ::sendmsg(handle(), &message, flags);
+    }
+    if (result == -1)
+        throw SendError("sendmsg failed");
+    return static_cast<int>(result);
+#elif defined(PATR_OS_WINDOWS)
+    std::vector<WSABUF> vectors;
+    auto count = FillVectors(buffers, vectors);
+    if (!count)
+        return 0;
+    DWORD sent = 0;
+    while (::WSASend(handle(), vectors.data(), count, &sent, 0, nullptr, nullptr) == SOCKET_ERROR)
+    {
+        if (!WouldBlockError(WSAGetLastError()))
+            throw SendError("WSASend failed");
+        WaitReady(handle(), true);
+    }
+    return static_cast<int>(sent);
+#endif
+}
+
+int Tcp::SocketImplementation::tryWriteSome(const ConstBufferSequenceType& buffers)
+{
+#if defined(PATR_OS_UNIX)
+    std::vector<iovec> vectors;
+    if (!FillVectors(buffers, vectors))
+        return 0;
+    auto message = msghdr();
+    message.msg_iov = vectors.data();
+    message.msg_iovlen = vectors.size();
+    int flags = MSG_DONTWAIT;
+#    if defined(MSG_NOSIGNAL)
+    flags |= MSG_NOSIGNAL;
+#    endif
+    auto result = ::sendmsg(handle(), &message, flags);
+    if (result == -1)
+    {
+        auto val = errno;
+        if (val == EWOULDBLOCK || val == EAGAIN || val == EINTR)
+            return 0;
+        throw SendError("sendmsg failed (" + std::to_string(val) + ')');
+    }
+    return static_cast<int>(result);
+#elif defined(PATR_OS_WINDOWS)
+    return writeSome(buffers);
+#endif
 }
 
 void Tcp::SocketImplementation::close()
@@ -314,22 +690,64 @@ void Tcp::SocketImplementation::close()
 #elif defined(PATR_OS_UNIX)
         ::close(handle());
 #endif
+    closed = true; // destruktor nie może zamknąć uchwytu ponownie - mógł zostać przydzielony innemu gniazdu.
 }
 
-Tcp::SocketService::SocketService(StreamServiceInterface& service, SocketInterface& implementation, HandleType handle) : shut(0), implementation(implementation), service(service)
+constexpr int Tcp::SocketService::DefaultTimeout;
+constexpr int Tcp::SocketService::WouldBlock;
+
+Tcp::SocketService::SocketService(StreamServiceInterface& service, SocketInterface& implementation, HandleType handle) :
+    shut(0),
+    handshaking(false),
+    timeout(DefaultTimeout),
+    timer(0),
+    lastActivity(TimerWheel::Clock::now()),
+    implementation(implementation),
+    service(service),
+    destroyed(nullptr)
 {
     this->handle = handle;
-    currentTime = 0;
-    timeout = 30000; // 30 sekund
+    arm(lastActivity + std::chrono::milliseconds(timeout));
+}
+
+Tcp::SocketService::~SocketService()
+{
+    if (timer)
+        service.cancel(timer);
+    if (destroyed)
+        *destroyed = true;
 }
 
 int Tcp::SocketService::readReady()
 {
-    currentTime = 0;
+    lastActivity = TimerWheel::Clock::now();
     if (readHandlers.empty()) return 0;
     int s = 0;
     if (!shut)
-        s = implementation.readSome(readHandlers.front().first);
+    {
+        auto handshake = implementation.handshake();
+        handshaking = handshake == SocketInterface::Handshake::Pending;
+        if (handshaking)
+            return WouldBlock; // bufor nie jest pobierany przed nawiązaniem połączenia.
+        if (handshake == SocketInterface::Handshake::Failed)
+        {
+            s = -1;
+        }
+        else
+        {
+            auto buffer = readHandlers.front().first();
+            try
+            {
+                s = implementation.readSome(buffer);
+            }
+            catch (const ReceiveError&)
+            {
+                s = -1; // np. połączenie zerwane przez drugą stronę - błąd otrzymuje handler, a nie serwis.
+            }
+            if (s == WouldBlock)
+                return s;
+        }
+    }
     if (s <= 0)
         shut += 1 - s;
     auto copy = readHandlers.front().second;
@@ -343,48 +761,138 @@ int Tcp::SocketService::writeReady()
 {
     if (writeHandlers.empty()) return 0;
 
-    int s = implementation.writeSome(writeHandlers.front().first);
-    writeHandlers.front().second(shut, s);
-
-    if (shut)
+    int s = 0;
+    int ec = shut;
+    if (!shut)
     {
-        writeHandlers.front().second(shut, -1);
-        return 0;
+        try
+        {
+            auto handshake = implementation.handshake();
+            handshaking = handshake == SocketInterface::Handshake::Pending;
+            if (handshaking)
+                return 0;
+            if (handshake == SocketInterface::Handshake::Failed)
+                throw SendError("handshake failed");
+            s = implementation.tryWriteSome(writeHandlers.front().first);
+            if (s == 0 && BufferSize(writeHandlers.front().first) > 0)
+                return 0; // zapis zablokowałby wywołanie - poczekaj na kolejną gotowość.
+            if (s > 0)
+                lastActivity = TimerWheel::Clock::now(); // klient odbierający odpowiedź nie jest bezczynny.
+        }
+        catch (const SendError&)
+        {
+            ec = 2;
+            s = -1;
+        }
     }
+    auto copy = writeHandlers.front().second;
     writeHandlers.pop();
+    copy(ec, s);
 
     return s;
 }
 
 void Tcp::SocketService::enqueue(BufferType& buffer, ReadHandler handler)
 {
-    readHandlers.push(std::make_pair(buffer, std::move(handler)));
+    enqueue([buffer] { return buffer; }, std::move(handler));
+}
+
+void Tcp::SocketService::enqueue(BufferSource source, ReadHandler handler)
+{
+    readHandlers.push(std::make_pair(std::move(source), std::move(handler)));
+    service.update(this);
 }
 
 void Tcp::SocketService::enqueue(const ConstBufferType& buffer, WriteHandler handler)
 {
-    writeHandlers.push(std::make_pair(buffer, std::move(handler)));
+    enqueue(ConstBufferSequenceType(1, buffer), std::move(handler));
+}
+
+void Tcp::SocketService::enqueue(ConstBufferSequenceType buffers, WriteHandler handler)
+{
+    if (writeHandlers.empty())
+        lastActivity = TimerWheel::Clock::now(); // oczekiwanie na gotowość liczone jest od zlecenia zapisu.
+    writeHandlers.push(std::make_pair(std::move(buffers), std::move(handler)));
+    service.update(this);
+}
+
+bool Tcp::SocketService::pendingRead() const
+{
+    return !readHandlers.empty();
+}
+
+bool Tcp::SocketService::pendingWrite() const
+{
+    return !writeHandlers.empty() && !(handshaking && !readHandlers.empty());
+}
+
+bool Tcp::SocketService::buffered() const
+{
+    return !shut && implementation.buffered();
+}
+
+int Tcp::SocketService::getTimeout() const
+{
+    return timeout;
+}
+
+void Tcp::SocketService::setTimeout(int milliseconds)
+{
+    timeout = milliseconds;
+    if (timer)
+        service.cancel(timer);
+    timer = 0;
+    if (!shut)
+        arm(lastActivity + std::chrono::milliseconds(timeout));
 }
 
-int Tcp::SocketService::remainingTime() const
+void Tcp::SocketService::arm(TimerWheel::TimePoint deadline)
 {
-    return timeout - currentTime;
+    if (timeout > 0)
+        timer = service.asyncWait(deadline, [this] { expired(); });
 }
 
-void Tcp::SocketService::updateRemainingTime(int milliseconds)
+void Tcp::SocketService::expired()
 {
-    currentTime += milliseconds;
-    if (currentTime >= timeout)
+    timer = 0;
+    auto deadline = lastActivity + std::chrono::milliseconds(timeout);
+    if (deadline > TimerWheel::Clock::now())
     {
-        shutdown();
-        readReady();
+        arm(deadline); // gniazdo było aktywne od zarejestrowania zdarzenia.
+        return;
     }
+
+    shutdown(); // gniazdo przekroczyło swój czas oczekiwania - handlery otrzymują błąd i mogą je zwolnić.
+}
+
+Tcp::StreamServiceInterface& Tcp::SocketService::getService() const
+{
+    return service;
 }
 
 void Tcp::SocketService::shutdown()
 {
+    if (timer)
+        service.cancel(timer);
+    timer = 0;
     shut = 1;
     service.remove(this);
+
+    // Oczekujące handlery otrzymują błąd i zwalniają przechwycone zasoby - także ostatnią referencję do gniazda.
+    bool released = false;
+    auto outer = destroyed; // handler może ponownie wywołać shutdown(), np. zamykając gniazdo.
+    destroyed = &released;
+    while (!released && !readHandlers.empty())
+        readReady();
+    while (!released && !writeHandlers.empty())
+        writeReady();
+    if (released)
+    {
+        if (outer)
+            *outer = true;
+        return;
+    }
+    destroyed = outer;
 }
 
 Tcp::Socket::Socket(std::unique_ptr<SocketInterface> implementation) : implementation(std::move(implementation))
@@ -402,11 +910,21 @@ int Tcp::Socket::readSome(BufferType & buffer)
     return implementation->readSome(buffer);
 }
 
+int Tcp::Socket::readSome(const BufferSequenceType& buffers)
+{
+    return implementation->readSome(buffers);
+}
+
 void Tcp::Socket::asyncReadSome(BufferType buffer, ReadHandler handler)
 {
     implementation->asyncReadSome(buffer, std::move(handler));
 }
 
+void Tcp::Socket::asyncReadSome(BufferSource source, ReadHandler handler)
+{
+    implementation->asyncReadSome(std::move(source), std::move(handler));
+}
+
 int Tcp::Socket::write(const ConstBufferType & buffer)
 {
     return implementation->write(buffer);
@@ -417,11 +935,21 @@ int Tcp::Socket::writeSome(const ConstBufferType & buffer)
     return implementation->writeSome(buffer);
 }
 
+int Tcp::Socket::writeSome(const ConstBufferSequenceType& buffers)
+{
+    return implementation->writeSome(buffers);
+}
+
 void Tcp::Socket::asyncWriteSome(const ConstBufferType & buffer, WriteHandler handler)
 {
     implementation->asyncWriteSome(buffer, std::move(handler));
 }
 
+void Tcp::Socket::asyncWriteSome(const ConstBufferSequenceType& buffers, WriteHandler handler)
+{
+    implementation->asyncWriteSome(buffers, std::move(handler));
+}
+
 void Tcp::Socket::close()
 {
     shutdown();
@@ -433,10 +961,35 @@ void Tcp::Socket::shutdown()
     implementation->shutdown();
 }
 
+void Tcp::Socket::setTimeout(int milliseconds)
+{
+    implementation->setTimeout(milliseconds);
+}
+
+Tcp::StreamServiceInterface& Tcp::Socket::getService() const
+{
+    return implementation->getService();
+}
+
+void Tcp::Socket::setOption(const Option::Option& option)
+{
+    implementation->setOption(option);
+}
+
+bool Tcp::Socket::idle() const
+{
+    return implementation->idle();
+}
+
 Tcp::AcceptorImplementation::AcceptorImplementation(StreamServiceInterface& service) : AcceptorInterface(service), streamService(service)
 {
 }
 
+Tcp::AcceptorImplementation::~AcceptorImplementation()
+{
+    close();
+}
+
 void Tcp::AcceptorImplementation::open(Endpoint::ProtocolType protocol)
 {
     handle(static_cast<HandleType>(::socket(protocol->ai_family, protocol->ai_socktype, protocol->ai_protocol)));
@@ -444,7 +997,7 @@ void Tcp::AcceptorImplementation::open(Endpoint::ProtocolType protocol)
 
 void Tcp::AcceptorImplementation::setOption(const Option::Option& option)
 {
-    if (::setsockopt(handle(), SOL_SOCKET, option.option, reinterpret_cast<const char*>(&option.value), sizeof option.value) == -1)
+    if (::setsockopt(handle(), option.level, option.option, reinterpret_cast<const char*>(&option.value), sizeof option.value) == -1)
     {
         throw SocketOptionError("setsockopt failed");
     }
@@ -465,29 +1018,108 @@ void Tcp::AcceptorImplementation::listen(int backlog)
     {
         throw ListenError("listen failed (" + std::to_string(GetLastSocketError()) + ')');
     }
+    SetNonBlocking(handle()); // acceptReady() przyjmuje połączenia do wyczerpania kolejki.
+    attach(); // akceptor utworzony w trakcie działania serwisu nie miał jeszcze uchwytu.
 }
 
 Tcp::Socket Tcp::AcceptorImplementation::accept()
 {
-    auto result = ::accept(handle(), nullptr, nullptr);
-    if (result == -1)
-    {
-        throw AcceptError("accept failed (" + std::to_string(GetLastSocketError()) + ')');
-    }
-    return Socket(std::unique_ptr<SocketImplementation>(new SocketImplementation(streamService, static_cast<HandleType>(result))));
+    return makeSocket(acceptHandle(true));
 }
 
-Tcp::AcceptorService::AcceptorService(AcceptorInterface& implementation) : implementation(implementation)
+Tcp::Socket Tcp::AcceptorImplementation::acceptPending()
 {
+    return makeSocket(acceptHandle(false));
 }
 
+Tcp::Socket Tcp::AcceptorImplementation::makeSocket(HandleType handle)
+{
+    return Socket(std::unique_ptr<SocketImplementation>(new SocketImplementation(streamService, handle)));
+}
+
+Tcp::AcceptorImplementation::HandleType Tcp::AcceptorImplementation::acceptHandle(bool wait)
+{
+    for (;;)
+    {
+#if defined(PATR_OS_LINUX)
+        auto result = ::accept4(handle(), nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
+        auto result = ::accept(handle(), nullptr, nullptr);
+#endif // defined(PATR_OS_LINUX)
+        if (result != -1)
+        {
+#if !defined(PATR_OS_LINUX)
+            SetNonBlocking(static_cast<HandleType>(result));
+#    if defined(PATR_OS_UNIX)
+            ::fcntl(result, F_SETFD, FD_CLOEXEC);
+#    endif // defined(PATR_OS_UNIX)
+#endif // !defined(PATR_OS_LINUX)
+            return static_cast<HandleType>(result);
+        }
+
+        auto error = GetLastSocketError();
+        if (!AcceptRetryable(error))
+            throw AcceptError("accept failed (" + std::to_string(error) + ')');
+        if (!wait)
+            throw AcceptRetryError("accept would block (" + std::to_string(error) + ')');
+        if (WouldBlockError(error))
+            WaitReady(handle(), false);
+    }
+}
+
+void Tcp::AcceptorImplementation::assign(HandleType handle)
+{
+    close();
+    SetNonBlocking(handle);
+    this->handle(handle);
+    attach(); // serwis mógł zostać wyrejestrowany przez close().
+}
+
+void Tcp::AcceptorImplementation::close()
+{
+    if (handle() == -1)
+        return;
+    detach();
+    CloseHandle(handle());
+    handle(-1);
+}
+
+Tcp::SslAcceptorImplementation::SslAcceptorImplementation(StreamServiceInterface& service, SslContext& context) : AcceptorImplementation(service), context(context)
+{
+    if (!context.server())
+        throw SslError("acceptor requires a server context");
+}
+
+Tcp::Socket Tcp::SslAcceptorImplementation::makeSocket(HandleType handle)
+{
+    return Socket(std::unique_ptr<SocketImplementation>(new SslSocketImplementation(streamService, handle, context)));
+}
+
+Tcp::AcceptorService::AcceptorService(AcceptorInterface& implementation) : implementation(implementation)
+{
+}
+
+constexpr std::size_t Tcp::AcceptorService::AcceptBatch;
+
 void Tcp::AcceptorService::acceptReady()
 {
-    auto socket = implementation.accept();
-    if (!handlers.empty())
+    // handler może zamknąć akceptor - kolejne wywołanie accept() nie może użyć zamkniętego uchwytu.
+    for (std::size_t accepted = 0; accepted < AcceptBatch && getHandle() != -1; ++accepted)
     {
-        handlers.front()(std::move(socket));
-        handlers.pop();
+        try
+        {
+            auto socket = implementation.acceptPending();
+            if (!handlers.empty())
+            {
+                auto handler = std::move(handlers.front());
+                handlers.pop();
+                handler(std::move(socket)); // handler zwykle wstawia kolejny do kolejki.
+            }
+        }
+        catch (const AcceptRetryError&)
+        {
+            break; // kolejka wyczerpana lub połączenie przyjął inny proces - handler czeka na kolejne.
+        }
     }
 }
 
@@ -535,38 +1167,38 @@ void Tcp::Acceptor::asyncAccept(Handler handler)
     implementation->asyncAccept(std::move(handler));
 }
 
-Tcp::EndpointImplementation::EndpointImplementation(const std::string & address, const std::string & port)
+void Tcp::Acceptor::assign(AcceptorInterface::HandleType handle)
 {
-    auto hints = addrinfo();
-    hints.ai_family = AF_INET;
-    hints.ai_socktype = SOCK_STREAM;
-    auto result = getaddrinfo(address.c_str(), port.c_str(), &hints, &addressVal);
-    if (result != 0)
-    {
-        std::string errinfo = "getaddrinfo failed: ";
-        //errinfo += gai_strerror(result);
-        throw EndpointError(errinfo);
-    }
+    implementation->assign(handle);
 }
 
-Tcp::EndpointImplementation::~EndpointImplementation()
+void Tcp::Acceptor::close()
+{
+    implementation->close();
+}
+
+Tcp::AcceptorInterface::HandleType Tcp::Acceptor::getHandle() const
+{
+    return implementation->getHandle();
+}
+
+Tcp::EndpointImplementation::EndpointImplementation(const std::string & address, const std::string & port, Resolver& resolver) : addressVal(resolver.resolve(address, port))
 {
-    freeaddrinfo(addressVal);
 }
 
 Tcp::EndpointImplementation::AddressType Tcp::EndpointImplementation::address() const
 {
-    return addressVal;
+    return addressVal.get();
 }
 
 Tcp::EndpointImplementation::ProtocolType Tcp::EndpointImplementation::protocol() const
 {
-    return addressVal;
+    return addressVal.get();
 }
 
 Tcp::Socket Tcp::EndpointImplementation::connect(StreamServiceInterface & service) const
 {
-    for (auto s = address(); s != nullptr; s = address()->ai_next)
+    for (auto s = address(); s != nullptr; s = s->ai_next)
     {
         auto fd = ::socket(s->ai_family, s->ai_socktype, s->ai_protocol);
         if (fd == -1)
@@ -585,6 +1217,11 @@ Tcp::Socket Tcp::EndpointImplementation::connect(StreamServiceInterface & servic
     throw Tcp::EndpointError("failed to connnect to endpoint");
 }
 
+Tcp::Socket Tcp::EndpointImplementation::connectNonBlocking(StreamServiceInterface& service) const
+{
+    return Socket(std::unique_ptr<SocketInterface>(new SocketImplementation(service, ConnectNonBlocking(address()))));
+}
+
 Tcp::Endpoint::Endpoint(const std::string & address, const std::string & port) : implementation(new EndpointImplementation(address, port))
 {
 }
@@ -636,8 +1273,94 @@ int Tcp::SignalService::get() const
     return sigVal;
 }
 
-Tcp::Option::ReuseAddress::ReuseAddress(bool value) : Option{ SO_REUSEADDR, value }
+void Tcp::SignalService::clear()
+{
+    sigFlag = false;
+}
+
+Tcp::Option::ReuseAddress::ReuseAddress(bool value) : Option{ SO_REUSEADDR, value, SOL_SOCKET }
+{
+}
+
+#if defined(SO_REUSEPORT)
+Tcp::Option::ReusePort::ReusePort(bool value) : Option{ SO_REUSEPORT, value, SOL_SOCKET }
+{
+}
+#else
+Tcp::Option::ReusePort::ReusePort(bool) : Option{ 0, 0, SOL_SOCKET }
+{
+    throw SocketOptionError("SO_REUSEPORT not supported");
+}
+#endif // defined(SO_REUSEPORT)
+
+#if defined(TCP_CORK)
+Tcp::Option::Cork::Cork(bool value) : Option{ TCP_CORK, value, IPPROTO_TCP }
+{
+}
+#elif defined(TCP_NOPUSH)
+Tcp::Option::Cork::Cork(bool value) : Option{ TCP_NOPUSH, value, IPPROTO_TCP }
+{
+}
+#else
+Tcp::Option::Cork::Cork(bool) : Option{ 0, 0, IPPROTO_TCP }
+{
+    throw SocketOptionError("TCP_CORK not supported");
+}
+#endif // defined(TCP_CORK)
+
+Tcp::Option::NoDelay::NoDelay(bool value) : Option{ TCP_NODELAY, value, IPPROTO_TCP }
+{
+}
+
+#if defined(TCP_DEFER_ACCEPT)
+Tcp::Option::DeferAccept::DeferAccept(int seconds) : Option{ TCP_DEFER_ACCEPT, seconds, IPPROTO_TCP }
+{
+}
+#else
+Tcp::Option::DeferAccept::DeferAccept(int) : Option{ 0, 0, IPPROTO_TCP }
+{
+    throw SocketOptionError("TCP_DEFER_ACCEPT not supported");
+}
+#endif // defined(TCP_DEFER_ACCEPT)
+
+Tcp::Option::ReceiveBuffer::ReceiveBuffer(int bytes) : Option{ SO_RCVBUF, bytes, SOL_SOCKET }
+{
+}
+
+Tcp::Option::SendBuffer::SendBuffer(int bytes) : Option{ SO_SNDBUF, bytes, SOL_SOCKET }
+{
+}
+
+#if defined(TCP_FASTOPEN)
+Tcp::Option::FastOpen::FastOpen(int queue) : Option{ TCP_FASTOPEN, queue, IPPROTO_TCP }
+{
+}
+#else
+Tcp::Option::FastOpen::FastOpen(int) : Option{ 0, 0, IPPROTO_TCP }
 {
+    throw SocketOptionError("TCP_FASTOPEN not supported");
+}
+#endif // defined(TCP_FASTOPEN)
+
+void Tcp::Consume(ConstBufferSequence& buffers, std::size_t bytes)
+{
+    auto first = buffers.begin();
+    for (; first != buffers.end() && bytes >= static_cast<std::size_t>(first->second); ++first)
+        bytes -= first->second;
+    if (first != buffers.end())
+    {
+        first->first += bytes;
+        first->second -= static_cast<int>(bytes);
+    }
+    buffers.erase(buffers.begin(), first);
+}
+
+std::size_t Tcp::BufferSize(const ConstBufferSequence& buffers)
+{
+    std::size_t size = 0;
+    for (const auto& buffer : buffers)
+        size += buffer.second;
+    return size;
 }
 
 Tcp::SocketInterface::HandleType Tcp::SocketInterface::handle() const
@@ -655,18 +1378,124 @@ void Tcp::SocketInterface::asyncReadSome(BufferType buffer, ReadHandler handler)
     service.enqueue(buffer, std::move(handler));
 }
 
+void Tcp::SocketInterface::asyncReadSome(BufferSource source, ReadHandler handler)
+{
+    service.enqueue(std::move(source), std::move(handler));
+}
+
+int Tcp::SocketInterface::readSome(const BufferSequenceType& buffers)
+{
+    for (const auto& buffer : buffers)
+    {
+        if (buffer.second > 0)
+        {
+            auto copy = buffer;
+            return readSome(copy);
+        }
+    }
+    return 0;
+}
+
+int Tcp::SocketInterface::writeSome(const ConstBufferSequenceType& buffers)
+{
+    int total = 0;
+    for (const auto& buffer : buffers)
+    {
+        if (buffer.second <= 0)
+            continue;
+        auto n = writeSome(buffer);
+        if (n <= 0)
+            return total ? total : n;
+        total += n;
+        if (n < buffer.second)
+            break; // kolejne bufory zostałyby zapisane z pominięciem reszty bieżącego.
+    }
+    return total;
+}
+
+int Tcp::SocketInterface::tryWriteSome(const ConstBufferType & buffer)
+{
+    return writeSome(buffer);
+}
+
+int Tcp::SocketInterface::tryWriteSome(const ConstBufferSequenceType& buffers)
+{
+    for (const auto& buffer : buffers)
+    {
+        if (buffer.second > 0)
+            return tryWriteSome(buffer);
+    }
+    return 0;
+}
+
 void Tcp::SocketInterface::asyncWriteSome(const ConstBufferType & buffer, WriteHandler handler)
 {
     service.enqueue(buffer, std::move(handler));
 }
 
+void Tcp::SocketInterface::asyncWriteSome(const ConstBufferSequenceType& buffers, WriteHandler handler)
+{
+    service.enqueue(buffers, std::move(handler));
+}
+
+Tcp::Socket Tcp::EndpointInterface::connectNonBlocking(StreamServiceInterface&) const
+{
+    throw NotImplemented("non-blocking connect is not supported by endpoint");
+}
+
+Tcp::SocketInterface::Handshake Tcp::SocketInterface::handshake()
+{
+    return Handshake::Done;
+}
+
+bool Tcp::SocketInterface::buffered() const
+{
+    return false;
+}
+
+bool Tcp::SocketInterface::idle() const
+{
+    if (buffered())
+        return false;
+#if defined(PATR_OS_WINDOWS)
+    WSAPOLLFD descriptor = { static_cast<SOCKET>(handle()), POLLRDNORM, 0 };
+    return ::WSAPoll(&descriptor, 1, 0) == 0;
+#elif defined(PATR_OS_UNIX)
+    // Gotowość do odczytu oznacza nieoczekiwane dane, zamknięcie połączenia lub błąd.
+    pollfd descriptor = { handle(), POLLIN, 0 };
+    int result;
+    while ((result = ::poll(&descriptor, 1, 0)) == -1 && errno == EINTR)
+        ;
+    return result == 0;
+#endif
+}
+
 void Tcp::SocketInterface::shutdown()
 {
     service.shutdown();
 }
 
-Tcp::AcceptorInterface::AcceptorInterface(StreamServiceInterface& service) : service(*this)
+void Tcp::SocketInterface::setTimeout(int milliseconds)
+{
+    service.setTimeout(milliseconds);
+}
+
+Tcp::StreamServiceInterface& Tcp::SocketInterface::getService() const
+{
+    return service.getService();
+}
+
+void Tcp::SocketInterface::setOption(const Option::Option& option)
 {
+    if (::setsockopt(handle(), option.level, option.option, reinterpret_cast<const char*>(&option.value), sizeof option.value) == -1)
+    {
+        throw SocketOptionError("setsockopt failed");
+    }
+}
+
+Tcp::AcceptorInterface::AcceptorInterface(StreamServiceInterface& service) : owner(service), service(*this)
+{
+    this->service.setHandle(-1);
     service.add(&this->service);
 }
 
@@ -685,6 +1514,33 @@ void Tcp::AcceptorInterface::handle(HandleType handle)
     service.setHandle(handle);
 }
 
+Tcp::AcceptorInterface::HandleType Tcp::AcceptorInterface::getHandle() const
+{
+    return handle();
+}
+
+void Tcp::AcceptorInterface::attach()
+{
+    owner.add(&service);
+}
+
+void Tcp::AcceptorInterface::detach()
+{
+    owner.remove(&service);
+}
+
+Tcp::StreamServiceInterface::StreamServiceInterface() : stopping(false)
+{
+    MakeWakeupPair(wakeup);
+}
+
+Tcp::StreamServiceInterface::~StreamServiceInterface()
+{
+    CloseHandle(wakeup[0]);
+    if (wakeup[1] != wakeup[0])
+        CloseHandle(wakeup[1]);
+}
+
 void Tcp::StreamServiceInterface::add(SocketService* service)
 {
     sockets.insert(service);
@@ -700,12 +1556,115 @@ void Tcp::StreamServiceInterface::add(AcceptorService* service)
     acceptors.insert(service);
 }
 
+void Tcp::StreamServiceInterface::remove(AcceptorService* service)
+{
+    acceptors.erase(service);
+}
+
 void Tcp::StreamServiceInterface::add(SignalService* service)
 {
     signal = service;
 }
 
-Tcp::StreamServiceFactory::StreamServiceFactory(StreamService & service) : service(service)
+void Tcp::StreamServiceInterface::update(SocketService*)
+{
+}
+
+Tcp::TimerWheel::TimerId Tcp::StreamServiceInterface::asyncWait(TimerWheel::TimePoint deadline, TimerWheel::Handler handler)
+{
+    return timers.arm(deadline, std::move(handler));
+}
+
+bool Tcp::StreamServiceInterface::cancel(TimerWheel::TimerId timer)
+{
+    return timers.cancel(timer);
+}
+
+void Tcp::StreamServiceInterface::post(PostHandler handler)
+{
+    bool notify;
+    {
+        std::lock_guard<std::mutex> lock(postMutex);
+        notify = posted.empty(); // serwis nie został jeszcze wybudzony dla oczekujących handlerów.
+        posted.push_back(std::move(handler));
+    }
+    if (notify)
+    {
+#if defined(PATR_OS_WINDOWS)
+        char c = 0;
+        ::send(wakeup[1], &c, 1, 0);
+#elif defined(PATR_OS_LINUX)
+        eventfd_t value = 1;
+        while (::write(wakeup[1], &value, sizeof value) == -1 && errno == EINTR)
+            ;
+#elif defined(PATR_OS_UNIX)
+        char c = 0;
+        while (::write(wakeup[1], &c, 1) == -1 && errno == EINTR)
+            ;
+#endif
+    }
+}
+
+void Tcp::StreamServiceInterface::stop()
+{
+    stopping = true;
+    post([] {}); // wybudza serwis, który sprawdzi flagę przed kolejnym oczekiwaniem.
+}
+
+void Tcp::StreamServiceInterface::setSignalHandler(std::function<void(int)> handler)
+{
+    signalHandler = std::move(handler);
+}
+
+bool Tcp::StreamServiceInterface::stopped()
+{
+    if (!stopping && signal && signal->received() && signalHandler)
+    {
+        signal->clear();
+        signalHandler(signal->get());
+    }
+    return stopping || (signal && signal->received());
+}
+
+Tcp::Service::HandleType Tcp::StreamServiceInterface::wakeupHandle() const
+{
+    return wakeup[0];
+}
+
+void Tcp::StreamServiceInterface::runPosted()
+{
+    std::array<char, 64> drain;
+#if defined(PATR_OS_WINDOWS)
+    while (::recv(wakeup[0], drain.data(), static_cast<int>(drain.size()), 0) > 0)
+        ;
+#elif defined(PATR_OS_UNIX)
+    while (::read(wakeup[0], drain.data(), drain.size()) > 0)
+        ;
+#endif
+    invokePosted();
+}
+
+void Tcp::StreamServiceInterface::discardPosted()
+{
+    std::vector<PostHandler> handlers;
+    {
+        std::lock_guard<std::mutex> lock(postMutex);
+        handlers.swap(posted);
+    }
+}
+
+void Tcp::StreamServiceInterface::invokePosted()
+{
+    std::vector<PostHandler> handlers;
+    {
+        std::lock_guard<std::mutex> lock(postMutex);
+        handlers.swap(posted);
+    }
+    for (auto& handler : handlers)
+        handler();
+}
+
+Tcp::StreamServiceFactory::StreamServiceFactory(StreamServiceInterface & service) : service(service)
 {
 }
 
@@ -719,13 +1678,17 @@ std::unique_ptr<Tcp::EndpointInterface> Tcp::StreamServiceFactory::resolve(const
     return std::unique_ptr<EndpointInterface>(new EndpointImplementation(host, port));
 }
 
-Tcp::SslEndpointImplementation::SslEndpointImplementation(const std::string& address, const std::string& port, SslContext& context) : EndpointImplementation(address, port), sslContext(context)
+Tcp::SslEndpointImplementation::SslEndpointImplementation(const std::string& address, const std::string& port, SslContext& context) :
+    EndpointImplementation(address, port),
+    sslContext(context),
+    host(address),
+    port(port)
 {
 }
 
 Tcp::Socket Tcp::SslEndpointImplementation::connect(StreamServiceInterface& service) const
 {
-    for (auto s = address(); s != nullptr; s = address()->ai_next)
+    for (auto s = address(); s != nullptr; s = s->ai_next)
     {
         auto fd = ::socket(s->ai_family, s->ai_socktype, s->ai_protocol);
         if (fd == -1)
@@ -737,20 +1700,78 @@ Tcp::Socket Tcp::SslEndpointImplementation::connect(StreamServiceInterface& serv
         }
         else
         {
-            return Socket(std::unique_ptr<SocketInterface>(new SslSocketImplementation(service, (int)fd, sslContext)));
+            return Socket(std::unique_ptr<SocketInterface>(new SslSocketImplementation(service, (int)fd, sslContext, host, port)));
         }
     }
 
     throw Tcp::EndpointError("failed to connnect to endpoint");
 }
 
-Tcp::SslContext::SslContext() : method(SSLv23_client_method()), context(SSL_CTX_new(method))
+Tcp::Socket Tcp::SslEndpointImplementation::connectNonBlocking(StreamServiceInterface& service) const
+{
+    return Socket(std::unique_ptr<SocketInterface>(new SslSocketImplementation(service, ConnectNonBlocking(address()), sslContext, host, port, false)));
+}
+
+Tcp::SslContext::SessionCache::SessionCache(std::size_t size, long timeout, bool tickets) : size(size), timeout(timeout), tickets(tickets)
+{
+}
+
+/// Sesje klienta, po jednej dla każdego serwera.
+struct Tcp::SslContext::ClientSessions
+{
+    ~ClientSessions()
+    {
+        for (auto& session : sessions)
+            SSL_SESSION_free(session.second);
+    }
+
+    std::mutex mutex;
+    std::unordered_map<std::string, SSL_SESSION*> sessions;
+    long handshakes = 0;
+    long resumed = 0;
+};
+
+Tcp::SslContext::SslContext() : method(SSLv23_client_method()), context(SSL_CTX_new(method)), isServer(false), sessions(new ClientSessions())
 {
     if (context == NULL)
     {
         ERR_print_errors_fp(stderr);
-        throw std::runtime_error("failed to initialize openssl context");
+        throw SslError("failed to initialize openssl context");
+    }
+
+    // Sesje przechowywane są według serwera, a nie identyfikatora - wewnętrzna pamięć openssl nie jest używana.
+    SSL_CTX_set_app_data(context, this);
+    SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+    SSL_CTX_sess_set_new_cb(context, NewSession);
+}
+
+Tcp::SslContext::SslContext(const std::string& certificateFile, const std::string& keyFile, const SessionCache& cache) :
+    method(SSLv23_server_method()),
+    context(SSL_CTX_new(method)),
+    isServer(true)
+{
+    if (context == NULL)
+        throw SslError("failed to initialize openssl context");
+
+    if (SSL_CTX_use_certificate_chain_file(context, certificateFile.c_str()) != 1
+        || SSL_CTX_use_PrivateKey_file(context, keyFile.c_str(), SSL_FILETYPE_PEM) != 1
+        || SSL_CTX_check_private_key(context) != 1)
+    {
+        SSL_CTX_free(context);
+        ERR_clear_error();
+        throw SslError("failed to load certificate " + certificateFile + " or key " + keyFile);
     }
+
+    SSL_CTX_set_options(context, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3 | SSL_OP_NO_TLSv1 | SSL_OP_NO_TLSv1_1 | SSL_OP_NO_COMPRESSION);
+    // zapis ponawiany jest z tą samą, ale ponownie scaloną sekwencją buforów.
+    SSL_CTX_set_mode(context, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+
+    SSL_CTX_set_session_id_context(context, SessionContext, sizeof SessionContext - 1);
+    SSL_CTX_set_session_cache_mode(context, cache.size ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+    SSL_CTX_sess_set_cache_size(context, static_cast<long>(cache.size));
+    SSL_CTX_set_timeout(context, cache.timeout);
+    if (!cache.tickets)
+        SSL_CTX_set_options(context, SSL_OP_NO_TICKET);
 }
 
 Tcp::SslContext::~SslContext()
@@ -758,9 +1779,79 @@ Tcp::SslContext::~SslContext()
     SSL_CTX_free(context);
 }
 
-Tcp::SslConnection Tcp::SslContext::connection(Tcp::SocketInterface::HandleType handle)
+Tcp::SslConnection Tcp::SslContext::connection(Tcp::SocketInterface::HandleType handle, const std::string& host, const std::string& port, bool wait)
+{
+    auto ssl = SSL_new(context);
+    if (isServer || host.empty() || !ssl)
+        return SslConnection(ssl, handle, isServer, wait);
+
+    if (!IsAddressLiteral(host))
+        SSL_set_tlsext_host_name(ssl, host.c_str());
+
+    auto key = new std::string(host + ':' + port);
+    SSL_set_ex_data(ssl, SessionKeyIndex(), key); // zwalniany wraz z połączeniem.
+    {
+        std::lock_guard<std::mutex> lock(sessions->mutex);
+        auto session = sessions->sessions.find(*key);
+        if (session != sessions->sessions.end())
+            SSL_set_session(ssl, session->second);
+    }
+
+    SslConnection connection(ssl, handle, isServer, wait);
+    if (SSL_is_init_finished(ssl))
+        Established(ssl);
+    return connection;
+}
+
+void Tcp::SslContext::Established(SSL* ssl)
 {
-    return SslConnection(SSL_new(context), handle);
+    auto self = static_cast<SslContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    if (!self || self->isServer)
+        return; // liczniki serwera prowadzi openssl.
+
+    std::lock_guard<std::mutex> lock(self->sessions->mutex);
+    ++self->sessions->handshakes;
+    if (SSL_session_reused(ssl))
+        ++self->sessions->resumed;
+}
+
+int Tcp::SslContext::NewSession(SSL* ssl, SSL_SESSION* session)
+{
+    auto key = static_cast<std::string*>(SSL_get_ex_data(ssl, SessionKeyIndex()));
+    auto self = static_cast<SslContext*>(SSL_CTX_get_app_data(SSL_get_SSL_CTX(ssl)));
+    if (!key || !self)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(self->sessions->mutex);
+    auto& sessions = self->sessions->sessions;
+    auto existing = sessions.find(*key);
+    if (existing != sessions.end())
+    {
+        SSL_SESSION_free(existing->second);
+        existing->second = session;
+        return 1;
+    }
+    if (sessions.size() >= MaxClientSessions)
+    {
+        SSL_SESSION_free(sessions.begin()->second);
+        sessions.erase(sessions.begin());
+    }
+    sessions.emplace(*key, session);
+    return 1; // przejęcie referencji do sesji.
+}
+
+bool Tcp::SslContext::server() const
+{
+    return isServer;
+}
+
+Tcp::SslContext::Statistics Tcp::SslContext::statistics() const
+{
+    if (isServer)
+        return Statistics{ SSL_CTX_sess_accept_good(context), SSL_CTX_sess_hits(context), SSL_CTX_sess_number(context) };
+
+    std::lock_guard<std::mutex> lock(sessions->mutex);
+    return Statistics{ sessions->handshakes, sessions->resumed, static_cast<long>(sessions->sessions.size()) };
 }
 
 Tcp::SslContext::SslContextInit::SslContextInit()
@@ -769,6 +1860,12 @@ Tcp::SslContext::SslContextInit::SslContextInit()
     OpenSSL_add_all_algorithms();
     SSL_load_error_strings();
     OPENSSL_config(NULL);
+#if defined(SIGPIPE)
+    // openssl zapisuje do gniazda przez write(), bez MSG_NOSIGNAL - zerwane połączenie TLS zgłaszane jest błędem zapisu.
+    // Ustawiane jednokrotnie, aby kolejne konteksty nie nadpisywały obsługi ustawionej później przez aplikację.
+    static std::once_flag ignored;
+    std::call_once(ignored, [] { std::signal(SIGPIPE, SIG_IGN); });
+#endif // defined(SIGPIPE)
 }
 
 Tcp::SslContext::SslContextInit::~SslContextInit()
@@ -777,15 +1874,31 @@ Tcp::SslContext::SslContextInit::~SslContextInit()
     EVP_cleanup();
 }
 
-Tcp::SslConnection::SslConnection(SSL* ssl, Tcp::SocketInterface::HandleType handle) : closed(false), ssl(ssl), handle(handle)
+Tcp::SslConnection::SslConnection(SSL* ssl, Tcp::SocketInterface::HandleType handle, bool server, bool wait) : closed(false), established(!server && wait), ssl(ssl), handle(handle)
 {
-    if (!SSL_set_fd(ssl, handle))
+    if (!ssl || !SSL_set_fd(ssl, handle))
+    {
+        SSL_free(ssl);
         throw SocketError("failed to open ssl socket");
+    }
 
-    SSL_connect(ssl);
+    if (server)
+    {
+        SetNonBlocking(handle); // handshake oraz odczyt nie mogą blokować serwisu.
+        SSL_set_accept_state(ssl);
+    }
+    else if (!wait)
+    {
+        SetNonBlocking(handle);
+        SSL_set_connect_state(ssl);
+    }
+    else
+    {
+        SSL_connect(ssl);
+    }
 }
 
-Tcp::SslConnection::SslConnection(SslConnection&& other) : closed(false), ssl(other.ssl), handle(other.handle)
+Tcp::SslConnection::SslConnection(SslConnection&& other) : closed(other.closed), established(other.established), ssl(other.ssl), handle(other.handle)
 {
     other.closed = true;
 }
@@ -795,31 +1908,89 @@ Tcp::SslConnection::~SslConnection()
     close();
 }
 
+Tcp::SocketInterface::Handshake Tcp::SslConnection::handshake()
+{
+    if (established)
+        return SocketInterface::Handshake::Done;
+
+    auto result = SSL_do_handshake(ssl);
+    if (result == 1)
+    {
+        established = true;
+        if (!SSL_is_server(ssl))
+            SslContext::Established(ssl);
+        return SocketInterface::Handshake::Done;
+    }
+
+    auto error = SSL_get_error(ssl, result);
+    if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+        return SocketInterface::Handshake::Pending;
+    ERR_clear_error();
+    return SocketInterface::Handshake::Failed;
+}
+
+bool Tcp::SslConnection::pending() const
+{
+    return SSL_pending(ssl) > 0; // nieprzetworzone rekordy pozostają w gnieździe (read-ahead jest wyłączony).
+}
+
+bool Tcp::SslConnection::resumed() const
+{
+    return SSL_session_reused(ssl) == 1;
+}
+
 int Tcp::SslConnection::sslRead(Tcp::Buffer& buffer)
 {
-    return SSL_read(ssl, buffer.first, buffer.second);
+    auto result = SSL_read(ssl, buffer.first, buffer.second);
+    if (result > 0)
+        return result;
+
+    auto error = SSL_get_error(ssl, result);
+    if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+        return SocketService::WouldBlock;
+    if (error == SSL_ERROR_ZERO_RETURN)
+        return 0;
+    ERR_clear_error();
+    return -1;
 }
 
-int Tcp::SslConnection::sslWrite(const Tcp::ConstBuffer& buffer)
+int Tcp::SslConnection::sslWrite(const Tcp::ConstBuffer& buffer, bool block)
 {
-    auto i = SSL_write(ssl, buffer.first, buffer.second);
-    if (SSL_get_error(ssl, i) == SSL_ERROR_WANT_WRITE)
+    for (;;)
     {
-        return sslWrite(buffer);
+        auto i = SSL_write(ssl, buffer.first, buffer.second);
+        if (i > 0)
+            return i;
+
+        auto error = SSL_get_error(ssl, i);
+        if (error == SSL_ERROR_WANT_WRITE || error == SSL_ERROR_WANT_READ)
+        {
+            if (!block)
+                return 0; // zapis zostanie ponowiony przy kolejnej gotowości gniazda.
+            // Gniazda serwera są nieblokujące - zapis ponawiany jest po gotowości, jak w SocketImplementation::writeSome.
+            WaitReady(handle, error == SSL_ERROR_WANT_WRITE);
+            continue;
+        }
+        ERR_clear_error();
+        throw SendError("SSL_write failed (" + std::to_string(error) + ')');
     }
-    return i;
 }
 
 void Tcp::SslConnection::close()
 {
     if (!closed)
     {
-        SSL_shutdown(ssl);
+        if (established)
+            SSL_shutdown(ssl); // nieblokujące gniazdo wysyła close_notify bez oczekiwania na odpowiedź.
         SSL_free(ssl);
+        closed = true;
     }
 }
 
-Tcp::SslSocketImplementation::SslSocketImplementation(StreamServiceInterface& service, HandleType handle, SslContext& ssl) : SocketImplementation(service, handle), connection(ssl.connection(handle))
+Tcp::SslSocketImplementation::SslSocketImplementation(StreamServiceInterface& service, HandleType handle, SslContext& ssl, const std::string& host, const std::string& port, bool wait) :
+    SocketImplementation(service, handle),
+    connection(ssl.connection(handle, host, port, wait)),
+    nonBlocking(ssl.server() || !wait)
 {
 }
 
@@ -833,6 +2004,61 @@ int Tcp::SslSocketImplementation::writeSome(const ConstBufferType& buffer)
     return connection.sslWrite(buffer);
 }
 
+int Tcp::SslSocketImplementation::readSome(const BufferSequenceType& buffers)
+{
+    return SocketInterface::readSome(buffers);
+}
+
+int Tcp::SslSocketImplementation::writeSome(const ConstBufferSequenceType& buffers)
+{
+    return writeRecord(buffers, true);
+}
+
+int Tcp::SslSocketImplementation::tryWriteSome(const ConstBufferType& buffer)
+{
+    return connection.sslWrite(buffer, !nonBlocking);
+}
+
+int Tcp::SslSocketImplementation::tryWriteSome(const ConstBufferSequenceType& buffers)
+{
+    return writeRecord(buffers, !nonBlocking);
+}
+
+Tcp::SocketInterface::Handshake Tcp::SslSocketImplementation::handshake()
+{
+    return connection.handshake();
+}
+
+bool Tcp::SslSocketImplementation::buffered() const
+{
+    return connection.pending();
+}
+
+bool Tcp::SslSocketImplementation::resumed() const
+{
+    return connection.resumed();
+}
+
+int Tcp::SslSocketImplementation::writeRecord(const ConstBufferSequenceType& buffers, bool block)
+{
+    std::string record; // małe bufory scalane są w jeden rekord zamiast osobnego rekordu na każdy.
+    for (const auto& buffer : buffers)
+    {
+        if (buffer.second <= 0)
+            continue;
+        if (record.size() + buffer.second > static_cast<std::size_t>(CoalesceLimit))
+        {
+            if (record.empty())
+                return connection.sslWrite(buffer, block); // duży bufor zapisywany jest bez kopiowania.
+            break;
+        }
+        record.append(buffer.first, buffer.second);
+    }
+    if (record.empty())
+        return 0;
+    return connection.sslWrite(ConstBufferType(record.data(), static_cast<int>(record.size())), block);
+}
+
 void Tcp::SslSocketImplementation::close()
 {
     connection.close();
@@ -848,7 +2074,17 @@ std::unique_ptr<Tcp::EndpointInterface> Tcp::SslStreamServiceFactory::resolve(co
     return std::unique_ptr<EndpointInterface>(new SslEndpointImplementation(host, port, context));
 }
 
+Tcp::SslStreamService::SslStreamService() : context(std::make_shared<SslContext>())
+{
+}
+
+Tcp::SslStreamService::SslStreamService(std::shared_ptr<SslContext> context) : context(std::move(context))
+{
+    if (!this->context || this->context->server())
+        throw SslError("ssl stream service requires a client context");
+}
+
 std::unique_ptr<Tcp::ServiceFactory> Tcp::SslStreamService::getFactory()
 {
-    return std::unique_ptr<ServiceFactory>(new SslStreamServiceFactory(*this, context));
+    return std::unique_ptr<ServiceFactory>(new SslStreamServiceFactory(*this, *context));
 }
@@ -7,10 +7,18 @@
 #include <map>
 #include <queue>
 #include <string>
+#include <stdexcept>
 #include <unordered_set>
 
 #include <functional>
 #include <chrono>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <vector>
+#include <unordered_map>
 
 #include "Predef.h"
 #if defined(PATR_OS_WINDOWS)
@@ -113,6 +121,13 @@ public:
     using AcceptorError::AcceptorError;
 };
 
+// Brak oczekującego połączenia na nieblokującym akceptorze - mógł je przyjąć inny proces współdzielący gniazdo.
+class AcceptRetryError : public AcceptError
+{
+public:
+    using AcceptError::AcceptError;
+};
+
 // Błąd demultipleksacji / asynchronicznego wywołania.
 class ServiceError : public TcpError
 {
@@ -134,9 +149,24 @@ public:
     using SocketError::SocketError;
 };
 
+// Błąd konfiguracji lub połączenia TLS.
+class SslError : public SocketError
+{
+public:
+    using SocketError::SocketError;
+};
+
 // Typ wykorzystywany do przesyłu informacji przez gniazda.
 typedef std::pair<char* /* data */, int /* size */> Buffer;
 typedef std::pair<const char* /* data */, int /* size */> ConstBuffer;
+/// Sekwencje buforów przesyłane jednym wywołaniem systemowym (readv/writev).
+typedef std::vector<Buffer> BufferSequence;
+typedef std::vector<ConstBuffer> ConstBufferSequence;
+
+/// Usuwa z początku sekwencji podaną liczbę przesłanych bajtów.
+void Consume(ConstBufferSequence& buffers, std::size_t bytes);
+/// Zwraca łączny rozmiar buforów sekwencji.
+std::size_t BufferSize(const ConstBufferSequence& buffers);
 
 
 
@@ -196,6 +226,7 @@ namespace Option {
     {
         int option;
         int value;
+        int level; //< Poziom opcji (SOL_SOCKET, IPPROTO_TCP).
     };
 
     /// Specjalizacja Tcp::Option dla opcji SO_REUSEADDR.
@@ -204,12 +235,144 @@ namespace Option {
         ReuseAddress(bool value);
     };
 
+    /// Specjalizacja Tcp::Option dla opcji SO_REUSEPORT.
+    /**
+     * Pozwala kilku akceptorom nasłuchiwać na tym samym porcie - jądro
+     * rozdziela między nie nowe połączenia. Na platformach bez SO_REUSEPORT
+     * konstruktor rzuca SocketOptionError.
+     */
+    struct ReusePort : public Option
+    {
+        ReusePort(bool value);
+    };
+
+    /// Specjalizacja Tcp::Option dla opcji TCP_CORK (TCP_NOPUSH na systemach BSD).
+    /**
+     * Wstrzymuje wysyłanie niepełnych segmentów do czasu wyłączenia opcji,
+     * łącząc kolejne zapisy. Na platformach bez tej opcji konstruktor rzuca SocketOptionError.
+     */
+    struct Cork : public Option
+    {
+        Cork(bool value);
+    };
+
+    /// Specjalizacja Tcp::Option dla opcji TCP_NODELAY.
+    /**
+     * Wyłącza algorytm Nagle'a - niepełne segmenty wysyłane są bez oczekiwania
+     * na potwierdzenie poprzednich. Ustawiona na akceptorze jest dziedziczona przez przyjęte gniazda.
+     */
+    struct NoDelay : public Option
+    {
+        NoDelay(bool value);
+    };
+
+    /// Specjalizacja Tcp::Option dla opcji TCP_DEFER_ACCEPT.
+    /**
+     * Akceptor wybudzany jest dopiero, gdy klient prześle pierwsze dane, nie później niż po seconds
+     * sekundach. Na platformach bez tej opcji konstruktor rzuca SocketOptionError.
+     */
+    struct DeferAccept : public Option
+    {
+        DeferAccept(int seconds);
+    };
+
+    /// Specjalizacja Tcp::Option dla opcji SO_RCVBUF.
+    /**
+     * Na akceptorze powinna zostać ustawiona przed listen(), aby wpłynęła na skalowanie okna TCP.
+     */
+    struct ReceiveBuffer : public Option
+    {
+        ReceiveBuffer(int bytes);
+    };
+
+    /// Specjalizacja Tcp::Option dla opcji SO_SNDBUF.
+    struct SendBuffer : public Option
+    {
+        SendBuffer(int bytes);
+    };
+
+    /// Specjalizacja Tcp::Option dla opcji TCP_FASTOPEN.
+    /**
+     * Pozwala klientom przesłać zapytanie w pakiecie SYN ponownego połączenia.
+     * queue ogranicza liczbę połączeń TFO oczekujących na zakończenie uzgadniania.
+     * Na platformach bez tej opcji konstruktor rzuca SocketOptionError.
+     */
+    struct FastOpen : public Option
+    {
+        FastOpen(int queue);
+    };
+
     // Możliwa rozbudowa, jeżeli zajdzie taka potrzeba.
 }
 
 
 
 
+/// Kolejka zdarzeń czasowych w postaci haszowanego koła czasu.
+/**
+ * Termin zdarzenia jest zaokrąglany w górę do wielokrotności rozdzielczości
+ * i przypisywany do przegródki (tick % liczba przegródek). Dodanie, usunięcie
+ * i wywołanie pojedynczego zdarzenia zajmują czas stały, niezależnie od
+ * liczby oczekujących zdarzeń. Klasa nie jest bezpieczna wielowątkowo -
+ * powinna być wykorzystywana wyłącznie z wątku serwisu.
+ */
+class TimerWheel : public NonCopyable
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef Clock::time_point TimePoint;
+    typedef std::function<void()> Handler;
+    /// Identyfikator zdarzenia, wartość 0 nie oznacza żadnego zdarzenia.
+    typedef std::uint64_t TimerId;
+
+    /// Tworzy koło o danej rozdzielczości w [ms] i liczbie przegródek.
+    TimerWheel(int resolution = 10, std::size_t slots = 1024);
+
+    /// Dodaje zdarzenie wywołujące handler po upływie terminu deadline.
+    TimerId arm(TimePoint deadline, Handler handler);
+    /// Usuwa oczekujące zdarzenie.
+    /**
+     * @return false, jeżeli zdarzenie już zostało wywołane lub nie istnieje.
+     */
+    bool cancel(TimerId timer);
+    /// Wywołuje wszystkie zdarzenia, których termin upłynął przed now.
+    /**
+     * Wywoływane funkcje mogą dodawać i usuwać kolejne zdarzenia.
+     * @return liczba wywołanych zdarzeń.
+     */
+    std::size_t expire(TimePoint now);
+    /// Zwraca czas w [ms], po którym należy wywołać expire().
+    /**
+     * @return -1, jeżeli nie ma oczekujących zdarzeń.
+     */
+    int timeout(TimePoint now) const;
+    /// Zwraca liczbę oczekujących zdarzeń.
+    std::size_t size() const;
+
+private:
+    struct Entry
+    {
+        TimerId id;
+        std::uint64_t tick;
+        Handler handler;
+    };
+    typedef std::list<Entry> Slot;
+
+    /// Wyszukuje najbliższą niepustą przegródkę.
+    void findNearest();
+
+    TimePoint origin;
+    std::chrono::milliseconds resolution;
+    std::uint64_t current; //< Ostatni obsłużony tick.
+    std::uint64_t nearest; //< Dolne ograniczenie ticku najbliższego zdarzenia.
+    TimerId lastId;
+    std::vector<Slot> slots;
+    std::unordered_map<TimerId, std::pair<std::size_t, Slot::iterator>> timers;
+};
+
+
+
+
 class StreamService;
 class Socket;
 class AcceptorImplementation;
@@ -266,6 +429,8 @@ public:
     virtual int get() const = 0;
     /// W celu sprawdzenia czy sygnał został wywołany.
     virtual bool received() const = 0;
+    /// Oznacza sygnał jako obsłużony.
+    virtual void clear() = 0;
 };
 
 
@@ -285,6 +450,8 @@ public:
     int get() const override;
     /// Zwraca, czy sygnał został wywołany.
     bool received() const override;
+    /// Oznacza sygnał jako obsłużony.
+    void clear() override;
 
 private:
     int& sigVal;
@@ -314,7 +481,18 @@ public:
     AcceptorService(AcceptorInterface& implementation);
 
     /// Wybudza implementację w celu dokonania asynchronicznej akcji.
+    /**
+     * Przyjmuje kolejne połączenia do wyczerpania kolejki gniazda (nie więcej niż AcceptBatch),
+     * dzięki czemu nagły napływ połączeń obsługiwany jest w jednym wybudzeniu. Jeżeli połączenie
+     * zostało już przyjęte przez inny proces, handler pozostaje w kolejce.
+     */
     void acceptReady();
+
+    /// Największa liczba połączeń przyjmowanych w jednym wybudzeniu.
+    /**
+     * Pozostałe połączenia zgłoszone zostaną przy kolejnym wybudzeniu, nie wstrzymując obsługi gniazd.
+     */
+    static constexpr std::size_t AcceptBatch = 64;
     /// Wprowadza nową funkcję do wywołania w kolejce.
     void enqueue(Handler handler);
 
@@ -337,46 +515,175 @@ public:
     typedef Service::HandleType HandleType;
     /// Prototyp funkcji służącej do obsługi asynchronicznego odczytu z gniazda.
     typedef std::function<void(int /*error code */, std::size_t /* bytes read */)> ReadHandler;
-    /// Prototyp funkcji służącej do obsługi asynchronicznego zapisu z gniazda.
+    /// Prototyp funkcji służącej do obsługi asynchronicznego zapisu do gniazda.
     /**
-     * Asynchroniczny zapis nie jest obecnie zaimplementowany.
+     * Wywoływana z kodem błędu i liczbą zapisanych bajtów, gdy gniazdo było gotowe do zapisu.
      */
-    typedef std::function<void(int, int)> WriteHandler;
+    typedef std::function<void(int /*error code */, int /* bytes written */)> WriteHandler;
     /// Bufor wywkorzystywany do komunikacji z implementacją.
     typedef Buffer BufferType;
     typedef ConstBuffer ConstBufferType;
+    typedef ConstBufferSequence ConstBufferSequenceType;
+    /// Funkcja dostarczająca bufor odczytu dopiero w chwili gotowości gniazda.
+    typedef std::function<BufferType()> BufferSource;
+
+    /// Domyślny czas bezczynności w [ms], po którym gniazdo zostaje zamknięte.
+    static constexpr int DefaultTimeout = 30000;
+    /// Wynik odczytu, który zablokowałby wywołanie (np. niepełny rekord TLS).
+    /**
+     * Handler odczytu pozostaje w kolejce do kolejnej gotowości gniazda.
+     */
+    static constexpr int WouldBlock = -2;
 
     /// Tworzy obiekt z implementacją o interfejsie SocketInterface.
     SocketService(StreamServiceInterface& service, SocketInterface& implementation, HandleType handle);
+    /// Usuwa oczekujące zdarzenie timeoutu.
+    ~SocketService();
     /// Oznacza, że gniazdo jest gotowe do nieblokującego odczytu.
+    /**
+     * @return liczba odczytanych bajtów lub WouldBlock, jeżeli implementacja oczekuje na kolejne dane.
+     */
     int readReady();
     /// Oznacza, że gniazdo jest gotowe do nieblokującego zapisu.
+    /**
+     * @return liczba zapisanych bajtów, 0 jeżeli zapis zablokowałby wywołanie.
+     */
     int writeReady();
 
     /// Służy wprowadzeniu nowych funkcji obsługujących asynchroniczny odczyt.
     void enqueue(BufferType& buffer, ReadHandler handler);
+    /// Wprowadza asynchroniczny odczyt do bufora pobieranego od source przy gotowości gniazda.
+    void enqueue(BufferSource source, ReadHandler handler);
     /// Służy wprowadzeniu nowych funkcji obsługujących asynchroniczny zapis.
     void enqueue(const ConstBufferType& buffer, WriteHandler handler);
+    /// Wprowadza asynchroniczny zapis sekwencji buforów jednym wywołaniem systemowym.
+    void enqueue(ConstBufferSequenceType buffers, WriteHandler handler);
+
+    /// Zwraca, czy w kolejce oczekuje asynchroniczny odczyt.
+    bool pendingRead() const;
+    /// Zwraca, czy w kolejce oczekuje asynchroniczny zapis.
+    /**
+     * Zapis nie jest zgłaszany, gdy handshake oczekuje na dane drugiej strony, a kontynuuje go oczekujący odczyt
+     * - gotowość gniazda do zapisu nie pozwala wtedy na postęp (np. nieblokujący klient TLS w select).
+     */
+    bool pendingWrite() const;
+    /// Zwraca, czy implementacja przechowuje odebrane dane niewidoczne dla serwisu.
+    /**
+     * Takie dane nie wywołają gotowości deskryptora - serwis powinien wywołać readReady bez jej oczekiwania.
+     */
+    bool buffered() const;
 
-    /// Zwraca pozostały czas, po upływie którego nastąpi timeout w [ms].
-    int remainingTime() const;
-    /// Uaktualnia pozostały czas do timeoutu w [ms].
-    void updateRemainingTime(int milliseconds);
+    /// Zwraca czas bezczynności w [ms], po upływie którego nastąpi timeout.
+    int getTimeout() const;
+    /// Ustawia czas bezczynności w [ms], wartość 0 wyłącza timeout.
+    /**
+     * Bezczynność liczona jest od ostatniego odczytu, zlecenia zapisu do pustej kolejki lub postępu zapisu.
+     */
+    void setTimeout(int milliseconds);
 
     /// Oznacza gniazdo jako gotowe do zamknięcia.
     /**
-     * Zamknięcie może nie nastąpić natychmiast.
+     * Zamknięcie może nie nastąpić natychmiast. Oczekujące handlery wywoływane są z błędem.
      */
     void shutdown();
 
+    /// Zwraca serwis, do którego należy gniazdo.
+    StreamServiceInterface& getService() const;
+
 private:
+    /// Rejestruje zdarzenie timeoutu w serwisie.
+    void arm(TimerWheel::TimePoint deadline);
+    /// Wywoływana przez serwis po upływie terminu zdarzenia.
+    /**
+     * Termin jest przesuwany leniwie - jeżeli od zarejestrowania nastąpił
+     * odczyt, zdarzenie jest rejestrowane ponownie.
+     */
+    void expired();
+
     int shut;
-    int timeout, currentTime;
-    std::chrono::high_resolution_clock::time_point begin;
-    std::queue<std::pair<BufferType, ReadHandler>> readHandlers;
-    std::queue<std::pair<ConstBufferType, WriteHandler>> writeHandlers;
+    bool handshaking; //< Handshake oczekuje na dane drugiej strony.
+    int timeout;
+    TimerWheel::TimerId timer;
+    TimerWheel::TimePoint lastActivity;
+    std::queue<std::pair<BufferSource, ReadHandler>> readHandlers;
+    std::queue<std::pair<ConstBufferSequenceType, WriteHandler>> writeHandlers;
     SocketInterface& implementation;
     StreamServiceInterface& service;
+    bool* destroyed; //< Ustawiana przez destruktor, gdy handler wywołany w shutdown() zwolni gniazdo.
+};
+
+
+
+
+/// Pamięć podręczna rozwiązywania nazw hostów.
+/**
+ * Adresy hosta przechowywane są przez ttl, a niepowodzenia (negatywnie) przez negativeTtl - getaddrinfo
+ * nie udostępnia czasu życia rekordów DNS, więc jest on stały. Równoczesne zapytania o ten sam host
+ * oczekują na jedno rozwiązanie. Wynik jest współdzielony - pozostaje ważny, dopóki korzysta z niego
+ * którykolwiek punkt docelowy, również po usunięciu z pamięci. Klasa jest bezpieczna wielowątkowo.
+ */
+class Resolver : public NonCopyable
+{
+public:
+    typedef std::shared_ptr<addrinfo> Result;
+    /// Funkcja rozwiązująca nazwę, zgłaszająca EndpointError przy niepowodzeniu.
+    /**
+     * Domyślnie SystemLookup, w testach może zostać zastąpiona lokalną implementacją.
+     */
+    typedef std::function<Result(const std::string& host, const std::string& port)> Lookup;
+
+    /// Liczniki zapytań.
+    struct Statistics
+    {
+        std::size_t lookups; //< Wywołania funkcji rozwiązującej.
+        std::size_t hits; //< Zapytania obsłużone z pamięci, także negatywnie.
+        std::size_t coalesced; //< Zapytania oczekujące na trwające rozwiązanie tej samej nazwy.
+    };
+
+    /**
+     * @param ttl - czas ważności rozwiązanych adresów.
+     * @param negativeTtl - czas, przez który niepowodzenie zgłaszane jest bez ponownego zapytania.
+     * @param capacity - największa liczba przechowywanych nazw.
+     */
+    Resolver(std::chrono::seconds ttl = std::chrono::seconds(60),
+             std::chrono::seconds negativeTtl = std::chrono::seconds(5),
+             std::size_t capacity = 1024,
+             Lookup lookup = SystemLookup);
+
+    /// Zwraca adresy hosta.
+    /**
+     * @throw EndpointError, jeżeli nie można rozwiązać nazwy.
+     */
+    Result resolve(const std::string& host, const std::string& port);
+    /// Usuwa zapamiętane wyniki.
+    void clear();
+    /// Zwraca liczniki zapytań.
+    Statistics statistics() const;
+
+    /// Rozwiązuje nazwę przez getaddrinfo (IPv4, TCP).
+    static Result SystemLookup(const std::string& host, const std::string& port);
+    /// Zwraca pamięć procesu, wykorzystywaną przez EndpointImplementation.
+    static Resolver& Shared();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        std::shared_future<Result> result;
+        Clock::time_point expires; //< Clock::time_point::max(), dopóki trwa rozwiązywanie.
+    };
+
+    /// Usuwa przeterminowane wpisy, a przy braku miejsca także najwcześniej wygasające.
+    void evict(Clock::time_point now);
+
+    std::chrono::seconds ttl;
+    std::chrono::seconds negativeTtl;
+    std::size_t capacity;
+    Lookup lookup;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    Statistics counters;
 };
 
 
@@ -396,6 +703,13 @@ public:
     virtual ProtocolType protocol() const = 0;
 
     virtual Socket connect(StreamServiceInterface& service) const = 0;
+    /// Rozpoczyna nawiązywanie połączenia i zwraca nieblokujące gniazdo bez oczekiwania na jego zakończenie.
+    /**
+     * Połączenie (wraz z handshake TLS) kończy serwis - pierwszy asynchroniczny zapis wykonywany jest
+     * po jego nawiązaniu, a niepowodzenie przekazywane handlerom oczekujących operacji.
+     * Domyślnie zgłasza NotImplemented.
+     */
+    virtual Socket connectNonBlocking(StreamServiceInterface& service) const;
 };
 
 
@@ -414,9 +728,9 @@ public:
      * address może przyjmować formę nazwy domeny (np. www.example.com),
      * mnemonikę (np. localhost), IPv4 (np. 0.0.0.0), IPv6 (np 0::0).
      * Port może przyjmować wartości od 1 do 49150 w postaci łańcucha znaków.
+     * Nazwa rozwiązywana jest przez resolver, domyślnie współdzielony przez proces.
      */
-    EndpointImplementation(const std::string& address, const std::string& port);
-    ~EndpointImplementation();
+    EndpointImplementation(const std::string& address, const std::string& port, Resolver& resolver = Resolver::Shared());
 
     /// Zwraca informacje o adresie niezbędne do wykonania operacji.
     AddressType address() const override;
@@ -424,9 +738,11 @@ public:
     ProtocolType protocol() const override;
 
     Socket connect(StreamServiceInterface& service) const override;
+    /// Wybiera pierwszy adres, którego połączenie nie zostało od razu odrzucone.
+    Socket connectNonBlocking(StreamServiceInterface& service) const override;
 
 private:
-    AddressType addressVal;
+    Resolver::Result addressVal;
 };
 
 
@@ -492,19 +808,41 @@ public:
      * nadchodzące połączenie.
      */
     virtual Socket accept() = 0;
+    /// Przyjmuje połączenie oczekujące w kolejce bez blokowania.
+    /**
+     * Rzuca AcceptRetryError, jeżeli kolejka jest pusta.
+     */
+    virtual Socket acceptPending() = 0;
     /// Asynchroniczna wersja przyjmuje funkcję do obsługi zdarzenia, gdy ono nadejdzie.
     /**
      * Przekazywana funkcja zostanie wykonana, gdy obiekt zostanie wybudzony.
      * Funkcja wraca bez blokowania.
      */
     void asyncAccept(Handler handler);
+    /// Przejmuje otwarte gniazdo nasłuchujące, np. przekazane przez proces nadrzędny.
+    /**
+     * Gniazdo może być współdzielone z innym procesem, dlatego jest przełączane w tryb nieblokujący.
+     */
+    virtual void assign(HandleType handle) = 0;
+    /// Zamyka gniazdo i wyrejestrowuje akceptor z serwisu.
+    /**
+     * Oczekujące wywołania asyncAccept nie zostaną wykonane. Połączenia oczekujące w kolejce
+     * gniazda pozostają dostępne dla innych procesów, które je współdzielą.
+     */
+    virtual void close() = 0;
+    /// Zwraca uchwyt gniazda nasłuchującego, -1 jeżeli gniazdo jest zamknięte.
+    HandleType getHandle() const;
 
 protected:
     /// Celem ograniczenia interakcji frontendu z obiektami typu *Service.
     HandleType handle() const;
     void handle(HandleType handle);
+    /// Dodaje lub usuwa akceptor z serwisu.
+    void attach();
+    void detach();
 
 private:
+    StreamServiceInterface& owner;
     AcceptorService service;
 };
 
@@ -519,8 +857,19 @@ public:
     typedef SocketService::WriteHandler WriteHandler;
     typedef SocketService::BufferType BufferType;
     typedef SocketService::ConstBufferType ConstBufferType;
+    typedef SocketService::BufferSource BufferSource;
+    typedef BufferSequence BufferSequenceType;
+    typedef ConstBufferSequence ConstBufferSequenceType;
     typedef SocketService::HandleType HandleType;
 
+    /// Stan nawiązywania połączenia prowadzonego przez implementację (np. handshake TLS).
+    enum class Handshake
+    {
+        Done,
+        Pending, //< Oczekuje na kolejne dane od drugiej strony.
+        Failed
+    };
+
     /// Tworzy obiekt związany z obiektem typu *Service.
     SocketInterface(StreamServiceInterface& service, HandleType handle);
     virtual ~SocketInterface() = default;
@@ -532,15 +881,27 @@ public:
     virtual int read(BufferType& buffer) = 0;
     /// Odczytuje dostępną w tej chwili liczbę bajtów.
     /**
-     * Może blokować, jeżeli w danej chwili bufor gniazda jest pusty.
+     * Może blokować, jeżeli w danej chwili bufor gniazda jest pusty. Gniazdo nieblokujące
+     * zwraca wtedy SocketService::WouldBlock.
      * @return ilość odczytanych bajtów - powinna być równa ilości dostępnych bajtów na gnieździe.
      */
     virtual int readSome(BufferType& buffer) = 0;
+    /// Odczytuje dostępne bajty do kolejnych buforów sekwencji (readv).
+    /**
+     * Domyślnie odczytuje do pierwszego niepustego bufora.
+     */
+    virtual int readSome(const BufferSequenceType& buffers);
     /// Oznacza asynchroniczne wywołanie funkcji ReadHandler.
     /**
      * Funkcja powinna wracać bez blokowania.
      */
     virtual void asyncReadSome(BufferType buffer, ReadHandler handler);
+    /// Asynchroniczny odczyt, którego bufor pobierany jest dopiero przy gotowości gniazda.
+    /**
+     * Pozwala oczekującym połączeniom nie przetrzymywać bufora. Jeżeli gniazdo zostanie
+     * zamknięte przed odczytem, source nie zostanie wywołane.
+     */
+    virtual void asyncReadSome(BufferSource source, ReadHandler handler);
     /// Odpowiednik read dla zapisu.
     /**
      * @return ilość faktycznie zapisanych bajtów - powinna wynosić rozmiar bufora.
@@ -551,13 +912,60 @@ public:
      * @return ilość faktycznie zapisanych bajtów.
      */
     virtual int writeSome(const ConstBufferType& buffer) = 0;
+    /// Zapisuje kolejne bufory sekwencji (writev).
+    /**
+     * Domyślnie zapisuje bufory pojedynczo do pierwszego niepełnego zapisu.
+     * @return ilość faktycznie zapisanych bajtów.
+     */
+    virtual int writeSome(const ConstBufferSequenceType& buffers);
+    /// Nieblokujący odpowiednik writeSome, wykorzystywany przez asynchroniczny zapis.
+    /**
+     * Domyślnie przekierowuje do writeSome.
+     * @return ilość faktycznie zapisanych bajtów, 0 jeżeli zapis zablokowałby wywołanie.
+     */
+    virtual int tryWriteSome(const ConstBufferType& buffer);
+    /// Nieblokujący zapis sekwencji buforów.
+    /**
+     * Domyślnie zapisuje pierwszy niepusty bufor przez tryWriteSome.
+     */
+    virtual int tryWriteSome(const ConstBufferSequenceType& buffers);
     /// Odpowiednik asyncReadSome dla zapisu.
+    /**
+     * Funkcja wraca bez blokowania, zapis nastąpi gdy serwis wykryje gotowość gniazda.
+     */
     virtual void asyncWriteSome(const ConstBufferType& buffer, WriteHandler handler);
+    /// Asynchroniczny zapis sekwencji buforów.
+    /**
+     * Bufory muszą pozostać ważne do wywołania handlera, który otrzymuje łączną liczbę zapisanych bajtów.
+     */
+    virtual void asyncWriteSome(const ConstBufferSequenceType& buffers, WriteHandler handler);
+    /// Kontynuuje nieblokujące nawiązywanie połączenia, wywoływana przez serwis przy gotowości gniazda.
+    /**
+     * Domyślnie połączenie jest nawiązane.
+     */
+    virtual Handshake handshake();
+    /// Zwraca, czy implementacja przechowuje odebrane, nieodczytane dane.
+    /**
+     * Domyślnie wszystkie dane oczekują w gnieździe.
+     */
+    virtual bool buffered() const;
+    /// Sprawdza bez blokowania, czy połączenie jest bezczynne.
+    /**
+     * Bezczynne połączenie nie ma danych do odczytu i nie zostało zamknięte przez drugą stronę,
+     * więc może posłużyć do kolejnego zapytania (np. połączenie trwałe HTTP).
+     */
+    bool idle() const;
 
     /// Bezpośrednio zamyka gniazdo.
     virtual void close() = 0;
     /// Oznacza gniazdo do zamknięcia.
     void shutdown();
+    /// Ustawia czas bezczynności w [ms], po którym gniazdo zostanie zamknięte.
+    void setTimeout(int milliseconds);
+    /// Zwraca serwis, do którego należy gniazdo.
+    StreamServiceInterface& getService() const;
+    /// Ustawia opcję gniazda.
+    void setOption(const Option::Option& option);
 
 protected:
     HandleType handle() const;
@@ -569,37 +977,106 @@ private:
 /// Tworzy połączenie ssl.
 /**
  * Odpowiedzialne za handshake i szyfrowanie/deszyfrowanie.
+ * Połączenie klienta nawiązywane jest domyślnie blokująco w konstruktorze, a połączenie serwera
+ * oraz klienta utworzone z wait == false działa na nieblokującym gnieździe - handshake
+ * kontynuowany jest przez handshake() przy każdej gotowości gniazda.
  */
 class SslConnection : public NonCopyable
 {
 public:
-    SslConnection(SSL* ssl, Tcp::SocketInterface::HandleType handle);
+    SslConnection(SSL* ssl, Tcp::SocketInterface::HandleType handle, bool server = false, bool wait = true);
     /// Powoduje przeniesienie odpowiedzialności za zamknięcie połączenia.
     SslConnection(SslConnection&& other);
     ~SslConnection();
 
+    /// Kontynuuje handshake nieblokującego połączenia.
+    SocketInterface::Handshake handshake();
+    /// Zwraca, czy odebrane dane oczekują w buforach openssl.
+    bool pending() const;
+    /// Zwraca, czy sesja została wznowiona bez pełnego handshake.
+    bool resumed() const;
+
+    /// Odczytuje odszyfrowane dane.
+    /**
+     * @return SocketService::WouldBlock, jeżeli nieblokujące gniazdo nie zawiera pełnego rekordu.
+     */
     int sslRead(Tcp::Buffer& buffer);
-    int sslWrite(const Tcp::ConstBuffer& buffer);
+    /// Zapisuje dane, blokując aż do zapisu części danych.
+    /**
+     * @param block dla false zwraca 0, jeżeli zapis zablokowałby wywołanie.
+     * @throw SendError, jeżeli zapis się nie powiódł.
+     */
+    int sslWrite(const Tcp::ConstBuffer& buffer, bool block = true);
 
     void close();
 
 private:
     bool closed;
+    bool established; //< Handshake został zakończony.
 
     SSL* ssl;
     Tcp::SocketInterface::HandleType handle;
 };
 
 /// Tworzy kontekst Openssl
+/**
+ * Kontekst serwera przechowuje certyfikat, klucz prywatny oraz pamięć sesji, dzięki której
+ * powracający klienci pomijają pełny handshake. Może być współdzielony przez wiele serwisów.
+ * Kontekst klienta przechowuje ostatnią sesję każdego serwera (host:port) i wznawia ją przy
+ * kolejnych połączeniach. Współdzielony przez wątki pozwala każdemu z nich wznawiać sesje
+ * nawiązane przez pozostałe.
+ */
 class SslContext : public NonCopyable
 {
 public:
+    /// Ustawienia wznawiania sesji po stronie serwera.
+    struct SessionCache
+    {
+        SessionCache(std::size_t size = 20480, long timeout = 300, bool tickets = true);
+
+        std::size_t size; //< Maksymalna liczba sesji przechowywanych przez serwer, 0 wyłącza pamięć sesji.
+        long timeout; //< Czas ważności sesji w [s].
+        bool tickets; //< Wznawianie za pomocą biletów sesji, przechowywanych przez klienta.
+    };
+
+    /// Liczniki połączeń serwera lub klienta.
+    struct Statistics
+    {
+        long handshakes; //< Liczba zakończonych handshake.
+        long resumed; //< Liczba wznowionych sesji.
+        long cached; //< Liczba sesji w pamięci serwera lub klienta.
+    };
+
+    /// Tworzy kontekst klienta.
     SslContext();
+    /// Tworzy kontekst serwera z certyfikatem (łańcuchem) i kluczem prywatnym w formacie PEM.
+    /**
+     * @throw SslError w przypadku błędu odczytu plików lub niezgodności klucza z certyfikatem.
+     */
+    SslContext(const std::string& certificateFile, const std::string& keyFile, const SessionCache& cache = SessionCache());
     ~SslContext();
 
-    SslConnection connection(Tcp::SocketInterface::HandleType handle);
+    /// Tworzy połączenie zgodne z rolą kontekstu.
+    /**
+     * Połączenie klienta z podanym hostem wysyła jego nazwę (SNI) i wznawia zapamiętaną sesję serwera host:port.
+     * Dla wait == false handshake klienta nie jest nawiązywany w tym wywołaniu (zob. SslConnection).
+     */
+    SslConnection connection(Tcp::SocketInterface::HandleType handle, const std::string& host = std::string(), const std::string& port = std::string(), bool wait = true);
+    /// Zwraca, czy kontekst przyjmuje połączenia.
+    bool server() const;
+    /// Zwraca liczniki połączeń - stosunek resumed do handshakes określa skuteczność wznawiania sesji.
+    Statistics statistics() const;
 
 private:
+    friend class SslConnection;
+
+    struct ClientSessions;
+
+    /// Zlicza zakończony handshake klienta, wywoływana po nawiązaniu połączenia.
+    static void Established(SSL* ssl);
+    /// Zapamiętuje sesję otrzymaną przez klienta (wywoływana przez openssl, także po handshake TLS 1.3).
+    static int NewSession(SSL* ssl, SSL_SESSION* session);
+
     struct SslContextInit
     {
         SslContextInit();
@@ -608,6 +1085,8 @@ private:
 
     const SSL_METHOD* method;
     SSL_CTX* context;
+    bool isServer;
+    std::unique_ptr<ClientSessions> sessions; //< Pamięć sesji klienta.
 };
 
 /// Pozwala na połączenie z gniazdem i komunikację poprzez ssl.
@@ -617,9 +1096,13 @@ public:
     SslEndpointImplementation(const std::string& address, const std::string& port, SslContext& context);
 
     Socket connect(StreamServiceInterface& service) const override;
+    /// Handshake TLS nawiązywany jest przez serwis, jak po stronie serwera.
+    Socket connectNonBlocking(StreamServiceInterface& service) const override;
 
 private:
     SslContext& sslContext;
+    std::string host; //< Nazwa serwera dla SNI i pamięci sesji.
+    std::string port;
 };
 
 
@@ -638,7 +1121,11 @@ public:
 class StreamServiceInterface
 {
 public:
-    virtual ~StreamServiceInterface() = default;
+    typedef std::function<void()> PostHandler;
+
+    /// Tworzy uchwyt służący do wybudzania serwisu przez post().
+    StreamServiceInterface();
+    virtual ~StreamServiceInterface();
 
     /// Uruchamia serwis.
     /**
@@ -655,19 +1142,76 @@ public:
     virtual void remove(SocketService* service);
     /// Dodaje istniejący serwis akceptora.
     virtual void add(AcceptorService* service);
+    /// Usuwa serwis akceptora.
+    virtual void remove(AcceptorService* service);
     /// Dodaje serwis do obsługi sygnałów.
     /**
      * Obsługiwany jest tylko jeden serwis sygnałów ze względów implementacyjnych.
      */
     virtual void add(SignalService* service);
+    /// Informuje serwis o nowym zadaniu w kolejce gniazda.
+    /**
+     * Wywoływane przez SocketService przy każdym enqueue, domyślnie nic nie robi.
+     */
+    virtual void update(SocketService* service);
+    /// Asynchronicznie wywołuje handler po upływie terminu deadline.
+    /**
+     * Handler wywoływany jest na wątku serwisu w trakcie run().
+     */
+    virtual TimerWheel::TimerId asyncWait(TimerWheel::TimePoint deadline, TimerWheel::Handler handler);
+    /// Anuluje oczekujące wywołanie asyncWait.
+    virtual bool cancel(TimerWheel::TimerId timer);
+    /// Zleca wywołanie handlera na wątku serwisu.
+    /**
+     * Jedyna metoda serwisu, którą można bezpiecznie wywołać z innych wątków.
+     * Wybudza serwis oczekujący na zdarzenia.
+     */
+    virtual void post(PostHandler handler);
+    /// Kończy działanie run() przy najbliższym wybudzeniu.
+    /**
+     * Podobnie jak post() może zostać wywołana z dowolnego wątku.
+     */
+    void stop();
+    /// Usuwa handlery zlecone przez post(), które nie zostały wywołane przed zakończeniem run().
+    /**
+     * Zwalnia przechwycone przez nie obiekty (np. połączenia z gotowymi odpowiedziami), gdy serwis
+     * jest jeszcze kompletny - w destruktorze klasy bazowej ich gniazda nie mogłyby się wyrejestrować.
+     */
+    void discardPosted();
+    /// Ustawia funkcję wywoływaną na wątku serwisu po otrzymaniu sygnału.
+    /**
+     * Zamiast kończyć run(), serwis przekazuje numer sygnału do handlera, który
+     * sam decyduje o zakończeniu (np. po dokończeniu obsługi połączeń).
+     */
+    void setSignalHandler(std::function<void(int)> handler);
 
     /// Zwraca nowy obiekt do tworzenia obiektów klasy spełniających wymagania danego serwisu.
     virtual std::unique_ptr<ServiceFactory> getFactory() = 0;
 
 protected:
+    /// Zwraca uchwyt, który staje się gotowy do odczytu po wywołaniu post() (eventfd na Linuksie).
+    Service::HandleType wakeupHandle() const;
+    /// Opróżnia uchwyt wybudzenia i wywołuje zlecone handlery.
+    void runPosted();
+    /// Wywołuje zlecone handlery, gdy uchwyt wybudzenia został już opróżniony przez serwis.
+    void invokePosted();
+    /// Zwraca, czy run() powinno zakończyć działanie.
+    /**
+     * Otrzymany sygnał przekazywany jest do handlera ustawionego przez setSignalHandler.
+     */
+    bool stopped();
+
     std::set<SocketService*> sockets;
     std::set<AcceptorService*> acceptors;
-    SignalService* signal;
+    SignalService* signal = nullptr;
+    TimerWheel timers;
+
+private:
+    Service::HandleType wakeup[2]; //< Koniec do odczytu i zapisu.
+    std::mutex postMutex;
+    std::vector<PostHandler> posted;
+    std::atomic<bool> stopping;
+    std::function<void(int)> signalHandler;
 };
 
 
@@ -676,12 +1220,13 @@ protected:
 
 /// Implementacja fabryki dla klasy StreamService.
 /**
- * Tworzy obiekty klasy obsługiwanej przez StreamService.
+ * Tworzy obiekty klasy obsługiwanej przez StreamService oraz inne
+ * serwisy oparte na deskryptorach plików (np. EpollStreamService).
  */
 class StreamServiceFactory : public ServiceFactory, public NonCopyable
 {
 public:
-    StreamServiceFactory(StreamService& service);
+    StreamServiceFactory(StreamServiceInterface& service);
 
     /// Zwraca implementację akceptora zgodną z wymaganiami StreamService.
     virtual std::unique_ptr<AcceptorInterface> getImplementation() override;
@@ -689,7 +1234,7 @@ public:
     virtual std::unique_ptr<EndpointInterface> resolve(const std::string & host, const std::string & port) override;
 
 private:
-    StreamService& service;
+    StreamServiceInterface& service;
 };
 
 class SslStreamServiceFactory : public StreamServiceFactory
@@ -717,8 +1262,10 @@ public:
 
     /// Implementuje interfejs StreamServiceInterface.
     int run() override;
+    using StreamServiceInterface::add;
     void add(SocketService* service) override;
     void remove(SocketService* service) override;
+    void remove(AcceptorService* service) override;
 
     /// Zwraca fabrykę do tworzenia obiektów klas obsługiwanych przez serwis.
     std::unique_ptr<ServiceFactory> getFactory() override;
@@ -726,11 +1273,10 @@ public:
 private:
     /// Wybiera możliwe do odczytu gniazda.
     /**
-     * Aktualizuje czas od ostatniego wywołania.
-     * Odpowiedzialna za timeout gniazd.
+     * Blokuje co najwyżej do terminu najbliższego zdarzenia czasowego.
      * @return liczba wybranych gniazd.
      */
-    int select(const std::chrono::high_resolution_clock::time_point& start, int& timeSinceLastUpdate);
+    int select();
 
     struct StreamServicePimpl;
     std::unique_ptr<StreamServicePimpl> pimpl;
@@ -740,11 +1286,98 @@ private:
 class SslStreamService : public StreamService
 {
 public:
+    /// Tworzy serwis z własnym kontekstem klienta.
+    SslStreamService();
+    /// Tworzy serwis korzystający ze współdzielonego kontekstu klienta, np. wspólnej dla wątków pamięci sesji.
+    SslStreamService(std::shared_ptr<SslContext> context);
+
+    std::unique_ptr<ServiceFactory> getFactory() override;
+
+private:
+    std::shared_ptr<SslContext> context;
+};
+
+#if defined(PATR_OS_LINUX)
+/// Serwis reaktywny oparty na epoll.
+/**
+ * W odróżnieniu od StreamService nie jest ograniczony przez FD_SETSIZE,
+ * a każde wybudzenie obsługuje wyłącznie gotowe deskryptory.
+ * Gniazda rejestrowane są w trybie edge-triggered z zainteresowaniem
+ * odczytem i zapisem, akceptory w trybie level-triggered.
+ */
+class EpollStreamService : public StreamServiceInterface
+{
+public:
+    /// Tworzy nowy obiekt serwisu.
+    EpollStreamService();
+    ~EpollStreamService();
+
+    /// Implementuje interfejs StreamServiceInterface.
+    int run() override;
+    using StreamServiceInterface::add;
+    void add(SocketService* service) override;
+    void remove(SocketService* service) override;
+    void add(AcceptorService* service) override;
+    void remove(AcceptorService* service) override;
+    void update(SocketService* service) override;
+
+    /// Zwraca fabrykę do tworzenia obiektów klas obsługiwanych przez serwis.
+    std::unique_ptr<ServiceFactory> getFactory() override;
+
+private:
+    struct EpollStreamServicePimpl;
+    std::unique_ptr<EpollStreamServicePimpl> pimpl;
+};
+
+/// Serwis reaktywny oparty na io_uring.
+/**
+ * Zamiast powiadomień o gotowości serwis zleca jądru same operacje i odbiera ich wyniki:
+ * akceptory utworzone przez fabrykę serwisu przyjmują połączenia wielokrotnym accept,
+ * a przyjęte gniazda odbierają dane wielokrotnym recv do buforów z pierścienia
+ * współdzielonego z jądrem. Zapis odbywa się przez send z kopii danych, a zamknięcie gniazda
+ * łączone jest z niewysłanym jeszcze zapisem. Zlecenia z całej iteracji przekazywane
+ * są jednym wywołaniem io_uring_enter, które jednocześnie oczekuje na wyniki.
+ * Pozostałe gniazda (np. TLS lub połączenia klienta) obsługiwane są jednorazowym poll.
+ * Wymaga jądra 5.19 lub nowszego - dostępność należy sprawdzić przez Supported().
+ */
+class UringStreamService : public StreamServiceInterface
+{
+public:
+    /// Tworzy nowy obiekt serwisu.
+    /**
+     * Rzuca ServiceError, jeżeli jądro nie obsługuje wymaganych operacji io_uring.
+     */
+    UringStreamService();
+    ~UringStreamService();
+
+    /// Implementuje interfejs StreamServiceInterface.
+    int run() override;
+    void add(SocketService* service) override;
+    void remove(SocketService* service) override;
+    void add(AcceptorService* service) override;
+    void remove(AcceptorService* service) override;
+    using StreamServiceInterface::add;
+    void update(SocketService* service) override;
+
+    /// Zwraca fabrykę tworzącą akceptory, których gniazda korzystają bezpośrednio z io_uring.
     std::unique_ptr<ServiceFactory> getFactory() override;
+    /// Zwraca liczbę zapisów blokujących zleconych bez oczekiwania na wynik, które nie wysłały wszystkich danych.
+    /**
+     * Taki zapis kończy odczyt gniazda błędem. Wywołanie z wątku run() lub po jego zakończeniu.
+     */
+    std::size_t failedWrites() const;
+
+    /// Sprawdza, czy jądro obsługuje operacje wymagane przez serwis.
+    static bool Supported();
 
 private:
-    SslContext context;
+    struct UringStreamServicePimpl;
+    class NativeFactory;
+    class NativeAcceptor;
+    class NativeSocket;
+    std::unique_ptr<UringStreamServicePimpl> pimpl;
 };
+#endif // defined(PATR_OS_LINUX)
 
 
 /// Frontend użytkownika dla klasy nasłuchującej nowych połączeń.
@@ -770,6 +1403,9 @@ public:
 
     Socket accept();
     void asyncAccept(Handler handler);
+    void assign(AcceptorInterface::HandleType handle);
+    void close();
+    AcceptorInterface::HandleType getHandle() const;
 
 private:
     std::unique_ptr<AcceptorInterface> implementation;
@@ -787,6 +1423,9 @@ public:
     typedef SocketInterface::WriteHandler WriteHandler;
     typedef SocketInterface::BufferType BufferType;
     typedef SocketInterface::ConstBufferType ConstBufferType;
+    typedef SocketInterface::BufferSequenceType BufferSequenceType;
+    typedef SocketInterface::ConstBufferSequenceType ConstBufferSequenceType;
+    typedef SocketInterface::BufferSource BufferSource;
     typedef SocketInterface::HandleType HandleType;
 
     //Socket(StreamService& service, HandleType handle);
@@ -796,13 +1435,21 @@ public:
     /// Przekierowuje wywołanie do implementacji.
     int read(BufferType& buffer);
     int readSome(BufferType& buffer);
+    int readSome(const BufferSequenceType& buffers);
     void asyncReadSome(BufferType buffer, ReadHandler handler);
+    void asyncReadSome(BufferSource source, ReadHandler handler);
     int write(const ConstBufferType& buffer);
     int writeSome(const ConstBufferType& buffer);
+    int writeSome(const ConstBufferSequenceType& buffers);
     void asyncWriteSome(const ConstBufferType& buffer, WriteHandler handler);
+    void asyncWriteSome(const ConstBufferSequenceType& buffers, WriteHandler handler);
 
     void close();
     void shutdown();
+    void setTimeout(int milliseconds);
+    StreamServiceInterface& getService() const;
+    void setOption(const Option::Option& option);
+    bool idle() const;
 
 private:
     std::unique_ptr<SocketInterface> implementation;
@@ -850,10 +1497,16 @@ private:
 
 
 /// Klasa zawierająca szczegóły implementacyjne na akceptora.
+/**
+ * Gniazdo nasłuchujące przełączane jest w tryb nieblokujący, co pozwala przyjmować kolejne
+ * połączenia do wyczerpania kolejki. Przyjęte gniazda są nieblokujące i zamykane przy exec.
+ */
 class AcceptorImplementation : public AcceptorInterface
 {
 public:
     AcceptorImplementation(StreamServiceInterface& service);
+    /// Zamyka gniazdo nasłuchujące.
+    ~AcceptorImplementation();
 
     /// Implementuje zgodnie z AcceptorInterface.
     void open(Endpoint::ProtocolType protocol) override;
@@ -862,12 +1515,41 @@ public:
     void listen(int backlog) override;
 
     Socket accept() override;
+    Socket acceptPending() override;
+    void assign(HandleType handle) override;
+    void close() override;
+
+protected:
+    /// Przyjmuje połączenie i zwraca jego uchwyt.
+    /**
+     * @param wait czy oczekiwać na połączenie, gdy kolejka jest pusta.
+     */
+    virtual HandleType acceptHandle(bool wait);
+    /// Tworzy gniazdo dla przyjętego uchwytu.
+    virtual Socket makeSocket(HandleType handle);
 
-private:
     StreamServiceInterface& streamService;
 };
 
 
+/// Akceptor przyjmujący połączenia TLS.
+/**
+ * Handshake nie jest prowadzony w accept() - odbywa się nieblokująco w serwisie, przy gotowości gniazda.
+ */
+class SslAcceptorImplementation : public AcceptorImplementation
+{
+public:
+    /// Tworzy akceptor wykorzystujący kontekst serwera.
+    SslAcceptorImplementation(StreamServiceInterface& service, SslContext& context);
+
+protected:
+    Socket makeSocket(HandleType handle) override;
+
+private:
+    SslContext& context;
+};
+
+
 
 /// Klasa zawierająca szczegóły implementacyjne gniazda TCP.
 class SocketImplementation : public SocketInterface, public NonCopyable
@@ -886,30 +1568,58 @@ public:
     /// Implementuje zgodnie z SocketInterface.
     int read(BufferType& buffer) override;
     int readSome(BufferType& buffer) override;
+    int readSome(const BufferSequenceType& buffers) override;
     int write(const ConstBufferType& buffer) override;
     int writeSome(const ConstBufferType& buffer) override;
+    int writeSome(const ConstBufferSequenceType& buffers) override;
+    int tryWriteSome(const ConstBufferType& buffer) override;
+    int tryWriteSome(const ConstBufferSequenceType& buffers) override;
 
     /// Zamyka gniazdo.
     void close() override;
 
-private:
+protected:
     bool closed;
 };
 
 
 /// Tworzy implementację gniazda korzystającą z funkcji openssl.
+/**
+ * Dla kontekstu serwera gniazdo jest nieblokujące, a handshake prowadzony jest przez serwis.
+ */
 class SslSocketImplementation : public SocketImplementation
 {
 public:
-    SslSocketImplementation(StreamServiceInterface& service, HandleType handle, SslContext& ssl);
+    /// Tworzy gniazdo zgodne z rolą kontekstu, host i port identyfikują serwer dla połączenia klienta.
+    /**
+     * Gniazdo klienta z wait == false jest nieblokujące, jak gniazdo serwera.
+     */
+    SslSocketImplementation(StreamServiceInterface& service, HandleType handle, SslContext& ssl,
+                            const std::string& host = std::string(), const std::string& port = std::string(), bool wait = true);
 
     int readSome(BufferType& buffer) override;
+    /// Odczytuje do pierwszego niepustego bufora.
+    int readSome(const BufferSequenceType& buffers) override;
     int writeSome(const ConstBufferType& buffer) override;
+    /// Łączy małe bufory w jeden rekord TLS.
+    int writeSome(const ConstBufferSequenceType& buffers) override;
+    /// Zapis ssl blokującego klienta pozostaje blokujący.
+    int tryWriteSome(const ConstBufferType& buffer) override;
+    int tryWriteSome(const ConstBufferSequenceType& buffers) override;
+    Handshake handshake() override;
+    bool buffered() const override;
+
+    /// Zwraca, czy sesja została wznowiona bez pełnego handshake.
+    bool resumed() const;
 
     void close() override;
 
 private:
+    /// Zapisuje sekwencję, scalając małe bufory.
+    int writeRecord(const ConstBufferSequenceType& buffers, bool block);
+
     SslConnection connection;
+    bool nonBlocking;
 };
 
 } // namespace Tcp
@@ -0,0 +1,119 @@
+#include "Socket.h"
+
+#include <algorithm>
+#include <cassert>
+
+Tcp::TimerWheel::TimerWheel(int resolution, std::size_t slots) :
+    origin(Clock::now()),
+    resolution(resolution),
+    current(0),
+    nearest(0),
+    lastId(0),
+    slots(slots)
+{
+    assert(resolution > 0 && slots > 0);
+}
+
+Tcp::TimerWheel::TimerId Tcp::TimerWheel::arm(TimePoint deadline, Handler handler)
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - origin);
+    auto count = elapsed.count() > 0 ? static_cast<std::uint64_t>(elapsed.count()) : 0;
+    auto tick = (count + resolution.count() - 1) / resolution.count(); // zaokrąglenie w górę - zdarzenie nie może nastąpić przed terminem.
+    tick = (std::max)(tick, current + 1);
+
+    auto index = static_cast<std::size_t>(tick % slots.size());
+    auto& slot = slots[index];
+    slot.push_back(Entry{ ++lastId, tick, std::move(handler) });
+
+    if (timers.empty() || tick < nearest)
+        nearest = tick;
+    timers[lastId] = std::make_pair(index, --slot.end());
+
+    return lastId;
+}
+
+bool Tcp::TimerWheel::cancel(TimerId timer)
+{
+    auto found = timers.find(timer);
+    if (found == timers.end())
+        return false;
+
+    slots[found->second.first].erase(found->second.second);
+    timers.erase(found);
+    return true; // nearest pozostaje poprawnym dolnym ograniczeniem.
+}
+
+std::size_t Tcp::TimerWheel::expire(TimePoint now)
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - origin).count();
+    auto target = elapsed > 0 ? static_cast<std::uint64_t>(elapsed) / resolution.count() : 0;
+    if (target <= current)
+        return 0;
+
+    if (timers.empty() || target < nearest)
+    {
+        current = target;
+        return 0;
+    }
+
+    std::vector<Handler> due;
+    auto steps = (std::min)(target - current, static_cast<std::uint64_t>(slots.size())); // każdą przegródkę wystarczy odwiedzić raz.
+    for (std::uint64_t step = 1; step <= steps; ++step)
+    {
+        auto& slot = slots[static_cast<std::size_t>((current + step) % slots.size())];
+        for (auto entry = slot.begin(); entry != slot.end();)
+        {
+            if (entry->tick <= target)
+            {
+                due.push_back(std::move(entry->handler));
+                timers.erase(entry->id);
+                entry = slot.erase(entry);
+            }
+            else
+            {
+                ++entry;
+            }
+        }
+    }
+
+    current = target;
+    findNearest();
+
+    for (auto& handler : due) // handlery mogą modyfikować koło.
+        handler();
+
+    return due.size();
+}
+
+int Tcp::TimerWheel::timeout(TimePoint now) const
+{
+    if (timers.empty())
+        return -1;
+
+    auto deadline = origin + resolution * nearest;
+    if (deadline <= now)
+        return 0;
+
+    auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(deadline - now).count();
+    return static_cast<int>((remaining + 999) / 1000); // zaokrąglenie w górę do pełnej milisekundy.
+}
+
+std::size_t Tcp::TimerWheel::size() const
+{
+    return timers.size();
+}
+
+void Tcp::TimerWheel::findNearest()
+{
+    if (timers.empty())
+        return;
+
+    for (std::uint64_t tick = current + 1; tick <= current + slots.size(); ++tick)
+    {
+        if (!slots[static_cast<std::size_t>(tick % slots.size())].empty())
+        {
+            nearest = tick; // zdarzenia z przegródki mogą należeć do dalszych obrotów.
+            return;
+        }
+    }
+}
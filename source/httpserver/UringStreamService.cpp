@@ -0,0 +1,1291 @@
+#include "Socket.h"
+#include "Predef.h"
+
+#if defined(PATR_OS_LINUX)
+
+#if defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#        include <linux/io_uring.h>
+#    endif
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) // nagłówki jądra 6.0, obejmują również pierścienie buforów z 5.19.
+
+#include <array>
+#include <deque>
+#include <thread>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <unordered_map>
+
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+namespace {
+    /// Liczba wpisów kolejki zgłoszeń, kolejka zakończeń jest czterokrotnie większa.
+    constexpr unsigned Entries = 256;
+    /// Liczba buforów w pierścieniu odbiorczym (potęga dwójki).
+    constexpr unsigned BufferCount = 512;
+    /// Rozmiar pojedynczego bufora odbiorczego.
+    constexpr unsigned BufferLength = 4096;
+    /// Identyfikator grupy buforów odbiorczych.
+    constexpr unsigned short BufferGroup = 0;
+    /// Maksymalna liczba buforów pierścienia zajętych przez nieodczytane dane jednego gniazda.
+    constexpr std::size_t ChunkLimit = 16;
+    /// Maksymalna liczba bajtów kopiowanych przez pojedynczy zapis bez blokowania.
+    constexpr std::size_t SendLength = 64 * 1024;
+
+    /// Rodzaj operacji zakodowany w najmłodszych bitach user_data.
+    /**
+     * Pozostałe bity zawierają wskaźnik rejestracji (lub wiadomości), wyrównany co najmniej do 8 bajtów.
+     */
+    enum Operation : std::uint64_t
+    {
+        Ignored = 0, //< Wynik nie jest potrzebny (close, anulowanie).
+        Receive,
+        Send,
+        PollIn,
+        PollOut,
+        Accept,
+        Wakeup,
+        Message
+    };
+    constexpr std::uint64_t OperationMask = 7;
+
+    int Setup(unsigned entries, io_uring_params& params)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+    }
+
+    int Enter(int ring, unsigned submit, unsigned wait, unsigned flags, void* argument, std::size_t size)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, ring, submit, wait, flags, argument, size));
+    }
+
+    int Register(int ring, unsigned opcode, void* argument, unsigned count)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_register, ring, opcode, argument, count));
+    }
+
+    void* Map(std::size_t size, int ring, off_t offset)
+    {
+        auto memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, offset);
+        if (memory == MAP_FAILED)
+            throw Tcp::PlatformError("io_uring mmap failed (" + std::to_string(errno) + ')');
+        return memory;
+    }
+
+    /// Kolejki zgłoszeń i zakończeń io_uring odwzorowane w pamięci procesu.
+    /**
+     * Korzysta bezpośrednio z wywołań systemowych, bez liburing.
+     */
+    class Ring
+    {
+    public:
+        explicit Ring(unsigned entries);
+        ~Ring();
+        Ring(const Ring&) = delete;
+        Ring& operator=(const Ring&) = delete;
+
+        /// Zwraca wyzerowany wpis kolejki zgłoszeń, przekazując jądru pełną kolejkę.
+        io_uring_sqe* next();
+        /// Przekazuje zgłoszenia i oczekuje na co najmniej wait zakończeń.
+        /**
+         * @param timeout maksymalny czas oczekiwania w [ms], -1 oznacza brak ograniczenia.
+         */
+        void enter(unsigned wait, int timeout);
+        /// Wywołuje complete dla każdego dostępnego zakończenia.
+        template<typename Function>
+        void reap(Function complete);
+        /// Zwraca, czy wpis nie został jeszcze przekazany jądru.
+        bool unsubmitted(const io_uring_sqe* sqe) const;
+
+        int handle() const { return ring; }
+        unsigned features() const { return params.features; }
+
+    private:
+        void release();
+
+        int ring;
+        io_uring_params params;
+        void* sqMemory;
+        void* cqMemory;
+        std::size_t sqSize;
+        std::size_t cqSize;
+        io_uring_sqe* sqes;
+        unsigned* sqHead;
+        unsigned* sqTail;
+        unsigned sqMask;
+        unsigned* cqHead;
+        unsigned* cqTail;
+        unsigned cqMask;
+        io_uring_cqe* cqes;
+        unsigned tail; //< Koniec kolejki zgłoszeń po stronie procesu.
+        unsigned published; //< Koniec kolejki widoczny dla jądra.
+    };
+
+    Ring::Ring(unsigned entries) : ring(-1), params(), sqMemory(MAP_FAILED), cqMemory(MAP_FAILED), sqes(nullptr), tail(0), published(0)
+    {
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+#if defined(IORING_SETUP_COOP_TASKRUN)
+        params.flags |= IORING_SETUP_COOP_TASKRUN; // zakończenia odbierane są wyłącznie w io_uring_enter.
+        ring = Setup(entries, params);
+        if (ring == -1 && errno == EINVAL)
+        {
+            params = io_uring_params();
+            params.flags = IORING_SETUP_CQSIZE;
+            params.cq_entries = entries * 4;
+        }
+#endif // defined(IORING_SETUP_COOP_TASKRUN)
+        if (ring == -1)
+            ring = Setup(entries, params);
+        if (ring == -1)
+            throw Tcp::PlatformError("io_uring_setup failed (" + std::to_string(errno) + ')');
+
+        sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        try
+        {
+            if (params.features & IORING_FEAT_SINGLE_MMAP)
+            {
+                sqSize = cqSize = std::max(sqSize, cqSize);
+                sqMemory = cqMemory = Map(sqSize, ring, IORING_OFF_SQ_RING);
+            }
+            else
+            {
+                sqMemory = Map(sqSize, ring, IORING_OFF_SQ_RING);
+                cqMemory = Map(cqSize, ring, IORING_OFF_CQ_RING);
+            }
+            sqes = static_cast<io_uring_sqe*>(Map(params.sq_entries * sizeof(io_uring_sqe), ring, IORING_OFF_SQES));
+        }
+        catch (...)
+        {
+            release();
+            throw;
+        }
+
+        auto sq = static_cast<char*>(sqMemory);
+        auto cq = static_cast<char*>(cqMemory);
+        sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        auto array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        for (unsigned i = 0; i < params.sq_entries; ++i)
+            array[i] = i; // wpisy przekazywane są w kolejności, więc tablica indeksów jest stała.
+        tail = published = *sqTail;
+    }
+
+    Ring::~Ring()
+    {
+        if (tail != published)
+        {
+            __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+            Enter(ring, tail - published, 0, 0, nullptr, 0); // np. zamknięcia gniazd z ostatniej iteracji.
+        }
+        release();
+    }
+
+    void Ring::release()
+    {
+        if (sqes)
+            ::munmap(sqes, params.sq_entries * sizeof(io_uring_sqe));
+        if (cqMemory != MAP_FAILED && cqMemory != sqMemory)
+            ::munmap(cqMemory, cqSize);
+        if (sqMemory != MAP_FAILED)
+            ::munmap(sqMemory, sqSize);
+        ::close(ring);
+    }
+
+    io_uring_sqe* Ring::next()
+    {
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= params.sq_entries)
+            enter(0, 0);
+        if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= params.sq_entries)
+            throw Tcp::ServiceError("io_uring submission queue is full");
+
+        auto sqe = &sqes[tail & sqMask];
+        std::memset(sqe, 0, sizeof *sqe);
+        ++tail;
+        return sqe;
+    }
+
+    void Ring::enter(unsigned wait, int timeout)
+    {
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        published = tail;
+        auto submit = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE); // również wpisy nieprzyjęte przez przerwane wywołanie.
+
+        int result;
+        if (wait)
+        {
+            __kernel_timespec timespec = { timeout / 1000, (timeout % 1000) * 1000000LL };
+            io_uring_getevents_arg argument = io_uring_getevents_arg();
+            if (timeout >= 0)
+                argument.ts = reinterpret_cast<std::uint64_t>(&timespec);
+            result = Enter(ring, submit, wait, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &argument, sizeof argument);
+        }
+        else if (submit)
+        {
+            result = Enter(ring, submit, 0, 0, nullptr, 0);
+        }
+        else
+        {
+            return;
+        }
+
+        if (result == -1 && errno != EINTR && errno != ETIME && errno != EAGAIN && errno != EBUSY)
+            throw Tcp::ServiceError("io_uring_enter failed (" + std::to_string(errno) + ')');
+    }
+
+    template<typename Function>
+    void Ring::reap(Function complete)
+    {
+        auto head = *cqHead;
+        for (;;)
+        {
+            auto end = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+            if (head == end)
+                break;
+            for (; head != end; ++head)
+            {
+                auto cqe = cqes[head & cqMask]; // kopia - wpis wraca do jądra przed wywołaniem complete.
+                __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+                complete(cqe);
+            }
+        }
+    }
+
+    bool Ring::unsubmitted(const io_uring_sqe* sqe) const
+    {
+        auto index = static_cast<unsigned>(sqe - sqes);
+        return ((index - published) & sqMask) < tail - published;
+    }
+
+    /// Pierścień buforów, z których jądro wybiera bufor dla odebranych danych.
+    class BufferRing
+    {
+    public:
+        BufferRing(int ring, unsigned count, unsigned length, unsigned short group);
+        ~BufferRing();
+        BufferRing(const BufferRing&) = delete;
+        BufferRing& operator=(const BufferRing&) = delete;
+
+        const char* data(unsigned short id) const { return storage.data() + std::size_t(id) * length; }
+        /// Zwraca bufor do pierścienia.
+        void recycle(unsigned short id);
+
+    private:
+        io_uring_buf* buffers;
+        std::size_t size;
+        std::vector<char> storage;
+        unsigned count;
+        unsigned length;
+        unsigned short tail;
+    };
+
+    BufferRing::BufferRing(int ring, unsigned count, unsigned length, unsigned short group) :
+        size(count * sizeof(io_uring_buf)),
+        storage(std::size_t(count) * length),
+        count(count),
+        length(length),
+        tail(0)
+    {
+        auto memory = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            throw Tcp::PlatformError("mmap failed (" + std::to_string(errno) + ')');
+        buffers = static_cast<io_uring_buf*>(memory);
+
+        auto registration = io_uring_buf_reg();
+        registration.ring_addr = reinterpret_cast<std::uint64_t>(memory);
+        registration.ring_entries = count;
+        registration.bgid = group;
+        if (Register(ring, IORING_REGISTER_PBUF_RING, &registration, 1) == -1)
+        {
+            auto error = errno;
+            ::munmap(memory, size);
+            throw Tcp::PlatformError("io_uring buffer ring registration failed (" + std::to_string(error) + ')');
+        }
+
+        for (unsigned i = 0; i < count; ++i)
+            recycle(static_cast<unsigned short>(i));
+    }
+
+    BufferRing::~BufferRing()
+    {
+        ::munmap(buffers, size);
+    }
+
+    void BufferRing::recycle(unsigned short id)
+    {
+        auto& buffer = buffers[tail & (count - 1)];
+        buffer.addr = reinterpret_cast<std::uint64_t>(data(id));
+        buffer.len = length;
+        buffer.bid = id;
+        ++tail;
+        __atomic_store_n(&buffers[0].resv, tail, __ATOMIC_RELEASE); // koniec pierścienia zajmuje pole resv pierwszego wpisu.
+    }
+}
+
+struct Tcp::UringStreamService::UringStreamServicePimpl
+{
+    /// Odebrane dane w buforze z pierścienia.
+    struct Chunk
+    {
+        unsigned short buffer;
+        int offset; //< Liczba bajtów już odczytanych przez gniazdo.
+        int size;
+    };
+
+    /// Stan gniazda lub akceptora, wskazywany przez user_data jego operacji.
+    struct alignas(8) Registration
+    {
+        SocketService* socket;
+        AcceptorService* acceptor;
+        int handle;
+        bool native; //< Gniazdo odbiera i wysyła dane przez io_uring, a nie tylko oczekuje gotowości.
+        bool queued; //< Rejestracja oczekuje w pending.
+        bool receiving;
+        bool stopping; //< Zlecono anulowanie odbioru, na którego zakończenie nikt nie oczekuje.
+        bool sending;
+        bool accepting;
+        bool pollingIn;
+        bool pollingOut;
+        bool readable;
+        bool writable;
+        bool starved; //< Odbiór przerwany z braku buforów w pierścieniu.
+        bool eof;
+        bool sent; //< Wynik zapisu oczekuje na odebranie przez writeReady.
+        int error;
+        int result;
+        int inflight; //< Operacje, których zakończenie nie zostało jeszcze odebrane.
+        std::deque<Chunk> chunks;
+        std::deque<int> accepted;
+        std::string outgoing; //< Kopia danych zapisu - bufory wywołującego mogą zostać zwolnione przed jego zakończeniem.
+    };
+    typedef std::unique_ptr<Registration> RegistrationPtr;
+
+    /// Dane wysyłane bez oczekiwania na wynik, przechowywane do zakończenia operacji.
+    struct alignas(8) OwnedMessage
+    {
+        Registration* registration; //< Utrzymywana przez inflight do odebrania wyniku.
+        std::string data;
+    };
+
+    UringStreamServicePimpl(UringStreamService& owner);
+    ~UringStreamServicePimpl();
+
+    Registration* create(SocketService* socket, AcceptorService* acceptor, int handle);
+    /// Rejestruje akceptor - gniazda nasłuchujące fabryki przyjmują połączenia wielokrotnym accept.
+    void attach(AcceptorService* acceptor);
+    /// Wstawia rejestrację do obsłużenia w bieżącej iteracji.
+    void queue(Registration* registration);
+    /// Wywołuje oczekujące zadania, dla których dostępne są wyniki operacji.
+    void dispatch(Registration* registration);
+    /// Zleca operacje potrzebne do dalszej obsługi rejestracji.
+    void arm(Registration* registration);
+    void armWakeup();
+    /// Anuluje operacje rejestracji, która zostanie zwolniona po odebraniu ich zakończeń.
+    void retire(RegistrationPtr registration);
+    void cancel(Registration* registration, Operation operation);
+    void complete(const io_uring_cqe& cqe);
+    void recycle(unsigned short buffer);
+    io_uring_sqe* submit(Registration* registration, Operation operation, unsigned char opcode, int handle);
+
+    /// Czy wywołanie następuje na wątku run(), jedynym korzystającym z kolejek.
+    bool serviceThread() const;
+    Registration* find(int handle) const;
+
+    /// Operacje gniazd i akceptorów utworzonych przez fabrykę serwisu.
+    void adopt(int handle);
+    int receive(int handle, SocketService::BufferType& buffer);
+    int trySend(int handle, const SocketService::ConstBufferSequenceType& buffers);
+    int send(int handle, const SocketService::ConstBufferSequenceType& buffers);
+    bool buffered(int handle) const;
+    bool close(int handle);
+    bool takeAccepted(int listener, int& handle);
+
+    UringStreamService& owner;
+    Ring ring;
+    BufferRing buffers;
+    bool multishotReceive; //< Jądra starsze niż 6.0 odbierają jednym recv na zlecenie.
+    bool wakeupArmed;
+    std::atomic<bool> running;
+    std::atomic<std::thread::id> thread;
+    std::array<char, 64> drain;
+    std::unordered_map<SocketService*, RegistrationPtr> registrations;
+    std::unordered_map<int, Registration*> handles;
+    std::vector<RegistrationPtr> acceptors;
+    /// Gniazda nasłuchujące akceptorów fabryki, obsługiwane wielokrotnym accept.
+    std::vector<int> listeners;
+    /// Rejestracje usunięte z serwisu, zwalniane po zakończeniu wszystkich ich operacji.
+    std::vector<RegistrationPtr> retired;
+    std::vector<Registration*> pending;
+    std::vector<Registration*> starved;
+    /// Zapisy bez oczekiwania na wynik, które nie wysłały wszystkich danych.
+    std::size_t failedWrites;
+    /// Ostatni niewysłany zapis, z którym można połączyć zamknięcie gniazda.
+    io_uring_sqe* lastSend;
+    int lastSendHandle;
+};
+
+/// Gniazdo przyjęte przez akceptor serwisu - dane odbierane są do buforów z pierścienia.
+/**
+ * Blokujący read() nie jest obsługiwany - dane trafiają do gniazda wyłącznie w trakcie run().
+ */
+class Tcp::UringStreamService::NativeSocket : public SocketImplementation
+{
+public:
+    NativeSocket(UringStreamService& service, HandleType handle) : SocketImplementation(service, handle), owner(*service.pimpl)
+    {
+        owner.adopt(handle);
+    }
+
+    ~NativeSocket()
+    {
+        close();
+    }
+
+    int readSome(BufferType& buffer) override
+    {
+        return owner.receive(handle(), buffer);
+    }
+
+    int readSome(const BufferSequenceType& buffers) override
+    {
+        int total = 0;
+        for (auto buffer : buffers)
+        {
+            if (buffer.second <= 0)
+                continue;
+            auto result = owner.receive(handle(), buffer);
+            if (result <= 0)
+                return total ? total : result;
+            total += result;
+            if (result < buffer.second)
+                break;
+        }
+        return total;
+    }
+
+    /// Zapis synchroniczny zlecany jest bez oczekiwania na wynik, dzięki czemu może zostać połączony z zamknięciem.
+    int writeSome(const ConstBufferType& buffer) override
+    {
+        return writeSome(ConstBufferSequenceType(1, buffer));
+    }
+
+    int writeSome(const ConstBufferSequenceType& buffers) override
+    {
+        auto result = owner.send(handle(), buffers);
+        return result >= 0 ? result : SocketImplementation::writeSome(buffers);
+    }
+
+    int tryWriteSome(const ConstBufferType& buffer) override
+    {
+        return tryWriteSome(ConstBufferSequenceType(1, buffer));
+    }
+
+    /// Zleca send i zwraca 0 - wynik przekazywany jest przy kolejnym wywołaniu, po zakończeniu operacji.
+    int tryWriteSome(const ConstBufferSequenceType& buffers) override
+    {
+        return owner.trySend(handle(), buffers);
+    }
+
+    bool buffered() const override
+    {
+        return owner.buffered(handle());
+    }
+
+    void close() override
+    {
+        if (!closed && !owner.close(handle()))
+            ::close(handle());
+        closed = true;
+    }
+
+private:
+    UringStreamServicePimpl& owner;
+};
+
+/// Akceptor, którego połączenia przyjmowane są wielokrotnym accept w trakcie run().
+class Tcp::UringStreamService::NativeAcceptor : public AcceptorImplementation
+{
+public:
+    NativeAcceptor(UringStreamService& service) : AcceptorImplementation(service), service(service)
+    {
+    }
+
+    ~NativeAcceptor()
+    {
+        close();
+    }
+
+    void listen(int backlog) override
+    {
+        AcceptorImplementation::listen(backlog);
+        auto& listeners = service.pimpl->listeners;
+        if (std::find(listeners.begin(), listeners.end(), getHandle()) == listeners.end())
+            listeners.push_back(getHandle());
+    }
+
+    void close() override
+    {
+        auto& listeners = service.pimpl->listeners;
+        listeners.erase(std::remove(listeners.begin(), listeners.end(), getHandle()), listeners.end());
+        AcceptorImplementation::close();
+    }
+
+protected:
+    HandleType acceptHandle(bool wait) override
+    {
+        int handle;
+        if (!wait && service.pimpl->takeAccepted(getHandle(), handle))
+        {
+            if (handle == -1)
+                throw AcceptRetryError("no accepted connection is queued");
+            return handle;
+        }
+        return AcceptorImplementation::acceptHandle(wait);
+    }
+
+    Socket makeSocket(HandleType handle) override
+    {
+        return Socket(std::unique_ptr<SocketImplementation>(new NativeSocket(service, handle)));
+    }
+
+private:
+    UringStreamService& service;
+};
+
+class Tcp::UringStreamService::NativeFactory : public StreamServiceFactory
+{
+public:
+    NativeFactory(UringStreamService& service) : StreamServiceFactory(service), service(service)
+    {
+    }
+
+    std::unique_ptr<AcceptorInterface> getImplementation() override
+    {
+        return std::unique_ptr<AcceptorInterface>(new NativeAcceptor(service));
+    }
+
+private:
+    UringStreamService& service;
+};
+
+Tcp::UringStreamService::UringStreamServicePimpl::UringStreamServicePimpl(UringStreamService& owner) :
+    owner(owner),
+    ring(Entries),
+    buffers(ring.handle(), BufferCount, BufferLength, BufferGroup),
+    multishotReceive(true),
+    wakeupArmed(false),
+    running(false),
+    thread(std::thread::id()),
+    failedWrites(0),
+    lastSend(nullptr),
+    lastSendHandle(-1)
+{
+}
+
+Tcp::UringStreamService::UringStreamServicePimpl::~UringStreamServicePimpl()
+{
+    for (auto& acceptor : acceptors)
+        for (auto handle : acceptor->accepted)
+            ::close(handle);
+}
+
+Tcp::UringStreamService::UringStreamServicePimpl::Registration* Tcp::UringStreamService::UringStreamServicePimpl::create(SocketService* socket, AcceptorService* acceptor, int handle)
+{
+    auto registration = new Registration();
+    registration->socket = socket;
+    registration->acceptor = acceptor;
+    registration->handle = handle;
+    registration->writable = true; // gniazdo bez rejestracji w jądrze zapisuje optymistycznie.
+    return registration;
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::attach(AcceptorService* acceptor)
+{
+    auto registered = std::any_of(acceptors.begin(), acceptors.end(), [acceptor](const RegistrationPtr& registration) {
+        return registration->acceptor == acceptor;
+    });
+    if (registered)
+        return;
+
+    auto handle = acceptor->getHandle();
+    auto registration = create(nullptr, acceptor, handle);
+    registration->native = std::find(listeners.begin(), listeners.end(), handle) != listeners.end();
+    acceptors.emplace_back(registration);
+    queue(registration);
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::queue(Registration* registration)
+{
+    if (registration->queued)
+        return;
+    registration->queued = true;
+    pending.push_back(registration);
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::dispatch(Registration* registration)
+{
+    if (registration->acceptor)
+    {
+        if (registration->native)
+        {
+            // acceptReady przyjmuje co najwyżej AcceptBatch połączeń - kontynuuj, dopóki handlery je przyjmują.
+            while (registration->acceptor && !registration->accepted.empty())
+            {
+                auto before = registration->accepted.size();
+                registration->acceptor->acceptReady();
+                if (registration->accepted.size() == before)
+                    break;
+            }
+        }
+        else if (registration->readable)
+        {
+            registration->readable = false;
+            registration->acceptor->acceptReady();
+        }
+        return;
+    }
+
+    auto socket = registration->socket;
+    if (registration->native)
+    {
+        while (registration->socket && socket->pendingRead() && (!registration->chunks.empty() || registration->eof || registration->error))
+            socket->readReady();
+        while (registration->socket && socket->pendingWrite() && !registration->sending)
+            socket->writeReady();
+        return;
+    }
+
+    while (registration->socket && socket->pendingRead() && (registration->readable || socket->buffered()))
+    {
+        registration->readable = false; // poll jednorazowy - kolejny odczyt po ponownej gotowości.
+        if (socket->readReady() == SocketService::WouldBlock)
+            break;
+    }
+    while (registration->socket && registration->writable && socket->pendingWrite())
+    {
+        if (socket->writeReady() <= 0)
+            registration->writable = false;
+    }
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::arm(Registration* registration)
+{
+    if (registration->acceptor)
+    {
+        if (registration->native && !registration->accepting)
+        {
+            auto sqe = submit(registration, Accept, IORING_OP_ACCEPT, registration->handle);
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+            registration->accepting = true;
+        }
+        else if (!registration->native && !registration->pollingIn)
+        {
+            auto sqe = submit(registration, PollIn, IORING_OP_POLL_ADD, registration->handle);
+            sqe->poll32_events = POLLIN;
+            registration->pollingIn = true;
+        }
+        return;
+    }
+
+    auto socket = registration->socket;
+    if (!socket)
+        return;
+
+    if (registration->native)
+    {
+        // Dane odbierane bez oczekującego odczytu zajmowałyby bufory współdzielone przez wszystkie gniazda
+        // (np. potok wysłany przez klienta, który nie odbiera odpowiedzi) - odbiór wznawiany jest przez update().
+        auto idle = !socket->pendingRead() || registration->chunks.size() >= ChunkLimit;
+        if (registration->receiving)
+        {
+            if (idle && !registration->chunks.empty() && !registration->stopping)
+            {
+                cancel(registration, Receive);
+                registration->stopping = true;
+            }
+            return;
+        }
+        if (idle || registration->eof || registration->error || registration->starved)
+            return;
+        auto sqe = submit(registration, Receive, IORING_OP_RECV, registration->handle);
+        sqe->flags = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = BufferGroup;
+        if (multishotReceive)
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+        else
+            sqe->len = BufferLength;
+        registration->receiving = true;
+        return;
+    }
+
+    if (socket->pendingRead() && !registration->readable && !registration->pollingIn && !socket->buffered())
+    {
+        auto sqe = submit(registration, PollIn, IORING_OP_POLL_ADD, registration->handle);
+        sqe->poll32_events = POLLIN | POLLRDHUP;
+        registration->pollingIn = true;
+    }
+    if (socket->pendingWrite() && !registration->writable && !registration->pollingOut)
+    {
+        auto sqe = submit(registration, PollOut, IORING_OP_POLL_ADD, registration->handle);
+        sqe->poll32_events = POLLOUT;
+        registration->pollingOut = true;
+    }
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::armWakeup()
+{
+    // Odczyt zamiast poll - uchwyt opróżniany jest bez dodatkowego wywołania systemowego.
+    auto sqe = submit(nullptr, Wakeup, IORING_OP_READ, owner.wakeupHandle());
+    sqe->addr = reinterpret_cast<std::uint64_t>(drain.data());
+    sqe->len = static_cast<unsigned>(drain.size());
+    wakeupArmed = true;
+}
+
+io_uring_sqe* Tcp::UringStreamService::UringStreamServicePimpl::submit(Registration* registration, Operation operation, unsigned char opcode, int handle)
+{
+    auto sqe = ring.next();
+    sqe->opcode = opcode;
+    sqe->fd = handle;
+    sqe->user_data = reinterpret_cast<std::uint64_t>(registration) | operation;
+    if (registration)
+        ++registration->inflight;
+    return sqe;
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::cancel(Registration* registration, Operation operation)
+{
+    auto sqe = ring.next();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = reinterpret_cast<std::uint64_t>(registration) | operation;
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::retire(RegistrationPtr registration)
+{
+    auto pointer = registration.get();
+    if (pointer->receiving)
+        cancel(pointer, Receive);
+    if (pointer->sending)
+        cancel(pointer, Send);
+    if (pointer->pollingIn)
+        cancel(pointer, PollIn);
+    if (pointer->pollingOut)
+        cancel(pointer, PollOut);
+    if (pointer->accepting)
+        cancel(pointer, Accept);
+
+    for (auto& chunk : pointer->chunks)
+        recycle(chunk.buffer);
+    pointer->chunks.clear();
+    for (auto handle : pointer->accepted)
+        ::close(handle); // połączenia przyjęte po zamknięciu akceptora.
+    pointer->accepted.clear();
+    starved.erase(std::remove(starved.begin(), starved.end(), pointer), starved.end());
+
+    retired.push_back(std::move(registration));
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::recycle(unsigned short buffer)
+{
+    buffers.recycle(buffer);
+    for (auto registration : starved)
+    {
+        registration->starved = false;
+        queue(registration); // wznowienie odbioru po zwolnieniu bufora.
+    }
+    starved.clear();
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::complete(const io_uring_cqe& cqe)
+{
+    auto operation = static_cast<Operation>(cqe.user_data & OperationMask);
+    auto pointer = cqe.user_data & ~OperationMask;
+
+    if (operation == Ignored)
+        return;
+    if (operation == Wakeup)
+    {
+        wakeupArmed = false;
+        owner.invokePosted();
+        if (cqe.res != -ECANCELED)
+            armWakeup();
+        return;
+    }
+    if (operation == Message)
+    {
+        std::unique_ptr<OwnedMessage> message(reinterpret_cast<OwnedMessage*>(pointer));
+        auto registration = message->registration;
+        --registration->inflight;
+        if (cqe.res >= 0 && static_cast<std::size_t>(cqe.res) == message->data.size())
+            return;
+
+        // writeSome zgłosił już zapis całości, a po nim mogły zostać zlecone kolejne - dosłanie reszty
+        // naruszyłoby kolejność danych, więc niepełny zapis kończy połączenie błędem odczytu.
+        ++failedWrites;
+        if (registration->socket && !registration->error)
+        {
+            registration->error = cqe.res < 0 ? -cqe.res : EPIPE;
+            queue(registration);
+        }
+        return;
+    }
+
+    auto registration = reinterpret_cast<Registration*>(pointer);
+    auto more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    if (!more)
+        --registration->inflight;
+    auto alive = registration->socket || registration->acceptor;
+
+    switch (operation)
+    {
+    case Receive:
+        if (!more)
+            registration->receiving = registration->stopping = false;
+        if (cqe.flags & IORING_CQE_F_BUFFER)
+        {
+            auto buffer = static_cast<unsigned short>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            if (alive && cqe.res > 0)
+                registration->chunks.push_back(Chunk{ buffer, 0, cqe.res });
+            else
+                recycle(buffer);
+        }
+        if (!alive || cqe.res > 0 || cqe.res == -ECANCELED)
+            break;
+        if (cqe.res == 0)
+        {
+            registration->eof = true;
+        }
+        else if (cqe.res == -ENOBUFS)
+        {
+            registration->starved = true;
+            starved.push_back(registration);
+        }
+        else if (cqe.res == -EINVAL && multishotReceive)
+        {
+            multishotReceive = false; // ponowne zlecenie w arm() jako pojedynczy recv.
+        }
+        else
+        {
+            registration->error = -cqe.res;
+        }
+        break;
+    case Send:
+        registration->sending = false;
+        registration->sent = true;
+        registration->result = cqe.res;
+        break;
+    case PollIn:
+        registration->pollingIn = false;
+        if (cqe.res > 0)
+            registration->readable = true;
+        break;
+    case PollOut:
+        registration->pollingOut = false;
+        if (cqe.res > 0)
+            registration->writable = true;
+        break;
+    case Accept:
+        if (!more)
+            registration->accepting = false;
+        if (cqe.res >= 0)
+        {
+            if (alive)
+                registration->accepted.push_back(cqe.res);
+            else
+                ::close(cqe.res);
+        }
+        break;
+    default:
+        break;
+    }
+
+    if (alive)
+        queue(registration);
+}
+
+bool Tcp::UringStreamService::UringStreamServicePimpl::serviceThread() const
+{
+    return running && thread.load() == std::this_thread::get_id();
+}
+
+Tcp::UringStreamService::UringStreamServicePimpl::Registration* Tcp::UringStreamService::UringStreamServicePimpl::find(int handle) const
+{
+    auto found = handles.find(handle);
+    return found != handles.end() ? found->second : nullptr;
+}
+
+void Tcp::UringStreamService::UringStreamServicePimpl::adopt(int handle)
+{
+    if (auto registration = find(handle))
+        registration->native = true;
+}
+
+int Tcp::UringStreamService::UringStreamServicePimpl::receive(int handle, SocketService::BufferType& buffer)
+{
+    auto registration = find(handle);
+    if (!registration)
+        return 0;
+
+    int total = 0;
+    auto& chunks = registration->chunks;
+    while (total < buffer.second && !chunks.empty())
+    {
+        auto& chunk = chunks.front();
+        auto count = std::min(buffer.second - total, chunk.size - chunk.offset);
+        std::memcpy(buffer.first + total, buffers.data(chunk.buffer) + chunk.offset, count);
+        total += count;
+        chunk.offset += count;
+        if (chunk.offset == chunk.size)
+        {
+            auto id = chunk.buffer;
+            chunks.pop_front();
+            recycle(id);
+            if (!registration->receiving)
+                queue(registration); // odbiór wstrzymany po osiągnięciu ChunkLimit.
+        }
+    }
+
+    if (total > 0)
+        return total;
+    if (registration->error)
+        return -1;
+    return registration->eof ? 0 : SocketService::WouldBlock;
+}
+
+int Tcp::UringStreamService::UringStreamServicePimpl::trySend(int handle, const SocketService::ConstBufferSequenceType& buffers)
+{
+    auto registration = find(handle);
+    if (!registration)
+        throw SendError("socket is not registered");
+
+    if (registration->sent)
+    {
+        registration->sent = false;
+        if (registration->result < 0)
+            throw SendError("send failed (" + std::to_string(-registration->result) + ')');
+        return registration->result;
+    }
+    if (registration->sending)
+        return 0;
+
+    // Bufory należą do wywołującego, który może je zwolnić (np. przy shutdown()) przed zakończeniem operacji,
+    // a anulowanie zlecane jest dopiero w kolejnej iteracji - jądro odczytuje kopię utrzymywaną przez rejestrację.
+    auto& outgoing = registration->outgoing;
+    outgoing.clear();
+    for (auto& buffer : buffers)
+    {
+        if (outgoing.size() >= SendLength)
+            break;
+        if (buffer.second > 0)
+            outgoing.append(buffer.first, std::min(static_cast<std::size_t>(buffer.second), SendLength - outgoing.size()));
+    }
+    if (outgoing.empty())
+        return 0;
+
+    auto sqe = submit(registration, Send, IORING_OP_SEND, handle);
+    sqe->addr = reinterpret_cast<std::uint64_t>(outgoing.data());
+    sqe->len = static_cast<unsigned>(outgoing.size());
+    sqe->msg_flags = MSG_NOSIGNAL;
+    registration->sending = true;
+    lastSend = sqe;
+    lastSendHandle = handle;
+    return 0;
+}
+
+int Tcp::UringStreamService::UringStreamServicePimpl::send(int handle, const SocketService::ConstBufferSequenceType& buffers)
+{
+    auto registration = find(handle);
+    if (!serviceThread() || !registration || registration->sending)
+        return -1; // zapis bezpośredni - kolejność względem zleconego zapisu nie byłaby zachowana.
+
+    auto message = new OwnedMessage();
+    message->registration = registration;
+    for (auto& buffer : buffers)
+        message->data.append(buffer.first, buffer.second > 0 ? buffer.second : 0);
+
+    auto sqe = submit(registration, Message, IORING_OP_SEND, handle);
+    sqe->user_data = reinterpret_cast<std::uint64_t>(message) | Message;
+    sqe->addr = reinterpret_cast<std::uint64_t>(message->data.data());
+    sqe->len = static_cast<unsigned>(message->data.size());
+    sqe->msg_flags = MSG_NOSIGNAL;
+    lastSend = sqe;
+    lastSendHandle = handle;
+    return static_cast<int>(message->data.size());
+}
+
+bool Tcp::UringStreamService::UringStreamServicePimpl::buffered(int handle) const
+{
+    auto registration = find(handle);
+    return registration && !registration->chunks.empty();
+}
+
+bool Tcp::UringStreamService::UringStreamServicePimpl::close(int handle)
+{
+    if (!serviceThread())
+        return false; // kolejki należą do wątku run() - gniazdo zamykane jest bezpośrednio.
+
+    auto linkable = lastSend && lastSendHandle == handle && ring.unsubmitted(lastSend) && lastSend->fd == handle
+        && lastSend->opcode == IORING_OP_SEND;
+    if (linkable)
+        lastSend->flags |= IOSQE_IO_HARDLINK; // zamknięcie nastąpi po zakończeniu zapisu, również nieudanego.
+    submit(nullptr, Ignored, IORING_OP_CLOSE, handle);
+    lastSend = nullptr;
+    return true;
+}
+
+bool Tcp::UringStreamService::UringStreamServicePimpl::takeAccepted(int listener, int& handle)
+{
+    for (auto& registration : acceptors)
+    {
+        if (registration->handle != listener || !registration->native)
+            continue;
+        handle = -1;
+        if (!registration->accepted.empty())
+        {
+            handle = registration->accepted.front();
+            registration->accepted.pop_front();
+        }
+        return true;
+    }
+    return false;
+}
+
+Tcp::UringStreamService::UringStreamService()
+{
+    if (!Supported())
+        throw ServiceError("io_uring is not supported by the kernel");
+    pimpl.reset(new UringStreamServicePimpl(*this));
+}
+
+Tcp::UringStreamService::~UringStreamService()
+{
+}
+
+int Tcp::UringStreamService::run()
+{
+    pimpl->thread = std::this_thread::get_id();
+    pimpl->running = true;
+
+    for (auto acceptor : acceptors)
+        pimpl->attach(acceptor);
+    if (!pimpl->wakeupArmed)
+        pimpl->armWakeup();
+
+    while (!stopped())
+    {
+        auto& pending = pimpl->pending;
+        for (std::size_t i = 0; i < pending.size(); ++i) // dispatch może dopisywać kolejne elementy.
+        {
+            auto registration = pending[i];
+            registration->queued = false;
+            pimpl->dispatch(registration);
+            pimpl->arm(registration);
+        }
+        pending.clear();
+
+        auto& retired = pimpl->retired;
+        retired.erase(std::remove_if(retired.begin(), retired.end(), [](const UringStreamServicePimpl::RegistrationPtr& registration) {
+            return registration->inflight == 0;
+        }), retired.end());
+
+        pimpl->lastSend = nullptr;
+        pimpl->ring.enter(1, timers.timeout(TimerWheel::Clock::now()));
+        pimpl->ring.reap([this](const io_uring_cqe& cqe) { pimpl->complete(cqe); });
+
+        timers.expire(TimerWheel::Clock::now());
+    }
+
+    pimpl->running = false;
+    pimpl->pending.clear();
+
+    // shutdown() usuwa gniazdo z kolekcji, a handlery mogą zwolnić także inne gniazda - kopia mogłaby je wskazywać.
+    while (!sockets.empty())
+    {
+        (*sockets.begin())->shutdown();
+    }
+
+    return signal ? signal->get() : 0;
+}
+
+void Tcp::UringStreamService::add(SocketService* service)
+{
+    StreamServiceInterface::add(service);
+
+    auto registration = pimpl->create(service, nullptr, service->getHandle());
+    pimpl->registrations[service] = UringStreamServicePimpl::RegistrationPtr(registration);
+    if (registration->handle != -1)
+        pimpl->handles[registration->handle] = registration;
+    pimpl->queue(registration); // odbiór zlecany jest w run(), gdy wiadomo już, czy gniazdo należy do serwisu.
+}
+
+void Tcp::UringStreamService::remove(SocketService* service)
+{
+    StreamServiceInterface::remove(service);
+
+    auto found = pimpl->registrations.find(service);
+    if (found == pimpl->registrations.end())
+        return;
+
+    auto registration = found->second.get();
+    registration->socket = nullptr; // zakończenia z kolejki mogą wciąż wskazywać na rejestrację.
+    auto handle = pimpl->handles.find(registration->handle);
+    if (handle != pimpl->handles.end() && handle->second == registration)
+        pimpl->handles.erase(handle);
+    pimpl->retire(std::move(found->second));
+    pimpl->registrations.erase(found);
+}
+
+void Tcp::UringStreamService::add(AcceptorService* service)
+{
+    StreamServiceInterface::add(service);
+    if (pimpl->running)
+        pimpl->attach(service); // pozostałe akceptory rejestrowane są w run(), gdy znane są ich uchwyty.
+}
+
+void Tcp::UringStreamService::remove(AcceptorService* service)
+{
+    StreamServiceInterface::remove(service);
+
+    auto& acceptors = pimpl->acceptors;
+    auto found = std::find_if(acceptors.begin(), acceptors.end(), [service](const UringStreamServicePimpl::RegistrationPtr& registration) {
+        return registration->acceptor == service;
+    });
+    if (found == acceptors.end())
+        return;
+
+    (*found)->acceptor = nullptr;
+    auto registration = std::move(*found);
+    acceptors.erase(found);
+    pimpl->retire(std::move(registration));
+    // Wielokrotny accept utrzymuje gniazdo nasłuchujące - musi zostać anulowany przed zamknięciem uchwytu,
+    // aby połączenia pozostały w kolejce gniazda (np. dla procesu przejmującego je po restart()).
+    pimpl->ring.enter(0, 0);
+}
+
+void Tcp::UringStreamService::update(SocketService* service)
+{
+    auto found = pimpl->registrations.find(service);
+    if (found != pimpl->registrations.end())
+        pimpl->queue(found->second.get());
+}
+
+std::unique_ptr<Tcp::ServiceFactory> Tcp::UringStreamService::getFactory()
+{
+    return std::unique_ptr<ServiceFactory>(new NativeFactory(*this));
+}
+
+std::size_t Tcp::UringStreamService::failedWrites() const
+{
+    return pimpl->failedWrites;
+}
+
+bool Tcp::UringStreamService::Supported()
+{
+    static const bool supported = []
+    {
+        try
+        {
+            Ring ring(4);
+            if (!(ring.features() & IORING_FEAT_EXT_ARG) || !(ring.features() & IORING_FEAT_NODROP))
+                return false;
+
+            std::vector<char> storage(sizeof(io_uring_probe) + IORING_OP_LAST * sizeof(io_uring_probe_op));
+            auto probe = reinterpret_cast<io_uring_probe*>(storage.data());
+            if (Register(ring.handle(), IORING_REGISTER_PROBE, probe, IORING_OP_LAST) == -1)
+                return false;
+            for (auto opcode : { IORING_OP_ACCEPT, IORING_OP_RECV, IORING_OP_SEND, IORING_OP_READ,
+                                 IORING_OP_POLL_ADD, IORING_OP_ASYNC_CANCEL, IORING_OP_CLOSE })
+            {
+                if (opcode > probe->last_op || !(probe->ops[opcode].flags & IO_URING_OP_SUPPORTED))
+                    return false;
+            }
+
+            BufferRing buffers(ring.handle(), 1, BufferLength, BufferGroup); // pierścień buffer i wielokrotny accept od 5.19.
+            return true;
+        }
+        catch (const TcpError&)
+        {
+            return false;
+        }
+    }();
+    return supported;
+}
+
+#else // io_uring niedostępny w nagłówkach systemu.
+
+struct Tcp::UringStreamService::UringStreamServicePimpl
+{
+};
+
+Tcp::UringStreamService::UringStreamService()
+{
+    throw ServiceError("io_uring is not supported by this build");
+}
+
+Tcp::UringStreamService::~UringStreamService()
+{
+}
+
+int Tcp::UringStreamService::run()
+{
+    return 0;
+}
+
+void Tcp::UringStreamService::add(SocketService* service)
+{
+    StreamServiceInterface::add(service);
+}
+
+void Tcp::UringStreamService::remove(SocketService* service)
+{
+    StreamServiceInterface::remove(service);
+}
+
+void Tcp::UringStreamService::add(AcceptorService* service)
+{
+    StreamServiceInterface::add(service);
+}
+
+void Tcp::UringStreamService::remove(AcceptorService* service)
+{
+    StreamServiceInterface::remove(service);
+}
+
+void Tcp::UringStreamService::update(SocketService*)
+{
+}
+
+std::unique_ptr<Tcp::ServiceFactory> Tcp::UringStreamService::getFactory()
+{
+    return std::unique_ptr<ServiceFactory>(new StreamServiceFactory(*this));
+}
+
+std::size_t Tcp::UringStreamService::failedWrites() const
+{
+    return 0;
+}
+
+bool Tcp::UringStreamService::Supported()
+{
+    return false;
+}
+
+#endif // defined(IORING_RECV_MULTISHOT)
+
+#endif // defined(PATR_OS_LINUX)
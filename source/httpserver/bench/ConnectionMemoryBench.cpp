@@ -0,0 +1,55 @@
+#include "../Server.h"
+#include "../ServerUtilities.h"
+#include "../Socket.h"
+#include "../../bench/Benchmark.h"
+
+#include <iomanip>
+#include <memory>
+#include <vector>
+
+namespace {
+
+    /// Liczba jednocześnie utrzymywanych połączeń.
+    constexpr int Connections = 10000;
+
+    /// Strategia przyjmująca połączenia bez obsługi zapytań.
+    class IdleStrategy : public Http::HandlerStrategy
+    {
+    public:
+        void handle(ConnectionResponse) override {}
+        void start(Http::ConnectionPtr) override {}
+        void stop(Http::ConnectionPtr) override {}
+    };
+
+    /// Wypisuje zajętość puli w przeliczeniu na jedno połączenie.
+    void Report(std::ostream& out, const std::string& name, const Utility::MemoryPool::Statistics& statistics)
+    {
+        auto reserved = statistics.capacity * statistics.blockSize;
+        out << std::left << std::setw(12) << name << std::right
+            << std::setw(8) << statistics.used << " used"
+            << std::setw(8) << statistics.capacity << " blocks"
+            << std::setw(12) << reserved / 1024 << " KiB"
+            << std::setw(10) << std::fixed << std::setprecision(1) << double(reserved) / Connections << " B/conn" << std::endl;
+    }
+}
+
+/// Mierzy pamięć zajmowaną przez bezczynne połączenia (bez odczytu w toku).
+PATR_BENCHMARK(ConnectionMemory)
+{
+    Tcp::StreamService service;
+    IdleStrategy strategy;
+
+    std::vector<Http::ConnectionPtr> connections;
+    connections.reserve(Connections);
+    for (int i = 0; i < Connections; ++i)
+    {
+        connections.push_back(std::make_shared<Http::Connection>(
+            Tcp::Socket(std::unique_ptr<Tcp::SocketInterface>(new Tcp::SocketImplementation(service, -1))), strategy));
+    }
+
+    auto occupancy = Http::Connection::occupancy();
+    out << Connections << " idle connections, embedded buffer would take "
+        << Connections * sizeof(Http::Connection::BufferType) / 1024 << " KiB" << std::endl;
+    Report(out, "buffers", occupancy.buffers);
+    Report(out, "state", occupancy.connections);
+}
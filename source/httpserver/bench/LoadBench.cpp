@@ -0,0 +1,209 @@
+#include "LoadGenerator.h"
+#include "../Server.h"
+#include "../ServerUtilities.h"
+#include "../Socket.h"
+#include "../../bench/Benchmark.h"
+
+#if defined(PATR_OS_LINUX)
+
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <iomanip>
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/prctl.h>
+
+/*
+ * Benchmark HttpLoad konfigurowany jest zmiennymi środowiskowymi:
+ *   PATR_LOAD_TARGET      - host:port zewnętrznego serwera, domyślnie uruchamiany jest Http::Server na 127.0.0.1:9124,
+ *   PATR_LOAD_SERVICE     - serwis uruchamianego serwera: select, epoll (domyślnie) lub uring,
+ *   PATR_LOAD_REACTORS    - liczba reaktorów uruchamianego serwera (domyślnie 1),
+ *   PATR_LOAD_CONNECTIONS - liczba równoległych połączeń (domyślnie 16),
+ *   PATR_LOAD_DURATION    - czas każdego pomiaru w sekundach (domyślnie 3),
+ *   PATR_LOAD_RATE        - zapytania na sekundę w pętli otwartej, domyślnie 50% i 90% przepustowości pętli zamkniętej,
+ *   PATR_LOAD_MIX         - mieszanka zapytań "[METODA ]ścieżka=waga,...", domyślnie "/=6,/json=3,/large=1".
+ */
+
+namespace {
+
+    constexpr auto Host = "127.0.0.1";
+    constexpr auto Port = "9124";
+    /// Rozmiar ciała odpowiedzi /large.
+    constexpr std::size_t LargeBody = 64U * 1024U;
+
+    /// Zwraca wartość zmiennej środowiskowej lub fallback, jeżeli nie jest ustawiona.
+    std::string Environment(const char* name, const std::string& fallback)
+    {
+        auto value = std::getenv(name);
+        return value && *value ? value : fallback;
+    }
+
+    /// Odczytuje mieszankę zapytań w postaci "[METODA ]ścieżka=waga" rozdzielanych przecinkami.
+    std::vector<Bench::LoadRequest> ParseMix(const std::string& description)
+    {
+        std::vector<Bench::LoadRequest> mix;
+        std::istringstream entries(description);
+        std::string entry;
+        while (std::getline(entries, entry, ','))
+        {
+            unsigned weight = 1;
+            auto equals = entry.rfind('=');
+            if (equals != std::string::npos)
+            {
+                weight = static_cast<unsigned>(std::strtoul(entry.c_str() + equals + 1, nullptr, 10));
+                entry.erase(equals);
+            }
+            auto space = entry.find(' ');
+            auto method = space == std::string::npos ? std::string("GET") : entry.substr(0, space);
+            auto path = space == std::string::npos ? entry : entry.substr(space + 1);
+            if (!path.empty() && weight > 0)
+                mix.push_back(Bench::LoadGenerator::MakeRequest(method, path, weight));
+        }
+        return mix;
+    }
+
+    /// Odpowiada na zapytania benchmarku według ścieżki.
+    Http::Response Handle(const Http::Request& request)
+    {
+        static const std::string json = R"({"id":42,"name":"benchmark","tags":["http","load","latency"],"active":true})";
+        static const std::string large(LargeBody, 'x');
+
+        auto path = Http::UriView(request.uri()).path();
+        if (path.equals("/json"))
+            return Http::Response(Http::Response::Status::Ok, json, "application/json");
+        if (path.equals("/large"))
+            return Http::Response(Http::Response::Status::Ok, large, "application/octet-stream");
+        if (path.equals("/"))
+            return Http::Response(Http::Response::Status::Ok, "Ok", "text/plain");
+        return Http::Response(Http::Response::Status::NotFound, "Not found", "text/plain");
+    }
+
+    /// Uruchamia Http::Server w procesie potomnym, jak w StreamServiceBench.
+    class ServerProcess
+    {
+    public:
+        ServerProcess(const std::string& service, std::size_t reactors) : pid(::fork())
+        {
+            if (pid == 0)
+            {
+                ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+                try
+                {
+                    Http::Server::ServiceBuilder builder = [service]
+                    {
+                        if (service == "select")
+                            return Http::Server::ServicePtr(new Tcp::StreamService());
+                        if (service == "uring" && Tcp::UringStreamService::Supported())
+                            return Http::Server::ServicePtr(new Tcp::UringStreamService());
+                        return Http::Server::ServicePtr(new Tcp::EpollStreamService());
+                    };
+                    Http::Server server(Host, Port, Handle, reactors, builder);
+                    server.run();
+                }
+                catch (const std::exception&)
+                {
+                }
+                ::_exit(0);
+            }
+        }
+
+        ~ServerProcess()
+        {
+            ::kill(pid, SIGKILL);
+            ::waitpid(pid, nullptr, 0);
+        }
+
+    private:
+        pid_t pid;
+    };
+
+    /// Wypisuje wiersz raportu z przepustowością i percentylami opóźnień w [us].
+    void Print(std::ostream& out, const std::string& mode, const std::string& name, const Bench::LoadResult& result, double elapsed)
+    {
+        const auto& latency = result.latency;
+        out << std::setw(14) << mode
+            << std::setw(14) << name
+            << std::setw(10) << std::fixed << std::setprecision(0) << latency.count() / elapsed
+            << std::setw(10) << latency.percentile(50.0)
+            << std::setw(10) << latency.percentile(99.0)
+            << std::setw(10) << latency.percentile(99.9)
+            << std::setw(10) << latency.max()
+            << std::setw(8) << result.rejected
+            << std::setw(8) << result.errors
+            << std::endl;
+    }
+
+    /// Przeprowadza pomiar i wypisuje wyniki łączne oraz dla każdego rodzaju zapytań.
+    Bench::LoadReport Measure(std::ostream& out, const std::string& host, const std::string& port,
+                              const std::vector<Bench::LoadRequest>& mix, const Bench::LoadSettings& settings)
+    {
+        auto report = Bench::LoadGenerator(host, port, mix, settings).run();
+        auto mode = settings.rate > 0.0 ? "open@" + std::to_string(static_cast<long>(settings.rate)) : std::string("closed");
+        Print(out, mode, "total", report.total, report.elapsed);
+        if (mix.size() > 1)
+            for (std::size_t i = 0; i < mix.size(); ++i)
+                Print(out, mode, mix[i].name, report.requests[i], report.elapsed);
+        return report;
+    }
+}
+
+/// Mierzy przepustowość i rozkład opóźnień Http::Server pod obciążeniem wielu połączeń trwałych.
+/**
+ * Najpierw w pętli zamkniętej (maksymalna przepustowość), następnie w pętli otwartej przy stałej
+ * częstości zapytań, gdzie percentyle nie są zaniżane przez oczekiwanie klienta na wolne odpowiedzi.
+ */
+PATR_BENCHMARK(HttpLoad)
+{
+    auto target = Environment("PATR_LOAD_TARGET", "");
+    auto separator = target.rfind(':');
+    auto host = separator == std::string::npos ? std::string(Host) : target.substr(0, separator);
+    auto port = separator == std::string::npos ? std::string(Port) : target.substr(separator + 1);
+
+    auto mix = ParseMix(Environment("PATR_LOAD_MIX", "/=6,/json=3,/large=1"));
+    if (mix.empty())
+    {
+        out << "PATR_LOAD_MIX contains no requests" << std::endl;
+        return;
+    }
+
+    Bench::LoadSettings settings(
+        std::strtoul(Environment("PATR_LOAD_CONNECTIONS", "16").c_str(), nullptr, 10),
+        std::chrono::milliseconds(static_cast<long>(std::atof(Environment("PATR_LOAD_DURATION", "3").c_str()) * 1000)));
+    auto rate = std::atof(Environment("PATR_LOAD_RATE", "0").c_str());
+
+    std::unique_ptr<ServerProcess> server;
+    if (separator == std::string::npos)
+    {
+        auto service = Environment("PATR_LOAD_SERVICE", "epoll");
+        auto reactors = std::strtoul(Environment("PATR_LOAD_REACTORS", "1").c_str(), nullptr, 10);
+        out << "server: " << service << ", reactors: " << reactors << ", ";
+        server.reset(new ServerProcess(service, reactors));
+    }
+    out << "target: " << host << ':' << port << ", connections: " << settings.connections
+        << ", duration: " << settings.duration.count() << " ms" << std::endl;
+
+    out << std::setw(14) << "mode" << std::setw(14) << "request" << std::setw(10) << "req/s"
+        << std::setw(10) << "p50 [us]" << std::setw(10) << "p99 [us]" << std::setw(10) << "p99.9"
+        << std::setw(10) << "max" << std::setw(8) << "4xx/5xx" << std::setw(8) << "errors" << std::endl;
+
+    if (rate > 0.0)
+    {
+        settings.rate = rate;
+        Measure(out, host, port, mix, settings);
+        return;
+    }
+
+    auto closed = Measure(out, host, port, mix, settings);
+    for (auto load : { 0.5, 0.9 })
+    {
+        settings.rate = closed.rps() * load;
+        if (settings.rate > 0.0)
+            Measure(out, host, port, mix, settings);
+    }
+}
+
+#endif // defined(PATR_OS_LINUX)
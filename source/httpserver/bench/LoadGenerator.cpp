@@ -0,0 +1,277 @@
+#include "LoadGenerator.h"
+#include "../ServerUtilities.h"
+#include "../Socket.h"
+
+#include <array>
+#include <cctype>
+#include <random>
+#include <thread>
+#include <memory>
+#include <cstdlib>
+
+namespace {
+
+    /// Odpowiedź odczytana z połączenia.
+    struct Response
+    {
+        int status = 0;
+        bool close = false; //< Serwer zamyka połączenie po odpowiedzi.
+    };
+
+    /// Porównuje nazwy nagłówków bez uwzględniania wielkości liter.
+    bool SameName(const std::string& data, std::size_t begin, std::size_t end, const char* name)
+    {
+        std::size_t i = 0;
+        for (; begin + i < end && name[i]; ++i)
+            if (std::tolower(static_cast<unsigned char>(data[begin + i])) != std::tolower(static_cast<unsigned char>(name[i])))
+                return false;
+        return begin + i == end && !name[i];
+    }
+
+    /// Zwraca pozycję za ciałem w kodowaniu chunked zaczynającym się od begin lub npos, jeżeli nie jest kompletne.
+    std::size_t ChunkedEnd(const std::string& data, std::size_t begin)
+    {
+        for (auto position = begin;;)
+        {
+            auto line = data.find(Http::CRLF, position);
+            if (line == std::string::npos)
+                return std::string::npos;
+            auto size = std::strtoul(data.c_str() + position, nullptr, 16);
+            position = line + 2;
+            if (size == 0)
+            {
+                // Po ostatniej części mogą wystąpić nagłówki końcowe zakończone pustą linią.
+                auto end = data.find(Http::CRLF, position);
+                while (end != std::string::npos && end != position)
+                {
+                    position = end + 2;
+                    end = data.find(Http::CRLF, position);
+                }
+                return end == std::string::npos ? std::string::npos : end + 2;
+            }
+            position += size + 2;
+            if (position > data.size())
+                return std::string::npos;
+        }
+    }
+
+    /// Odczytuje z gniazda kompletną odpowiedź.
+    /**
+     * Zgłasza Tcp::TcpError, jeżeli połączenie zostanie zamknięte przed jej końcem.
+     */
+    Response ReadResponse(Tcp::Socket& socket, std::string& data)
+    {
+        std::array<char, 16384> buffer;
+        data.clear();
+
+        auto receive = [&]
+        {
+            auto b = Tcp::MakeBuffer(buffer);
+            auto bytes = socket.readSome(b);
+            if (bytes > 0)
+                data.append(buffer.data(), bytes);
+            return bytes > 0;
+        };
+
+        std::size_t headerEnd;
+        while ((headerEnd = data.find("\r\n\r\n")) == std::string::npos)
+            if (!receive())
+                throw Tcp::ReceiveError("connection closed before response headers");
+
+        Response response;
+        auto lineEnd = data.find(Http::CRLF);
+        auto space = data.find(' ');
+        if (space < lineEnd)
+            response.status = std::atoi(data.c_str() + space + 1);
+        response.close = data.compare(0, 8, "HTTP/1.0") == 0;
+
+        auto bodyBegin = headerEnd + 4;
+        auto length = std::string::npos;
+        bool chunked = false;
+        for (auto position = lineEnd + 2; position < headerEnd;)
+        {
+            auto end = data.find(Http::CRLF, position);
+            auto colon = data.find(':', position);
+            if (colon < end)
+            {
+                auto value = colon + 1;
+                while (value < end && data[value] == ' ')
+                    ++value;
+                if (SameName(data, position, colon, "Content-Length"))
+                    length = std::strtoul(data.c_str() + value, nullptr, 10);
+                else if (SameName(data, position, colon, "Transfer-Encoding"))
+                    chunked = SameName(data, value, end, "chunked");
+                else if (SameName(data, position, colon, "Connection"))
+                    response.close = SameName(data, value, end, "close");
+            }
+            position = end + 2;
+        }
+
+        if (chunked)
+        {
+            while (ChunkedEnd(data, bodyBegin) == std::string::npos)
+                if (!receive())
+                    throw Tcp::ReceiveError("connection closed inside chunked body");
+        }
+        else if (length != std::string::npos)
+        {
+            while (data.size() < bodyBegin + length)
+                if (!receive())
+                    throw Tcp::ReceiveError("connection closed inside response body");
+        }
+        else
+        {
+            // Ciało bez długości kończy się wraz z połączeniem.
+            while (receive())
+                ;
+            response.close = true;
+        }
+        return response;
+    }
+}
+
+Bench::LoadSettings::LoadSettings(std::size_t connections, std::chrono::milliseconds duration, double rate, std::chrono::milliseconds warmup)
+    : connections(connections), duration(duration), rate(rate), warmup(warmup)
+{
+}
+
+void Bench::LoadResult::merge(const LoadResult& other)
+{
+    latency.merge(other.latency);
+    rejected += other.rejected;
+    errors += other.errors;
+}
+
+double Bench::LoadReport::rps() const
+{
+    return elapsed > 0.0 ? total.latency.count() / elapsed : 0.0;
+}
+
+Bench::LoadGenerator::LoadGenerator(const std::string& host, const std::string& port, std::vector<LoadRequest> mix, LoadSettings settings)
+    : host(host), port(port), mix(std::move(mix)), settings(settings)
+{
+}
+
+Bench::LoadRequest Bench::LoadGenerator::MakeRequest(const std::string& method, const std::string& path, unsigned weight, const std::string& body)
+{
+    auto data = method + ' ' + path + " HTTP/1.1" + Http::CRLF + "Host: localhost" + Http::CRLF;
+    if (!body.empty() || method == "POST" || method == "PUT")
+        data += "Content-Length: " + std::to_string(body.size()) + Http::CRLF;
+    data += Http::CRLF + body;
+    return LoadRequest{ method + ' ' + path, std::move(data), weight };
+}
+
+Bench::LoadReport Bench::LoadGenerator::run() const
+{
+    auto connections = std::max<std::size_t>(settings.connections, 1U);
+    std::vector<LoadReport> reports(connections);
+    std::vector<std::thread> workers;
+
+    // Wątki rozpoczynają jednocześnie, po utworzeniu wszystkich.
+    auto start = std::chrono::steady_clock::now() + std::chrono::milliseconds(50);
+    for (std::size_t i = 0; i < connections; ++i)
+        workers.emplace_back([this, i, start, &reports] { work(i, start, reports[i]); });
+    for (auto& worker : workers)
+        worker.join();
+
+    LoadReport report;
+    report.elapsed = std::chrono::duration<double>(settings.duration).count();
+    report.requests.resize(mix.size());
+    for (const auto& partial : reports)
+    {
+        report.total.merge(partial.total);
+        for (std::size_t i = 0; i < mix.size(); ++i)
+            report.requests[i].merge(partial.requests[i]);
+        report.reconnects += partial.reconnects;
+    }
+    return report;
+}
+
+void Bench::LoadGenerator::work(std::size_t connection, std::chrono::steady_clock::time_point start, LoadReport& report) const
+{
+    typedef std::chrono::steady_clock Clock;
+
+    report.requests.resize(mix.size());
+    if (mix.empty())
+        return;
+
+    std::vector<double> weights;
+    for (const auto& request : mix)
+        weights.push_back(request.weight);
+    std::mt19937 random(static_cast<std::mt19937::result_type>(connection + 1));
+    std::discrete_distribution<std::size_t> pick(weights.begin(), weights.end());
+
+    // Każde połączenie w pętli otwartej obsługuje równą część zapytań, przesuniętą względem pozostałych.
+    auto connections = std::max<std::size_t>(settings.connections, 1U);
+    auto interval = settings.rate > 0.0
+        ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(connections / settings.rate))
+        : Clock::duration::zero();
+    auto measured = start + settings.warmup;
+    auto end = measured + settings.duration;
+    auto next = start + interval * static_cast<Clock::duration::rep>(connection) / static_cast<Clock::duration::rep>(connections);
+
+    Tcp::StreamService client;
+    auto endpoint = client.getFactory()->resolve(host, port);
+    std::unique_ptr<Tcp::Socket> socket;
+    std::string data;
+
+    std::this_thread::sleep_until(start);
+    for (;;)
+    {
+        Clock::time_point began;
+        if (interval != Clock::duration::zero())
+        {
+            began = next;
+            next += interval;
+            std::this_thread::sleep_until(began);
+        }
+        else
+        {
+            began = Clock::now();
+        }
+        if (began >= end)
+            break;
+
+        auto index = pick(random);
+        auto& result = report.requests[index];
+        try
+        {
+            if (!socket)
+            {
+                socket.reset(new Tcp::Socket(endpoint->connect(client)));
+                socket->setOption(Tcp::Option::NoDelay(true));
+            }
+            socket->write(Tcp::MakeBuffer(mix[index].data));
+            auto response = ReadResponse(*socket, data);
+
+            auto finished = Clock::now();
+            if (finished >= measured && finished < end)
+            {
+                result.latency.record(static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(finished - began).count()));
+                if (response.status >= 400)
+                    ++result.rejected;
+            }
+            if (response.close) // np. wyczerpany limit KeepAlive::maxRequests.
+            {
+                socket->close();
+                socket.reset();
+                ++report.reconnects;
+            }
+        }
+        catch (const Tcp::TcpError&)
+        {
+            if (Clock::now() >= measured)
+                ++result.errors;
+            if (socket)
+                socket->close();
+            socket.reset();
+            ++report.reconnects;
+            std::this_thread::sleep_for(std::chrono::milliseconds(10)); // serwer może jeszcze nie nasłuchiwać.
+        }
+    }
+    if (socket)
+        socket->close();
+
+    for (const auto& result : report.requests)
+        report.total.merge(result);
+}
@@ -0,0 +1,94 @@
+#ifndef PATR_LOADGENERATOR_H
+#define PATR_LOADGENERATOR_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "../../bench/Histogram.h"
+
+namespace Bench {
+
+/// Rodzaj zapytania w mieszance obciążenia.
+struct LoadRequest
+{
+    std::string name; //< Etykieta w raporcie, np. "GET /json".
+    std::string data; //< Pełne zapytanie HTTP/1.1 wysyłane na połączeniu trwałym.
+    unsigned weight; //< Udział względem pozostałych zapytań mieszanki.
+};
+
+/// Parametry przebiegu generatora obciążenia.
+struct LoadSettings
+{
+    /**
+     * @param connections - liczba równoległych połączeń, każde obsługiwane przez osobny wątek.
+     * @param duration - czas pomiaru.
+     * @param rate - łączna liczba zapytań na sekundę w pętli otwartej, 0 oznacza pętlę zamkniętą.
+     * @param warmup - czas przed pomiarem, którego odpowiedzi nie są wliczane.
+     */
+    LoadSettings(std::size_t connections = 16U,
+                 std::chrono::milliseconds duration = std::chrono::seconds(3),
+                 double rate = 0.0,
+                 std::chrono::milliseconds warmup = std::chrono::milliseconds(500));
+
+    std::size_t connections;
+    std::chrono::milliseconds duration;
+    double rate;
+    std::chrono::milliseconds warmup;
+};
+
+/// Wyniki pomiaru jednego rodzaju zapytań lub całej mieszanki.
+struct LoadResult
+{
+    Histogram latency; //< Opóźnienia odpowiedzi w [us].
+    std::uint64_t rejected = 0; //< Odpowiedzi o statusie 4xx i 5xx (np. 503 przy przeciążeniu).
+    std::uint64_t errors = 0; //< Zapytania przerwane błędem połączenia.
+
+    void merge(const LoadResult& other);
+};
+
+/// Raport z przebiegu generatora.
+struct LoadReport
+{
+    double elapsed = 0.0; //< Czas pomiaru w [s].
+    LoadResult total;
+    std::vector<LoadResult> requests; //< Wyniki w kolejności mieszanki.
+    std::uint64_t reconnects = 0; //< Połączenia otwarte ponownie po zamknięciu przez serwer lub błędzie.
+
+    /// Zwraca liczbę odebranych odpowiedzi na sekundę.
+    double rps() const;
+};
+
+/// Generator obciążenia HTTP/1.1 na połączeniach trwałych
+/**
+ * W pętli zamkniętej każde połączenie wysyła kolejne zapytanie zaraz po odebraniu odpowiedzi,
+ * mierząc przepustowość serwera. W pętli otwartej zapytania wysyłane są według stałego harmonogramu,
+ * niezależnie od czasu odpowiedzi, a opóźnienie liczone jest od zaplanowanej chwili wysłania -
+ * opóźniona odpowiedź nie wstrzymuje więc pomiaru kolejnych zapytań (coordinated omission).
+ * Rodzaj każdego zapytania losowany jest według wag mieszanki.
+ * Odpowiedzi odczytywane są do końca ciała (Content-Length, chunked lub zamknięcie połączenia).
+ */
+class LoadGenerator
+{
+public:
+    LoadGenerator(const std::string& host, const std::string& port, std::vector<LoadRequest> mix, LoadSettings settings = LoadSettings());
+
+    /// Przeprowadza pomiar, blokując do jego zakończenia.
+    LoadReport run() const;
+
+    /// Tworzy zapytanie mieszanki z metody, ścieżki i opcjonalnego ciała.
+    static LoadRequest MakeRequest(const std::string& method, const std::string& path, unsigned weight, const std::string& body = "");
+
+private:
+    /// Generuje obciążenie na jednym połączeniu, zapisując wyniki w report.
+    void work(std::size_t connection, std::chrono::steady_clock::time_point start, LoadReport& report) const;
+
+    std::string host;
+    std::string port;
+    std::vector<LoadRequest> mix;
+    LoadSettings settings;
+};
+
+} // namespace Bench
+
+#endif // PATR_LOADGENERATOR_H
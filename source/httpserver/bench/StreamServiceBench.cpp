@@ -0,0 +1,385 @@
+#include "../Server.h"
+#include "../ServerUtilities.h"
+#include "../Socket.h"
+#include "../../bench/Benchmark.h"
+
+#if defined(PATR_OS_LINUX)
+
+#include <new>
+#include <array>
+#include <atomic>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <iomanip>
+#include <algorithm>
+
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/prctl.h>
+#include <sys/select.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
+
+namespace {
+
+    constexpr auto Host = "127.0.0.1";
+    constexpr auto Port = "9123";
+    /// Liczba mierzonych zapytań na każdą konfigurację.
+    constexpr int Requests = 500;
+    /// Liczba zapytań, dla których zliczane są wywołania systemowe (każde z nich jest przechwytywane).
+    constexpr int CountedRequests = 200;
+    /// Deskryptory zarezerwowane na potrzeby procesu poza połączeniami.
+    constexpr int ReservedHandles = 64;
+
+    typedef std::function<Http::Server::ServicePtr()> ServiceMaker;
+
+    /// Zwraca porównywane serwisy, io_uring tylko jeżeli obsługuje go jądro.
+    std::vector<std::pair<std::string, ServiceMaker>> Services()
+    {
+        std::vector<std::pair<std::string, ServiceMaker>> services = {
+            { "select", [] { return Http::Server::ServicePtr(new Tcp::StreamService()); } },
+            { "epoll", [] { return Http::Server::ServicePtr(new Tcp::EpollStreamService()); } }
+        };
+        if (Tcp::UringStreamService::Supported())
+            services.push_back({ "uring", [] { return Http::Server::ServicePtr(new Tcp::UringStreamService()); } });
+        return services;
+    }
+
+    /// Podnosi limit otwartych deskryptorów do maksymalnego dozwolonego.
+    rlim_t RaiseFileLimit()
+    {
+        auto limit = rlimit();
+        ::getrlimit(RLIMIT_NOFILE, &limit);
+        limit.rlim_cur = limit.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+        ::getrlimit(RLIMIT_NOFILE, &limit);
+        return limit.rlim_cur;
+    }
+
+    /// Zlicza wywołania systemowe bieżącego wątku w liczniku count.
+    /**
+     * Filtr seccomp przekazuje każde wywołanie wątku do nadzorcy, który je zlicza i pozwala
+     * kontynuować. Nadzorca uruchamiany jest przed instalacją filtra, więc sam mu nie podlega,
+     * podobnie jak wątki utworzone wcześniej. Przechwycone wywołania są wielokrotnie wolniejsze.
+     * @return false, jeżeli jądro nie pozwala zainstalować filtra.
+     */
+    bool CountSyscalls(std::atomic<long>& count)
+    {
+#if defined(SECCOMP_FILTER_FLAG_NEW_LISTENER) && defined(SECCOMP_USER_NOTIF_FLAG_CONTINUE)
+        // Nadzorca odczytuje uchwyt bez oczekiwania na zmiennej warunkowej - jej powiadomienie byłoby już przechwycone.
+        static std::atomic<int> listener(-1);
+        std::thread([&count]
+        {
+            int handle;
+            while ((handle = listener.load()) == -1)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            for (;;)
+            {
+                auto notification = seccomp_notif();
+                if (::ioctl(handle, SECCOMP_IOCTL_NOTIF_RECV, &notification) == -1)
+                {
+                    // ENOENT - wywołanie przerwane przed odebraniem (np. przez task_work io_uring), zostanie ponowione.
+                    if (errno == EINTR || errno == ENOENT)
+                        continue;
+                    return;
+                }
+                ++count;
+                auto response = seccomp_notif_resp();
+                response.id = notification.id;
+                response.flags = SECCOMP_USER_NOTIF_FLAG_CONTINUE;
+                ::ioctl(handle, SECCOMP_IOCTL_NOTIF_SEND, &response);
+            }
+        }).detach();
+
+        sock_filter filter[] = { BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_USER_NOTIF) };
+        sock_fprog program = { 1, filter };
+        ::prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+        auto handle = static_cast<int>(::syscall(__NR_seccomp, SECCOMP_SET_MODE_FILTER, SECCOMP_FILTER_FLAG_NEW_LISTENER, &program));
+        listener = handle == -1 ? -2 : handle;
+        return handle != -1;
+#else
+        (void)count;
+        return false;
+#endif
+    }
+
+    /// Sprawdza, czy na porcie serwera nasłuchuje jakiekolwiek gniazdo.
+    bool Listening()
+    {
+        int handle = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        sockaddr_in address = sockaddr_in();
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(std::stoi(Port)));
+        address.sin_addr.s_addr = inet_addr(Host);
+        auto connected = ::connect(handle, reinterpret_cast<sockaddr*>(&address), sizeof address) == 0;
+        ::close(handle);
+        return connected;
+    }
+
+    /// Uruchamia Http::Server z danym serwisem w procesie potomnym.
+    /**
+     * Osobny proces izoluje limity deskryptorów oraz globalny stan Tcp::SignalSet.
+     * Jeżeli podano syscalls (w pamięci współdzielonej), zliczane są w nim wywołania
+     * systemowe wątku serwisu, a -1 oznacza brak takiej możliwości.
+     */
+    class ServerProcess
+    {
+    public:
+        ServerProcess(ServiceMaker makeService, std::atomic<long>* syscalls = nullptr) : pid(::fork())
+        {
+            if (pid == 0)
+            {
+                ::prctl(PR_SET_PDEATHSIG, SIGKILL);
+                try
+                {
+                    Http::Server server(Host, Port, [](const Http::Request&)
+                    {
+                        return Http::Response(Http::Response::Status::Ok, "Ok", "text/plain");
+                    }, makeService());
+                    // Wątki puli obsługi istnieją już, więc filtr obejmuje wyłącznie wątek serwisu.
+                    if (syscalls && !CountSyscalls(*syscalls))
+                        *syscalls = -1;
+                    server.run();
+                }
+                catch (const std::exception&)
+                {
+                }
+                ::_exit(0);
+            }
+        }
+
+        ~ServerProcess()
+        {
+            ::kill(pid, SIGKILL);
+            ::waitpid(pid, nullptr, 0);
+            // Jądro kończy operacje io_uring zabitego procesu asynchronicznie - do tego czasu gniazdo nasłuchujące
+            // wciąż przyjmuje połączenia, które kolejny serwer otrzymałby zerwane.
+            for (int attempt = 0; attempt < 100 && Listening(); ++attempt)
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+    private:
+        pid_t pid;
+    };
+
+    /// Otwiera połączenie z serwerem, ponawiając próby do czasu jego uruchomienia.
+    Tcp::Socket Connect(Tcp::StreamServiceInterface& client)
+    {
+        for (int attempt = 0;; ++attempt)
+        {
+            try
+            {
+                return client.getFactory()->resolve(Host, Port)->connect(client);
+            }
+            catch (const Tcp::EndpointError&)
+            {
+                if (attempt > 100)
+                    throw;
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            }
+        }
+    }
+
+    /// Wykonuje pełne zapytanie na nowym połączeniu.
+    /**
+     * @return czas od nawiązania połączenia do odebrania odpowiedzi w [us].
+     */
+    double RoundTrip(Tcp::StreamServiceInterface& client)
+    {
+        static const std::string request = std::string("GET / HTTP/1.0") + Http::CRLF + Http::CRLF;
+        std::array<char, 512> buffer;
+
+        auto start = std::chrono::steady_clock::now();
+        auto socket = Connect(client);
+        socket.write(Tcp::MakeBuffer(request));
+        auto b = Tcp::MakeBuffer(buffer);
+        while (socket.readSome(b) > 0)
+            ;
+        socket.close();
+        return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /// Wykonuje kolejne zapytania na trwałym połączeniu, otwierając nowe, gdy serwer zamknie bieżące.
+    void KeepAlive(Tcp::StreamServiceInterface& client, int requests)
+    {
+        static const std::string request = std::string("GET / HTTP/1.1") + Http::CRLF + Http::CRLF;
+        static const std::string end = std::string(Http::CRLF) + Http::CRLF + "Ok";
+        std::array<char, 512> buffer;
+
+        auto socket = Connect(client);
+        for (int i = 0; i < requests; ++i)
+        {
+            socket.write(Tcp::MakeBuffer(request));
+            std::string response;
+            while (response.size() < end.size() || response.compare(response.size() - end.size(), end.size(), end) != 0)
+            {
+                auto b = Tcp::MakeBuffer(buffer);
+                auto bytes = socket.readSome(b);
+                if (bytes <= 0)
+                    break;
+                response.append(buffer.data(), bytes);
+            }
+            if (response.find("Connection: close") != std::string::npos) // wyczerpany limit KeepAlive::maxRequests.
+            {
+                socket.close();
+                socket = Connect(client);
+            }
+        }
+        socket.close();
+    }
+
+    /// Mierzy opóźnienia zapytań przy danej liczbie bezczynnych połączeń.
+    void Measure(std::ostream& out, const std::string& name, ServiceMaker makeService, int idle)
+    {
+        ServerProcess server(makeService);
+        Tcp::EpollStreamService client; // StreamService nie obsłuży deskryptorów powyżej FD_SETSIZE.
+
+        std::vector<Tcp::Socket> connections;
+        connections.reserve(idle);
+        static const std::string partial = "GET / HTTP/1.0"; // połączenie pozostaje w trakcie odczytu.
+        for (int i = 0; i < idle; ++i)
+        {
+            connections.push_back(Connect(client));
+            connections.back().write(Tcp::MakeBuffer(partial));
+        }
+
+        std::vector<double> latencies;
+        latencies.reserve(Requests);
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < Requests; ++i)
+            latencies.push_back(RoundTrip(client));
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::sort(latencies.begin(), latencies.end());
+        out << std::setw(8) << name
+            << std::setw(8) << idle
+            << std::setw(12) << std::fixed << std::setprecision(0) << Requests / elapsed
+            << std::setw(12) << std::setprecision(1) << latencies[latencies.size() / 2]
+            << std::setw(12) << latencies[latencies.size() * 99 / 100]
+            << std::endl;
+
+        for (auto& connection : connections)
+            connection.close();
+    }
+}
+
+/// Porównuje skalowanie StreamService (select), EpollStreamService i UringStreamService względem liczby otwartych połączeń.
+PATR_BENCHMARK(StreamServiceScaling)
+{
+    auto limit = RaiseFileLimit();
+    // Obie strony połączenia należą do procesów o tym samym limicie.
+    auto maxIdle = static_cast<int>(limit) - ReservedHandles;
+
+    auto services = Services();
+
+    out << std::setw(8) << "backend" << std::setw(8) << "idle" << std::setw(12) << "req/s"
+        << std::setw(12) << "p50 [us]" << std::setw(12) << "p99 [us]" << std::endl;
+
+    for (auto idle : { 0, 256, 900, 4000, 10000 })
+    {
+        for (auto& service : services)
+        {
+            if (idle > maxIdle)
+            {
+                out << std::setw(8) << service.first << std::setw(8) << idle << "  n/a (RLIMIT_NOFILE " << limit << ')' << std::endl;
+                continue;
+            }
+            if (service.first == "select" && idle + ReservedHandles >= FD_SETSIZE)
+            {
+                out << std::setw(8) << service.first << std::setw(8) << idle << "  n/a (FD_SETSIZE " << FD_SETSIZE << ')' << std::endl;
+                continue;
+            }
+            Measure(out, service.first, service.second, idle);
+        }
+    }
+}
+
+namespace {
+
+    /// Wykonuje count zapytań, na nowych połączeniach lub jednym trwałym, i zwraca czas w [s].
+    double Run(Tcp::StreamServiceInterface& client, bool keepAlive, int count)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (keepAlive)
+        {
+            KeepAlive(client, count);
+        }
+        else
+        {
+            for (int i = 0; i < count; ++i)
+                RoundTrip(client);
+        }
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /// Zwraca liczbę wywołań systemowych wątku serwisu na zapytanie, ujemną jeżeli nie można ich zliczyć.
+    double SyscallsPerRequest(ServiceMaker makeService, bool keepAlive)
+    {
+        auto memory = ::mmap(nullptr, sizeof(std::atomic<long>), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED)
+            return -1;
+        auto syscalls = new (memory) std::atomic<long>(0);
+
+        double result;
+        {
+            ServerProcess server(makeService, syscalls);
+            Tcp::EpollStreamService client;
+            Run(client, keepAlive, 10); // uruchomienie serwera i pierwsze połączenia nie są wliczane.
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+            auto before = syscalls->load();
+            Run(client, keepAlive, CountedRequests);
+            std::this_thread::sleep_for(std::chrono::milliseconds(100)); // zamknięcie ostatniego połączenia.
+            result = before < 0 ? -1 : double(syscalls->load() - before) / CountedRequests;
+        }
+        ::munmap(memory, sizeof(std::atomic<long>));
+        return result;
+    }
+}
+
+/// Porównuje przepustowość oraz liczbę wywołań systemowych serwisu na zapytanie dla każdego z serwisów.
+/**
+ * Zapytania wykonywane są kolejno, na nowych połączeniach (close) oraz na jednym połączeniu trwałym (keep-alive).
+ * Liczone są wyłącznie wywołania wątku serwisu - pula obsługi zapytań działa na osobnych wątkach.
+ */
+PATR_BENCHMARK(ServiceSyscalls)
+{
+    if (!Tcp::UringStreamService::Supported())
+        out << "io_uring is not supported by the kernel" << std::endl;
+
+    out << std::setw(8) << "backend" << std::setw(12) << "mode" << std::setw(12) << "req/s" << std::setw(14) << "syscalls/req" << std::endl;
+    for (auto& service : Services())
+    {
+        for (auto keepAlive : { false, true })
+        {
+            double elapsed;
+            {
+                ServerProcess server(service.second);
+                Tcp::EpollStreamService client;
+                Run(client, keepAlive, 10);
+                elapsed = Run(client, keepAlive, Requests);
+            }
+            auto syscalls = SyscallsPerRequest(service.second, keepAlive);
+
+            out << std::setw(8) << service.first
+                << std::setw(12) << (keepAlive ? "keep-alive" : "close")
+                << std::setw(12) << std::fixed << std::setprecision(0) << Requests / elapsed;
+            if (syscalls < 0)
+                out << std::setw(14) << "n/a" << std::endl;
+            else
+                out << std::setw(14) << std::setprecision(1) << syscalls << std::endl;
+        }
+    }
+}
+
+#endif // defined(PATR_OS_LINUX)
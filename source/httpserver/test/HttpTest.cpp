@@ -5,6 +5,33 @@
 #include "../ServerUtilities.h"
 #include "../Socket.h"
 
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#if defined(PATR_OS_UNIX)
+#    include <arpa/inet.h>
+#    include <fcntl.h>
+#    include <netinet/in.h>
+#    include <netinet/tcp.h>
+#    include <poll.h>
+#    include <sys/resource.h>
+#    include <sys/socket.h>
+#    include <sys/wait.h>
+#    include <unistd.h>
+#endif // defined(PATR_OS_UNIX)
+
 /// Testy sprawdzające poprawność parsera zapytań HTTP.
 BOOST_AUTO_TEST_SUITE(RequestParse)
 
@@ -73,6 +100,184 @@ BOOST_AUTO_TEST_CASE(RequestContents)
     BOOST_CHECK(request.body() == content);
 }
 
+/// Parsuje dane RequestScanner, przekazując je w kawałkach zakończonych na podanych pozycjach.
+/**
+ * @return wynik oraz liczba znaków nagłówka (dla Result::Good).
+ */
+std::pair<Http::RequestParser::Result, std::size_t> Scan(std::string input, const std::vector<std::size_t>& splits, Http::Request& request)
+{
+    Http::RequestScanner scanner;
+    std::size_t begin = 0;
+    for (auto split : splits)
+    {
+        BOOST_REQUIRE(begin <= split && split <= input.size());
+        auto result = scanner.parse(&input[0] + begin, &input[0] + split);
+        if (result.first == Http::RequestParser::Result::Good)
+            scanner.assign(request);
+        if (result.first != Http::RequestParser::Result::Indeterminate)
+            return std::make_pair(result.first, static_cast<std::size_t>(result.second - &input[0]));
+        begin = split;
+    }
+    return std::make_pair(Http::RequestParser::Result::Indeterminate, input.size());
+}
+
+/// Sprawdza czy nagłówek podzielony pomiędzy odczyty zostanie sparsowany jak przekazany w całości.
+BOOST_AUTO_TEST_CASE(ScannerSplitHeaders)
+{
+    std::string input = "POST /test?q=1 HTTP/1.1\r\nHost: localhost\r\nX-Folded: a\r\n \tb\r\nContent-Length: 2\r\n\r\nab";
+    auto head = input.size() - 2;
+
+    for (std::size_t split = 0; split <= input.size(); ++split)
+    {
+        Http::Request request;
+        auto result = Scan(input, { split, input.size() }, request);
+        BOOST_REQUIRE(result.first == Http::RequestParser::Result::Good);
+        BOOST_CHECK_EQUAL(result.second, head);
+        BOOST_CHECK(request.method() == "POST" && request.uri().raw() == "/test?q=1" && request.version() == "1.1");
+        BOOST_REQUIRE_EQUAL(request.headers().size(), 3U);
+        BOOST_CHECK(request.headers()[1] == Http::Header("X-Folded", "ab"));
+        BOOST_CHECK(request.headers()[2] == Http::Header("Content-Length", "2"));
+    }
+
+    std::vector<std::size_t> bytes;
+    for (std::size_t i = 1; i <= input.size(); ++i)
+        bytes.push_back(i);
+    Http::Request request;
+    BOOST_CHECK(Scan(input, bytes, request) == std::make_pair(Http::RequestParser::Result::Good, head));
+    std::string bad = "GET / HTTP/1.1\r\nBad header\r\n\r\n";
+    BOOST_CHECK(Scan(bad, { 20, bad.size() }, request).first == Http::RequestParser::Result::Bad);
+}
+
+/// Porównuje RequestScanner z RequestParser na korpusie zapytań poddawanych losowym mutacjom.
+/**
+ * Wyniki oraz zawartość poprawnych zapytań muszą być identyczne. RequestScanner zgłasza
+ * błędy po odczytaniu końca linii, więc dla zapytań niepoprawnych w ostatniej, niezakończonej
+ * linii sprawdzane jest, czy błąd zostanie wykryty po jej zakończeniu.
+ */
+BOOST_AUTO_TEST_CASE(ScannerDifferentialFuzz)
+{
+    const std::vector<std::string> corpus = {
+        "GET / HTTP/1.0\r\n\r\n",
+        "GET /index.html?a=1&b=%20 HTTP/1.1\r\nHost: example.com\r\nConnection: keep-alive\r\n\r\n",
+        "POST /api/flashcards HTTP/1.1\r\nContent-Type: application/json\r\nContent-Length: 12\r\n\r\n{\"id\": \"12\"}",
+        "PUT /x HTTP/1.1\r\nX-Folded: first\r\n\t second\r\n   \r\nX-Empty: \r\n\r\n",
+        "OPTIONS * HTTP/12.34\r\nUser-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/52.0 Safari/537.36\r\n"
+            "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/webp,*/*;q=0.8\r\nAccept-Encoding: gzip, deflate, sdch\r\n\r\n",
+        "GET /\xc5\xbc\xc3\xb3\xc5\x82w HTTP/1.1\r\nCookie: a=\xff\xfe\r\n\r\n",
+        "GET  HTTP/1.1\r\n\r\n",
+        "DELETE /a HTTP/1.1\r\nA:  \r\nB: x\r\n\r\nGET /b HTTP/1.1\r\n\r\n"
+    };
+    const std::string interesting("\r\n: \t/.H0\x7f\x80\0", 12);
+
+    std::mt19937 random(20161014);
+    auto below = [&random](std::size_t n) { return std::uniform_int_distribution<std::size_t>(0, n - 1)(random); };
+
+    for (int iteration = 0; iteration < 20000; ++iteration)
+    {
+        auto input = corpus[below(corpus.size())];
+        for (auto mutations = below(4); mutations > 0 && !input.empty(); --mutations)
+        {
+            auto position = below(input.size());
+            auto value = below(2) ? interesting[below(interesting.size())] : static_cast<char>(below(256));
+            switch (below(4))
+            {
+            case 0: input[position] = value; break;
+            case 1: input.insert(input.begin() + position, value); break;
+            case 2: input.erase(input.begin() + position); break;
+            default: input.resize(position); break;
+            }
+        }
+
+        Http::Request expected;
+        Http::RequestParser parser;
+        auto reference = parser.parse(input.begin(), input.end(), expected);
+
+        std::vector<std::size_t> splits;
+        for (auto chunks = below(3); chunks > 0 && !input.empty(); --chunks)
+            splits.push_back(below(input.size()));
+        splits.push_back(input.size());
+        std::sort(splits.begin(), splits.end());
+
+        Http::Request actual;
+        auto result = Scan(input, splits, actual);
+
+        if (reference.first == Http::RequestParser::Result::Good)
+        {
+            BOOST_REQUIRE_MESSAGE(result.first == reference.first, "input: " << input);
+            BOOST_REQUIRE_EQUAL(result.second, static_cast<std::size_t>(reference.second - input.begin()));
+            BOOST_REQUIRE(actual.method() == expected.method() && actual.uri().raw() == expected.uri().raw());
+            BOOST_REQUIRE(actual.version() == expected.version() && actual.headers() == expected.headers());
+        }
+        else if (reference.first == Http::RequestParser::Result::Bad && result.first == Http::RequestParser::Result::Indeterminate)
+        {
+            BOOST_REQUIRE_MESSAGE(Scan(input + Http::CRLF, { input.size() + 2 }, actual).first == Http::RequestParser::Result::Bad, "input: " << input);
+        }
+        else
+        {
+            BOOST_REQUIRE_MESSAGE(result.first == reference.first, "input: " << input);
+        }
+    }
+}
+
+/// Sprawdza czy nagłówek przekraczający ograniczenia zostanie odrzucony z odpowiednim statusem, także przed końcem linii.
+BOOST_AUTO_TEST_CASE(ScannerLimits)
+{
+    auto scan = [](std::string input, Http::ResponseStatus& status)
+    {
+        Http::RequestScanner scanner(Http::RequestLimits(32, 64, 3));
+        auto result = scanner.parse(&input[0], &input[0] + input.size()).first;
+        status = scanner.status();
+        return result;
+    };
+    Http::ResponseStatus status;
+
+    BOOST_CHECK(scan("GET /within-limits HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\n\r\n", status) == Http::RequestParser::Result::Good);
+    BOOST_CHECK(scan("GET /" + std::string(32, 'a') + " HTTP/1.1\r\n\r\n", status) == Http::RequestParser::Result::Bad);
+    BOOST_CHECK(status == Http::ResponseStatus::RequestUriTooLarge);
+    BOOST_CHECK(scan("GET /" + std::string(32, 'a'), status) == Http::RequestParser::Result::Bad); // Niezakończona linia.
+    BOOST_CHECK(status == Http::ResponseStatus::RequestUriTooLarge);
+    BOOST_CHECK(scan("GET / HTTP/1.1\r\nA: 1\r\nB: 2\r\nC: 3\r\nD: 4\r\n\r\n", status) == Http::RequestParser::Result::Bad);
+    BOOST_CHECK(status == Http::ResponseStatus::RequestHeaderFieldsTooLarge);
+    BOOST_CHECK(scan("GET / HTTP/1.1\r\nCookie: " + std::string(64, 'c'), status) == Http::RequestParser::Result::Bad);
+    BOOST_CHECK(status == Http::ResponseStatus::RequestHeaderFieldsTooLarge);
+    BOOST_CHECK(scan("GET / HTTP/1.1\r\nBad header\r\n\r\n", status) == Http::RequestParser::Result::Bad);
+    BOOST_CHECK(status == Http::ResponseStatus::BadRequest);
+}
+
+/// Sprawdza czy widok URI dzieli ścieżkę i argumenty GET zgodnie z Uri::segments() i Uri::query().
+BOOST_AUTO_TEST_CASE(UriViewParts)
+{
+    Http::Uri uri("/api/items/42?sort=asc&&flag&limit=10#top");
+    Http::UriView view(uri);
+    BOOST_CHECK_EQUAL(view.path().str(), "/api/items/42");
+    BOOST_CHECK_EQUAL(view.query().str(), "sort=asc&&flag&limit=10");
+
+    std::vector<std::string> segments;
+    std::size_t position = 0;
+    Http::Slice segment, value;
+    while (view.segment(position, segment))
+        segments.push_back(segment.str());
+    BOOST_CHECK((segments == std::vector<std::string>{"api", "items", "42"}));
+
+    std::vector<std::string> parameters;
+    position = 0;
+    while (view.parameter(position, segment, value))
+        parameters.push_back(segment.str() + '=' + value.str());
+    BOOST_CHECK((parameters == std::vector<std::string>{"sort=asc", "flag=", "limit=10"}));
+
+    BOOST_REQUIRE(view.parameter("limit", value));
+    BOOST_CHECK(value.equals("10"));
+    BOOST_CHECK(!view.parameter("lim", value));
+
+    Http::UriView root("/", 1), trailing("/dir/", 5);
+    position = 0;
+    BOOST_CHECK(root.segment(position, segment) && segment.size == 0 && !root.segment(position, segment));
+    position = 0;
+    BOOST_CHECK(trailing.segment(position, segment) && segment.equals("dir"));
+    BOOST_CHECK(trailing.segment(position, segment) && segment.size == 0 && !trailing.segment(position, segment));
+    BOOST_CHECK(root.query().size == 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 /// Testy sprawdzające poprawność klasy odpowiedzialnej za odpowiedzi HTTP od serwera.
@@ -89,13 +294,444 @@ BOOST_AUTO_TEST_CASE(ResponseContents)
     BOOST_CHECK(response.status() == Http::ResponseStatus::Ok);
 }
 
+/// Sprawdza czy sekwencja buforów odpowiada postaci tekstowej odpowiedzi.
+BOOST_AUTO_TEST_CASE(ResponseBuffers)
+{
+    Http::Response response(Http::ResponseStatus::Ok, "body", "text/plain");
+    response.headers.push_back(Http::Header("Connection", "close"));
+
+    std::string joined;
+    for (const auto& buffer : response.buffers())
+        joined.append(buffer.first, buffer.second);
+    BOOST_CHECK(joined == response.raw());
+    BOOST_CHECK(joined == "HTTP/1.1 200 OK\r\nContent-Length: 4\r\nContent-Type: text/plain\r\nConnection: close\r\n\r\nbody");
+}
+
+/// Sprawdza czy linie statusu spoza dotychczasowych odpowiedzi zostaną uzupełnione.
+BOOST_AUTO_TEST_CASE(StatusLines)
+{
+    auto line = [](Http::ResponseStatus status)
+    {
+        auto raw = Http::Response(status, "", "").raw();
+        return raw.substr(0, raw.find(Http::CRLF) + 2);
+    };
+    BOOST_CHECK(line(Http::ResponseStatus::MethodNotAllowed) == "HTTP/1.1 405 Method Not Allowed\r\n");
+    BOOST_CHECK(line(Http::ResponseStatus::NotFound) == "HTTP/1.1 404 Not Found\r\n");
+    BOOST_CHECK(line(Http::ResponseStatus::HttpVersionNotSupported) == "HTTP/1.1 505 HTTP Version Not Supported\r\n");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
-#include <sstream>
+/// Parsuje nagłówek zapytania i odbiera jego ciało, przekazując dane po jednym znaku.
+/**
+ * @return wynik odbioru oraz pozostałe po ciele dane.
+ */
+std::pair<Http::BodyReader::Result, std::string> ReceiveBody(std::string input, Http::BodyReader& reader, Http::Request& request)
+{
+    Http::RequestScanner scanner;
+    auto head = scanner.parse(&input[0], &input[0] + input.size());
+    BOOST_REQUIRE(head.first == Http::RequestParser::Result::Good);
+    scanner.assign(request);
+
+    auto result = reader.start(request);
+    if (result != Http::BodyReader::Result::Good)
+        return std::make_pair(result, std::string());
+
+    for (auto begin = head.second, end = &input[0] + input.size(); ; ++begin)
+    {
+        auto read = reader.read(begin, begin == end ? end : begin + 1, request);
+        if (read.first != Http::BodyReader::Result::Indeterminate)
+            return std::make_pair(read.first, std::string(read.second, end));
+        if (begin == end)
+            return std::make_pair(read.first, std::string());
+    }
+}
+
+/// Testy sprawdzające poprawność odbioru ciała zapytania.
+BOOST_AUTO_TEST_SUITE(RequestBody)
+
+/// Sprawdza czy ciało o znanej długości zostanie odebrane, a dane kolejnego zapytania pominięte.
+BOOST_AUTO_TEST_CASE(ContentLengthBody)
+{
+    Http::BodyReader reader;
+    Http::Request request;
+    auto result = ReceiveBody("POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\n0123456789GET", reader, request);
+    BOOST_REQUIRE(result.first == Http::BodyReader::Result::Good);
+    BOOST_CHECK_EQUAL(request.body(), "0123456789");
+    BOOST_CHECK_EQUAL(result.second, "GET");
+}
+
+/// Sprawdza czy ciało przesłane kawałkami zostanie zdekodowane wraz z rozszerzeniami i nagłówkami końcowymi.
+BOOST_AUTO_TEST_CASE(ChunkedBody)
+{
+    Http::BodyReader reader;
+    Http::Request request;
+    auto result = ReceiveBody("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+        "4\r\nWiki\r\n5;name=value\r\npedia\r\nE\r\n in\r\n\r\nchunks.\r\n0\r\nExpires: never\r\n\r\nGET", reader, request);
+    BOOST_REQUIRE(result.first == Http::BodyReader::Result::Good);
+    BOOST_CHECK_EQUAL(request.body(), "Wikipedia in\r\n\r\nchunks.");
+    BOOST_CHECK_EQUAL(result.second, "GET");
+    BOOST_REQUIRE_EQUAL(request.headers().size(), 1U);
+    BOOST_CHECK(request.headers()[0] == Http::Header("Content-Length", "23"));
+
+    BOOST_CHECK(ReceiveBody("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n4\r\nWikiX", reader, request).first == Http::BodyReader::Result::Bad);
+    BOOST_CHECK(ReceiveBody("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nz\r\n", reader, request).first == Http::BodyReader::Result::Bad);
+    BOOST_CHECK(ReceiveBody("POST / HTTP/1.1\r\nTransfer-Encoding: gzip\r\n\r\n", reader, request).first == Http::BodyReader::Result::Unsupported);
+    BOOST_CHECK(ReceiveBody("POST / HTTP/1.1\r\nContent-Length: 1x\r\n\r\n", reader, request).first == Http::BodyReader::Result::Bad);
+}
+
+/// Sprawdza czy zbyt duże ciało zostanie odrzucone, w miarę możliwości przed jego odebraniem.
+BOOST_AUTO_TEST_CASE(BodyLimit)
+{
+    Http::BodyReader reader(Http::BodyLimits(16));
+    Http::Request request;
+    BOOST_CHECK(ReceiveBody("POST / HTTP/1.1\r\nContent-Length: 17\r\n\r\n", reader, request).first == Http::BodyReader::Result::TooLarge);
+    BOOST_CHECK(ReceiveBody("POST / HTTP/1.1\r\nContent-Length: 99999999999999999999999\r\n\r\n", reader, request).first == Http::BodyReader::Result::TooLarge);
+    BOOST_CHECK(ReceiveBody("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n11\r\n", reader, request).first == Http::BodyReader::Result::TooLarge);
+    BOOST_CHECK(ReceiveBody("POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n8\r\n01234567\r\n9\r\n012345678\r\n0\r\n\r\n", reader, request).first == Http::BodyReader::Result::TooLarge);
+}
+
+/// Sprawdza czy ciało większe od progu zostanie zapisane do pliku tymczasowego usuwanego wraz z zapytaniem.
+BOOST_AUTO_TEST_CASE(SpillToFile)
+{
+    std::string content(1000, 'x');
+    std::string path;
+    {
+        Http::BodyReader reader(Http::BodyLimits(4096, 100));
+        Http::Request request;
+        auto result = ReceiveBody("POST / HTTP/1.1\r\nContent-Length: 1000\r\n\r\n" + content, reader, request);
+        BOOST_REQUIRE(result.first == Http::BodyReader::Result::Good);
+        BOOST_CHECK(request.body().empty());
+
+        path = request.bodyFile();
+        BOOST_REQUIRE(!path.empty());
+        std::ifstream file(path, std::ios::binary);
+        BOOST_CHECK(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()) == content);
+    }
+    BOOST_CHECK(!std::ifstream(path).good());
+}
+
+#if defined(PATR_OS_UNIX)
+/// Sprawdza czy nieudany zapis do pliku tymczasowego pozostawi ciało w pamięci lub zostanie zgłoszony jako błąd serwera.
+BOOST_AUTO_TEST_CASE(SpillWriteFailure)
+{
+    rlimit previous;
+    BOOST_REQUIRE(::getrlimit(RLIMIT_FSIZE, &previous) == 0);
+    auto handler = std::signal(SIGXFSZ, SIG_IGN); // Przekroczenie limitu zgłaszane jest błędem zapisu.
+    rlimit limit = previous;
+    limit.rlim_cur = 1000;
+    BOOST_REQUIRE(::setrlimit(RLIMIT_FSIZE, &limit) == 0);
+
+    std::string content(8000, 'x');
+    Http::Request request;
+    Http::BodyReader spilled(Http::BodyLimits(16000, 7000)); // Przeniesienie odebranej części nie mieści się w pliku.
+    auto kept = ReceiveBody("POST / HTTP/1.1\r\nContent-Length: 8000\r\n\r\n" + content, spilled, request).first;
+    auto body = request.body();
+
+    Http::BodyReader streamed(Http::BodyLimits(16000, 100)); // Kolejne dane ciała nie mieszczą się w pliku.
+    Http::Request next;
+    auto failed = ReceiveBody("POST / HTTP/1.1\r\nContent-Length: 8000\r\n\r\n" + content, streamed, next).first;
+
+    ::setrlimit(RLIMIT_FSIZE, &previous);
+    std::signal(SIGXFSZ, handler);
+    BOOST_CHECK(kept == Http::BodyReader::Result::Good);
+    BOOST_CHECK(body == content);
+    BOOST_CHECK(failed == Http::BodyReader::Result::Failed);
+}
+#endif // defined(PATR_OS_UNIX)
+
+/// Sprawdza czy ciało zostanie przekazane do odbiorcy dostarczonego przez użytkownika.
+BOOST_AUTO_TEST_CASE(BodySinkReceivesData)
+{
+    struct StringSink : public Http::BodySink
+    {
+        bool write(const char* data, std::size_t size) override
+        {
+            received.append(data, size);
+            return true;
+        }
+        std::string received;
+    };
+
+    Http::BodyLimits limits;
+    limits.sink = [](const Http::Request& request) -> std::shared_ptr<Http::BodySink>
+    {
+        if (request.uri().raw() == "/upload")
+            return std::make_shared<StringSink>();
+        return nullptr;
+    };
+    Http::BodyReader reader(limits);
+    Http::Request request;
+    auto result = ReceiveBody("POST /upload HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n", reader, request);
+    BOOST_REQUIRE(result.first == Http::BodyReader::Result::Good);
+    BOOST_CHECK(request.body().empty());
+    BOOST_REQUIRE(request.bodySink());
+    BOOST_CHECK_EQUAL(static_cast<StringSink&>(*request.bodySink()).received, "abc");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+namespace {
+
+    /// Zamienia zapis szesnastkowy na ciąg bajtów.
+    std::string FromHex(const std::string& hex)
+    {
+        std::string bytes;
+        for (std::size_t i = 0; i + 1 < hex.size(); i += 2)
+            bytes.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+        return bytes;
+    }
+
+    /// Tworzy ramkę HTTP/2 o podanym typie, flagach i identyfikatorze strumienia.
+    std::string Frame(std::uint8_t type, std::uint8_t flags, std::uint32_t stream, const std::string& payload = std::string())
+    {
+        std::string frame;
+        frame.push_back(static_cast<char>(payload.size() >> 16));
+        frame.push_back(static_cast<char>(payload.size() >> 8));
+        frame.push_back(static_cast<char>(payload.size()));
+        frame.push_back(static_cast<char>(type));
+        frame.push_back(static_cast<char>(flags));
+        for (int shift = 24; shift >= 0; shift -= 8)
+            frame.push_back(static_cast<char>(stream >> shift));
+        return frame + payload;
+    }
+
+    /// Ramka HTTP/2 odczytana z danych wysłanych przez serwer.
+    struct ReceivedFrame
+    {
+        std::uint8_t type;
+        std::uint8_t flags;
+        std::uint32_t stream;
+        std::string payload;
+    };
+
+    /// Dzieli dane na kompletne ramki HTTP/2, pozostawiając w buforze niepełną końcówkę.
+    std::vector<ReceivedFrame> Frames(std::string& data)
+    {
+        std::vector<ReceivedFrame> frames;
+        std::size_t offset = 0;
+        while (data.size() - offset >= 9)
+        {
+            auto byte = [&](std::size_t i) { return static_cast<std::uint32_t>(static_cast<unsigned char>(data[offset + i])); };
+            std::size_t length = (byte(0) << 16) | (byte(1) << 8) | byte(2);
+            if (data.size() - offset - 9 < length)
+                break;
+            ReceivedFrame frame{static_cast<std::uint8_t>(byte(3)), static_cast<std::uint8_t>(byte(4)),
+                ((byte(5) << 24) | (byte(6) << 16) | (byte(7) << 8) | byte(8)) & 0x7fffffffU, data.substr(offset + 9, length)};
+            frames.push_back(std::move(frame));
+            offset += 9 + length;
+        }
+        data.erase(0, offset);
+        return frames;
+    }
+
+    /// Tworzy blok z nagłówkiem o długiej wartości dodawanym do tablicy dynamicznej i count odwołaniami do niego.
+    std::string HeaderBomb(std::size_t value, std::size_t count)
+    {
+        std::string block("\x40\x06x-bomb", 8); // literał z indeksowaniem i nową nazwą.
+        if (value < 0x7f)
+            block.push_back(static_cast<char>(value));
+        else
+        {
+            block.push_back('\x7f');
+            auto rest = value - 0x7f;
+            for (; rest >= 0x80; rest >>= 7)
+                block.push_back(static_cast<char>((rest & 0x7f) | 0x80));
+            block.push_back(static_cast<char>(rest));
+        }
+        block.append(value, 'x');
+        return block + std::string(count, '\xbe'); // indeks 62 - najnowszy wpis tablicy dynamicznej.
+    }
+
+    /// Początek połączenia h2c - zapowiedź z prior knowledge i pusta ramka SETTINGS.
+    const std::string ClientPreface = std::string("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n") + Frame(4, 0, 0);
+
+    /// Blok nagłówków zapytania GET o podaną ścieżkę, zakodowany bez indeksowania i bez kodu Huffmana.
+    std::string RequestBlock(const std::string& path)
+    {
+        return std::string("\x82\x86\x04", 3) + static_cast<char>(path.size()) + path + FromHex("410f7777772e6578616d706c652e636f6d");
+    }
+}
+
+/// Testy kompresji nagłówków HPACK (RFC 7541).
+BOOST_AUTO_TEST_SUITE(HeaderCompression)
+
+/// Sprawdza dekodowanie przykładów z RFC 7541 (C.3 i C.4) wraz z użyciem tablicy dynamicznej.
+BOOST_AUTO_TEST_CASE(DecodeRfcExamples)
+{
+    const std::vector<std::vector<std::string>> examples = {
+        {"828684410f7777772e6578616d706c652e636f6d", "828684be58086e6f2d6361636865",
+            "828785bf400a637573746f6d2d6b65790c637573746f6d2d76616c7565"},
+        {"828684418cf1e3c2e5f23a6ba0ab90f4ff", "828684be5886a8eb10649cbf", "828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf"}};
+    const std::vector<Http::HeaderContainer> expected = {
+        {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}},
+        {{":method", "GET"}, {":scheme", "http"}, {":path", "/"}, {":authority", "www.example.com"}, {"cache-control", "no-cache"}},
+        {{":method", "GET"}, {":scheme", "https"}, {":path", "/index.html"}, {":authority", "www.example.com"}, {"custom-key", "custom-value"}}};
+
+    for (const auto& blocks : examples)
+    {
+        Http::HpackDecoder decoder;
+        for (std::size_t i = 0; i < blocks.size(); ++i)
+        {
+            auto block = FromHex(blocks[i]);
+            Http::HeaderContainer headers;
+            BOOST_REQUIRE(decoder.decode(block.data(), block.size(), headers));
+            BOOST_CHECK(headers == expected[i]);
+        }
+    }
+
+    Http::HpackDecoder decoder;
+    Http::HeaderContainer headers;
+    auto invalid = FromHex("be"); // indeks spoza pustej tablicy dynamicznej.
+    BOOST_CHECK(!decoder.decode(invalid.data(), invalid.size(), headers));
+    auto padding = FromHex("418cf1e3c2e5f23a6ba0ab90f400"); // dopełnienie kodu Huffmana musi składać się z jedynek.
+    BOOST_CHECK(!decoder.decode(padding.data(), padding.size(), headers));
+}
+
+/// Sprawdza czy koder indeksuje powtarzające się nagłówki, a dekoder odtwarza je bez zmian.
+BOOST_AUTO_TEST_CASE(EncoderRoundTrip)
+{
+    Http::HpackEncoder encoder;
+    Http::HpackDecoder decoder;
+    std::vector<std::size_t> sizes;
+    for (int i = 0; i < 3; ++i)
+    {
+        Http::HeaderContainer headers = {{":status", "200"}, {"content-type", "text/plain"}, {"content-length", std::to_string(10 + i)},
+            {"x-request", "identifier"}};
+        std::string block;
+        encoder.encode(headers, block);
+        sizes.push_back(block.size());
+
+        Http::HeaderContainer decoded;
+        BOOST_REQUIRE(decoder.decode(block.data(), block.size(), decoded));
+        BOOST_CHECK(decoded == headers);
+    }
+    BOOST_CHECK(sizes[1] < sizes[0]);
+}
+
+/// Sprawdza czy odwołania do dużego wpisu tablicy nie są rozwijane po przekroczeniu limitów, a tablica pozostaje zgodna z koderem.
+BOOST_AUTO_TEST_CASE(BoundedDecoding)
+{
+    Http::HpackDecoder decoder;
+    auto bomb = HeaderBomb(4000, 10000) + HeaderBomb(100, 0); // ostatni wpis dodawany jest po przekroczeniu limitu.
+    Http::HeaderContainer headers;
+    bool exceeded;
+    BOOST_REQUIRE(decoder.decode(bomb.data(), bomb.size(), headers, 32 * 1024, 100, exceeded));
+    BOOST_CHECK(exceeded);
+    BOOST_CHECK(headers.empty());
+
+    std::string next("\xbe", 1);
+    BOOST_REQUIRE(decoder.decode(next.data(), next.size(), headers, 32 * 1024, 100, exceeded));
+    BOOST_CHECK(!exceeded);
+    BOOST_REQUIRE_EQUAL(headers.size(), 1U);
+    BOOST_CHECK(headers[0] == Http::Header("x-bomb", std::string(100, 'x')));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/// Testy sesji HTTP/2 niezależne od gniazd.
+BOOST_AUTO_TEST_SUITE(Http2Framing)
+
+/// Sprawdza czy ciało odpowiedzi jest wysyłane wyłącznie w granicach okna kontroli przepływu klienta.
+BOOST_AUTO_TEST_CASE(FlowControlWindow)
+{
+    std::string output;
+    std::vector<std::uint32_t> dispatched;
+    Http::Http2Session session([&output](std::string frames, std::size_t) { output += frames; },
+        [&dispatched](std::uint32_t stream, Http::Request request)
+        {
+            BOOST_CHECK_EQUAL(request.uri().raw(), "/large");
+            const auto& headers = request.headers();
+            BOOST_CHECK(std::find(headers.begin(), headers.end(), Http::Header("Host", "www.example.com")) != headers.end());
+            dispatched.push_back(stream);
+        });
+
+    auto start = ClientPreface.substr(18) + Frame(1, 0x5, 1, RequestBlock("/large"));
+    BOOST_REQUIRE(session.consume(start.data(), start.data() + start.size()));
+    BOOST_REQUIRE_EQUAL(dispatched.size(), 1U);
+
+    session.respond(1, Http::Response(Http::ResponseStatus::Ok, std::string(100000, 'x'), "text/plain"));
+    auto sent = [&output]
+    {
+        std::size_t bytes = 0;
+        bool ended = false;
+        for (const auto& frame : Frames(output))
+            if (frame.type == 0 && frame.stream == 1)
+            {
+                bytes += frame.payload.size();
+                ended = ended || (frame.flags & 0x1);
+            }
+        return std::make_pair(bytes, ended);
+    };
+    auto first = sent();
+    BOOST_CHECK_EQUAL(first.first, 65535U); // domyślne okno strumienia i połączenia.
+    BOOST_CHECK(!first.second);
+
+    auto update = Frame(8, 0, 0, FromHex("00010000"));
+    BOOST_REQUIRE(session.consume(update.data(), update.data() + update.size()));
+    BOOST_CHECK_EQUAL(sent().first, 0U); // okno strumienia wciąż jest wyczerpane.
+
+    update = Frame(8, 0, 1, FromHex("00010000"));
+    BOOST_REQUIRE(session.consume(update.data(), update.data() + update.size()));
+    auto second = sent();
+    BOOST_CHECK_EQUAL(second.first, 100000U - 65535U);
+    BOOST_CHECK(second.second);
+    BOOST_CHECK(session.idle());
+}
+
+/// Sprawdza czy blok nagłówków rozwijający się ponad limit zostanie odrzucony odpowiedzią 431 bez zamykania sesji.
+BOOST_AUTO_TEST_CASE(HeaderListBomb)
+{
+    std::string output;
+    std::vector<std::string> dispatched;
+    Http::Http2Session session([&output](std::string frames, std::size_t) { output += frames; },
+        [&dispatched](std::uint32_t, Http::Request request) { dispatched.push_back(request.uri().raw()); });
+
+    auto input = ClientPreface.substr(18) + Frame(1, 0x5, 1, RequestBlock("/bomb") + HeaderBomb(4000, 10000))
+        + Frame(1, 0x5, 3, RequestBlock("/next"));
+    BOOST_REQUIRE(session.consume(input.data(), input.data() + input.size()));
+    BOOST_CHECK(dispatched == std::vector<std::string>({ "/next" }));
+
+    auto frames = Frames(output);
+    auto rejected = std::find_if(frames.begin(), frames.end(), [](const ReceivedFrame& frame) { return frame.type == 1 && frame.stream == 1; });
+    BOOST_REQUIRE(rejected != frames.end());
+    BOOST_CHECK(rejected->payload.find("431") != std::string::npos);
+}
+
+/// Sprawdza czy naruszenie protokołu kończy sesję ramką GOAWAY.
+BOOST_AUTO_TEST_CASE(ProtocolError)
+{
+    std::string output;
+    Http::Http2Session session([&output](std::string frames, std::size_t) { output += frames; }, [](std::uint32_t, Http::Request) {});
+
+    auto input = ClientPreface.substr(18) + Frame(1, 0x5, 2, RequestBlock("/")); // strumienie klienta mają nieparzyste numery.
+    BOOST_CHECK(!session.consume(input.data(), input.data() + input.size()));
+    BOOST_CHECK(session.finished());
+
+    auto frames = Frames(output);
+    BOOST_REQUIRE(!frames.empty());
+    BOOST_CHECK_EQUAL(frames.back().type, 7U);
+    BOOST_CHECK_EQUAL(frames.back().payload.substr(4), FromHex("00000001"));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
 
 /// Klasa imitująca StreamService.
 class ServiceMock : public Tcp::StreamServiceInterface
 {
+public:
+    std::size_t pendingTimers() const
+    {
+        return timers.size();
+    }
+
+    /// Wywołuje zlecone zadanie natychmiast, w miejsce wątku serwisu.
+    void post(PostHandler handler) override
+    {
+        handler();
+    }
+
+private:
     int run() override
     {
         return 0;
@@ -127,6 +763,11 @@ public:
     }
 
 private:
+    using SocketInterface::readSome;
+    using SocketInterface::asyncReadSome;
+    using SocketInterface::writeSome;
+    using SocketInterface::asyncWriteSome;
+
     int read(BufferType & buffer) override
     {
         if (closed)
@@ -149,6 +790,10 @@ private:
         auto bytes = readSome(buffer);
         handler(bytes <= 0, bytes);
     }
+    void asyncReadSome(BufferSource source, ReadHandler handler) override
+    {
+        asyncReadSome(source(), std::move(handler));
+    }
     int write(const ConstBufferType & buffer) override
     {
         if (closed && !writer.str().empty())
@@ -164,7 +809,29 @@ private:
     }
     void asyncWriteSome(const ConstBufferType& buffer, WriteHandler handler) override
     {
-        throw Tcp::NotImplemented("");
+        int bytes = -1;
+        try
+        {
+            bytes = write(buffer);
+        }
+        catch (const Tcp::SendError&)
+        {
+        }
+        handler(bytes < 0, bytes);
+    }
+    void asyncWriteSome(const ConstBufferSequenceType& buffers, WriteHandler handler) override
+    {
+        int bytes = 0;
+        try
+        {
+            for (const auto& buffer : buffers)
+                bytes += write(buffer);
+        }
+        catch (const Tcp::SendError&)
+        {
+            bytes = -1;
+        }
+        handler(bytes < 0, bytes);
     }
     void close() override
     {
@@ -250,6 +917,29 @@ BOOST_AUTO_TEST_CASE(ConnectionValidity)
     BOOST_CHECK(globalWriter.str() == response.raw());
 }
 
+/// Sprawdza czy zapytanie o zbyt dużym ciele zostanie odrzucone bez wywołania funkcji obsługującej.
+BOOST_AUTO_TEST_CASE(ConnectionBodyTooLarge)
+{
+    ServiceMock service;
+    std::ostringstream globalWriter;
+    bool called = false;
+    auto socket = std::unique_ptr<Tcp::SocketInterface>(new SocketMock("POST / HTTP/1.0\r\nContent-Length: 100\r\n\r\n", service, nullptr, &globalWriter));
+    {
+        Http::ThreadedHandlerStrategy handler([&called](const Http::Request&)
+        {
+            called = true;
+            return Http::Response(Http::ResponseStatus::Ok, "", "");
+        }
+        );
+
+        BOOST_REQUIRE_NO_THROW(
+            handler.start(std::make_shared<Http::Connection>(Tcp::Socket(std::move(socket)), handler, Http::KeepAlive(), Http::BodyLimits(16))));
+    }
+
+    BOOST_CHECK(!called);
+    BOOST_CHECK(globalWriter.str().find("413") != std::string::npos);
+}
+
 /// Sprawdza czy połączenie poprawnie reaguje na niespodziewane zamknięcie po stronie klienta.
 BOOST_AUTO_TEST_CASE(ConnectionSendClosed)
 {
@@ -292,3 +982,1758 @@ BOOST_AUTO_TEST_CASE(ConnectionClose)
 }
 
 BOOST_AUTO_TEST_SUITE_END()
+
+/// Testy sprawdzające kontrolę przyjmowania zapytań przy przeciążeniu.
+BOOST_AUTO_TEST_SUITE(LoadShedding)
+
+/// Sprawdza czy limit rośnie przy stałym opóźnieniu i maleje, gdy opóźnienie rośnie.
+BOOST_AUTO_TEST_CASE(AdaptiveLimit)
+{
+    Http::ConcurrencyLimit limit(4, 2, 100);
+    for (int i = 0; i < 4; ++i)
+        BOOST_REQUIRE(limit.acquire());
+    BOOST_CHECK(!limit.acquire());
+    BOOST_CHECK_EQUAL(limit.statistics().rejected, 1U);
+
+    for (int i = 0; i < 200; ++i) // Stałe opóźnienie przy pełnym wykorzystaniu limitu.
+    {
+        limit.release(std::chrono::milliseconds(10));
+        while (limit.acquire()) {}
+    }
+    auto grown = limit.statistics().limit;
+    BOOST_CHECK_GT(grown, 4U);
+
+    for (int i = 0; i < 200; ++i) // Opóźnienie rosnące wraz z kolejką.
+    {
+        limit.release(std::chrono::milliseconds(100));
+        while (limit.acquire()) {}
+    }
+    BOOST_CHECK_LT(limit.statistics().limit, grown);
+    BOOST_CHECK_GE(limit.statistics().limit, 2U);
+    BOOST_CHECK_GE(limit.retryAfter(), 1U);
+}
+
+/// Sprawdza czy ustalona kolejka (stała liczba klientów w pętli zamkniętej) nie utrzymuje limitu na minimum.
+BOOST_AUTO_TEST_CASE(StandingQueue)
+{
+    Http::ConcurrencyLimit limit(16, 2, 100);
+    for (int i = 0; i < 5000; ++i)
+    {
+        while (limit.acquire()) {}
+        limit.release(std::chrono::milliseconds(i % 50 ? 16 : 1)); // Tylko nieliczne zapytania nie oczekują w kolejce.
+    }
+    BOOST_CHECK_GE(limit.statistics().limit, 16U);
+}
+
+/// Sprawdza czy zapytania ponad limit są odrzucane natychmiast statusem 503 z nagłówkiem Retry-After.
+BOOST_AUTO_TEST_CASE(ShedsOverload)
+{
+    std::atomic<int> handled(0);
+    std::vector<Http::Response> rejected;
+    {
+        Http::ThreadedHandlerStrategy strategy([&handled](const Http::Request&)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            ++handled;
+            return Http::Response(Http::ResponseStatus::Ok, "", "");
+        }, 5000U, 1U);
+
+        for (int i = 0; i < 20; ++i)
+        {
+            strategy.handle([&rejected](Http::HandlerStrategy::RequestHandler handler)
+            {
+                auto response = handler(Http::Request());
+                if (response.status() == Http::ResponseStatus::ServiceUnavailable)
+                    rejected.push_back(response); // Odrzucenie następuje na wątku wywołującym.
+            });
+        }
+
+        BOOST_CHECK_EQUAL(strategy.admission().rejected, rejected.size());
+    }
+
+    BOOST_CHECK_EQUAL(handled + rejected.size(), 20U);
+    BOOST_REQUIRE(!rejected.empty());
+    auto& headers = rejected.front().headers;
+    BOOST_CHECK(std::find_if(headers.begin(), headers.end(), [](const Http::Header& header) { return header.first == "Retry-After"; }) != headers.end());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#if defined(PATR_OS_LINUX)
+/// Testy sprawdzające poprawność serwisu opartego na epoll.
+BOOST_AUTO_TEST_SUITE(EpollService)
+
+/// Sprawdza czy dane zapisane przed uruchomieniem serwisu zostaną odczytane w całości mimo trybu edge-triggered.
+BOOST_AUTO_TEST_CASE(EdgeTriggeredRead)
+{
+    int fds[2];
+    BOOST_REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    Tcp::EpollStreamService service;
+    int sigVal = 0;
+    bool sigFlag = false;
+    Tcp::SignalService signal(sigVal, sigFlag);
+    service.add(&signal);
+
+    std::string message = "GET / HTTP/1.0\r\n\r\n";
+    BOOST_REQUIRE(::write(fds[1], message.data(), message.size()) == static_cast<ssize_t>(message.size()));
+
+    Tcp::Socket socket(std::unique_ptr<Tcp::SocketInterface>(new Tcp::SocketImplementation(service, fds[0])));
+    std::array<char, 4> buffer;
+    std::string received;
+    std::function<void(int, std::size_t)> handler = [&](int ec, std::size_t bytes)
+    {
+        received.append(buffer.data(), bytes);
+        if (ec || received.size() == message.size())
+            sigFlag = true;
+        else
+            socket.asyncReadSome(Tcp::MakeBuffer(buffer), handler);
+    };
+    socket.asyncReadSome(Tcp::MakeBuffer(buffer), handler);
+
+    service.run();
+    ::close(fds[1]);
+
+    BOOST_CHECK(received == message);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+#endif // defined(PATR_OS_LINUX)
+
+/// Testy sprawdzające poprawność kolejki zdarzeń czasowych.
+BOOST_AUTO_TEST_SUITE(Timers)
+
+/// Sprawdza czy zdarzenia są wywoływane po upływie terminu i nie wcześniej.
+BOOST_AUTO_TEST_CASE(TimerExpiry)
+{
+    Tcp::TimerWheel wheel(10, 8);
+    auto now = Tcp::TimerWheel::Clock::now();
+    std::vector<int> fired;
+
+    wheel.arm(now + std::chrono::milliseconds(30), [&fired] { fired.push_back(1); });
+    wheel.arm(now + std::chrono::milliseconds(500), [&fired] { fired.push_back(2); }); // kilka obrotów koła.
+    BOOST_REQUIRE(wheel.size() == 2);
+    BOOST_CHECK(wheel.timeout(now) > 0);
+
+    BOOST_CHECK(wheel.expire(now + std::chrono::milliseconds(20)) == 0);
+    BOOST_CHECK(wheel.expire(now + std::chrono::milliseconds(50)) == 1);
+    BOOST_CHECK(wheel.expire(now + std::chrono::milliseconds(300)) == 0);
+    BOOST_CHECK(wheel.expire(now + std::chrono::milliseconds(520)) == 1);
+
+    BOOST_CHECK(fired == std::vector<int>({ 1, 2 }));
+    BOOST_CHECK(wheel.size() == 0);
+    BOOST_CHECK(wheel.timeout(now) == -1);
+}
+
+/// Sprawdza czy anulowane zdarzenia nie zostaną wywołane, a wywołane zdarzenia mogą dodawać kolejne.
+BOOST_AUTO_TEST_CASE(TimerCancel)
+{
+    Tcp::TimerWheel wheel(10, 8);
+    auto now = Tcp::TimerWheel::Clock::now();
+    int fired = 0;
+
+    auto timer = wheel.arm(now + std::chrono::milliseconds(30), [&fired] { fired += 1; });
+    wheel.arm(now + std::chrono::milliseconds(40), [&] { wheel.arm(now + std::chrono::milliseconds(60), [&fired] { fired += 10; }); });
+    BOOST_CHECK(wheel.cancel(timer));
+    BOOST_CHECK(!wheel.cancel(timer));
+
+    wheel.expire(now + std::chrono::milliseconds(50));
+    BOOST_CHECK(fired == 0 && wheel.size() == 1);
+    wheel.expire(now + std::chrono::milliseconds(80));
+    BOOST_CHECK(fired == 10 && wheel.size() == 0);
+}
+
+/// Sprawdza czy serwis wywoła zdarzenie zarejestrowane przez asyncWait.
+BOOST_AUTO_TEST_CASE(ServiceAsyncWait)
+{
+    Tcp::StreamService service;
+    int sigVal = 0;
+    bool sigFlag = false;
+    Tcp::SignalService signal(sigVal, sigFlag);
+    service.add(&signal);
+
+    auto start = Tcp::TimerWheel::Clock::now();
+    service.asyncWait(start + std::chrono::milliseconds(30), [&sigFlag] { sigFlag = true; });
+    service.run();
+
+    BOOST_CHECK(Tcp::TimerWheel::Clock::now() - start >= std::chrono::milliseconds(30));
+}
+
+/// Sprawdza czy zmiana czasu bezczynności gniazda poprawnie rejestruje zdarzenie timeoutu.
+BOOST_AUTO_TEST_CASE(SocketTimeout)
+{
+    ServiceMock service;
+    std::unique_ptr<Tcp::SocketInterface> socket(new SocketMock("", service));
+    socket->setTimeout(20);
+    BOOST_REQUIRE(service.pendingTimers() == 1);
+    socket->setTimeout(0);
+    BOOST_CHECK(service.pendingTimers() == 0);
+    socket->setTimeout(20);
+    socket.reset();
+    BOOST_CHECK(service.pendingTimers() == 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#if defined(PATR_OS_UNIX)
+/// Przesyła zapytania przez parę gniazd do połączenia obsługiwanego przez serwis i zwraca odebrane dane.
+/**
+ * Serwis działa na bieżącym wątku do czasu zamknięcia połączenia przez serwer.
+ */
+std::string Exchange(Tcp::StreamServiceInterface& service, const std::string& requests, Http::HandlerStrategy::RequestHandler handler,
+    const Http::KeepAlive& keepAlive = Http::KeepAlive(), std::size_t nThreads = 0U)
+{
+    int fds[2];
+    BOOST_REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    int sigVal = 0;
+    bool sigFlag = false;
+    Tcp::SignalService signal(sigVal, sigFlag);
+    service.add(&signal);
+
+    std::atomic<bool> done(false);
+    std::function<void()> poll = [&]
+    {
+        if (done)
+            sigFlag = true;
+        else
+            service.asyncWait(Tcp::TimerWheel::Clock::now() + std::chrono::milliseconds(10), poll);
+    };
+    poll();
+
+    std::string received;
+    std::thread client([&]
+    {
+        ::write(fds[1], requests.data(), requests.size());
+        std::array<char, 4096> buffer;
+        ssize_t bytes;
+        while ((bytes = ::read(fds[1], buffer.data(), buffer.size())) > 0)
+            received.append(buffer.data(), bytes);
+        ::close(fds[1]);
+        done = true;
+    });
+
+    {
+        Http::ThreadedHandlerStrategy strategy(handler, 5000U, nThreads);
+        strategy.start(std::make_shared<Http::Connection>(
+            Tcp::Socket(std::unique_ptr<Tcp::SocketInterface>(new Tcp::SocketImplementation(service, fds[0]))), strategy, keepAlive));
+        service.run();
+        client.join();
+    }
+
+    return received;
+}
+
+/// Testy sprawdzające poprawność trwałych połączeń HTTP/1.1.
+BOOST_AUTO_TEST_SUITE(PersistentConnections)
+
+/// Sprawdza czy zapytania przesłane potokowo otrzymają odpowiedzi w kolejności na jednym połączeniu.
+BOOST_AUTO_TEST_CASE(PipelinedRequests)
+{
+    Tcp::StreamService service;
+    auto received = Exchange(service,
+        "GET /1 HTTP/1.1\r\n\r\n"
+        "POST /2 HTTP/1.1\r\nContent-Length: 3\r\n\r\nabc"
+        "GET /3 HTTP/1.1\r\nConnection: close\r\n\r\n",
+        [](const Http::Request& request)
+        {
+            if (request.uri().raw() == "/1")
+                std::this_thread::sleep_for(std::chrono::milliseconds(50)); // późniejsze odpowiedzi nie mogą wyprzedzić pierwszej.
+            return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + request.body() + ']', "text/plain");
+        });
+
+    auto first = received.find("[/1]"), second = received.find("[/2abc]"), third = received.find("[/3]");
+    BOOST_REQUIRE(first != std::string::npos && second != std::string::npos && third != std::string::npos);
+    BOOST_CHECK(first < second && second < third);
+    BOOST_CHECK(received.find("Connection: close") > second);
+}
+
+/// Sprawdza czy włączone łączenie odpowiedzi nie zmienia ich kolejności ani treści.
+BOOST_AUTO_TEST_CASE(CorkedPipeline)
+{
+    Tcp::StreamService service;
+    auto received = Exchange(service,
+        "GET /1 HTTP/1.1\r\n\r\n"
+        "GET /2 HTTP/1.1\r\n\r\n"
+        "GET /3 HTTP/1.1\r\nConnection: close\r\n\r\n",
+        [](const Http::Request& request) { return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain"); },
+        Http::KeepAlive(5000, 100, true)); // gniazdo uniksowe nie obsługuje TCP_CORK - opcja zostanie wyłączona.
+
+    auto first = received.find("[/1]"), second = received.find("[/2]"), third = received.find("[/3]");
+    BOOST_REQUIRE(first != std::string::npos && second != std::string::npos && third != std::string::npos);
+    BOOST_CHECK(first < second && second < third);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/// Testy połączeń HTTP/2 bez szyfrowania (h2c).
+BOOST_AUTO_TEST_SUITE(Http2Connections)
+
+/// Sprawdza czy strumienie jednego połączenia są obsługiwane równolegle, a szybsza odpowiedź wyprzedza wolniejszą.
+BOOST_AUTO_TEST_CASE(MultiplexedStreams)
+{
+    Tcp::StreamService service;
+    auto received = Exchange(service,
+        ClientPreface + Frame(1, 0x5, 1, RequestBlock("/slow")) + Frame(1, 0x5, 3, RequestBlock("/fast")) +
+            Frame(7, 0, 0, FromHex("0000000300000000")),
+        [](const Http::Request& request)
+        {
+            if (request.uri().raw() == "/slow")
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+            return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+        }, Http::KeepAlive(), 2U);
+
+    BOOST_REQUIRE(received.size() > 9);
+    BOOST_CHECK_EQUAL(received[3], '\x4'); // serwer rozpoczyna od własnej ramki SETTINGS.
+    std::vector<std::pair<std::uint32_t, std::string>> bodies;
+    for (const auto& frame : Frames(received))
+        if (frame.type == 0 && !frame.payload.empty())
+            bodies.push_back(std::make_pair(frame.stream, frame.payload));
+    BOOST_REQUIRE_EQUAL(bodies.size(), 2U);
+    BOOST_CHECK(bodies[0] == std::make_pair(3U, std::string("[/fast]")));
+    BOOST_CHECK(bodies[1] == std::make_pair(1U, std::string("[/slow]")));
+    BOOST_CHECK(received.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/// Testy sprawdzające poprawność asynchronicznego wysyłania odpowiedzi przez serwis.
+BOOST_AUTO_TEST_SUITE(AsyncResponse)
+
+/// Sprawdza czy odpowiedź większa od bufora gniazda zostanie wysłana w całości przez kolejne zapisy.
+BOOST_AUTO_TEST_CASE(LargeResponse)
+{
+    std::string content(4 * 1024 * 1024, 'x');
+    auto handler = [&content](const Http::Request&) { return Http::Response(Http::ResponseStatus::Ok, content, "text/plain"); };
+    std::string request = "GET / HTTP/1.0\r\n\r\n";
+
+    Tcp::StreamService select;
+    auto received = Exchange(select, request, handler);
+    BOOST_CHECK(received.size() > content.size() && received.compare(received.size() - content.size(), content.size(), content) == 0);
+
+#if defined(PATR_OS_LINUX)
+    Tcp::EpollStreamService epoll;
+    received = Exchange(epoll, request, handler);
+    BOOST_CHECK(received.size() > content.size() && received.compare(received.size() - content.size(), content.size(), content) == 0);
+#endif // defined(PATR_OS_LINUX)
+}
+
+/// Sprawdza czy odpowiedź strumieniowa zostanie wysłana kodowaniem chunked, a połączenie obsłuży kolejne zapytanie.
+BOOST_AUTO_TEST_CASE(ChunkedStreamingResponse)
+{
+    Tcp::StreamService service;
+    auto received = Exchange(service,
+        "GET /stream HTTP/1.1\r\n\r\n"
+        "GET /next HTTP/1.1\r\nConnection: close\r\n\r\n",
+        [](const Http::Request& request)
+        {
+            if (request.uri().raw() != "/stream")
+                return Http::Response(Http::ResponseStatus::Ok, "[next]", "text/plain");
+            return Http::Response(Http::ResponseStatus::Ok, "application/json", [](Http::ResponseStream& stream)
+            {
+                stream.write("{\"regions\":[");
+                stream.write("");
+                stream.write("\"abcdefghijklmnopq\"]}");
+            });
+        });
+
+    BOOST_CHECK(received.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+    BOOST_CHECK(received.find("Content-Length: 0") == std::string::npos);
+    BOOST_CHECK(received.find("\r\n\r\nc\r\n{\"regions\":[\r\n15\r\n\"abcdefghijklmnopq\"]}\r\n0\r\n\r\nHTTP/1.1 200 OK") != std::string::npos);
+    BOOST_CHECK(received.find("[next]") != std::string::npos);
+}
+
+/// Sprawdza czy klient HTTP/1.0 otrzyma ciało zakończone zamknięciem połączenia.
+BOOST_AUTO_TEST_CASE(Http10StreamingResponse)
+{
+    Tcp::StreamService service;
+    auto received = Exchange(service, "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n",
+        [](const Http::Request&)
+        {
+            return Http::Response(Http::ResponseStatus::Ok, "text/plain", [](Http::ResponseStream& stream)
+            {
+                stream.write("first,");
+                stream.write("second");
+            });
+        });
+
+    BOOST_CHECK(received.find("Transfer-Encoding") == std::string::npos);
+    BOOST_CHECK(received.find("Connection: close\r\n") != std::string::npos);
+    BOOST_CHECK(received.compare(received.size() - 16, 16, "\r\n\r\nfirst,second") == 0);
+}
+
+/// Sprawdza czy strumień większy od okna wysyłania zostanie przesłany w całości i w kolejności.
+BOOST_AUTO_TEST_CASE(LargeStreamingResponse)
+{
+    const int parts = 256;
+    auto handler = [](const Http::Request&)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, "text/plain", [](Http::ResponseStream& stream)
+        {
+            for (int i = 0; i < parts && stream.good(); ++i)
+                stream.write(std::string(16 * 1024, static_cast<char>('a' + i % 26)));
+        });
+    };
+
+    Tcp::StreamService select;
+    auto received = Exchange(select, "GET / HTTP/1.0\r\n\r\n", handler);
+    auto body = received.substr(received.find("\r\n\r\n") + 4);
+    BOOST_REQUIRE(body.size() == parts * 16 * 1024u);
+    for (int i = 0; i < parts; ++i)
+        BOOST_CHECK(body[i * 16 * 1024] == 'a' + i % 26 && body[(i + 1) * 16 * 1024 - 1] == 'a' + i % 26);
+}
+
+/// Sprawdza czy bezczynne połączenia keep-alive zwracają bufory odczytu do puli.
+BOOST_AUTO_TEST_CASE(IdleConnectionsReleaseBuffers)
+{
+    const int count = 16;
+    auto before = Http::Connection::occupancy();
+
+    Tcp::StreamService service;
+    int sigVal = 0;
+    bool sigFlag = false;
+    Tcp::SignalService signal(sigVal, sigFlag);
+    service.add(&signal);
+
+    std::vector<std::array<int, 2>> pairs(count);
+    for (auto& fds : pairs)
+        BOOST_REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds.data()) == 0);
+
+    std::atomic<int> answered(0);
+    std::thread client([&]
+    {
+        std::string request = "GET / HTTP/1.1\r\n\r\n";
+        for (auto& fds : pairs)
+            ::write(fds[1], request.data(), request.size());
+        for (auto& fds : pairs)
+        {
+            std::array<char, 1024> buffer;
+            std::string received;
+            ssize_t bytes;
+            while (received.find("idle") == std::string::npos && (bytes = ::read(fds[1], buffer.data(), buffer.size())) > 0)
+                received.append(buffer.data(), bytes);
+            ++answered;
+        }
+    });
+
+    Http::Connection::PoolOccupancy idle{};
+    {
+        Http::ThreadedHandlerStrategy strategy([](const Http::Request&) { return Http::Response(Http::ResponseStatus::Ok, "idle", "text/plain"); }, 5000U, count); // limit zapytań nie odrzuci żadnego z nich.
+        for (auto& fds : pairs)
+        {
+            strategy.start(std::make_shared<Http::Connection>(
+                Tcp::Socket(std::unique_ptr<Tcp::SocketInterface>(new Tcp::SocketImplementation(service, fds[0]))), strategy));
+        }
+
+        std::function<void()> poll = [&]
+        {
+            if (answered == count)
+            {
+                idle = Http::Connection::occupancy(); // wszystkie połączenia oczekują na kolejne zapytanie.
+                sigFlag = true;
+            }
+            else
+                service.asyncWait(Tcp::TimerWheel::Clock::now() + std::chrono::milliseconds(10), poll);
+        };
+        poll();
+        service.run();
+        client.join();
+
+        for (auto& fds : pairs)
+            ::close(fds[1]);
+    }
+
+    BOOST_CHECK_EQUAL(idle.buffers.used, before.buffers.used);
+    BOOST_CHECK_EQUAL(idle.connections.used, before.connections.used + count);
+    BOOST_CHECK(idle.buffers.peak >= 1 && idle.buffers.capacity >= idle.buffers.peak);
+}
+
+/// Sprawdza czy zapis sekwencji buforów jest wznawiany od miejsca częściowego zapisu.
+BOOST_AUTO_TEST_CASE(ScatterGatherWrite)
+{
+    int fds[2];
+    BOOST_REQUIRE(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    std::vector<std::string> parts = { "HTTP/1.1 200 OK\r\n", "Content-Length: 1048576\r\n", "\r\n", std::string(1 << 20, 'b') };
+    std::string expected;
+    Tcp::ConstBufferSequence buffers;
+    for (const auto& part : parts)
+    {
+        expected += part;
+        buffers.push_back(Tcp::MakeBuffer(part));
+    }
+
+    std::string received;
+    std::thread reader([&]
+    {
+        std::array<char, 4096> head;
+        std::vector<char> tail(8192);
+        Tcp::StreamService unused;
+        Tcp::SocketImplementation socket(unused, fds[1]);
+        int bytes;
+        while ((bytes = socket.readSome(Tcp::BufferSequence{ Tcp::MakeBuffer(head), Tcp::MakeBuffer(tail) })) > 0)
+        {
+            auto first = (std::min)(bytes, static_cast<int>(head.size()));
+            received.append(head.data(), first);
+            received.append(tail.data(), bytes - first);
+        }
+    });
+
+    {
+        Tcp::StreamService unused;
+        Tcp::SocketImplementation socket(unused, fds[0]);
+        int partial = 0;
+        while (Tcp::BufferSize(buffers))
+        {
+            auto bytes = socket.tryWriteSome(buffers); // nieblokujący zapis kończy się na zapełnionym buforze gniazda.
+            BOOST_REQUIRE(bytes >= 0);
+            if (bytes > 0 && static_cast<std::size_t>(bytes) < Tcp::BufferSize(buffers))
+                ++partial;
+            Tcp::Consume(buffers, bytes);
+            if (!bytes)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        BOOST_CHECK(partial > 0); // bufor gniazda jest mniejszy od odpowiedzi.
+    }
+    reader.join();
+
+    BOOST_CHECK(received == expected);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+/// Testy sprawdzające działanie serwera na kilku serwisach.
+BOOST_AUTO_TEST_SUITE(MultiReactor)
+
+/// Sprawdza czy serwer z kilkoma akceptorami na wspólnym porcie obsłuży wszystkie połączenia i zakończy działanie po stop().
+BOOST_AUTO_TEST_CASE(ReusePortReactors)
+{
+    Http::Server server("127.0.0.1", "9341", [](const Http::Request& request)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+    }, 4);
+
+    std::thread reactors([&server] { server.run(); });
+
+    for (int i = 0; i < 32; ++i)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = sockaddr_in();
+        address.sin_family = AF_INET;
+        address.sin_port = htons(9341);
+        address.sin_addr.s_addr = inet_addr("127.0.0.1");
+        BOOST_REQUIRE(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) == 0);
+
+        std::string request = "GET /" + std::to_string(i) + " HTTP/1.0\r\n\r\n", received;
+        ::write(fd, request.data(), request.size());
+        std::array<char, 1024> buffer;
+        ssize_t bytes;
+        while ((bytes = ::read(fd, buffer.data(), buffer.size())) > 0)
+            received.append(buffer.data(), bytes);
+        ::close(fd);
+
+        BOOST_CHECK(received.find("[/" + std::to_string(i) + ']') != std::string::npos);
+    }
+
+    server.stop();
+    reactors.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+namespace {
+
+    /// Otwiera połączenie z lokalnym portem, zwraca -1 w przypadku niepowodzenia.
+    int Connect(int port)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = sockaddr_in();
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        address.sin_addr.s_addr = inet_addr("127.0.0.1");
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0)
+        {
+            ::close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    /// Odczytuje dane do zamknięcia połączenia lub pojawienia się until.
+    std::string Receive(int fd, const std::string& until = std::string())
+    {
+        std::string received;
+        std::array<char, 1024> buffer;
+        ssize_t bytes;
+        while ((until.empty() || received.find(until) == std::string::npos) && (bytes = ::read(fd, buffer.data(), buffer.size())) > 0)
+            received.append(buffer.data(), bytes);
+        return received;
+    }
+}
+
+/// Testy sprawdzające łagodne kończenie działania serwera.
+BOOST_AUTO_TEST_SUITE(GracefulShutdown)
+
+/// Sprawdza czy drain() dokończy rozpoczęte zapytanie, zamknie bezczynne połączenie i przestanie przyjmować nowe.
+BOOST_AUTO_TEST_CASE(DrainCompletesInFlight)
+{
+    Http::Server server("127.0.0.1", "9345", [](const Http::Request& request)
+    {
+        if (request.uri().raw() == "/slow")
+            std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+    });
+    std::thread reactor([&server] { server.run(); });
+
+    int idle = Connect(9345);
+    BOOST_REQUIRE(idle != -1);
+    std::string request = "GET /fast HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::write(idle, request.data(), request.size());
+    BOOST_CHECK(Receive(idle, "[/fast]").find("[/fast]") != std::string::npos);
+
+    int busy = Connect(9345);
+    BOOST_REQUIRE(busy != -1);
+    request = "GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::write(busy, request.data(), request.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    server.drain(std::chrono::milliseconds(5000));
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    BOOST_CHECK_EQUAL(Connect(9345), -1);
+    BOOST_CHECK(Receive(idle).empty()); // bezczynne połączenie keep-alive zostaje zamknięte bez odpowiedzi.
+
+    auto response = Receive(busy);
+    BOOST_CHECK(response.find("HTTP/1.1 200") == 0);
+    BOOST_CHECK(response.find("Connection: close") != std::string::npos);
+    BOOST_CHECK(response.find("[/slow]") != std::string::npos);
+
+    reactor.join();
+    ::close(idle);
+    ::close(busy);
+}
+
+/// Sprawdza czy run() zakończy działanie po upływie czasu na dokończenie zapytań.
+BOOST_AUTO_TEST_CASE(DrainDeadline)
+{
+    Http::Server server("127.0.0.1", "9346", [](const Http::Request&)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        return Http::Response(Http::ResponseStatus::Ok, "late", "text/plain");
+    });
+    std::thread reactor([&server] { server.run(); });
+
+    int fd = Connect(9346);
+    BOOST_REQUIRE(fd != -1);
+    std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    ::write(fd, request.data(), request.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    auto start = std::chrono::steady_clock::now();
+    server.drain(std::chrono::milliseconds(100));
+    reactor.join();
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(700));
+    ::close(fd);
+}
+
+/// Sprawdza czy serwer przejmie gniazdo nasłuchujące wraz z oczekującym w nim połączeniem.
+BOOST_AUTO_TEST_CASE(InheritedListener)
+{
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    socklen_t length = sizeof address;
+    BOOST_REQUIRE(::bind(listener, reinterpret_cast<sockaddr*>(&address), length) == 0);
+    BOOST_REQUIRE(::listen(listener, 8) == 0);
+    BOOST_REQUIRE(::getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == 0);
+
+    int fd = Connect(ntohs(address.sin_port)); // połączenie czeka w kolejce gniazda do czasu uruchomienia nowego serwera.
+    BOOST_REQUIRE(fd != -1);
+    std::string request = "GET /inherited HTTP/1.0\r\n\r\n";
+    ::write(fd, request.data(), request.size());
+
+    auto child = ::fork();
+    BOOST_REQUIRE(child != -1);
+    if (child == 0)
+    {
+        ::close(fd);
+        if (listener != 3)
+        {
+            ::dup2(listener, 3);
+            ::close(listener);
+        }
+        ::setenv("LISTEN_FDS", "1", 1);
+        ::setenv("LISTEN_PID", std::to_string(::getpid()).c_str(), 1);
+
+        Http::Server* current = nullptr;
+        Http::Server server("127.0.0.1", "1", [&current](const Http::Request& request)
+        {
+            current->drain(std::chrono::milliseconds(1000));
+            return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+        });
+        current = &server;
+        server.run();
+        ::_exit(0);
+    }
+
+    ::close(listener);
+    auto response = Receive(fd);
+    ::close(fd);
+    int status = 0;
+    BOOST_REQUIRE(::waitpid(child, &status, 0) == child);
+    BOOST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    BOOST_CHECK(response.find("[/inherited]") != std::string::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/// Testy przekazywania zakończonej pracy wątków roboczych do wątku serwisu.
+BOOST_AUTO_TEST_SUITE(WorkerHandoff)
+
+/// Sprawdza czy handlery zlecane jednocześnie z wielu wątków zostaną wywołane na wątku serwisu.
+BOOST_AUTO_TEST_CASE(PostFromWorkers)
+{
+    auto check = [](Tcp::StreamServiceInterface& service)
+    {
+        int sigVal = 0;
+        bool sigFlag = false;
+        Tcp::SignalService signal(sigVal, sigFlag);
+        service.add(&signal);
+
+        const int workers = 4, posts = 2000;
+        int invoked = 0; // modyfikowana wyłącznie na wątku serwisu.
+        std::thread::id serviceThread;
+        bool sameThread = true;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < workers; ++i)
+            threads.emplace_back([&]
+            {
+                for (int j = 0; j < posts; ++j)
+                    service.post([&]
+                    {
+                        sameThread = sameThread && std::this_thread::get_id() == serviceThread;
+                        if (++invoked == workers * posts)
+                            sigFlag = true;
+                    });
+            });
+
+        serviceThread = std::this_thread::get_id();
+        service.run();
+        for (auto& thread : threads)
+            thread.join();
+        BOOST_CHECK_EQUAL(invoked, workers * posts);
+        BOOST_CHECK(sameThread);
+    };
+
+    Tcp::StreamService select;
+    check(select);
+#if defined(PATR_OS_LINUX)
+    Tcp::EpollStreamService epoll;
+    check(epoll);
+    if (Tcp::UringStreamService::Supported())
+    {
+        Tcp::UringStreamService uring;
+        check(uring);
+    }
+#endif // defined(PATR_OS_LINUX)
+}
+
+/// Sprawdza czy odpowiedź obsłużona po zatrzymaniu serwisu zostanie zwolniona wraz z połączeniem przy niszczeniu serwera.
+BOOST_AUTO_TEST_CASE(StopDuringHandler)
+{
+    std::atomic<bool> started(false), finished(false);
+    int fd = -1;
+    {
+        Http::Server server("127.0.0.1", "9351", [&started, &finished](const Http::Request&)
+        {
+            started = true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(200));
+            finished = true;
+            return Http::Response(Http::ResponseStatus::Ok, "late", "text/plain");
+        });
+        std::thread reactor([&server] { server.run(); });
+
+        fd = Connect(9351);
+        BOOST_REQUIRE(fd != -1);
+        std::string request = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+        ::write(fd, request.data(), request.size());
+        while (!started)
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+        server.stop(); // serwis kończy działanie przed odpowiedzią wątku roboczego.
+        reactor.join();
+        BOOST_CHECK(!finished);
+    }
+
+    BOOST_CHECK(finished);
+    BOOST_CHECK(Receive(fd).empty()); // połączenie zamknięte bez odpowiedzi.
+    ::close(fd);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+/// Testy sprawdzające opcje gniazd oraz przyjmowanie połączeń przez akceptor.
+BOOST_AUTO_TEST_SUITE(AcceptorOptions)
+
+/// Sprawdza czy opcje ustawione na akceptorze trafiają do gniazda nasłuchującego.
+BOOST_AUTO_TEST_CASE(ListenerOptions)
+{
+    Tcp::StreamService service;
+    Tcp::Acceptor acceptor(service);
+    Tcp::Endpoint endpoint = service.getFactory()->resolve("127.0.0.1", "0");
+    acceptor.open(endpoint.protocol());
+    acceptor.setOption(Tcp::Option::NoDelay(true));
+    acceptor.setOption(Tcp::Option::ReceiveBuffer(64 * 1024));
+    acceptor.bind(endpoint.address());
+    acceptor.listen(16);
+
+    auto handle = acceptor.getHandle();
+    int value = 0;
+    socklen_t length = sizeof value;
+    BOOST_REQUIRE(::getsockopt(handle, IPPROTO_TCP, TCP_NODELAY, &value, &length) == 0);
+    BOOST_CHECK(value != 0);
+    BOOST_REQUIRE(::getsockopt(handle, SOL_SOCKET, SO_RCVBUF, &value, &length) == 0);
+    BOOST_CHECK(value >= 64 * 1024);
+    BOOST_CHECK(::fcntl(handle, F_GETFL) & O_NONBLOCK);
+
+#if defined(PATR_OS_LINUX)
+    acceptor.setOption(Tcp::Option::DeferAccept(5));
+    acceptor.setOption(Tcp::Option::FastOpen(32));
+    BOOST_REQUIRE(::getsockopt(handle, IPPROTO_TCP, TCP_DEFER_ACCEPT, &value, &length) == 0);
+    BOOST_CHECK(value >= 5); // jądro zaokrągla czas do liczby retransmisji SYN-ACK.
+    BOOST_REQUIRE(::getsockopt(handle, IPPROTO_TCP, TCP_FASTOPEN, &value, &length) == 0);
+    BOOST_CHECK_EQUAL(value, 32);
+#endif // defined(PATR_OS_LINUX)
+
+    acceptor.close();
+    BOOST_CHECK_EQUAL(acceptor.getHandle(), -1);
+}
+
+/// Sprawdza czy połączenia oczekujące w kolejce przyjmowane są w jednym wybudzeniu jako gniazda nieblokujące.
+BOOST_AUTO_TEST_CASE(AcceptBurst)
+{
+    const int count = 20;
+    Tcp::StreamService service;
+    int sigVal = 0;
+    bool sigFlag = false;
+    Tcp::SignalService signal(sigVal, sigFlag);
+    service.add(&signal);
+
+    Tcp::Acceptor acceptor(service);
+    Tcp::Endpoint endpoint = service.getFactory()->resolve("127.0.0.1", "0");
+    acceptor.open(endpoint.protocol());
+    acceptor.bind(endpoint.address());
+    acceptor.listen(count);
+
+    sockaddr_in address = sockaddr_in();
+    socklen_t length = sizeof address;
+    BOOST_REQUIRE(::getsockname(acceptor.getHandle(), reinterpret_cast<sockaddr*>(&address), &length) == 0);
+    std::vector<int> clients;
+    for (int i = 0; i < count; ++i)
+    {
+        clients.push_back(Connect(ntohs(address.sin_port)));
+        BOOST_REQUIRE(clients.back() != -1);
+    }
+
+    std::vector<Tcp::Socket> accepted;
+    int nonBlocking = 0;
+    std::function<void(Tcp::Socket)> handler = [&](Tcp::Socket socket)
+    {
+        std::array<char, 16> data;
+        auto buffer = Tcp::MakeBuffer(data);
+        if (socket.readSome(buffer) == Tcp::SocketService::WouldBlock)
+            ++nonBlocking;
+        accepted.push_back(std::move(socket));
+        acceptor.asyncAccept(handler);
+    };
+    acceptor.asyncAccept(handler);
+    service.asyncWait(Tcp::TimerWheel::Clock::now(), [&] { sigFlag = true; }); // timery wywoływane są po akceptorach.
+    service.run();
+
+    BOOST_CHECK_EQUAL(accepted.size(), static_cast<std::size_t>(count));
+    BOOST_CHECK_EQUAL(nonBlocking, count);
+    for (auto client : clients)
+        ::close(client);
+}
+
+#if defined(PATR_OS_LINUX)
+/// Sprawdza czy serwis epoll obsługuje akceptor otwarty w trakcie działania oraz ponowne wywołanie run().
+BOOST_AUTO_TEST_CASE(EpollLateAcceptor)
+{
+    Tcp::EpollStreamService service;
+    int sigVal = 0;
+    bool sigFlag = false;
+    Tcp::SignalService signal(sigVal, sigFlag);
+    service.add(&signal);
+
+    std::unique_ptr<Tcp::Acceptor> acceptor;
+    std::vector<Tcp::Socket> accepted;
+    int client = -1;
+    service.asyncWait(Tcp::TimerWheel::Clock::now(), [&]
+    {
+        acceptor.reset(new Tcp::Acceptor(service));
+        Tcp::Endpoint endpoint = service.getFactory()->resolve("127.0.0.1", "0");
+        acceptor->open(endpoint.protocol());
+        acceptor->bind(endpoint.address());
+        acceptor->listen(4);
+
+        sockaddr_in address = sockaddr_in();
+        socklen_t length = sizeof address;
+        ::getsockname(acceptor->getHandle(), reinterpret_cast<sockaddr*>(&address), &length);
+        client = Connect(ntohs(address.sin_port));
+        acceptor->asyncAccept([&](Tcp::Socket socket)
+        {
+            accepted.push_back(std::move(socket));
+            sigFlag = true;
+        });
+    });
+    service.run();
+    BOOST_REQUIRE_EQUAL(accepted.size(), 1U);
+
+    sigFlag = false;
+    sockaddr_in address = sockaddr_in();
+    socklen_t length = sizeof address;
+    BOOST_REQUIRE(::getsockname(acceptor->getHandle(), reinterpret_cast<sockaddr*>(&address), &length) == 0);
+    auto second = Connect(ntohs(address.sin_port));
+    acceptor->asyncAccept([&](Tcp::Socket socket)
+    {
+        accepted.push_back(std::move(socket));
+        sigFlag = true;
+    });
+    BOOST_CHECK_NO_THROW(service.run()); // Akceptor pozostaje zarejestrowany z poprzedniego wywołania.
+    BOOST_CHECK_EQUAL(accepted.size(), 2U);
+
+    ::close(client);
+    ::close(second);
+}
+#endif // defined(PATR_OS_LINUX)
+
+BOOST_AUTO_TEST_SUITE_END()
+
+namespace {
+
+    /// Wysyła dane po size bajtów co interval do chwili otrzymania odpowiedzi, zwraca czas wysyłania.
+    std::chrono::steady_clock::duration Trickle(int fd, const std::string& data, std::size_t size, std::chrono::milliseconds interval)
+    {
+        auto start = std::chrono::steady_clock::now();
+        pollfd readable = { fd, POLLIN, 0 };
+        for (std::size_t offset = 0; offset < data.size(); offset += size)
+        {
+            ::send(fd, data.data() + offset, std::min(size, data.size() - offset), MSG_NOSIGNAL);
+            if (::poll(&readable, 1, static_cast<int>(interval.count())) > 0)
+                break;
+        }
+        return std::chrono::steady_clock::now() - start;
+    }
+}
+
+/// Testy sprawdzające ograniczenia zapytań wolnych lub zbyt dużych klientów.
+BOOST_AUTO_TEST_SUITE(SlowClients)
+
+/// Sprawdza czy nagłówek przesyłany powoli zostanie przerwany po upływie terminu, mimo aktywności klienta.
+BOOST_AUTO_TEST_CASE(HeaderDeadline)
+{
+    Http::Server server("127.0.0.1", "9347", [](const Http::Request&)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, "ok", "text/plain");
+    });
+    server.setRequestLimits(Http::RequestLimits(8192U, 32U * 1024U, 100U, 300));
+    std::thread reactor([&server] { server.run(); });
+
+    int fd = Connect(9347);
+    BOOST_REQUIRE(fd != -1);
+    auto elapsed = Trickle(fd, "GET / HTTP/1.1\r\n" + std::string(100, 'X'), 1, std::chrono::milliseconds(20));
+    BOOST_CHECK(Receive(fd).find("HTTP/1.1 408 Request Timeout\r\n") == 0);
+    BOOST_CHECK(elapsed < std::chrono::milliseconds(1500));
+    ::close(fd);
+
+    fd = Connect(9347);
+    BOOST_REQUIRE(fd != -1);
+    std::string request = "GET / HTTP/1.1\r\n";
+    for (int i = 0; i <= 100; ++i)
+        request += "X-Header-" + std::to_string(i) + ": value\r\n";
+    request += "\r\n";
+    ::write(fd, request.data(), request.size());
+    BOOST_CHECK_EQUAL(Receive(fd), "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    ::close(fd);
+
+    server.stop();
+    reactor.join();
+}
+
+/// Sprawdza czy ciało przesyłane wolniej niż RequestLimits::minRate zostanie przerwane, a szybsze - odebrane.
+BOOST_AUTO_TEST_CASE(BodyMinimumRate)
+{
+    Http::Server server("127.0.0.1", "9348", [](const Http::Request& request)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, std::to_string(request.body().size()), "text/plain");
+    });
+    server.setRequestLimits(Http::RequestLimits(8192U, 32U * 1024U, 100U, 10000, 300, 1000U));
+    std::thread reactor([&server] { server.run(); });
+
+    int fd = Connect(9348);
+    BOOST_REQUIRE(fd != -1);
+    std::string head = "POST / HTTP/1.1\r\nContent-Length: 2000\r\n\r\n";
+    ::write(fd, head.data(), head.size());
+    auto elapsed = Trickle(fd, std::string(2000, 'b'), 10, std::chrono::milliseconds(50)); // 200 B/s
+    BOOST_CHECK(Receive(fd).find("HTTP/1.1 408") == 0);
+    BOOST_CHECK(elapsed < std::chrono::milliseconds(1500));
+    ::close(fd);
+
+    fd = Connect(9348);
+    BOOST_REQUIRE(fd != -1);
+    ::write(fd, head.data(), head.size());
+    Trickle(fd, std::string(2000, 'b'), 500, std::chrono::milliseconds(100)); // 5000 B/s
+    auto response = Receive(fd, "2000");
+    BOOST_CHECK(response.find("HTTP/1.1 200") == 0);
+    ::close(fd);
+
+    server.stop();
+    reactor.join();
+}
+
+/// Sprawdza czy klient zrywający połączenie po odrzuconym nagłówku nie przerwie pracy serwera.
+BOOST_AUTO_TEST_CASE(RejectedClientReset)
+{
+    Http::Server server("127.0.0.1", "9354", [](const Http::Request&)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, "ok", "text/plain");
+    });
+    server.setRequestLimits(Http::RequestLimits(64U, 32U * 1024U));
+    std::thread reactor([&server] { server.run(); });
+
+    const auto oversized = "GET /" + std::string(1000, 'x') + " HTTP/1.1\r\n\r\n";
+    for (int i = 0; i < 50; ++i)
+    {
+        int fd = Connect(9354);
+        BOOST_REQUIRE(fd != -1);
+        ::write(fd, oversized.data(), oversized.size());
+        linger reset = { 1, 0 }; // zamknięcie wysyła RST, odpowiedź serwera kończy się błędem zapisu.
+        ::setsockopt(fd, SOL_SOCKET, SO_LINGER, &reset, sizeof reset);
+        ::close(fd);
+    }
+
+    int fd = Connect(9354);
+    BOOST_REQUIRE(fd != -1);
+    ::write(fd, oversized.data(), oversized.size());
+    BOOST_CHECK_EQUAL(Receive(fd), "HTTP/1.1 414 Request-URI Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+    ::close(fd);
+
+    fd = Connect(9354);
+    BOOST_REQUIRE(fd != -1);
+    const std::string request = "GET / HTTP/1.0\r\n\r\n";
+    ::write(fd, request.data(), request.size());
+    BOOST_CHECK(Receive(fd).find("HTTP/1.1 200") == 0);
+    ::close(fd);
+
+    server.stop();
+    reactor.join();
+}
+
+/// Sprawdza czy strumień HTTP/2 bez końca zapytania zostanie przerwany po upływie terminu, a obsługiwany - nie.
+BOOST_AUTO_TEST_CASE(Http2StalledStream)
+{
+    Http::Server server("127.0.0.1", "9356", [](const Http::Request& request)
+    {
+        if (request.uri().raw() == "/slow")
+            std::this_thread::sleep_for(std::chrono::milliseconds(600));
+        return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+    });
+    server.setRequestLimits(Http::RequestLimits(8192U, 32U * 1024U, 100U, 10000, 300, 1000U));
+    std::thread reactor([&server] { server.run(); });
+
+    int fd = Connect(9356);
+    BOOST_REQUIRE(fd != -1);
+    timeval timeout = { 5, 0 };
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    auto start = std::chrono::steady_clock::now();
+    auto stalled = ClientPreface + Frame(1, 0x4, 1, RequestBlock("/stalled")); // END_HEADERS bez END_STREAM.
+    ::write(fd, stalled.data(), stalled.size());
+    Receive(fd);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1500));
+    ::close(fd);
+
+    fd = Connect(9356);
+    BOOST_REQUIRE(fd != -1);
+    auto handled = ClientPreface + Frame(1, 0x5, 1, RequestBlock("/slow")) + Frame(7, 0, 0, FromHex("0000000100000000"));
+    ::write(fd, handled.data(), handled.size());
+    BOOST_CHECK(Receive(fd).find("[/slow]") != std::string::npos);
+    ::close(fd);
+
+    server.stop();
+    reactor.join();
+}
+
+/// Sprawdza czy połączenie klienta, który przestał odbierać odpowiedź, zostanie zamknięte, a jej producent zwolniony.
+BOOST_AUTO_TEST_CASE(StalledResponseWrite)
+{
+    std::atomic<bool> finished(false);
+    Http::Server server("127.0.0.1", "9358", [&finished](const Http::Request&)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, "text/plain", [&finished](Http::ResponseStream& stream)
+        {
+            for (int i = 0; i < 4096 && stream.good(); ++i) // 64 MB
+                stream.write(std::string(16 * 1024, 'x'));
+            finished = true;
+        });
+    });
+    server.setKeepAlive(Http::KeepAlive(5000, 100, false, 300));
+    std::thread reactor([&server] { server.run(); });
+
+    int fd = Connect(9358);
+    BOOST_REQUIRE(fd != -1);
+    const std::string request = "GET / HTTP/1.1\r\n\r\n";
+    ::write(fd, request.data(), request.size());
+    for (int i = 0; i < 100 && !finished; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    BOOST_CHECK(finished);
+    ::close(fd);
+
+    server.stop();
+    reactor.join();
+}
+
+/// Sprawdza czy klient HTTP/2 ogłaszający duże okno, lecz nieodbierający odpowiedzi, wstrzyma jej producenta.
+BOOST_AUTO_TEST_CASE(Http2UnreadResponse)
+{
+    std::atomic<std::size_t> produced(0);
+    Http::Server server("127.0.0.1", "9357", [&produced](const Http::Request&)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, "text/plain", [&produced](Http::ResponseStream& stream)
+        {
+            for (int i = 0; i < 4096 && stream.good(); ++i) // 64 MB
+            {
+                stream.write(std::string(16 * 1024, 'x'));
+                produced += 16 * 1024;
+            }
+        });
+    });
+    std::thread reactor([&server] { server.run(); });
+
+    int fd = Connect(9357);
+    BOOST_REQUIRE(fd != -1);
+    auto request = std::string("PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n") +
+        Frame(4, 0, 0, FromHex("00047fffffff")) + Frame(8, 0, 0, FromHex("7fff0000")) + // największe okna strumienia i połączenia.
+        Frame(1, 0x5, 1, RequestBlock("/"));
+    ::write(fd, request.data(), request.size());
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    BOOST_CHECK(produced < 16u << 20); // bufory gniazd i okno StreamWindow.
+    ::close(fd);
+
+    server.stop();
+    reactor.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+namespace {
+
+    /// Samopodpisany certyfikat i klucz zapisane w plikach tymczasowych na czas testu.
+    struct SelfSigned
+    {
+        SelfSigned() :
+            certificate("/tmp/patr-tls-" + std::to_string(::getpid()) + ".crt"),
+            key("/tmp/patr-tls-" + std::to_string(::getpid()) + ".key")
+        {
+            EVP_PKEY* pkey = nullptr;
+            auto context = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+            EVP_PKEY_keygen_init(context);
+            EVP_PKEY_CTX_set_ec_paramgen_curve_nid(context, NID_X9_62_prime256v1);
+            EVP_PKEY_keygen(context, &pkey);
+            EVP_PKEY_CTX_free(context);
+
+            auto x509 = X509_new();
+            ASN1_INTEGER_set(X509_get_serialNumber(x509), 1);
+            X509_gmtime_adj(X509_getm_notBefore(x509), 0);
+            X509_gmtime_adj(X509_getm_notAfter(x509), 3600);
+            X509_set_pubkey(x509, pkey);
+            auto name = X509_get_subject_name(x509);
+            X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0);
+            X509_set_issuer_name(x509, name);
+            X509_sign(x509, pkey, EVP_sha256());
+
+            auto file = std::fopen(certificate.c_str(), "w");
+            PEM_write_X509(file, x509);
+            std::fclose(file);
+            file = std::fopen(key.c_str(), "w");
+            PEM_write_PrivateKey(file, pkey, nullptr, nullptr, 0, nullptr, nullptr);
+            std::fclose(file);
+
+            X509_free(x509);
+            EVP_PKEY_free(pkey);
+        }
+
+        ~SelfSigned()
+        {
+            std::remove(certificate.c_str());
+            std::remove(key.c_str());
+        }
+
+        std::string certificate;
+        std::string key;
+    };
+
+    /// Wysyła zapytanie przez TLS, wznawiając sesję session, jeżeli jest dostępna, i zwraca odpowiedź.
+    /**
+     * Po zakończeniu session wskazuje na sesję połączenia, a resumed określa, czy została wznowiona.
+     */
+    std::string TlsRequest(SSL_CTX* client, int port, const std::string& request, SSL_SESSION*& session, bool& resumed)
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in address = sockaddr_in();
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = inet_addr("127.0.0.1");
+        if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address) != 0)
+        {
+            ::close(fd);
+            return "";
+        }
+
+        auto ssl = SSL_new(client);
+        SSL_set_fd(ssl, fd);
+        if (session)
+            SSL_set_session(ssl, session);
+
+        std::string received;
+        if (SSL_connect(ssl) == 1 && SSL_write(ssl, request.data(), static_cast<int>(request.size())) > 0)
+        {
+            std::array<char, 4096> buffer;
+            int bytes;
+            while ((bytes = SSL_read(ssl, buffer.data(), static_cast<int>(buffer.size()))) > 0)
+                received.append(buffer.data(), bytes);
+        }
+
+        resumed = SSL_session_reused(ssl) == 1;
+        if (session)
+            SSL_SESSION_free(session);
+        session = SSL_get1_session(ssl);
+        SSL_shutdown(ssl);
+        SSL_free(ssl);
+        ::close(fd);
+        return received;
+    }
+}
+
+/// Testy sprawdzające obsługę połączeń TLS po stronie serwera.
+BOOST_AUTO_TEST_SUITE(ServerTls)
+
+/// Sprawdza czy niepoprawne pliki certyfikatu zgłaszają błąd.
+BOOST_AUTO_TEST_CASE(MissingCertificate)
+{
+    BOOST_CHECK_THROW(Tcp::SslContext("/nonexistent.crt", "/nonexistent.key"), Tcp::SslError);
+}
+
+namespace {
+    void CustomHandler(int) {}
+}
+
+/// Sprawdza czy kolejne konteksty nie nadpisują obsługi SIGPIPE ustawionej przez aplikację.
+BOOST_AUTO_TEST_CASE(SignalHandlerKept)
+{
+    Tcp::SslContext first;
+    auto previous = std::signal(SIGPIPE, CustomHandler);
+    Tcp::SslContext second;
+    BOOST_CHECK(std::signal(SIGPIPE, previous) == CustomHandler);
+}
+
+/// Sprawdza czy serwer obsłuży zapytania przez TLS, a powracający klient wznowi sesję bez pełnego handshake.
+BOOST_AUTO_TEST_CASE(SessionResumption)
+{
+    SelfSigned files;
+    const std::string large(1 << 20, 'x'); // przekracza bufor gniazda - zapis musi oczekiwać na gotowość.
+
+    std::vector<Http::Server::ServiceBuilder> builders{ Http::Server::DefaultService };
+#if defined(PATR_OS_LINUX)
+    builders.push_back([] { return Http::Server::ServicePtr(new Tcp::EpollStreamService()); });
+#endif // defined(PATR_OS_LINUX)
+
+    int port = 9342;
+    for (const auto& builder : builders)
+    {
+        ++port; // każdy serwis nasłuchuje na osobnym porcie.
+        auto tls = std::make_shared<Tcp::SslContext>(files.certificate, files.key);
+        Http::Server server("127.0.0.1", std::to_string(port), [&large](const Http::Request& request)
+        {
+            if (request.uri().raw() == "/large")
+                return Http::Response(Http::ResponseStatus::Ok, large, "text/plain");
+            return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+        }, tls, 1, builder);
+        std::thread reactor([&server] { server.run(); });
+
+        auto client = SSL_CTX_new(TLS_client_method());
+        SSL_SESSION* session = nullptr;
+        bool resumed = true;
+
+        auto first = TlsRequest(client, port, "GET /first HTTP/1.0\r\n\r\n", session, resumed);
+        BOOST_CHECK(first.find("[/first]") != std::string::npos);
+        BOOST_CHECK(!resumed);
+
+        auto second = TlsRequest(client, port, "GET /second HTTP/1.0\r\n\r\n", session, resumed);
+        BOOST_CHECK(second.find("[/second]") != std::string::npos);
+        BOOST_CHECK(resumed);
+
+        auto body = TlsRequest(client, port, "GET /large HTTP/1.0\r\n\r\n", session, resumed);
+        BOOST_CHECK(body.size() > large.size() && body.compare(body.size() - large.size(), large.size(), large) == 0);
+
+        SSL_SESSION_free(session);
+        SSL_CTX_free(client);
+        server.stop();
+        reactor.join();
+
+        auto statistics = tls->statistics();
+        BOOST_CHECK_EQUAL(statistics.handshakes, 3);
+        BOOST_CHECK_GE(statistics.resumed, 1);
+    }
+}
+
+/// Sprawdza czy serwisy klienta ze wspólnym kontekstem wznawiają sesję nawiązaną przez inny wątek.
+BOOST_AUTO_TEST_CASE(ClientSessionCache)
+{
+    SelfSigned files;
+    auto tls = std::make_shared<Tcp::SslContext>(files.certificate, files.key);
+    Http::Server server("127.0.0.1", "9352", [](const Http::Request& request)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+    }, tls, 1, Http::Server::DefaultService);
+    std::thread reactor([&server] { server.run(); });
+
+    BOOST_CHECK_THROW(Tcp::SslStreamService{ tls }, Tcp::SslError);
+
+    auto client = std::make_shared<Tcp::SslContext>();
+    auto download = [&client](const std::string& path)
+    {
+        Tcp::SslStreamService service(client);
+        auto socket = service.getFactory()->resolve("127.0.0.1", "9352")->connect(service);
+        const auto request = "GET " + path + " HTTP/1.0\r\n\r\n";
+        socket.write(Tcp::MakeBuffer(request));
+
+        std::string received;
+        std::array<char, 4096> buffer;
+        auto chunk = std::make_pair(buffer.data(), static_cast<int>(buffer.size()));
+        int bytes;
+        while ((bytes = socket.readSome(chunk)) > 0)
+            received.append(buffer.data(), bytes);
+        socket.close();
+        return received;
+    };
+
+    const int downloads = 4;
+    for (int i = 0; i < downloads; ++i)
+    {
+        // każde połączenie z osobnego wątku - sesję poprzedniego przekazuje wyłącznie wspólny kontekst.
+        std::string received;
+        std::thread([&] { received = download("/" + std::to_string(i)); }).join();
+        BOOST_CHECK(received.find("[/" + std::to_string(i) + "]") != std::string::npos);
+    }
+
+    server.stop();
+    reactor.join();
+
+    auto statistics = client->statistics();
+    BOOST_CHECK_EQUAL(statistics.handshakes, downloads);
+    BOOST_CHECK_EQUAL(statistics.resumed, downloads - 1);
+    BOOST_CHECK_EQUAL(statistics.cached, 1);
+    BOOST_CHECK_EQUAL(tls->statistics().resumed, downloads - 1);
+}
+
+/// Sprawdza czy blokujący zapis do nieblokującego gniazda TLS serwera oczekuje na gotowość zamiast ponawiać zapis.
+BOOST_AUTO_TEST_CASE(BlockingServerWrite)
+{
+    SelfSigned files;
+    Tcp::SslContext tls(files.certificate, files.key);
+    const std::string large(4 << 20, 'x');
+
+    int listener = ::socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    ::setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof reuse);
+    sockaddr_in address = sockaddr_in();
+    address.sin_family = AF_INET;
+    address.sin_port = htons(9353);
+    address.sin_addr.s_addr = inet_addr("127.0.0.1");
+    BOOST_REQUIRE(::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof address) == 0);
+    ::listen(listener, 1);
+
+    std::size_t received = 0;
+    std::thread client([&received]
+    {
+        int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        int size = 16384; // małe bufory gniazd - zapis serwera musi oczekiwać na klienta.
+        ::setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof size);
+        sockaddr_in address = sockaddr_in();
+        address.sin_family = AF_INET;
+        address.sin_port = htons(9353);
+        address.sin_addr.s_addr = inet_addr("127.0.0.1");
+        ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof address);
+        auto context = SSL_CTX_new(TLS_client_method());
+        auto ssl = SSL_new(context);
+        SSL_set_fd(ssl, fd);
+        if (SSL_connect(ssl) == 1)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(300)); // serwer zapełnia bufor gniazda.
+            std::array<char, 16384> buffer;
+            int bytes;
+            while ((bytes = SSL_read(ssl, buffer.data(), static_cast<int>(buffer.size()))) > 0)
+                received += bytes;
+        }
+        SSL_free(ssl);
+        SSL_CTX_free(context);
+        ::close(fd);
+    });
+
+    int fd = ::accept(listener, nullptr, nullptr);
+    ::close(listener);
+    int size = 16384;
+    ::setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof size);
+    Tcp::StreamService service;
+    Tcp::SslSocketImplementation socket(service, fd, tls);
+    while (socket.handshake() == Tcp::SocketInterface::Handshake::Pending)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    auto cpu = std::clock();
+    BOOST_CHECK_EQUAL(socket.write(Tcp::ConstBuffer(large.data(), static_cast<int>(large.size()))), static_cast<int>(large.size()));
+    auto spent = static_cast<double>(std::clock() - cpu) / CLOCKS_PER_SEC;
+    socket.close();
+    client.join();
+
+    BOOST_CHECK_EQUAL(received, large.size());
+    BOOST_CHECK_LT(spent, 0.15); // ponawianie bez oczekiwania zajęłoby procesor przez cały czas uśpienia klienta.
+}
+
+/// Sprawdza czy nieblokujący klient nawiąże połączenie i handshake TLS w serwisie, bez blokowania wywołującego.
+BOOST_AUTO_TEST_CASE(NonBlockingClient)
+{
+    SelfSigned files;
+    auto tls = std::make_shared<Tcp::SslContext>(files.certificate, files.key);
+    Http::Server server("127.0.0.1", "9359", [](const Http::Request& request)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+    }, tls, 1, Http::Server::DefaultService);
+    std::thread reactor([&server] { server.run(); });
+
+    Tcp::SslContext client;
+    Tcp::StreamService service;
+    auto socket = Tcp::SslEndpointImplementation("127.0.0.1", "9359", client).connectNonBlocking(service);
+    BOOST_CHECK_EQUAL(client.statistics().handshakes, 0);
+
+    const std::string request = "GET /async HTTP/1.0\r\n\r\n";
+    int written = 0;
+    socket.asyncWriteSome(Tcp::MakeBuffer(request), [&written](int, int bytes) { written = bytes; });
+
+    std::string received;
+    std::array<char, 4096> buffer;
+    std::function<void(int, std::size_t)> read = [&](int error, std::size_t bytes)
+    {
+        if (error)
+        {
+            service.stop();
+            return;
+        }
+        received.append(buffer.data(), bytes);
+        socket.asyncReadSome(Tcp::Buffer(buffer.data(), static_cast<int>(buffer.size())), read);
+    };
+    socket.asyncReadSome(Tcp::Buffer(buffer.data(), static_cast<int>(buffer.size())), read);
+    service.run();
+
+    server.stop();
+    reactor.join();
+
+    BOOST_CHECK_EQUAL(written, static_cast<int>(request.size()));
+    BOOST_CHECK(received.find("[/async]") != std::string::npos);
+    BOOST_CHECK_EQUAL(client.statistics().handshakes, 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#if defined(PATR_OS_LINUX)
+
+/// Testy sprawdzające serwis oparty na io_uring (lub serwis zastępczy, gdy jądro go nie obsługuje).
+BOOST_AUTO_TEST_SUITE(UringService)
+
+/// Sprawdza czy gniazda odbierające dane z pierścienia buforów obsłużą potok zapytań, duże ciało i odpowiedź oraz odmowę.
+BOOST_AUTO_TEST_CASE(NativeConnections)
+{
+    if (!Tcp::UringStreamService::Supported())
+        BOOST_TEST_MESSAGE("io_uring is not supported, testing the fallback service");
+
+    const std::string large(1 << 20, 'x'); // wymaga kilku zapisów.
+    Http::Server server("127.0.0.1", "9349", [&large](const Http::Request& request)
+    {
+        if (request.uri().raw() == "/large")
+            return Http::Response(Http::ResponseStatus::Ok, large, "text/plain");
+        return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + std::to_string(request.body().size()) + ']', "text/plain");
+    }, 1, Http::Server::UringService);
+    std::thread reactor([&server] { server.run(); });
+
+    int fd = Connect(9349);
+    BOOST_REQUIRE(fd != -1);
+    std::string body(100000, 'b'); // zajmuje wiele buforów pierścienia.
+    std::string requests = "GET /1 HTTP/1.1\r\n\r\n"
+        "POST /2 HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body +
+        "GET /large HTTP/1.1\r\nConnection: close\r\n\r\n";
+    ::write(fd, requests.data(), requests.size());
+    auto received = Receive(fd);
+    ::close(fd);
+
+    auto first = received.find("[/10]"), second = received.find("[/2100000]");
+    BOOST_REQUIRE(first != std::string::npos && second != std::string::npos);
+    BOOST_CHECK(first < second);
+    BOOST_CHECK(received.size() > large.size() && received.compare(received.size() - large.size(), large.size(), large) == 0);
+
+    for (int i = 0; i < 16; ++i) // odmowa wysyłana jest przed zamknięciem gniazda.
+    {
+        fd = Connect(9349);
+        BOOST_REQUIRE(fd != -1);
+        std::string oversized = "GET / HTTP/1.1\r\n";
+        for (int header = 0; header <= 100; ++header)
+            oversized += "X-Header-" + std::to_string(header) + ": value\r\n";
+        oversized += "\r\n";
+        ::write(fd, oversized.data(), oversized.size());
+        BOOST_CHECK_EQUAL(Receive(fd), "HTTP/1.1 431 Request Header Fields Too Large\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+        ::close(fd);
+    }
+
+    server.stop();
+    reactor.join();
+}
+
+/// Sprawdza czy klient wysyłający dane bez oczekującego odczytu nie zajmie buforów pierścienia pozostałych połączeń.
+BOOST_AUTO_TEST_CASE(PinnedBuffers)
+{
+    std::promise<void> release;
+    auto held = release.get_future().share();
+    Http::Server::StrategyPtr strategy(new Http::ThreadedHandlerStrategy([held](const Http::Request& request)
+    {
+        if (request.uri().raw() == "/hold")
+            held.wait();
+        return Http::Response(Http::ResponseStatus::Ok, '[' + std::to_string(request.body().size()) + ']', "text/plain");
+    }, 5000U, 2)); // wstrzymany handler nie blokuje drugiego połączenia.
+    Http::Server server("127.0.0.1", "9355", Http::Server::UringService, 1, std::move(strategy));
+    std::thread reactor([&server] { server.run(); });
+
+    int greedy = Connect(9355);
+    BOOST_REQUIRE(greedy != -1);
+    timeval timeout = { 1, 0 }; // serwis przestaje odbierać dane - zapis zakończy się po upływie czasu.
+    ::setsockopt(greedy, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof timeout);
+    std::string flood = "GET /hold HTTP/1.1\r\nConnection: close\r\n\r\n" + std::string(4 << 20, 'x'); // więcej niż cały pierścień.
+    std::size_t offset = 0;
+    ssize_t sent;
+    while (offset < flood.size() && (sent = ::send(greedy, flood.data() + offset, flood.size() - offset, MSG_NOSIGNAL)) > 0)
+        offset += sent;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200)); // serwis odbiera dane pozostałe w buforach gniazda.
+
+    int fd = Connect(9355);
+    BOOST_REQUIRE(fd != -1);
+    timeout.tv_sec = 5;
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout);
+    std::string body(100000, 'b');
+    std::string request = "POST / HTTP/1.1\r\nConnection: close\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    ::send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+    BOOST_CHECK(Receive(fd).find("[100000]") != std::string::npos);
+    ::close(fd);
+
+    release.set_value();
+    ::close(greedy);
+    server.stop();
+    reactor.join();
+}
+
+/// Sprawdza czy gniazda TLS, obsługiwane przez poll zamiast odbioru do pierścienia, zostaną obsłużone poprawnie.
+BOOST_AUTO_TEST_CASE(PolledTlsConnections)
+{
+    SelfSigned files;
+    auto tls = std::make_shared<Tcp::SslContext>(files.certificate, files.key);
+    Http::Server server("127.0.0.1", "9350", [](const Http::Request& request)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, '[' + request.uri().raw() + ']', "text/plain");
+    }, tls, 1, Http::Server::UringService);
+    std::thread reactor([&server] { server.run(); });
+
+    auto client = SSL_CTX_new(TLS_client_method());
+    SSL_SESSION* session = nullptr;
+    bool resumed = false;
+    BOOST_CHECK(TlsRequest(client, 9350, "GET /first HTTP/1.0\r\n\r\n", session, resumed).find("[/first]") != std::string::npos);
+    BOOST_CHECK(TlsRequest(client, 9350, "GET /second HTTP/1.0\r\n\r\n", session, resumed).find("[/second]") != std::string::npos);
+    BOOST_CHECK(resumed);
+
+    SSL_SESSION_free(session);
+    SSL_CTX_free(client);
+    server.stop();
+    reactor.join();
+}
+
+/// Sprawdza czy nieudany zapis zlecony bez oczekiwania na wynik zostanie zliczony i zakończy odczyt gniazda błędem.
+BOOST_AUTO_TEST_CASE(FailedDirectWrite)
+{
+    if (!Tcp::UringStreamService::Supported())
+    {
+        BOOST_TEST_MESSAGE("io_uring is not supported, skipping");
+        return;
+    }
+
+    Tcp::UringStreamService service;
+    Tcp::Acceptor acceptor(service);
+    Tcp::Endpoint endpoint = service.getFactory()->resolve("127.0.0.1", "0");
+    acceptor.open(endpoint.protocol());
+    acceptor.bind(endpoint.address());
+    acceptor.listen(1);
+
+    sockaddr_in address = sockaddr_in();
+    socklen_t length = sizeof address;
+    BOOST_REQUIRE(::getsockname(acceptor.getHandle(), reinterpret_cast<sockaddr*>(&address), &length) == 0);
+    int client = Connect(ntohs(address.sin_port));
+    BOOST_REQUIRE(client != -1);
+
+    std::unique_ptr<Tcp::Socket> accepted;
+    std::array<char, 16> data;
+    int written = 0, received = 1;
+    acceptor.asyncAccept([&](Tcp::Socket socket)
+    {
+        accepted.reset(new Tcp::Socket(std::move(socket)));
+        linger reset = { 1, 0 };
+        ::setsockopt(client, SOL_SOCKET, SO_LINGER, &reset, sizeof reset);
+        ::close(client); // RST - zapis zakończy się błędem dopiero po zwróceniu wyniku przez writeSome.
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+        std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+        written = accepted->writeSome(Tcp::ConstBuffer(response.data(), static_cast<int>(response.size())));
+        accepted->asyncReadSome(Tcp::MakeBuffer(data), [&](int, int bytes)
+        {
+            received = bytes;
+            service.stop();
+        });
+    });
+    service.run();
+
+    BOOST_CHECK(written > 0);
+    BOOST_CHECK(received <= 0);
+    BOOST_CHECK_EQUAL(service.failedWrites(), 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif // defined(PATR_OS_LINUX)
+
+#endif // defined(PATR_OS_UNIX)
+
+/// Testy pamięci podręcznej rozwiązywania nazw.
+BOOST_AUTO_TEST_SUITE(NameResolution)
+
+/// Sprawdza czy kolejne zapytania o ten sam host zostaną obsłużone z pamięci do czasu jej wygaśnięcia.
+BOOST_AUTO_TEST_CASE(CachedLookup)
+{
+    int lookups = 0;
+    auto stub = [&lookups](const std::string&, const std::string& port)
+    {
+        ++lookups;
+        return Tcp::Resolver::SystemLookup("127.0.0.1", port);
+    };
+
+    Tcp::Resolver resolver(std::chrono::seconds(60), std::chrono::seconds(5), 16, stub);
+    auto first = resolver.resolve("storage.local", "80");
+    auto second = resolver.resolve("storage.local", "80");
+    BOOST_CHECK_EQUAL(lookups, 1);
+    BOOST_CHECK(first == second);
+    BOOST_CHECK_EQUAL(resolver.statistics().hits, 1U);
+
+    resolver.resolve("storage.local", "8080"); // port jest częścią wyniku.
+    BOOST_CHECK_EQUAL(lookups, 2);
+
+    resolver.clear();
+    resolver.resolve("storage.local", "80");
+    BOOST_CHECK_EQUAL(lookups, 3);
+
+    Tcp::Resolver expiring(std::chrono::seconds(0), std::chrono::seconds(0), 16, stub);
+    expiring.resolve("storage.local", "80");
+    expiring.resolve("storage.local", "80");
+    BOOST_CHECK_EQUAL(lookups, 5);
+}
+
+/// Sprawdza czy niepowodzenie zostanie zapamiętane na czas negativeTtl.
+BOOST_AUTO_TEST_CASE(NegativeCaching)
+{
+    int lookups = 0;
+    auto stub = [&lookups](const std::string& host, const std::string&) -> Tcp::Resolver::Result
+    {
+        ++lookups;
+        throw Tcp::EndpointError("no such host " + host);
+    };
+
+    Tcp::Resolver resolver(std::chrono::seconds(60), std::chrono::seconds(60), 16, stub);
+    BOOST_CHECK_THROW(resolver.resolve("missing.local", "80"), Tcp::EndpointError);
+    BOOST_CHECK_THROW(resolver.resolve("missing.local", "80"), Tcp::EndpointError);
+    BOOST_CHECK_EQUAL(lookups, 1);
+
+    Tcp::Resolver retrying(std::chrono::seconds(60), std::chrono::seconds(0), 16, stub);
+    BOOST_CHECK_THROW(retrying.resolve("missing.local", "80"), Tcp::EndpointError);
+    BOOST_CHECK_THROW(retrying.resolve("missing.local", "80"), Tcp::EndpointError);
+    BOOST_CHECK_EQUAL(lookups, 3);
+}
+
+/// Sprawdza czy równoczesne zapytania o ten sam host zostaną połączone w jedno rozwiązanie.
+BOOST_AUTO_TEST_CASE(CoalescedLookups)
+{
+    std::atomic<int> lookups(0);
+    std::atomic<bool> release(false);
+    auto stub = [&lookups, &release](const std::string&, const std::string& port)
+    {
+        ++lookups;
+        while (!release)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        return Tcp::Resolver::SystemLookup("127.0.0.1", port);
+    };
+
+    Tcp::Resolver resolver(std::chrono::seconds(60), std::chrono::seconds(5), 16, stub);
+    const int threads = 8;
+    std::atomic<int> resolved(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+        workers.emplace_back([&resolver, &resolved] { resolved += resolver.resolve("storage.local", "80") != nullptr; });
+
+    while (resolver.statistics().coalesced + 1 < static_cast<std::size_t>(threads))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    release = true;
+    for (auto& worker : workers)
+        worker.join();
+
+    BOOST_CHECK_EQUAL(lookups, 1);
+    BOOST_CHECK_EQUAL(resolved, threads);
+    BOOST_CHECK_EQUAL(resolver.statistics().lookups, 1U);
+}
+
+/// Sprawdza czy przy braku miejsca usuwane są najwcześniej wygasające nazwy.
+BOOST_AUTO_TEST_CASE(Capacity)
+{
+    int lookups = 0;
+    auto stub = [&lookups](const std::string&, const std::string& port)
+    {
+        ++lookups;
+        return Tcp::Resolver::SystemLookup("127.0.0.1", port);
+    };
+
+    Tcp::Resolver resolver(std::chrono::seconds(60), std::chrono::seconds(5), 2, stub);
+    resolver.resolve("a.local", "80");
+    resolver.resolve("b.local", "80");
+    resolver.resolve("c.local", "80"); // usuwa a.local.
+    resolver.resolve("c.local", "80");
+    resolver.resolve("a.local", "80");
+    BOOST_CHECK_EQUAL(lookups, 4);
+}
+
+/// Sprawdza czy punkty docelowe tworzone przez fabrykę serwisu korzystają z pamięci procesu (localhost z /etc/hosts).
+BOOST_AUTO_TEST_CASE(FactoryUsesSharedCache)
+{
+    auto& resolver = Tcp::Resolver::Shared();
+    resolver.clear();
+    auto before = resolver.statistics();
+
+    Tcp::StreamService service;
+    auto first = service.getFactory()->resolve("localhost", "80");
+    auto second = service.getFactory()->resolve("localhost", "80");
+    BOOST_CHECK(first->address() == second->address());
+
+    auto after = resolver.statistics();
+    BOOST_CHECK_EQUAL(after.lookups - before.lookups, 1U);
+    BOOST_CHECK_EQUAL(after.hits - before.hits, 1U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,25 @@
+#include <iostream>
+
+#include "bench/Benchmark.h"
+
+/// Uruchamia benchmarki podane jako argumenty lub wszystkie, jeżeli nie podano żadnego.
+int main(int argc, char* argv[])
+{
+    auto& registry = Bench::Registry();
+
+    for (const auto& benchmark : registry)
+    {
+        bool selected = argc < 2;
+        for (int i = 1; i < argc; ++i)
+            selected = selected || benchmark.first == argv[i];
+
+        if (!selected)
+            continue;
+
+        std::cout << "== " << benchmark.first << " ==" << std::endl;
+        benchmark.second(std::cout);
+        std::cout << std::endl;
+    }
+
+    return 0;
+}
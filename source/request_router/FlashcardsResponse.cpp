@@ -1,4 +1,6 @@
 ﻿#include <fstream>
+#include <memory>
+#include <tuple>
 #include <iterator>
 #include <opencv2/opencv.hpp>
 
@@ -31,9 +33,8 @@ std::string getTextFromDisk(const std::string& filename)
 
 std::string getTextFromHttp(const std::string& url)
 {
-    std::vector<unsigned char> buffer;
-    Utility::dlFileToBuffer(url, buffer);
-    return std::string(buffer.begin(), buffer.end());
+    auto data = Utility::dlFileAsync(url).get();
+    return std::string(data.begin(), data.end());
 }
 
 
@@ -77,10 +78,73 @@ std::pair<std::string, int> FlashcardsResponse(const std::string& body, std::str
 }
 
 
+Http::Response FlashcardsStreamingResponse(const std::string& body, std::string(*textFetcher)(const std::string&))
+{
+    std::shared_ptr<std::vector<cv::Mat>> images;
+    bool delegate = false;
+
+    auto error = GenericRequestErrorHandler([&](Http::ResponseStatus& status, Json& response)
+    {
+        response[Rest::Response::STATUS] = Rest::Response::FLASHCARDS_STATUS_FAILURE;
+
+        Json request = Json::deserialize(body);
+
+        std::string url = request[Rest::Request::URL];
+        std::string action = request[Rest::Request::ACTION];
+
+        if (action != Rest::Request::IMG_TO_FLASHCARD)
+        {
+            delegate = true; // tekst pobierany jest w całości, brak wyników częściowych.
+            return;
+        }
+
+        cv::Mat source = GetImageFromUrl(url);
+        images = std::make_shared<std::vector<cv::Mat>>(Ocr::preprocess(source));
+        status = Http::Response::Status::Ok;
+    });
+
+    if (delegate)
+        std::tie(error.first, error.second) = FlashcardsResponse(body, textFetcher);
+    if (!images)
+        return Http::Response(static_cast<Http::Response::Status>(error.second), error.first, "application/json");
+
+    // Błędy przed wysłaniem nagłówków zwracane są jak w FlashcardsResponse, późniejsze - w polu error_description.
+    return Http::Response(Http::Response::Status::Ok, "application/json", [images](Http::ResponseStream& stream)
+    {
+        if (!stream.write(std::string("{\"") + Rest::Response::FLASHCARDS_REGIONS + "\":["))
+            return;
+
+        Json result;
+        try
+        {
+            Ocr ocr;
+            std::string text;
+            for (std::size_t i = 0; i < images->size(); ++i)
+            {
+                auto region = ocr.recognize((*images)[i]);
+                text += region;
+                if (!stream.write((i ? "," : "") + Json(region).serialize()))
+                    return; // klient zamknął połączenie.
+            }
+
+            result[Rest::Response::FLASHCARDS] = textToFlashcardJson(text);
+            result[Rest::Response::STATUS] = result[Rest::Response::FLASHCARDS].size() > 0 ? 1 : 2;
+        }
+        catch (const std::exception& e)
+        {
+            result[Rest::Response::STATUS] = Rest::Response::FLASHCARDS_STATUS_FAILURE;
+            result[Rest::Response::ERROR_DESCRIPTION] = std::string(Rest::Response::ErrorStrings::UNKNOWN_ELABORATE) + e.what();
+        }
+
+        stream.write("]," + result.serialize().substr(1)); // pola wyniku dołączane są do otwartego obiektu.
+    });
+}
+
+
 void registerFlashcardsResponse(Router::RequestRouter& router)
 {
-    router.registerEndPointService(Rest::Endpoint::FLASHCARDS_ENDPOINT, [](const std::string& body)
+    router.registerStreamingEndPointService(Rest::Endpoint::FLASHCARDS_ENDPOINT, [](const std::string& body)
     {
-        return FlashcardsResponse(body, getTextFromHttp);
+        return FlashcardsStreamingResponse(body, getTextFromHttp);
     });
 }
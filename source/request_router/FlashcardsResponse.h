@@ -9,10 +9,20 @@ namespace Router
     class RequestRouter;
 }
 
+namespace Http
+{
+    class Response;
+}
+
 
 // Tworzy odpowiedź na zapytanie zamiany obrazka / pliku tekstowego na fiszki
 std::pair<std::string, int> FlashcardsResponse(const std::string& body, std::string(*textFetcher)(const std::string&));
 
+// Tworzy strumieniową odpowiedź na zapytanie zamiany obrazka na fiszki.
+// Tekst kolejnych regionów wysyłany jest w tablicy "regions" zaraz po rozpoznaniu, fiszki i status na końcu dokumentu.
+// Pozostałe akcje obsługiwane są przez FlashcardsResponse.
+Http::Response FlashcardsStreamingResponse(const std::string& body, std::string(*textFetcher)(const std::string&));
+
 // Dodaje obsługę żądania przetwarzania obrazka / pliku tekstowego na fiszki do RequestRouter
 void registerFlashcardsResponse(Router::RequestRouter& router);
 
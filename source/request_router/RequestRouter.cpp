@@ -8,11 +8,24 @@ namespace Router
 {
     Http::Response RequestRouter::routeRequest(const Http::Request& request)
     {
-        auto func = services.find(request.uri().raw());
+        RouteMatch match(request.uri());
+        std::string allowed;
+        auto route = routes.find(request.method(), match, &allowed);
 
         logger.trace("received request");
 
-        if (func == services.end())
+        if (!route && !allowed.empty())
+        {
+            logger.info("request endpoint ", request.uri().raw(), " does not support method ", request.method(), ", return code ", static_cast<int>(Http::Response::Status::MethodNotAllowed));
+            Http::Response response(
+                Http::Response::Status::MethodNotAllowed,
+                R"({"error":"method not allowed"})",
+                "application/json");
+            response.headers.push_back(Http::Header("Allow", allowed));
+            return response;
+        }
+
+        if (!route)
         {
             logger.info("request endpoint ", request.uri().raw(), " not found, return code ", static_cast<int>(Http::Response::Status::NotFound));
             return Http::Response(
@@ -24,20 +37,13 @@ namespace Router
 
         try
         {
-            std::string body;
-            int response_code;
-            std::tie(body, response_code) = func->second(request.body());
-           
-            logger.info("endpoint ", func->first, " success, return code ", response_code);
-
-            return Http::Response(
-                static_cast<Http::Response::Status>(response_code),
-                body,
-                "application/json");
+            auto response = route->handler(request, match);
+            logger.info("endpoint ", route->pattern, " success, return code ", static_cast<int>(response.status()));
+            return response;
         }
         catch (const std::exception& e)
         {
-            logger.warn("endpoint ", func->first, " failed, return code ", static_cast<int>(Http::Response::Status::InternalServerError), ", error message: ", e.what());
+            logger.warn("endpoint ", request.uri().raw(), " failed, return code ", static_cast<int>(Http::Response::Status::InternalServerError), ", error message: ", e.what());
 
             if (emitExceptionsToStdcerr)
                 std::cerr << "REQUEST ROUTER: Caught exception in execution handler for " + request.uri().raw() + " endpoint: "
@@ -61,14 +67,25 @@ namespace Router
 
     void RequestRouter::registerEndPointService(const std::string& endPoint, EndpointHandler func)
     {
-        auto lookup = services.find(endPoint);
-        if (lookup != services.end())
-        {
-            lookup->second = std::move(func);
-        }
-        else
+        routes.add("", endPoint, [func](const Http::Request& request, const RouteMatch&)
         {
-            services.insert({ endPoint, std::move(func) });
-        }
+            std::string body;
+            int response_code;
+            std::tie(body, response_code) = func(request.body());
+            return Http::Response(
+                static_cast<Http::Response::Status>(response_code),
+                body,
+                "application/json");
+        });
     };
+
+    void RequestRouter::registerStreamingEndPointService(const std::string& endPoint, ResponseHandler func)
+    {
+        routes.add("", endPoint, [func](const Http::Request& request, const RouteMatch&) { return func(request.body()); });
+    }
+
+    void RequestRouter::registerRoute(const std::string& method, const std::string& pattern, RouteHandler handler)
+    {
+        routes.add(method, pattern, std::move(handler));
+    }
 }
@@ -1,10 +1,10 @@
 #ifndef PATR_REQUESTROUTER_H
 #define PATR_REQUESTROUTER_H
 
-#include <map>
 #include <string>
 #include <functional>
 #include "../httpserver/ServerUtilities.h"
+#include "RouteTable.h"
 
 #include "../log/Logger.h"
 
@@ -19,8 +19,22 @@ namespace Router
          * @return odpowiedź na zapytanie (np. JSON) w postaci std::pair<std::string, int>. int określa kod odpowiedzi Http.
          */
         using EndpointHandler = std::function<std::pair<std::string, int>(const std::string&)>;
+        /// Szablon lambdy zwracającej gotową odpowiedź
+        /*
+         * @param ciało zapytania http (np. JSON)
+         * @return odpowiedź Http, również strumieniowa (Http::Response::Producer) - ciało generowane jest w trakcie wysyłania.
+         */
+        using ResponseHandler = std::function<Http::Response(const std::string&)>;
+        /// Szablon lambdy obsługującej trasę
+        /*
+         * @param zapytanie http
+         * @param wynik dopasowania trasy - parametry ścieżki i argumenty GET (RouteMatch::uri())
+         * @return odpowiedź Http, również strumieniowa
+         */
+        using RouteHandler = RouteTable::Handler;
 
-        std::map<std::string, EndpointHandler> services;
+        /// Trasy wszystkich zarejestrowanych handlerów, kompilowane podczas rejestracji.
+        RouteTable routes;
 
     public:
         RequestRouter(LogManager& logManager);
@@ -45,13 +59,34 @@ namespace Router
          */
         void registerEndPointService(const std::string& endpoint, EndpointHandler handler);
 
+        /// Rejestruje handler zwracający pełną odpowiedź Http, np. strumieniową
+        /*
+         * @param endpoint - ciąg znaków określający dla jakiego endpointa jest przeznaczony handler.
+         * @param handler - lambda lub obiekt funkcyjny przyjmujący const std::string& i zwracający Http::Response.
+         * Wyjątki zgłoszone przed zwróceniem odpowiedzi obsługiwane są jak w registerEndPointService,
+         * wyjątek producenta odpowiedzi strumieniowej przerywa połączenie.
+         * Zastępuje handler zarejestrowany wcześniej dla tego samego endpointa.
+         */
+        void registerStreamingEndPointService(const std::string& endpoint, ResponseHandler handler);
+
+        /// Rejestruje handler trasy dla podanej metody HTTP
+        /*
+         * @param method - metoda HTTP (np. Http::RequestMethod::GET), pusty ciąg znaków oznacza wszystkie metody bez własnego handlera.
+         * @param pattern - wzorzec ścieżki, w którym segmenty rozpoczynające się od ':' są parametrami, np. "/api/items/:id".
+         * @param handler - lambda lub obiekt funkcyjny przyjmujący zapytanie i RouteMatch, zwracający Http::Response.
+         * Zapytanie o istniejącą ścieżkę bez handlera dla jego metody otrzymuje odpowiedź 405 z nagłówkiem Allow.
+         * Zastępuje handler zarejestrowany wcześniej dla tej samej metody i wzorca.
+         */
+        void registerRoute(const std::string& method, const std::string& pattern, RouteHandler handler);
+
 
-        /// Wywołuje odpowiedni handler (na podstawie URI zapytania)
+        /// Wywołuje odpowiedni handler (na podstawie metody i ścieżki URI zapytania, z pominięciem argumentów GET)
         /*
          * @param Request od serwera
          * @return Odpowiedź do serwera z ciałem zawierającym:
          *   wynik działania handlera lub
          *   json z wiadomością o "not found" jeżeli nie ma obsługi żądanego endpointa lub
+         *   json z wiadomością o "method not allowed" jeżeli endpoint nie obsługuje metody zapytania lub
          *   json z wiadomością o "internal server error" jeżeli złapano wyjątek podczas działania handlera.
          */
         Http::Response routeRequest(const Http::Request& request);
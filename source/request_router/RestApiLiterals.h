@@ -23,6 +23,7 @@ namespace Rest {
     constexpr auto SEGMENTATION_STATUS_FAILURE = 2;
 
     constexpr auto FLASHCARDS = "flashcards";
+    constexpr auto FLASHCARDS_REGIONS = "regions";
     constexpr auto FLASHCARDS_STATUS_FAILURE = 0;
 
     constexpr auto FLASHCARD_ANALYSIS_FLASHCARDS = "flashcards";
@@ -0,0 +1,174 @@
+#include "RouteTable.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace Router
+{
+    struct RouteTable::Node
+    {
+        using Child = std::pair<std::string, std::unique_ptr<Node>>;
+
+        std::vector<Child> children; //< Segmenty stałe posortowane rosnąco.
+        std::unique_ptr<Node> parameter; //< Segment parametru, dopasowywany po segmentach stałych.
+        std::vector<std::pair<std::string, Route>> methods; //< Trasy dla poszczególnych metod.
+        std::unique_ptr<Route> any; //< Trasa dla metod bez własnego handlera.
+    };
+
+    namespace
+    {
+        /// Porównuje segment węzła z wycinkiem ścieżki bez kopiowania.
+        int Compare(const std::string& segment, const Http::Slice& slice)
+        {
+            return segment.compare(0, segment.size(), slice.data, slice.size);
+        }
+    }
+
+    RouteMatch::RouteMatch(const Http::Uri& uri) : view(uri), count(0), names(nullptr)
+    {
+    }
+
+    bool RouteMatch::parameter(const char* name, Http::Slice& value) const
+    {
+        if (!names)
+            return false;
+
+        for (std::size_t i = 0; i < count && i < names->size(); ++i)
+        {
+            if ((*names)[i] == name)
+            {
+                value = values[i];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const Http::UriView& RouteMatch::uri() const
+    {
+        return view;
+    }
+
+    RouteTable::RouteTable() : root(new Node()), count(0)
+    {
+    }
+
+    RouteTable::~RouteTable() = default;
+    RouteTable::RouteTable(RouteTable&&) = default;
+    RouteTable& RouteTable::operator=(RouteTable&&) = default;
+
+    void RouteTable::add(const std::string& method, const std::string& pattern, Handler handler)
+    {
+        std::vector<Http::Slice> segments;
+        Http::UriView view(pattern.data(), pattern.size());
+        std::size_t position = 0;
+        Http::Slice segment;
+        while (view.segment(position, segment))
+            segments.push_back(segment);
+
+        Route route{ pattern, {}, std::move(handler) };
+        for (const auto& segment : segments)
+            if (segment.size > 1 && segment.data[0] == ':')
+                route.parameters.push_back(std::string(segment.data + 1, segment.size - 1));
+        if (route.parameters.size() > RouteMatch::MaxParameters)
+            throw std::invalid_argument("too many parameters in route " + pattern);
+
+        auto node = root.get();
+        for (const auto& segment : segments)
+        {
+            if (segment.size > 1 && segment.data[0] == ':')
+            {
+                if (!node->parameter)
+                    node->parameter.reset(new Node());
+                node = node->parameter.get();
+                continue;
+            }
+
+            auto child = std::lower_bound(node->children.begin(), node->children.end(), segment,
+                [](const Node::Child& child, const Http::Slice& segment) { return Compare(child.first, segment) < 0; });
+            if (child == node->children.end() || Compare(child->first, segment) != 0)
+                child = node->children.emplace(child, segment.str(), std::unique_ptr<Node>(new Node()));
+            node = child->second.get();
+        }
+
+        if (method.empty())
+        {
+            if (!node->any)
+                ++count;
+            node->any.reset(new Route(std::move(route)));
+            return;
+        }
+
+        auto existing = std::find_if(node->methods.begin(), node->methods.end(),
+            [&method](const std::pair<std::string, Route>& entry) { return entry.first == method; });
+        if (existing != node->methods.end())
+            existing->second = std::move(route);
+        else
+        {
+            node->methods.emplace_back(method, std::move(route));
+            ++count;
+        }
+    }
+
+    const RouteTable::Route* RouteTable::find(const std::string& method, RouteMatch& match, std::string* allowed) const
+    {
+        match.count = 0;
+        match.names = nullptr;
+
+        auto node = this->match(*root, 0, match);
+        if (!node)
+            return nullptr;
+
+        const Route* route = node->any.get();
+        for (const auto& entry : node->methods)
+        {
+            if (entry.first == method)
+            {
+                route = &entry.second;
+                break;
+            }
+        }
+
+        if (route)
+        {
+            match.names = &route->parameters;
+        }
+        else if (allowed)
+        {
+            allowed->clear();
+            for (const auto& entry : node->methods)
+                *allowed += (allowed->empty() ? "" : ", ") + entry.first;
+        }
+        return route;
+    }
+
+    std::size_t RouteTable::size() const
+    {
+        return count;
+    }
+
+    const RouteTable::Node* RouteTable::match(const Node& node, std::size_t position, RouteMatch& match) const
+    {
+        Http::Slice segment;
+        if (!match.view.segment(position, segment))
+            return node.methods.empty() && !node.any ? nullptr : &node;
+
+        auto child = std::lower_bound(node.children.begin(), node.children.end(), segment,
+            [](const Node::Child& child, const Http::Slice& segment) { return Compare(child.first, segment) < 0; });
+        if (child != node.children.end() && Compare(child->first, segment) == 0)
+        {
+            if (auto found = this->match(*child->second, position, match))
+                return found;
+        }
+
+        if (node.parameter && segment.size > 0 && match.count < RouteMatch::MaxParameters)
+        {
+            match.values[match.count++] = segment;
+            if (auto found = this->match(*node.parameter, position, match))
+                return found;
+            --match.count;
+        }
+        return nullptr;
+    }
+}
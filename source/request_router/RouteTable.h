@@ -0,0 +1,100 @@
+#ifndef PATR_ROUTETABLE_H
+#define PATR_ROUTETABLE_H
+
+#include <array>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include "../httpserver/ServerUtilities.h"
+
+namespace Router
+{
+    /// Wynik dopasowania trasy - parametry ścieżki i widok URI zapytania
+    /*
+     * Wartości parametrów są wycinkami URI zapytania i pozostają ważne do czasu jego zniszczenia.
+     * Parametry ścieżki i argumenty GET nie są dekodowane.
+     */
+    class RouteMatch
+    {
+    public:
+        /// Największa liczba parametrów we wzorcu trasy.
+        static constexpr std::size_t MaxParameters = 8;
+
+        RouteMatch(const Http::Uri& uri);
+
+        /// Zwraca wartość parametru ścieżki o podanej nazwie (np. "id" dla wzorca /api/items/:id)
+        /*
+         * @return false, jeżeli trasa nie posiada takiego parametru.
+         */
+        bool parameter(const char* name, Http::Slice& value) const;
+        /// Zwraca widok URI zapytania, m.in. z argumentami GET.
+        const Http::UriView& uri() const;
+
+    private:
+        friend class RouteTable;
+
+        Http::UriView view;
+        std::array<Http::Slice, MaxParameters> values;
+        std::size_t count;
+        const std::vector<std::string>* names; //< Nazwy parametrów dopasowanej trasy.
+    };
+
+    /// Drzewo tras kompilowane podczas rejestracji
+    /*
+     * Wzorzec dzielony jest na segmenty ścieżki - segment rozpoczynający się od ':' jest parametrem
+     * dopasowującym dowolny segment. Segmenty stałe mają pierwszeństwo przed parametrami.
+     * Każda trasa może mieć osobne handlery dla metod HTTP oraz handler dla pozostałych metod.
+     * Wyszukiwanie nie alokuje pamięci - porównuje wycinki ścieżki z posortowanymi segmentami węzłów.
+     */
+    class RouteTable
+    {
+    public:
+        /// Handler trasy otrzymujący zapytanie i wynik dopasowania.
+        using Handler = std::function<Http::Response(const Http::Request&, const RouteMatch&)>;
+
+        /// Zarejestrowana trasa.
+        struct Route
+        {
+            std::string pattern; //< Wzorzec, z którego utworzono trasę.
+            std::vector<std::string> parameters; //< Nazwy parametrów w kolejności segmentów.
+            Handler handler;
+        };
+
+        RouteTable();
+        ~RouteTable();
+        RouteTable(RouteTable&&);
+        RouteTable& operator=(RouteTable&&);
+
+        /// Rejestruje handler trasy
+        /*
+         * @param method - metoda HTTP, pusty ciąg znaków oznacza wszystkie metody bez własnego handlera.
+         * @param pattern - wzorzec ścieżki, np. "/api/items/:id".
+         * Zastępuje handler zarejestrowany wcześniej dla tej samej metody i wzorca.
+         * Zgłasza std::invalid_argument, jeżeli wzorzec ma więcej niż RouteMatch::MaxParameters parametrów.
+         */
+        void add(const std::string& method, const std::string& pattern, Handler handler);
+
+        /// Wyszukuje trasę dla metody i ścieżki zapytania
+        /*
+         * @param match - wynik dopasowania, uzupełniany parametrami ścieżki.
+         * @param allowed - jeżeli ścieżka istnieje, ale nie obsługuje metody, otrzymuje listę metod dla nagłówka Allow.
+         * @return trasa lub nullptr, jeżeli ścieżka nie istnieje albo nie obsługuje metody.
+         */
+        const Route* find(const std::string& method, RouteMatch& match, std::string* allowed = nullptr) const;
+
+        /// Zwraca liczbę zarejestrowanych tras - par metody i wzorca.
+        std::size_t size() const;
+
+    private:
+        struct Node;
+
+        /// Dopasowuje segmenty ścieżki od pozycji position do poddrzewa węzła.
+        const Node* match(const Node& node, std::size_t position, RouteMatch& match) const;
+
+        std::unique_ptr<Node> root;
+        std::size_t count; //< Liczba tras, zastąpienie handlera jej nie zmienia.
+    };
+}
+
+#endif //PATR_ROUTETABLE_H
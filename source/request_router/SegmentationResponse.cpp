@@ -47,8 +47,7 @@ cv::Mat GetImageLocal(const std::string& path)
 
 cv::Mat GetImageFromUrl(const std::string& url)
 {
-    std::vector<unsigned char> buffer;
-    Utility::dlFileToBuffer(url, buffer);
+    auto buffer = Utility::dlFileAsync(url).get();
     return imdecode(cv::Mat(buffer), 1);
 }
 
@@ -6,6 +6,8 @@
 #include "../SegmentationResponse.h"
 #include "../TextAnalysisResponse.h"
 
+#include <algorithm>
+
 
 BOOST_AUTO_TEST_SUITE(RequestRouter)
 
@@ -21,7 +23,7 @@ struct FuncObj
 class TestRouter : public Router::RequestRouter
 {
 public:
-    size_t size() { return services.size(); }
+    size_t size() { return routes.size(); }
 };
 
 
@@ -105,6 +107,114 @@ BOOST_AUTO_TEST_CASE(Routing)
     BOOST_CHECK(not_found_response.raw().find(R"({"error":"no service for /api/none"})") != std::string::npos);
 }
 
+BOOST_AUTO_TEST_CASE(StreamingServices)
+{
+    TestRouter tr;
+    tr.emitExceptionsToStdcerr = false;
+    registerServices(tr);
+
+    // Handler strumieniowy zastępuje zwykły handler endpointa bez dodawania trasy
+    tr.registerStreamingEndPointService("/api/test", [](const std::string& s)
+    {
+        return Http::Response(Http::Response::Status::Ok, "application/json", [s](Http::ResponseStream& stream)
+        {
+            stream.write("[");
+            stream.write(s);
+            stream.write("]");
+        });
+    });
+    BOOST_CHECK(tr.size() == 3);
+
+    auto response = tr.routeRequest(getTestRequest("/api/test", "{}"));
+    BOOST_REQUIRE(response.streaming());
+
+    std::string body;
+    Http::ResponseStream stream([&body](const char* data, std::size_t size)
+    {
+        body.append(data, size);
+        return true;
+    });
+    response.produce(stream);
+    BOOST_CHECK(body == "[{}]");
+
+    tr.registerEndPointService("/api/test", FuncObj());
+    BOOST_CHECK(tr.size() == 3);
+    BOOST_CHECK(!tr.routeRequest(getTestRequest("/api/test", "{}")).streaming());
+}
+
+Http::Request getMethodRequest(const std::string& method, const std::string& uri)
+{
+    std::string input = method + " " + uri + " HTTP/1.1\r\n\r\n";
+
+    Http::Request request;
+    Http::RequestParser parser;
+    parser.parse(input.begin(), input.end(), request);
+    return request;
+}
+
+BOOST_AUTO_TEST_CASE(RouteParameters)
+{
+    Router::RequestRouter rr;
+    rr.emitExceptionsToStdcerr = false;
+
+    rr.registerRoute(Http::RequestMethod::GET, "/api/items/:id", [](const Http::Request&, const Router::RouteMatch& match)
+    {
+        Http::Slice id, limit;
+        BOOST_REQUIRE(match.parameter("id", id));
+        std::string body = "item " + id.str();
+        if (match.uri().parameter("limit", limit))
+            body += " limit " + limit.str();
+        return Http::Response(Http::Response::Status::Ok, body, "text/plain");
+    });
+    rr.registerRoute(Http::RequestMethod::GET, "/api/items/latest", [](const Http::Request&, const Router::RouteMatch&)
+    {
+        return Http::Response(Http::Response::Status::Ok, "latest", "text/plain");
+    });
+    rr.registerRoute(Http::RequestMethod::PUT, "/api/items/:id/tags/:tag", [](const Http::Request&, const Router::RouteMatch& match)
+    {
+        Http::Slice id, tag;
+        BOOST_REQUIRE(match.parameter("id", id) && match.parameter("tag", tag));
+        return Http::Response(Http::Response::Status::Ok, id.str() + ":" + tag.str(), "text/plain");
+    });
+
+    BOOST_CHECK_EQUAL(rr.routeRequest(getMethodRequest("GET", "/api/items/42")).body(), "item 42");
+    BOOST_CHECK_EQUAL(rr.routeRequest(getMethodRequest("GET", "/api/items/42?sort=asc&limit=10")).body(), "item 42 limit 10");
+    // Segment stały ma pierwszeństwo przed parametrem.
+    BOOST_CHECK_EQUAL(rr.routeRequest(getMethodRequest("GET", "/api/items/latest")).body(), "latest");
+    BOOST_CHECK_EQUAL(rr.routeRequest(getMethodRequest("PUT", "/api/items/7/tags/new")).body(), "7:new");
+
+    BOOST_CHECK(rr.routeRequest(getMethodRequest("GET", "/api/items/")).status() == Http::Response::Status::NotFound);
+    BOOST_CHECK(rr.routeRequest(getMethodRequest("GET", "/api/items/7/tags")).status() == Http::Response::Status::NotFound);
+}
+
+BOOST_AUTO_TEST_CASE(MethodDispatch)
+{
+    Router::RequestRouter rr;
+    rr.emitExceptionsToStdcerr = false;
+    registerServices(rr);
+
+    rr.registerRoute(Http::RequestMethod::GET, "/api/resource", [](const Http::Request&, const Router::RouteMatch&)
+    {
+        return Http::Response(Http::Response::Status::Ok, "get", "text/plain");
+    });
+    rr.registerRoute(Http::RequestMethod::DELETE, "/api/resource", [](const Http::Request&, const Router::RouteMatch&)
+    {
+        return Http::Response(Http::Response::Status::Ok, "delete", "text/plain");
+    });
+
+    BOOST_CHECK_EQUAL(rr.routeRequest(getMethodRequest("GET", "/api/resource")).body(), "get");
+    BOOST_CHECK_EQUAL(rr.routeRequest(getMethodRequest("DELETE", "/api/resource")).body(), "delete");
+
+    auto response = rr.routeRequest(getMethodRequest("POST", "/api/resource"));
+    BOOST_CHECK(response.status() == Http::Response::Status::MethodNotAllowed);
+    BOOST_CHECK(std::find(response.headers.begin(), response.headers.end(), Http::Header("Allow", "GET, DELETE")) != response.headers.end());
+
+    // Endpointy bez metody obsługują dowolną metodę, a argumenty GET nie wpływają na wybór endpointa.
+    auto request = getTestRequest("/api/test?verbose=1", "{}");
+    BOOST_CHECK(rr.routeRequest(request).raw().find(R"({"request":"response"})") != std::string::npos);
+    BOOST_CHECK(rr.routeRequest(getMethodRequest("GET", "/api/test")).status() == Http::Response::Status::Ok);
+}
+
 BOOST_AUTO_TEST_CASE(SegmentationResponse)
 {
     auto response = ::SegmentationResponse(R"({
@@ -0,0 +1,165 @@
+#include "ConnectionPool.h"
+#include "../httpserver/Socket.h"
+
+#include <algorithm>
+
+struct Utility::ConnectionPool::Connection::Entry
+{
+    Entry(std::unique_ptr<Tcp::StreamService> service) : service(std::move(service))
+    {
+    }
+
+    ~Entry()
+    {
+        if (socket)
+            socket->close();
+    }
+
+    std::unique_ptr<Tcp::StreamService> service; //< Niszczony po gnieździe, które z niego korzysta.
+    std::unique_ptr<Tcp::Socket> socket;
+    std::chrono::steady_clock::time_point since; //< Początek bezczynności.
+};
+
+Utility::ConnectionPool::Limits::Limits(std::size_t maxIdlePerHost, std::chrono::seconds idleTimeout, std::size_t maxIdle) :
+    maxIdlePerHost(maxIdlePerHost), idleTimeout(idleTimeout), maxIdle(maxIdle)
+{
+}
+
+Utility::ConnectionPool::Connection::Connection(ConnectionPool& pool, std::string key, std::unique_ptr<Entry> entry, bool reused) :
+    pool(&pool), key(std::move(key)), entry(std::move(entry)), wasReused(reused)
+{
+}
+
+Utility::ConnectionPool::Connection::Connection(Connection&& other) :
+    pool(other.pool), key(std::move(other.key)), entry(std::move(other.entry)), wasReused(other.wasReused)
+{
+}
+
+Utility::ConnectionPool::Connection::~Connection() = default;
+
+Tcp::Socket& Utility::ConnectionPool::Connection::socket()
+{
+    return *entry->socket;
+}
+
+bool Utility::ConnectionPool::Connection::reused() const
+{
+    return wasReused;
+}
+
+void Utility::ConnectionPool::Connection::release()
+{
+    if (entry)
+        pool->release(key, std::move(entry));
+}
+
+Utility::ConnectionPool::ConnectionPool(Limits limits) : limits(limits), context(std::make_shared<Tcp::SslContext>()), idleCount(0), counters()
+{
+}
+
+Utility::ConnectionPool::~ConnectionPool() = default;
+
+Utility::ConnectionPool::Connection Utility::ConnectionPool::acquire(const std::string& host, const std::string& port, bool secure)
+{
+    auto key = (secure ? "https://" : "http://") + host + ':' + port;
+    auto now = std::chrono::steady_clock::now();
+
+    std::vector<std::unique_ptr<Entry>> stale; // zamykane poza blokadą - zamknięcie TLS wysyła dane.
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto connections = idleConnections.find(key);
+        while (connections != idleConnections.end() && !connections->second.empty())
+        {
+            auto entry = std::move(connections->second.back());
+            connections->second.pop_back();
+            --idleCount;
+
+            if (now - entry->since < limits.idleTimeout && entry->socket->idle())
+            {
+                ++counters.reuses;
+                return Connection(*this, std::move(key), std::move(entry), true);
+            }
+            ++counters.discarded;
+            stale.push_back(std::move(entry));
+        }
+    }
+    stale.clear();
+
+    std::unique_ptr<Entry> entry(new Entry(std::unique_ptr<Tcp::StreamService>(secure ? new Tcp::SslStreamService(context) : new Tcp::StreamService())));
+    auto& service = *entry->service;
+    entry->socket.reset(new Tcp::Socket(service.getFactory()->resolve(host, port)->connect(service)));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++counters.connects;
+    }
+    return Connection(*this, std::move(key), std::move(entry), false);
+}
+
+void Utility::ConnectionPool::release(const std::string& key, std::unique_ptr<Entry> entry)
+{
+    auto now = std::chrono::steady_clock::now();
+    entry->since = now;
+
+    std::vector<std::unique_ptr<Entry>> stale;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto& host = idleConnections[key];
+
+        // Najdawniej używane połączenia hosta przekraczające czas bezczynności nie zostałyby już wydane.
+        auto expired = std::find_if(host.begin(), host.end(),
+            [&](const std::unique_ptr<Entry>& idle) { return now - idle->since < limits.idleTimeout; });
+        std::move(host.begin(), expired, std::back_inserter(stale));
+        host.erase(host.begin(), expired);
+        idleCount -= stale.size();
+
+        if (!host.empty() && host.size() >= limits.maxIdlePerHost)
+        {
+            stale.push_back(std::move(host.front()));
+            host.erase(host.begin());
+            --idleCount;
+        }
+        if (host.size() < limits.maxIdlePerHost && idleCount < limits.maxIdle)
+        {
+            host.push_back(std::move(entry));
+            ++idleCount;
+        }
+        else
+        {
+            stale.push_back(std::move(entry));
+        }
+        counters.discarded += stale.size();
+    }
+}
+
+void Utility::ConnectionPool::clear()
+{
+    std::map<std::string, std::vector<std::unique_ptr<Entry>>> stale;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stale.swap(idleConnections);
+        idleCount = 0;
+    }
+}
+
+Utility::ConnectionPool::Statistics Utility::ConnectionPool::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+std::size_t Utility::ConnectionPool::idle() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return idleCount;
+}
+
+const Tcp::SslContext& Utility::ConnectionPool::tls() const
+{
+    return *context;
+}
+
+Utility::ConnectionPool& Utility::ConnectionPool::Shared()
+{
+    static ConnectionPool pool;
+    return pool;
+}
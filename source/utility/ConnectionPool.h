@@ -0,0 +1,121 @@
+#ifndef PATR_CONNECTIONPOOL_H
+#define PATR_CONNECTIONPOOL_H
+
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstddef>
+
+namespace Tcp {
+class Socket;
+class StreamService;
+class SslContext;
+}
+
+namespace Utility {
+
+/// Pula trwałych połączeń klienta HTTP/1.1 współdzielona przez wątki.
+/**
+ * Bezczynne połączenia przechowywane są osobno dla każdego hosta (schemat, host i port) i wydawane
+ * od ostatnio używanego. Przed wydaniem połączenie jest sprawdzane - przeterminowane, zamknięte przez
+ * serwer lub z nieoczekiwanymi danymi jest zamykane. Każde połączenie ma własny serwis, ponieważ
+ * serwisy nie są bezpieczne wielowątkowo, a połączenie może trafić do innego wątku niż je utworzył.
+ * Połączenia TLS korzystają ze wspólnego kontekstu klienta, więc nowe połączenie wznawia sesję
+ * nawiązaną wcześniej z tym samym serwerem przez dowolny wątek.
+ * Klasa jest bezpieczna wielowątkowo, nawiązywanie połączeń odbywa się poza blokadą.
+ */
+class ConnectionPool
+{
+public:
+    /// Ograniczenia bezczynnych połączeń.
+    struct Limits
+    {
+        Limits(std::size_t maxIdlePerHost = 8, std::chrono::seconds idleTimeout = std::chrono::seconds(30), std::size_t maxIdle = 64);
+
+        std::size_t maxIdlePerHost; //< Największa liczba bezczynnych połączeń jednego hosta.
+        std::chrono::seconds idleTimeout; //< Czas bezczynności, po którym połączenie nie jest ponownie używane.
+        std::size_t maxIdle; //< Największa łączna liczba bezczynnych połączeń.
+    };
+
+    /// Liczniki puli.
+    struct Statistics
+    {
+        std::size_t connects; //< Nawiązane połączenia.
+        std::size_t reuses; //< Wydania bezczynnych połączeń.
+        std::size_t discarded; //< Bezczynne połączenia zamknięte przez sprawdzenie, czas bezczynności lub ograniczenia.
+    };
+
+    /// Połączenie wydane z puli.
+    /**
+     * Połączenie, które nie zostanie zwrócone przez release(), jest zamykane wraz z obiektem
+     * - np. gdy odczyt odpowiedzi przerwano wyjątkiem.
+     */
+    class Connection
+    {
+    public:
+        Connection(Connection&& other);
+        ~Connection();
+
+        Tcp::Socket& socket();
+        /// Zwraca, czy połączenie obsłużyło już wcześniejsze zapytanie.
+        bool reused() const;
+        /// Zwraca połączenie do puli - tylko po odczytaniu całej odpowiedzi, jeżeli serwer go nie zamyka.
+        void release();
+
+    private:
+        friend class ConnectionPool;
+
+        struct Entry;
+
+        Connection(ConnectionPool& pool, std::string key, std::unique_ptr<Entry> entry, bool reused);
+
+        ConnectionPool* pool;
+        std::string key;
+        std::unique_ptr<Entry> entry;
+        bool wasReused;
+    };
+
+    explicit ConnectionPool(Limits limits = Limits());
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /// Wydaje bezczynne połączenie z hostem lub nawiązuje nowe.
+    /**
+     * @param secure - połączenie TLS.
+     * @throw Tcp::TcpError, jeżeli nie można nawiązać połączenia.
+     */
+    Connection acquire(const std::string& host, const std::string& port, bool secure);
+    /// Zamyka wszystkie bezczynne połączenia.
+    void clear();
+    /// Zwraca liczniki puli.
+    Statistics statistics() const;
+    /// Zwraca liczbę bezczynnych połączeń.
+    std::size_t idle() const;
+    /// Zwraca kontekst połączeń TLS, m.in. z licznikami wznowionych sesji.
+    const Tcp::SslContext& tls() const;
+
+    /// Zwraca pulę wykorzystywaną przez dlFileToBuffer.
+    static ConnectionPool& Shared();
+
+private:
+    typedef Connection::Entry Entry;
+
+    /// Przyjmuje połączenie z powrotem, o ile nie przekracza ograniczeń.
+    void release(const std::string& key, std::unique_ptr<Entry> entry);
+
+    Limits limits;
+    std::shared_ptr<Tcp::SslContext> context;
+    mutable std::mutex mutex;
+    std::map<std::string, std::vector<std::unique_ptr<Entry>>> idleConnections; //< Od najdawniej używanego.
+    std::size_t idleCount;
+    Statistics counters;
+};
+
+} // namespace Utility
+
+#endif // PATR_CONNECTIONPOOL_H
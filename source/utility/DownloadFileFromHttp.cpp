@@ -2,192 +2,183 @@
 
 #include "../httpserver/Socket.h"
 #include "DownloadFileFromHttp.h"
+#include "ResponseParser.h"
+#include "ConnectionPool.h"
 
-#include <tuple>
-#include <regex>
 #include <string>
 #include <vector>
-#include <sstream>
 #include <fstream>
-#include <array>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 
 
 using namespace std;
 
 namespace
 {
-    enum class ResponseStatus
-    {
-        Good,
-        Error,
-        Redirect
-    };
+    /// Rozmiar bufora odbiorczego.
+    constexpr size_t receive_buffer_size = 64 * 1024;
 
-    const string content_len_str = "Content-Length: ";
-    const string header_separator = "\r\n\r\n";
-    const string new_line = "\r\n";
-    constexpr auto default_port = "80";
-    constexpr auto ssl_port = "443";
-    constexpr auto https = "https://";
-    const auto location_rgx = regex{ R"c((?:[L|l]ocation\:)\s+(.+[^\r\n])(?:\r\n))c" };
-    const auto http_response_rgx = regex{ R"(^HTTP\/[\d.]+\s+(\d+)\s+(.*)$)" };
-    constexpr int error_code = 400;
-    constexpr int redirect_code = 300;
-
-    
-    tuple<string, string, string> getDomainPortEndpoint(const string& url)
-    {
-        size_t domain_end;
-        size_t domain_start = url.find("http") == string::npos ? 0 : url.find_first_of("//") + 2;
-        size_t port_s = 0, port_e = 0;
 
-        auto endpoint_start = url.find("/", domain_start);
-        if (endpoint_start == string::npos)
+    void makeRequest(Tcp::Socket& sock, const std::string& request)
+    {
+        auto sent = sock.write(Tcp::MakeBuffer(request));
+        if (sent == 0)
         {
-            return getDomainPortEndpoint(url + "/");
+            throw runtime_error("Request fail: " + string{ strerror(errno) });
         }
+    }
+}
 
-        auto colon = url.find_first_of(":", domain_start);
-        if (colon != string::npos && colon < endpoint_start)
-        {
-            domain_end = colon;
-            port_s = colon + 1;
-            port_e = endpoint_start;
-        }
-        else
-        {
-            domain_end = endpoint_start;
-        }
 
-        return make_tuple<string, string, string>(
-            { url.begin() + domain_start,  url.begin() + domain_end },
-            port_s == port_e ? default_port : string{ url.begin() + port_s, url.begin() + port_e },
-            { url.begin() + endpoint_start, url.end() }
-        );
+
+namespace
+{
+    typedef function<int(pair<char*, int>&)> Reader;
+
+    /// Odbiorca ciała odpowiedzi.
+    struct Sink
+    {
+        Utility::Consumer consume;
+        function<void(size_t)> expect; //< Zapowiedź długości ciała, np. do rezerwacji bufora.
+    };
+
+    /// Zwraca odbiorcę dopisującego ciało do bufora.
+    Sink bufferSink(vector<unsigned char>& buffer)
+    {
+        return Sink{
+            [&buffer](const unsigned char* data, size_t size) { buffer.insert(end(buffer), data, data + size); },
+            [&buffer](size_t size) { buffer.reserve(buffer.size() + size); }
+        };
     }
-    
 
-    pair<ResponseStatus, string> checkResponse(const string& header)
+    /// Zwraca odbiorcę przekazującego ciało do funkcji consumer.
+    Sink consumerSink(const Utility::Consumer& consumer)
     {
-        string first_line{ begin(header), begin(header) + header.find_first_of(new_line) };
+        return Sink{ consumer, [](size_t) {} };
+    }
 
-        
-        smatch result;
-        if (!regex_search(first_line, result, http_response_rgx))
-        {
-            return{ ResponseStatus::Error, "Couldn't parse header" };
-        }
+    /// Wynik odczytu odpowiedzi.
+    struct Response
+    {
+        string redirect; //< Adres przekierowania, ciało odpowiedzi zostało pominięte.
+        bool reusable; //< Połączenie można wykorzystać do kolejnego zapytania.
+    };
 
-        int response_code = stoi(result[1]);
-        if (response_code >= error_code)
+    /// Bufor odbiorczy zachowywany w wątku i wykorzystywany przez kolejne pobrania.
+    /**
+     * Zagnieżdżone pobranie (np. z odbiorcy ciała) tworzy własny bufor.
+     */
+    class Receiver
+    {
+    public:
+        Receiver() : storage(move(spare()))
         {
-            return{ ResponseStatus::Error, result[2] };
+            storage.resize(receive_buffer_size);
         }
 
-        if (response_code > redirect_code)
+        ~Receiver()
         {
-            smatch loc_result;
-            if (regex_search(header, loc_result, location_rgx))
-            {
-                return{ ResponseStatus::Redirect, loc_result[1] };
-            }
+            spare() = move(storage);
         }
 
-        return{ ResponseStatus::Good, "" };
-    }
+        Receiver(const Receiver&) = delete;
+        Receiver& operator=(const Receiver&) = delete;
 
+        pair<char*, int> buffer() { return make_pair(storage.data(), static_cast<int>(storage.size())); }
 
-    string prepareRequest(const string& domain, const string& endpoint)
-    {
-        return "GET " + endpoint + " HTTP/1.0\r\n"
-            + "Host: " + domain + "\r\n"
-            + "User-Agent: curl/7.43.0\r\n"
-            + "Accept: */*\r\n\r\n";
-    }
+    private:
+        static vector<char>& spare()
+        {
+            thread_local vector<char> buffer;
+            return buffer;
+        }
 
+        vector<char> storage;
+    };
 
-    void makeRequest(Tcp::Socket& sock, const std::string& request)
+    /// Odczytuje odpowiedź, przekazując ciało odbiorcy.
+    /**
+     * Odebrane dane przetwarza Utility::ResponseParser - ciało przekazywane jest odbiorcy fragmentami
+     * wprost z bufora odbiorczego, a ciało przekierowania jest pomijane.
+     * @throw std::runtime_error przy błędach http i zerwaniu połączenia przed końcem odpowiedzi.
+     */
+    Response readResponse(const Sink& sink, const Reader& read)
     {
-        auto sent = sock.write(Tcp::MakeBuffer(request));
-        if (sent == 0)
+        Utility::ResponseParser parser(sink.consume, sink.expect);
+        Receiver receiver;
+        for (;;)
         {
-            throw runtime_error("Request fail: " + string{ strerror(errno) });
+            auto b = receiver.buffer();
+            auto recvd = read(b);
+            if (recvd <= 0)
+            {
+                parser.close();
+                break;
+            }
+            if (parser.consume(b.first, recvd))
+                break;
         }
+        return Response{ parser.redirect(), parser.reusable() };
     }
-}
-
-
 
-namespace Utility
-{
-    void fetchData(vector<unsigned char>& buffer, function<int(pair<char*, int>&)> func)
+    /// Pobiera zasób przez połączenie trwałe z puli.
+    /**
+     * Połączenie z puli mogło zostać zamknięte przez serwer tuż przed wysłaniem zapytania
+     * - jeżeli nie odebrano żadnej odpowiedzi, zapytanie jest ponawiane na nowym połączeniu.
+     * @return adres przekierowania lub pusty ciąg znaków.
+     */
+    string dlFromPool(const Utility::HttpTarget& target, const Sink& sink)
     {
-        array<char, 1024> b = { 0 };
-        Tcp::Buffer tb = Tcp::MakeBuffer(b);
-
-        size_t recvd;
+        const auto req = target.request();
+        auto& pool = Utility::ConnectionPool::Shared();
 
-        bool header_complete = false;
-        string header;
-
-        while ((recvd = func(tb)) != 0)
+        for (;;)
         {
-            if (!header_complete)
+            auto connection = pool.acquire(target.domain, target.port, target.secure);
+            auto& sock = connection.socket();
+            size_t received = 0;
+            try
             {
-                copy(begin(b), begin(b) + recvd, back_inserter(header));
-
-                auto end_of_header = header.find(header_separator);
-                if (end_of_header == string::npos)
-                {
-                    continue;
-                }
-
-
-                header_complete = true;
-
-                ResponseStatus status;
-                string msg;
-                tie(status, msg) = checkResponse(header);
-                if (status == ResponseStatus::Error)
+                makeRequest(sock, req);
+                auto response = readResponse(sink, [&sock, &received](Tcp::Buffer& b) -> int
                 {
-                    throw runtime_error(msg);
-                }
-                else if (status == ResponseStatus::Redirect)
+                    auto recvd = sock.readSome(b);
+                    received += recvd > 0 ? recvd : 0;
+                    return recvd;
+                });
+                if (response.reusable)
                 {
-                    return dlFileToBuffer(msg, buffer);
+                    connection.release();
                 }
-
-                auto header_content_len = search(begin(header), end(header), begin(content_len_str), end(content_len_str));
-                if (header_content_len != end(header))
-                {
-                    auto r_after_content_len = search(header_content_len, end(header), begin(new_line), end(new_line));
-                    string n{ header_content_len + 16, r_after_content_len };
-                    buffer.reserve(stoul(n));
-                }
-
-                auto body_start = search(begin(header), end(header), begin(header_separator), end(header_separator));
-                buffer.insert(end(buffer), body_start + 4, end(header));
+                return response.redirect;
             }
-            else
+            catch (const runtime_error&)
             {
-                buffer.insert(end(buffer), begin(b), begin(b) + recvd);
+                if (!connection.reused() || received > 0)
+                    throw;
             }
         }
     }
-}
 
-namespace
-{
-    void dlFromStreamService(const string& domain, const string& port, const string& endpoint, vector<unsigned char>& buffer, Tcp::StreamService& service)
+    /// Pobiera zasób, podążając za przekierowaniami.
+    void dlToSink(const string& url, const Sink& sink)
     {
-        auto sock = service.getFactory()->resolve(domain, port)->connect(service);
-        const auto req = prepareRequest(domain, endpoint);
-        makeRequest(sock, req);
+        auto redirect = dlFromPool(Utility::HttpTarget(url), sink);
+        if (!redirect.empty())
+        {
+            dlToSink(redirect, sink);
+        }
+    }
 
-        Utility::fetchData(buffer, [&sock](Tcp::Buffer& b) -> int
+    void fetchToSink(const Sink& sink, const Reader& read)
+    {
+        auto response = readResponse(sink, read);
+        if (!response.redirect.empty())
         {
-            return sock.readSome(b);
-        });
+            dlToSink(response.redirect, sink);
+        }
     }
 }
 
@@ -195,40 +186,51 @@ namespace
 
 namespace Utility 
 {
+    void fetchData(vector<unsigned char>& buffer, function<int(pair<char*, int>&)> func)
+    {
+        fetchToSink(bufferSink(buffer), func);
+    }
+
+
+    void fetchData(const Consumer& consumer, function<int(pair<char*, int>&)> func)
+    {
+        fetchToSink(consumerSink(consumer), func);
+    }
+
+
     void dlFileToBuffer(const string& url, vector<unsigned char>& buffer)
     {
-        auto result = getDomainPortEndpoint(url);
-        string domain = get<0>(result);
-        string port = get<1>(result);
-        string endpoint = get<2>(result);
+        dlToSink(url, bufferSink(buffer));
+    }
 
-        bool is_https = url.find(https) != std::string::npos || port == ssl_port;
 
-        if (is_https)
-        {
-            thread_local Tcp::SslStreamService service;
-            dlFromStreamService(domain, ssl_port, endpoint, buffer, service);
-        }
-        else
-        {
-            thread_local Tcp::StreamService service;
-            dlFromStreamService(domain, port, endpoint, buffer, service);
-        }
+    void dlFileToConsumer(const string& url, const Consumer& consumer)
+    {
+        dlToSink(url, consumerSink(consumer));
     }
 
 
     void dlFileToFile(const string& url, const string& path)
     {
-        vector<unsigned char> buffer;
-        dlFileToBuffer(url, buffer);
-
         ofstream file(path, ios::binary);
 
         if (!file.good())
             throw runtime_error("Couldn't open file to save. Path: " + path);
 
-        file.write(reinterpret_cast<char*>(&buffer[0]), buffer.size());
-
-        file.flush();
+        try
+        {
+            dlFileToConsumer(url, [&file](const unsigned char* data, size_t size)
+            {
+                if (!file.write(reinterpret_cast<const char*>(data), size))
+                    throw runtime_error("Couldn't write file: " + string{ strerror(errno) });
+            });
+            file.flush();
+        }
+        catch (...)
+        {
+            file.close();
+            remove(path.c_str());
+            throw;
+        }
     }
 }
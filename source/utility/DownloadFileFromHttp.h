@@ -4,9 +4,19 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <future>
+#include <exception>
+#include <cstddef>
 
 namespace Utility 
 {
+    /// Odbiorca kolejnych fragmentów pobieranego ciała odpowiedzi.
+    /*
+     * Fragmenty wskazują na bufor odbiorczy i są ważne tylko w trakcie wywołania.
+     * Wyjątek zgłoszony przez odbiorcę przerywa pobieranie.
+     */
+    typedef std::function<void(const unsigned char* /* data */, std::size_t /* size */)> Consumer;
+
     /// Funkcja pobiera dane z danego adresu http i wrzuca do podanego bufora.
     /*
      * @param url adres http w postaci std::string
@@ -18,6 +28,36 @@ namespace Utility
     void dlFileToBuffer(const std::string& url, std::vector<unsigned char>& buffer);
 
 
+    /// Funkcja pobiera dane z danego adresu http i przekazuje je fragmentami do odbiorcy.
+    /*
+     * Ciało nie jest kopiowane do pośredniego bufora, więc duże pliki nie muszą mieścić się w pamięci.
+     * @param url adres http w postaci std::string
+     * @param consumer odbiorca kolejnych fragmentów ciała
+     * @throw std::runtime_error jak w dlFileToBuffer, po przekazaniu części danych pobieranie jest przerywane
+    */
+    void dlFileToConsumer(const std::string& url, const Consumer& consumer);
+
+
+    /// Funkcja zleca pobranie danych z danego adresu http i natychmiast wraca.
+    /*
+     * Pobieranie odbywa się na nieblokujących gniazdach reaktora pobrań, z ograniczeniem liczby
+     * równoczesnych pobrań z jednego hosta i łącznie - zob. Utility::Downloader.
+     * @param url adres http w postaci std::string
+     * @param callback funkcja otrzymująca pobrane dane lub wyjątek jak z dlFileToBuffer,
+     * wywoływana na wątku reaktora - nie powinna blokować
+    */
+    void dlFileAsync(const std::string& url, std::function<void(std::vector<unsigned char>& /* data */, std::exception_ptr /* error */)> callback);
+
+
+    /// Funkcja zleca pobranie danych z danego adresu http i zwraca przyszły wynik.
+    /*
+     * Jak dlFileAsync(url, callback) - wątek oczekujący na wynik nie uczestniczy w przesyle.
+     * @param url adres http w postaci std::string
+     * @return przyszłe dane lub wyjątek jak z dlFileToBuffer
+    */
+    std::future<std::vector<unsigned char>> dlFileAsync(const std::string& url);
+
+
     /// Funkcja zapisuje plik z podanego adresu http do pliku o podanej ścieżce
     /*
      * @param url adres http w postaci std::string
@@ -35,6 +75,14 @@ namespace Utility
      * Przeznaczenie raczej testowe - napisanie lambdy, która podaje dane celem sprawdzenia wyodrębnienia ciała
      */
     void fetchData(std::vector<unsigned char>& buffer, std::function<int(std::pair<char* /* data */, int /* size */>&)> func);
+
+
+    /// Funkcja pobiera dane z podanej lambdy i przekazuje ciało fragmentami do odbiorcy
+    /*
+     * @param consumer odbiorca kolejnych fragmentów ciała
+     * @param func lambda jak w fetchData(buffer, func)
+     */
+    void fetchData(const Consumer& consumer, std::function<int(std::pair<char* /* data */, int /* size */>&)> func);
 }
 
 #endif //PATR_DLHTTPFILE_UTILITY_H
@@ -0,0 +1,407 @@
+#include "Downloader.h"
+#include "DownloadFileFromHttp.h"
+#include "../httpserver/Socket.h"
+
+#include <future>
+#include <stdexcept>
+#include <algorithm>
+
+namespace
+{
+    /// Rozmiar bufora odczytu odpowiedzi.
+    constexpr std::size_t BufferSize = 64 * 1024;
+    /// Największa liczba przekierowań jednego pobrania.
+    constexpr std::size_t MaxRedirects = 10;
+
+    /// Zwraca schemat, nazwę i port adresu, np. "http://example.com:8080".
+    std::string HostOf(const std::string& url)
+    {
+        auto scheme = url.find("://");
+        auto start = scheme == std::string::npos ? 0 : scheme + 3;
+        return url.substr(0, url.find('/', start));
+    }
+}
+
+Utility::Downloader::Limits::Limits(std::size_t perHost, std::size_t total) :
+    perHost(std::max<std::size_t>(perHost, 1)), total(std::max<std::size_t>(total, 1))
+{
+}
+
+Utility::Downloader::Transfer::Transfer(Job job) : job(std::move(job)), target(this->job.url), redirects(0), sent(0), received(0)
+{
+}
+
+Utility::Downloader::Downloader(Limits limits) :
+    limits(limits),
+    reactor(new Tcp::StreamService()),
+    buffer(BufferSize),
+    running(0),
+    closing(false),
+    counters()
+{
+    // Resolver współdzielony przez pobrania tworzony jest wcześniej, więc zostanie zniszczony później.
+    Tcp::Resolver::Shared();
+
+    reactorThread = std::thread([this] { reactor->run(); });
+}
+
+Utility::Downloader::~Downloader()
+{
+    reactor->post([this]
+    {
+        closing = true;
+        auto abandoned = std::make_exception_ptr(std::runtime_error("Downloader stopped"));
+        std::map<std::string, std::deque<Job>> queued;
+        queued.swap(waiting);
+        rotation.clear();
+        std::vector<unsigned char> none;
+        for (auto& host : queued)
+            for (auto& job : host.second)
+                finish(job, none, abandoned);
+        if (running == 0)
+            complete(nullptr, nullptr);
+    });
+    reactorThread.join();
+}
+
+void Utility::Downloader::download(const std::string& url, Callback callback)
+{
+    auto job = std::make_shared<Job>(Job{ url, HostOf(url), std::move(callback) });
+    reactor->post([this, job] { admit(std::move(*job)); });
+}
+
+void Utility::Downloader::admit(Job job)
+{
+    if (closing)
+    {
+        std::vector<unsigned char> none;
+        finish(job, none, std::make_exception_ptr(std::runtime_error("Downloader stopped")));
+        return;
+    }
+
+    if (running < limits.total && active[job.host] < limits.perHost)
+    {
+        start(std::move(job));
+        return;
+    }
+
+    auto& queue = waiting[job.host];
+    if (queue.empty())
+        rotation.push_back(job.host);
+    queue.push_back(std::move(job));
+    std::lock_guard<std::mutex> lock(mutex);
+    ++counters.queued;
+}
+
+void Utility::Downloader::start(Job job)
+{
+    ++running;
+    ++active[job.host];
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++counters.started;
+        counters.peak = std::max(counters.peak, running);
+    }
+
+    std::unique_ptr<Transfer> transfer(new Transfer(std::move(job)));
+    auto raw = transfer.get();
+    transfers[raw] = std::move(transfer);
+    request(raw);
+}
+
+void Utility::Downloader::request(Transfer* transfer)
+{
+    transfer->request = transfer->target.request();
+    transfer->sent = 0;
+    transfer->received = 0;
+    transfer->parser.reset(new ResponseParser(
+        [transfer](const unsigned char* data, std::size_t size) { transfer->data.insert(transfer->data.end(), data, data + size); },
+        [transfer](std::size_t size) { transfer->data.reserve(transfer->data.size() + size); }));
+    try
+    {
+        transfer->link = acquire(transfer->target);
+    }
+    catch (...)
+    {
+        complete(transfer, std::current_exception());
+        return;
+    }
+
+    transfer->link->reader = [this, transfer](int error, std::size_t bytes) { receive(transfer, error, bytes); };
+    read(*transfer->link);
+    send(transfer);
+}
+
+void Utility::Downloader::send(Transfer* transfer)
+{
+    auto link = transfer->link.get();
+    auto& request = transfer->request;
+    link->socket->asyncWriteSome(Tcp::ConstBuffer(request.data() + transfer->sent, static_cast<int>(request.size() - transfer->sent)),
+        [this, transfer, link](int error, int written)
+    {
+        if (transfer->link.get() != link)
+            return; // połączenie zamknięte po zakończeniu odpowiedzi lub błędzie.
+        if (error || written <= 0)
+        {
+            auto reason = !link->reused && transfer->sent == 0 ? "Couldn't connect to " : "Request fail: ";
+            fail(transfer, std::make_exception_ptr(std::runtime_error(reason + transfer->target.key())));
+            return;
+        }
+        transfer->sent += written;
+        if (transfer->sent < transfer->request.size())
+            send(transfer);
+    });
+}
+
+void Utility::Downloader::receive(Transfer* transfer, int error, std::size_t bytes)
+{
+    auto& parser = *transfer->parser;
+    try
+    {
+        if (error)
+        {
+            if (transfer->link->reused && transfer->received == 0)
+            {
+                // Serwer zamknął połączenie trwałe przed otrzymaniem zapytania.
+                fail(transfer, nullptr);
+                return;
+            }
+            parser.close();
+        }
+        else
+        {
+            transfer->received += bytes;
+            parser.consume(buffer.data(), bytes);
+        }
+    }
+    catch (...)
+    {
+        fail(transfer, std::current_exception());
+        return;
+    }
+
+    if (!parser.complete())
+    {
+        read(*transfer->link);
+        return;
+    }
+
+    // Zapytanie wysłane częściowo nie pozwala na ponowne użycie połączenia.
+    if (parser.reusable() && transfer->sent == transfer->request.size())
+        release(std::move(transfer->link));
+    else
+        discard(std::move(transfer->link));
+
+    if (parser.redirect().empty())
+    {
+        complete(transfer, nullptr);
+        return;
+    }
+    if (++transfer->redirects > MaxRedirects)
+    {
+        complete(transfer, std::make_exception_ptr(std::runtime_error("Too many redirects")));
+        return;
+    }
+    transfer->target = HttpTarget(parser.redirect());
+    request(transfer);
+}
+
+void Utility::Downloader::fail(Transfer* transfer, std::exception_ptr error)
+{
+    auto retry = !error || (transfer->link->reused && transfer->received == 0);
+    discard(std::move(transfer->link));
+    if (retry)
+        request(transfer);
+    else
+        complete(transfer, error);
+}
+
+void Utility::Downloader::complete(Transfer* transfer, std::exception_ptr error)
+{
+    if (transfer)
+    {
+        auto owned = std::move(transfers[transfer]);
+        transfers.erase(transfer);
+        if (owned->link)
+            discard(std::move(owned->link));
+
+        --running;
+        if (--active[owned->job.host] == 0)
+            active.erase(owned->job.host);
+
+        if (error)
+            owned->data.clear();
+        finish(owned->job, owned->data, error);
+    }
+
+    // Zwolnione miejsca przydzielane są kolejnym hostom z oczekującymi zleceniami.
+    for (auto hosts = rotation.size(); hosts > 0 && running < limits.total; --hosts)
+    {
+        auto host = std::move(rotation.front());
+        rotation.pop_front();
+        auto& queue = waiting[host];
+        if (active[host] < limits.perHost)
+        {
+            auto next = std::move(queue.front());
+            queue.pop_front();
+            start(std::move(next));
+        }
+
+        if (queue.empty())
+            waiting.erase(host);
+        else
+            rotation.push_back(std::move(host));
+    }
+
+    if (closing && running == 0)
+    {
+        // Połączenia trwałe zamykane są przed zakończeniem run(), które zamknęłoby je wraz z handlerami.
+        std::map<std::string, std::vector<std::unique_ptr<Link>>> links;
+        links.swap(idle);
+        for (auto& host : links)
+            for (auto& link : host.second)
+                discard(std::move(link));
+        reactor->stop();
+    }
+}
+
+void Utility::Downloader::finish(Job& job, std::vector<unsigned char>& data, std::exception_ptr error)
+{
+    if (error)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++counters.failed;
+    }
+    try
+    {
+        job.callback(data, error);
+    }
+    catch (...)
+    {
+        // wyjątek nie może przerwać pracy reaktora obsługującego pozostałe pobrania.
+    }
+}
+
+std::unique_ptr<Utility::Downloader::Link> Utility::Downloader::acquire(const HttpTarget& target)
+{
+    auto key = target.key();
+    auto host = idle.find(key);
+    while (host != idle.end() && !host->second.empty())
+    {
+        auto link = std::move(host->second.back());
+        host->second.pop_back();
+        if (host->second.empty())
+            idle.erase(host);
+        if (link->socket->idle())
+        {
+            link->reused = true;
+            return link;
+        }
+        discard(std::move(link));
+        host = idle.find(key);
+    }
+
+    std::unique_ptr<Tcp::Socket> socket;
+    if (target.secure)
+    {
+        if (!tls)
+            tls.reset(new Tcp::SslContext());
+        socket.reset(new Tcp::Socket(Tcp::SslEndpointImplementation(target.domain, target.port, *tls).connectNonBlocking(*reactor)));
+    }
+    else
+    {
+        socket.reset(new Tcp::Socket(Tcp::EndpointImplementation(target.domain, target.port).connectNonBlocking(*reactor)));
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        ++counters.connects;
+    }
+    return std::unique_ptr<Link>(new Link{ std::move(key), std::move(socket), nullptr, false, false });
+}
+
+void Utility::Downloader::release(std::unique_ptr<Link> link)
+{
+    auto& host = idle[link->key];
+    if (host.size() >= limits.perHost)
+    {
+        discard(std::move(link));
+        return;
+    }
+
+    // Dane lub zamknięcie połączenia przez serwer, a także timeout gniazda, wykluczają ponowne użycie.
+    auto raw = link.get();
+    link->reader = [this, raw](int, std::size_t)
+    {
+        auto host = idle.find(raw->key);
+        if (host == idle.end())
+            return;
+        auto found = std::find_if(host->second.begin(), host->second.end(), [raw](const std::unique_ptr<Link>& link) { return link.get() == raw; });
+        if (found == host->second.end())
+            return;
+        auto evicted = std::move(*found);
+        host->second.erase(found);
+        if (host->second.empty())
+            idle.erase(host);
+        discard(std::move(evicted));
+    };
+    read(*link);
+    host.push_back(std::move(link));
+}
+
+void Utility::Downloader::discard(std::unique_ptr<Link> link)
+{
+    link->reader = [](int, std::size_t) {};
+    link->socket->shutdown();
+}
+
+void Utility::Downloader::read(Link& link)
+{
+    if (link.reading)
+        return;
+    link.reading = true;
+    auto raw = &link;
+    link.socket->asyncReadSome([this] { return Tcp::Buffer(buffer.data(), static_cast<int>(buffer.size())); },
+        [raw](int error, std::size_t bytes)
+    {
+        raw->reading = false;
+        auto reader = raw->reader;
+        reader(error, bytes);
+    });
+}
+
+Utility::Downloader::Statistics Utility::Downloader::statistics() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return counters;
+}
+
+Utility::Downloader& Utility::Downloader::Shared()
+{
+    static Downloader downloader([]
+    {
+        auto perHost = std::max<std::size_t>(std::thread::hardware_concurrency(), 4);
+        return Limits(perHost, std::max<std::size_t>(perHost, 16));
+    }());
+    return downloader;
+}
+
+namespace Utility
+{
+    void dlFileAsync(const std::string& url, std::function<void(std::vector<unsigned char>&, std::exception_ptr)> callback)
+    {
+        Downloader::Shared().download(url, std::move(callback));
+    }
+
+    std::future<std::vector<unsigned char>> dlFileAsync(const std::string& url)
+    {
+        auto promise = std::make_shared<std::promise<std::vector<unsigned char>>>();
+        dlFileAsync(url, [promise](std::vector<unsigned char>& data, std::exception_ptr error)
+        {
+            if (error)
+                promise->set_exception(error);
+            else
+                promise->set_value(std::move(data));
+        });
+        return promise->get_future();
+    }
+}
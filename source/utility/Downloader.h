@@ -0,0 +1,167 @@
+#ifndef PATR_DOWNLOADER_H
+#define PATR_DOWNLOADER_H
+
+#include <map>
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cstddef>
+#include <exception>
+#include <functional>
+
+#include "ResponseParser.h"
+
+namespace Tcp {
+class StreamService;
+class SslContext;
+class Socket;
+}
+
+namespace Utility {
+
+/// Asynchroniczne pobieranie plików przez HTTP z ograniczeniem liczby równoczesnych pobrań.
+/**
+ * Pobrania prowadzi dedykowany reaktor (Tcp::StreamService) działający na własnym wątku - połączenia
+ * (wraz z handshake TLS), zapytania i odczyt odpowiedzi odbywają się na nieblokujących gniazdach, a stan
+ * pobrań, kolejki hostów i połączenia trwałe dostępne są wyłącznie z tego wątku, więc nie wymagają blokad.
+ * Blokujące pozostaje jedynie rozwiązywanie nazw, wykonywane przez Tcp::Resolver::Shared z pamięcią podręczną.
+ * Zlecenia przekraczające ograniczenia oczekują w kolejce swojego hosta, a zwolnione miejsca przydzielane
+ * są hostom po kolei. Host określa schemat, nazwa i port adresu.
+ */
+class Downloader
+{
+public:
+    /// Funkcja zwrotna otrzymująca pobrane dane lub wyjątek jak z dlFileToBuffer.
+    /**
+     * Wywoływana na wątku reaktora - nie powinna blokować, np. dekodowanie obrazka należy
+     * przekazać innemu wątkowi. Wyjątki zgłoszone przez funkcję są pomijane.
+     */
+    typedef std::function<void(std::vector<unsigned char>& data, std::exception_ptr error)> Callback;
+
+    /// Ograniczenia liczby równoczesnych pobrań.
+    struct Limits
+    {
+        Limits(std::size_t perHost = 4, std::size_t total = 16);
+
+        std::size_t perHost; //< Największa liczba równoczesnych pobrań z jednego hosta.
+        std::size_t total; //< Największa łączna liczba równoczesnych pobrań.
+    };
+
+    /// Liczniki pobrań.
+    struct Statistics
+    {
+        std::size_t started; //< Rozpoczęte pobrania.
+        std::size_t failed; //< Pobrania zakończone błędem, także odrzucone przy zamykaniu.
+        std::size_t queued; //< Zlecenia, które oczekiwały na zwolnienie miejsca.
+        std::size_t peak; //< Największa liczba równoczesnych pobrań.
+        std::size_t connects; //< Nawiązane połączenia, pozostałe zapytania wysłano połączeniami trwałymi.
+    };
+
+    explicit Downloader(Limits limits = Limits());
+    /// Czeka na zakończenie trwających pobrań, zlecenia oczekujące w kolejce kończy błędem.
+    /**
+     * Zlecenia nie mogą być przekazywane w trakcie niszczenia obiektu.
+     */
+    ~Downloader();
+
+    Downloader(const Downloader&) = delete;
+    Downloader& operator=(const Downloader&) = delete;
+
+    /// Zleca pobranie zasobu i natychmiast wraca, może zostać wywołana z dowolnego wątku.
+    void download(const std::string& url, Callback callback);
+    /// Zwraca liczniki pobrań.
+    Statistics statistics() const;
+
+    /// Zwraca obiekt wykorzystywany przez dlFileAsync.
+    /**
+     * Wątki obsługi zapytań serwera czekają na pobrania tego obiektu, dlatego domyślne ograniczenie
+     * pobrań z hosta nie jest mniejsze od liczby procesorów (domyślnej liczby wątków ThreadedHandlerStrategy).
+     */
+    static Downloader& Shared();
+
+private:
+    /// Zlecenie pobrania.
+    struct Job
+    {
+        std::string url;
+        std::string host;
+        Callback callback;
+    };
+
+    /// Połączenie z hostem, trwające lub bezczynne.
+    struct Link
+    {
+        std::string key; //< Host połączenia, jak HttpTarget::key.
+        std::unique_ptr<Tcp::Socket> socket;
+        std::function<void(int, std::size_t)> reader; //< Odbiorca wyniku oczekującego odczytu.
+        bool reading; //< Odczyt oczekuje w kolejce gniazda.
+        bool reused; //< Połączenie zostało wcześniej wykorzystane - serwer mógł je już zamknąć.
+    };
+
+    /// Trwające pobranie.
+    struct Transfer
+    {
+        Transfer(Job job);
+
+        Job job;
+        HttpTarget target;
+        std::size_t redirects;
+        std::unique_ptr<Link> link;
+        std::string request;
+        std::size_t sent;
+        std::size_t received; //< Odebrane bajty odpowiedzi na bieżące zapytanie.
+        std::vector<unsigned char> data;
+        std::unique_ptr<ResponseParser> parser;
+    };
+
+    /// Rozpoczyna pobranie lub umieszcza je w kolejce hosta.
+    void admit(Job job);
+    /// Zajmuje miejsce pobrania i wysyła pierwsze zapytanie.
+    void start(Job job);
+    /// Wysyła zapytanie o bieżący adres pobrania połączeniem trwałym lub nowym.
+    void request(Transfer* transfer);
+    /// Zleca zapis pozostałej części zapytania.
+    void send(Transfer* transfer);
+    /// Przetwarza wynik odczytu odpowiedzi.
+    void receive(Transfer* transfer, int error, std::size_t bytes);
+    /// Zamyka połączenie po błędzie, ponawiając zapytanie, na które serwer nie zdążył odpowiedzieć.
+    void fail(Transfer* transfer, std::exception_ptr error);
+    /// Zwalnia miejsce pobrania, wywołuje funkcję zwrotną i rozpoczyna oczekujące.
+    void complete(Transfer* transfer, std::exception_ptr error);
+    /// Wywołuje funkcję zwrotną zlecenia.
+    void finish(Job& job, std::vector<unsigned char>& data, std::exception_ptr error);
+    /// Wydaje bezczynne połączenie z hostem lub rozpoczyna nowe.
+    std::unique_ptr<Link> acquire(const HttpTarget& target);
+    /// Przechowuje połączenie do kolejnego zapytania, zamykane jest przy dowolnym zdarzeniu odczytu lub bezczynności.
+    void release(std::unique_ptr<Link> link);
+    /// Zamyka połączenie, oczekujące handlery nie są przekazywane pobraniom.
+    void discard(std::unique_ptr<Link> link);
+    /// Zleca odczyt, jeżeli połączenie go nie oczekuje.
+    void read(Link& link);
+
+    Limits limits;
+    std::unique_ptr<Tcp::StreamService> reactor;
+    std::unique_ptr<Tcp::SslContext> tls; //< Kontekst klienta tworzony przy pierwszym adresie https.
+
+    // Stan reaktora, dostępny wyłącznie z jego wątku.
+    std::map<std::string, std::size_t> active; //< Trwające pobrania według hosta.
+    std::map<std::string, std::deque<Job>> waiting; //< Zlecenia oczekujące według hosta.
+    std::deque<std::string> rotation; //< Hosty z oczekującymi zleceniami, w kolejności przydziału.
+    std::map<Transfer*, std::unique_ptr<Transfer>> transfers;
+    std::map<std::string, std::vector<std::unique_ptr<Link>>> idle; //< Połączenia trwałe według hosta, niszczone przed reaktorem.
+    std::vector<char> buffer; //< Bufor odczytu wszystkich połączeń.
+    std::size_t running;
+    bool closing;
+
+    mutable std::mutex mutex;
+    Statistics counters; //< Chronione przez mutex.
+
+    std::thread reactorThread;
+};
+
+} // namespace Utility
+
+#endif // PATR_DOWNLOADER_H
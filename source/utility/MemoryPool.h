@@ -0,0 +1,131 @@
+#ifndef PATR_MEMORYPOOL_H
+#define PATR_MEMORYPOOL_H
+
+#include <mutex>
+#include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+
+namespace Utility {
+
+/// Pula bloków pamięci o stałym rozmiarze.
+/**
+ * Bloki przydzielane są z płyt (slab) zawierających blocksPerSlab bloków, a zwolnione
+ * trafiają na listę wolnych bloków i są ponownie wykorzystywane bez udziału alokatora systemowego.
+ * Pamięć płyt zwalniana jest dopiero wraz z pulą - jej pojemność odpowiada największemu
+ * jednoczesnemu wykorzystaniu. Klasa jest bezpieczna wielowątkowo.
+ */
+class MemoryPool
+{
+public:
+    /// Zajętość puli.
+    struct Statistics
+    {
+        std::size_t blockSize; //< Rozmiar bloku w bajtach.
+        std::size_t capacity; //< Liczba bloków we wszystkich płytach.
+        std::size_t used; //< Liczba przydzielonych bloków.
+        std::size_t peak; //< Największa liczba jednocześnie przydzielonych bloków.
+    };
+
+    /// Tworzy pustą pulę, płyty przydzielane są przy pierwszym użyciu.
+    MemoryPool(std::size_t blockSize, std::size_t blocksPerSlab = 64) :
+        blockSize(Align(std::max(blockSize, sizeof(Node)))),
+        blocksPerSlab(std::max<std::size_t>(blocksPerSlab, 1)),
+        freeList(nullptr),
+        capacity(0),
+        used(0),
+        peak(0)
+    {
+    }
+
+    MemoryPool(const MemoryPool&) = delete;
+    MemoryPool& operator=(const MemoryPool&) = delete;
+
+    /// Przydziela blok o rozmiarze nie mniejszym niż size.
+    /**
+     * Żądania większe od rozmiaru bloku obsługuje operator new.
+     */
+    void* allocate(std::size_t size)
+    {
+        if (size > blockSize)
+            return ::operator new(size);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!freeList)
+            grow();
+
+        auto block = freeList;
+        freeList = block->next;
+        peak = std::max(peak, ++used);
+        return block;
+    }
+
+    /// Zwraca blok przydzielony przez allocate z tym samym rozmiarem.
+    void deallocate(void* block, std::size_t size)
+    {
+        if (!block)
+            return;
+        if (size > blockSize)
+        {
+            ::operator delete(block);
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto node = static_cast<Node*>(block);
+        node->next = freeList;
+        freeList = node;
+        --used;
+    }
+
+    /// Zwraca obecną zajętość puli.
+    Statistics statistics() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return Statistics{ blockSize, capacity, used, peak };
+    }
+
+private:
+    /// Wolny blok przechowuje wskaźnik na kolejny wolny blok.
+    struct Node
+    {
+        Node* next;
+    };
+
+    /// Zaokrągla rozmiar do wyrównania wymaganego przez dowolny typ.
+    static std::size_t Align(std::size_t size)
+    {
+        const auto alignment = alignof(std::max_align_t);
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    /// Przydziela nową płytę i dołącza jej bloki do listy wolnych.
+    void grow()
+    {
+        slabs.emplace_back(new char[blockSize * blocksPerSlab]); // pamięć z new char[] jest wyrównana dla max_align_t.
+        auto slab = slabs.back().get();
+        for (std::size_t i = blocksPerSlab; i-- > 0;)
+        {
+            auto node = reinterpret_cast<Node*>(slab + i * blockSize);
+            node->next = freeList;
+            freeList = node;
+        }
+        capacity += blocksPerSlab;
+    }
+
+    const std::size_t blockSize;
+    const std::size_t blocksPerSlab;
+
+    mutable std::mutex mutex;
+    Node* freeList;
+    std::vector<std::unique_ptr<char[]>> slabs;
+    std::size_t capacity;
+    std::size_t used;
+    std::size_t peak;
+};
+
+} // namespace Utility
+
+#endif // PATR_MEMORYPOOL_H
@@ -0,0 +1,347 @@
+#include "ResponseParser.h"
+
+#include <tuple>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+
+using namespace std;
+
+namespace
+{
+    const string new_line = "\r\n";
+    constexpr auto default_port = "80";
+    constexpr auto ssl_port = "443";
+    constexpr auto https = "https://";
+    constexpr int http_error_code = 400;
+    constexpr int http_redirect_code = 300;
+
+
+    tuple<string, string, string> getDomainPortEndpoint(const string& url)
+    {
+        size_t domain_end;
+        size_t domain_start = url.find("http") == string::npos ? 0 : url.find_first_of("//") + 2;
+        size_t port_s = 0, port_e = 0;
+
+        auto endpoint_start = url.find("/", domain_start);
+        if (endpoint_start == string::npos)
+        {
+            return getDomainPortEndpoint(url + "/");
+        }
+
+        auto colon = url.find_first_of(":", domain_start);
+        if (colon != string::npos && colon < endpoint_start)
+        {
+            domain_end = colon;
+            port_s = colon + 1;
+            port_e = endpoint_start;
+        }
+        else
+        {
+            domain_end = endpoint_start;
+        }
+
+        return make_tuple<string, string, string>(
+            { url.begin() + domain_start,  url.begin() + domain_end },
+            port_s == port_e ? default_port : string{ url.begin() + port_s, url.begin() + port_e },
+            { url.begin() + endpoint_start, url.end() }
+        );
+    }
+
+
+    /// Nagłówek odpowiedzi odczytany w jednym przebiegu.
+    struct ResponseHeader
+    {
+        int code = 0;
+        string reason;
+        string location;
+        string length; //< Wartość Content-Length, pusta gdy brak.
+        bool chunked = false;
+        bool close = false; //< Serwer zamyka połączenie po odpowiedzi.
+    };
+
+    /// Odczytuje długość zapisaną w podanej podstawie, po której mogą wystąpić jedynie białe znaki lub rozszerzenia po ';'.
+    /**
+     * @throw runtime_error dla wartości niebędących liczbą lub przekraczających zakres size_t.
+     */
+    size_t parseSize(const string& value, int base, bool extensions)
+    {
+        auto start = value.c_str();
+        if (!isxdigit(static_cast<unsigned char>(*start)) || (base == 10 && !isdigit(static_cast<unsigned char>(*start))))
+            throw runtime_error("Couldn't parse length: " + value);
+
+        char* end;
+        errno = 0;
+        auto result = strtoull(start, &end, base);
+        if (errno == ERANGE || result > numeric_limits<size_t>::max())
+            throw runtime_error("Length out of range: " + value);
+        while (*end == ' ' || *end == '\t')
+            ++end;
+        if (*end != '\0' && !(extensions && *end == ';'))
+            throw runtime_error("Couldn't parse length: " + value);
+        return static_cast<size_t>(result);
+    }
+
+    bool equalsIgnoreCase(const char* data, size_t size, const char* name)
+    {
+        auto length = strlen(name);
+        return size == length && equal(data, data + size, name, [](char a, char b) { return tolower(a) == tolower(b); });
+    }
+
+    bool containsIgnoreCase(string value, const char* token)
+    {
+        transform(begin(value), end(value), begin(value), [](char c) { return static_cast<char>(tolower(c)); });
+        return value.find(token) != string::npos;
+    }
+
+    /// Odczytuje linię statusu i nagłówki potrzebne do ustalenia długości ciała.
+    /**
+     * @param size - długość nagłówka wraz z kończącym go pustym wierszem.
+     */
+    ResponseHeader parseHeader(const char* data, size_t size)
+    {
+        ResponseHeader header;
+        const auto end_of_header = data + size - 2;
+        auto line_end = search(data, end_of_header, begin(new_line), end(new_line));
+
+        // HTTP/x.y kod opis
+        if (line_end - data < 5 || !equal(data, data + 5, "HTTP/"))
+            throw runtime_error("Couldn't parse header");
+        auto position = find_if(data + 5, line_end, [](char c) { return c != '.' && !isdigit(static_cast<unsigned char>(c)); });
+        auto code = find_if(position, line_end, [](char c) { return c != ' ' && c != '\t'; });
+        auto code_end = find_if(code, line_end, [](char c) { return !isdigit(static_cast<unsigned char>(c)); });
+        if (position == data + 5 || code == position || code_end == code || code_end - code > 3)
+            throw runtime_error("Couldn't parse header");
+        header.code = stoi(string(code, code_end));
+        header.reason.assign(find_if(code_end, line_end, [](char c) { return c != ' ' && c != '\t'; }), line_end);
+        header.close = equal(data + 5, data + 8, "1.0");
+
+        while (line_end + 2 < end_of_header)
+        {
+            auto line = line_end + 2;
+            line_end = search(line, end_of_header, begin(new_line), end(new_line));
+            auto colon = find(line, line_end, ':');
+            if (colon == line_end)
+                continue;
+
+            auto value_start = find_if(colon + 1, line_end, [](char c) { return c != ' ' && c != '\t'; });
+            string value(value_start, line_end);
+            auto name_size = static_cast<size_t>(colon - line);
+            if (equalsIgnoreCase(line, name_size, "Location"))
+                header.location = move(value);
+            else if (equalsIgnoreCase(line, name_size, "Content-Length"))
+                header.length = move(value);
+            else if (equalsIgnoreCase(line, name_size, "Transfer-Encoding"))
+                header.chunked = containsIgnoreCase(move(value), "chunked");
+            else if (equalsIgnoreCase(line, name_size, "Connection"))
+                header.close = header.close || containsIgnoreCase(move(value), "close");
+        }
+        return header;
+    }
+}
+
+
+
+Utility::HttpTarget::HttpTarget(const string& url)
+{
+    tie(domain, port, endpoint) = getDomainPortEndpoint(url);
+    secure = url.find(https) != string::npos || port == ssl_port;
+
+    if (secure && port == default_port)
+    {
+        port = ssl_port;
+    }
+}
+
+string Utility::HttpTarget::request() const
+{
+    return "GET " + endpoint + " HTTP/1.1\r\n"
+        + "Host: " + domain + "\r\n"
+        + "User-Agent: curl/7.43.0\r\n"
+        + "Accept: */*\r\n\r\n";
+}
+
+string Utility::HttpTarget::key() const
+{
+    return (secure ? "https://" : "http://") + domain + ':' + port;
+}
+
+
+
+constexpr size_t Utility::ResponseParser::MaxHeaderSize;
+
+Utility::ResponseParser::ResponseParser(Consumer consumer, Expectation expect) :
+    consumer(move(consumer)),
+    expect(move(expect)),
+    state(State::Header),
+    remaining(0),
+    skip(false),
+    bodyless(false),
+    keepAlive(true)
+{
+}
+
+bool Utility::ResponseParser::consume(const char* data, size_t size)
+{
+    const auto end = data + size;
+    while (data != end)
+    {
+        switch (state)
+        {
+        case State::Header:
+            if (line(data, end, "Response header too large") && text.size() >= 4 && text.compare(text.size() - 4, 4, "\r\n\r\n") == 0)
+                header();
+            break;
+
+        case State::Length:
+        case State::ChunkData:
+            deliver(data, end);
+            if (remaining == 0)
+                state = state == State::Length ? State::Done : State::ChunkEnd;
+            break;
+
+        case State::ChunkSize:
+            if (line(data, end, "Malformed chunked body"))
+            {
+                remaining = parseSize(text.substr(0, text.size() - 2), 16, true); // rozszerzenia po ';' są pomijane.
+                state = remaining == 0 ? State::Trailer : State::ChunkData;
+                text.clear();
+            }
+            break;
+
+        case State::ChunkEnd:
+        case State::Trailer:
+            if (line(data, end, "Malformed chunked body"))
+            {
+                auto empty = text.size() == 2;
+                text.clear();
+                if (state == State::ChunkEnd && !empty)
+                    throw runtime_error("Malformed chunked body");
+                if (state == State::ChunkEnd)
+                    state = State::ChunkSize;
+                else if (empty) // nagłówki końcowe są pomijane.
+                    state = State::Done;
+            }
+            break;
+
+        case State::Close:
+            consumer(reinterpret_cast<const unsigned char*>(data), end - data);
+            data = end;
+            break;
+
+        case State::Done:
+            if (!bodyless)
+                throw runtime_error("Unexpected data after response body");
+            keepAlive = false;
+            data = end;
+            break;
+        }
+    }
+    return state == State::Done;
+}
+
+void Utility::ResponseParser::close()
+{
+    switch (state)
+    {
+    case State::Header:
+        throw runtime_error(text.empty() ? "Connection closed before response" : "Connection closed inside response header");
+    case State::Length:
+        throw runtime_error("Connection closed before end of body");
+    case State::Close:
+        state = State::Done;
+        keepAlive = false;
+        break;
+    case State::Done:
+        keepAlive = false;
+        break;
+    default:
+        throw runtime_error("Connection closed inside chunked body");
+    }
+}
+
+bool Utility::ResponseParser::complete() const
+{
+    return state == State::Done;
+}
+
+const string& Utility::ResponseParser::redirect() const
+{
+    return location;
+}
+
+bool Utility::ResponseParser::reusable() const
+{
+    return keepAlive;
+}
+
+bool Utility::ResponseParser::line(const char*& data, const char* end, const char* error)
+{
+    auto found = static_cast<const char*>(memchr(data, '\n', end - data));
+    auto last = found ? found + 1 : end;
+    if (text.size() + (last - data) > MaxHeaderSize)
+        throw runtime_error(error);
+    text.append(data, last);
+    data = last;
+    return found && text.size() >= 2 && text[text.size() - 2] == '\r';
+}
+
+void Utility::ResponseParser::header()
+{
+    auto header = parseHeader(text.data(), text.size());
+    text.clear();
+    if (header.code >= http_error_code)
+    {
+        throw runtime_error(header.reason);
+    }
+
+    keepAlive = !header.close;
+    if (header.code > http_redirect_code)
+        location = move(header.location);
+    skip = !location.empty();
+
+    if (header.code == 204 || header.code == 304 || header.code / 100 == 1)
+    {
+        state = State::Done;
+        bodyless = true;
+    }
+    else if (header.chunked)
+    {
+        state = State::ChunkSize;
+    }
+    else if (!header.length.empty())
+    {
+        remaining = parseSize(header.length, 10, false);
+        if (!skip)
+            expect(remaining);
+        state = remaining == 0 ? State::Done : State::Length;
+    }
+    else if (location.empty())
+    {
+        // Ciało bez długości kończy się wraz z połączeniem.
+        state = State::Close;
+        keepAlive = false;
+    }
+    else
+    {
+        // Ciało przekierowania bez długości nie jest odczytywane - połączenie nie zostanie ponownie użyte.
+        state = State::Done;
+        bodyless = true;
+        keepAlive = false;
+    }
+}
+
+void Utility::ResponseParser::deliver(const char*& data, const char* end)
+{
+    auto count = min(remaining, static_cast<size_t>(end - data));
+    if (!skip)
+        consumer(reinterpret_cast<const unsigned char*>(data), count);
+    data += count;
+    remaining -= count;
+}
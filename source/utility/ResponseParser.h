@@ -0,0 +1,102 @@
+#ifndef PATR_RESPONSEPARSER_H
+#define PATR_RESPONSEPARSER_H
+
+#include "DownloadFileFromHttp.h"
+
+#include <string>
+#include <cstddef>
+#include <functional>
+
+namespace Utility {
+
+/// Adres zasobu HTTP rozłożony na części potrzebne do połączenia.
+struct HttpTarget
+{
+    /// Rozkłada adres, np. "https://example.com:8443/image.png".
+    /**
+     * Brak portu oznacza port domyślny schematu, a port 443 - połączenie TLS także bez schematu https.
+     */
+    explicit HttpTarget(const std::string& url);
+
+    /// Zwraca zapytanie GET o zasób.
+    std::string request() const;
+    /// Zwraca schemat, nazwę i port hosta, np. "https://example.com:443".
+    std::string key() const;
+
+    std::string domain;
+    std::string port;
+    std::string endpoint; //< Ścieżka zasobu wraz z argumentami.
+    bool secure; //< Połączenie TLS.
+};
+
+/// Przyrostowy parser odpowiedzi HTTP/1.1 klienta.
+/**
+ * Przyjmuje kolejne odebrane dane w dowolnym podziale, więc nie wymaga blokującego odczytu.
+ * Nagłówek odczytywany jest raz, po odebraniu pustego wiersza. Ciało ograniczone przez Content-Length,
+ * kodowanie chunked lub zamknięcie połączenia przekazywane jest odbiorcy fragmentami wprost z przyjętych
+ * danych. Ciało przekierowania jest pomijane.
+ */
+class ResponseParser
+{
+public:
+    /// Zapowiedź długości ciała, np. do rezerwacji bufora.
+    typedef std::function<void(std::size_t)> Expectation;
+
+    /// Największa długość nagłówka odpowiedzi oraz wierszy kodowania chunked.
+    static constexpr std::size_t MaxHeaderSize = 64 * 1024;
+
+    explicit ResponseParser(Consumer consumer, Expectation expect = [](std::size_t) {});
+
+    /// Przetwarza kolejne odebrane dane.
+    /**
+     * @return true, jeżeli odpowiedź została odczytana w całości.
+     * @throw std::runtime_error przy błędach http (4xx i 5xx), niepoprawnej odpowiedzi oraz danych za jej końcem.
+     */
+    bool consume(const char* data, std::size_t size);
+    /// Oznacza zamknięcie połączenia przez serwer, kończąc ciało ograniczone zamknięciem.
+    /**
+     * @throw std::runtime_error, jeżeli połączenie zamknięto przed końcem odpowiedzi.
+     */
+    void close();
+
+    /// Zwraca, czy odpowiedź została odczytana w całości.
+    bool complete() const;
+    /// Zwraca adres przekierowania lub pusty ciąg znaków.
+    const std::string& redirect() const;
+    /// Zwraca, czy połączenie można wykorzystać do kolejnego zapytania.
+    bool reusable() const;
+
+private:
+    enum class State
+    {
+        Header,
+        Length, //< Ciało o znanej długości.
+        ChunkSize,
+        ChunkData,
+        ChunkEnd, //< Koniec wiersza za danymi części.
+        Trailer, //< Nagłówki końcowe kodowania chunked.
+        Close, //< Ciało do zamknięcia połączenia.
+        Done
+    };
+
+    /// Dopisuje dane do bieżącego wiersza, zwraca true po odebraniu jego końca.
+    bool line(const char*& data, const char* end, const char* error);
+    /// Przetwarza odczytany nagłówek i wybiera sposób odczytu ciała.
+    void header();
+    /// Przekazuje odbiorcy część ciała, nie więcej niż remaining.
+    void deliver(const char*& data, const char* end);
+
+    Consumer consumer;
+    Expectation expect;
+    State state;
+    std::string text; //< Nagłówek lub niepełny wiersz kodowania chunked.
+    std::size_t remaining; //< Pozostała długość ciała lub części.
+    std::string location;
+    bool skip; //< Ciało przekierowania nie jest przekazywane odbiorcy.
+    bool bodyless; //< Odpowiedź bez ciała - nadmiarowe dane wykluczają jedynie ponowne użycie połączenia.
+    bool keepAlive;
+};
+
+} // namespace Utility
+
+#endif // PATR_RESPONSEPARSER_H
@@ -0,0 +1,482 @@
+#define BOOST_TEST_DYN_LINK
+#include <boost/test/unit_test.hpp>
+
+#include "../DownloadFileFromHttp.h"
+#include "../ConnectionPool.h"
+#include "../Downloader.h"
+#include "../../httpserver/Server.h"
+#include "../../httpserver/ServerUtilities.h"
+#include "../../httpserver/Socket.h"
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <thread>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <unistd.h>
+
+namespace
+{
+    /// Zwraca funkcję podającą kolejne fragmenty odpowiedzi, jak odczyt z gniazda.
+    std::function<int(std::pair<char*, int>&)> Chunks(std::vector<std::string> chunks)
+    {
+        auto position = std::make_shared<std::size_t>(0);
+        auto data = std::make_shared<std::vector<std::string>>(std::move(chunks));
+        return [position, data](std::pair<char*, int>& buffer) -> int
+        {
+            if (*position == data->size())
+                return 0;
+            auto& chunk = (*data)[(*position)++];
+            BOOST_REQUIRE(chunk.size() <= static_cast<std::size_t>(buffer.second));
+            std::memcpy(buffer.first, chunk.data(), chunk.size());
+            return static_cast<int>(chunk.size());
+        };
+    }
+
+    std::string ToString(const std::vector<unsigned char>& buffer)
+    {
+        return std::string(buffer.begin(), buffer.end());
+    }
+
+    /// Serwer HTTP działający w osobnym wątku przez czas życia obiektu.
+    class LocalServer
+    {
+    public:
+        /**
+         * @param threads - liczba wątków obsługujących zapytania, 0 oznacza liczbę procesorów.
+         */
+        LocalServer(const std::string& port, Http::Server::RequestHandler handler, std::size_t threads = 0) :
+            server("127.0.0.1", port, Http::Server::DefaultService(), Http::Server::StrategyPtr(new Http::ThreadedHandlerStrategy(std::move(handler), 5000U, threads))),
+            reactor([this] { server.run(); })
+        {
+        }
+
+        ~LocalServer()
+        {
+            server.stop();
+            reactor.join();
+        }
+
+    private:
+        Http::Server server;
+        std::thread reactor;
+    };
+}
+
+/// Testy pobierania plików przez HTTP.
+BOOST_AUTO_TEST_SUITE(Download)
+
+/// Sprawdza czy ciało ograniczone przez Content-Length zostanie odczytane niezależnie od podziału na fragmenty.
+BOOST_AUTO_TEST_CASE(ContentLengthFraming)
+{
+    std::vector<unsigned char> buffer;
+    Utility::fetchData(buffer, Chunks({ "HTTP/1.1 200 OK\r\ncontent-length: 10\r\n", "\r\n0123", "456789" }));
+    BOOST_CHECK_EQUAL(ToString(buffer), "0123456789");
+
+    buffer.clear();
+    BOOST_CHECK_THROW(Utility::fetchData(buffer, Chunks({ "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n0123" })), std::runtime_error);
+    BOOST_CHECK_THROW(Utility::fetchData(buffer, Chunks({ "HTTP/1.1 200 OK\r\nContent-Length: x\r\n\r\n" })), std::runtime_error);
+    BOOST_CHECK_THROW(Utility::fetchData(buffer, Chunks({ "HTTP/1.1 200 OK\r\nContent-Length: 99999999999999999999999\r\n\r\n" })), std::runtime_error);
+}
+
+/// Sprawdza czy ciało w kodowaniu chunked zostanie zdekodowane, także gdy części dzielone są między odczyty.
+BOOST_AUTO_TEST_CASE(ChunkedFraming)
+{
+    std::vector<unsigned char> buffer;
+    Utility::fetchData(buffer, Chunks({
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhel",
+        "lo\r\n6;ext=1\r\n world\r",
+        "\n0\r\nTrailer: x\r\n",
+        "\r\n" }));
+    BOOST_CHECK_EQUAL(ToString(buffer), "hello world");
+
+    buffer.clear();
+    BOOST_CHECK_THROW(Utility::fetchData(buffer, Chunks({ "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhel" })), std::runtime_error);
+    BOOST_CHECK_THROW(Utility::fetchData(buffer, Chunks({ "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n" })), std::runtime_error);
+}
+
+/// Sprawdza czy ciało bez długości zostanie odczytane do zamknięcia połączenia.
+BOOST_AUTO_TEST_CASE(CloseDelimitedBody)
+{
+    std::vector<unsigned char> buffer;
+    Utility::fetchData(buffer, Chunks({ "HTTP/1.0 200 OK\r\n\r\nab", "cd" }));
+    BOOST_CHECK_EQUAL(ToString(buffer), "abcd");
+
+    buffer.clear();
+    BOOST_CHECK_THROW(Utility::fetchData(buffer, Chunks({ "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n" })), std::runtime_error);
+}
+
+/// Sprawdza czy kolejne pobrania z tego samego hosta wykorzystują jedno połączenie trwałe.
+BOOST_AUTO_TEST_CASE(KeepAliveReuse)
+{
+    std::atomic<int> requests(0);
+    LocalServer server("9361", [&requests](const Http::Request& request)
+    {
+        ++requests;
+        return Http::Response(Http::ResponseStatus::Ok, "file " + request.uri().raw(), "text/plain");
+    });
+
+    auto& pool = Utility::ConnectionPool::Shared();
+    pool.clear();
+    auto before = pool.statistics();
+
+    for (int i = 0; i < 10; ++i)
+    {
+        std::vector<unsigned char> buffer;
+        Utility::dlFileToBuffer("http://127.0.0.1:9361/image" + std::to_string(i), buffer);
+        BOOST_CHECK_EQUAL(ToString(buffer), "file /image" + std::to_string(i));
+    }
+
+    auto after = pool.statistics();
+    BOOST_CHECK_EQUAL(requests, 10);
+    BOOST_CHECK_EQUAL(after.connects - before.connects, 1U);
+    BOOST_CHECK_EQUAL(after.reuses - before.reuses, 9U);
+    BOOST_CHECK_EQUAL(pool.idle(), 1U);
+    pool.clear();
+}
+
+/// Sprawdza czy połączenie zamknięte przez serwer w czasie bezczynności zostanie odrzucone przed użyciem.
+BOOST_AUTO_TEST_CASE(StaleConnection)
+{
+    auto handler = [](const Http::Request&)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, "ok", "text/plain");
+    };
+
+    auto& pool = Utility::ConnectionPool::Shared();
+    pool.clear();
+    std::vector<unsigned char> buffer;
+    {
+        LocalServer server("9362", handler);
+        Utility::dlFileToBuffer("http://127.0.0.1:9362/", buffer);
+    }
+    BOOST_CHECK_EQUAL(pool.idle(), 1U);
+
+    auto before = pool.statistics();
+    LocalServer server("9362", handler);
+    buffer.clear();
+    Utility::dlFileToBuffer("http://127.0.0.1:9362/", buffer);
+    BOOST_CHECK_EQUAL(ToString(buffer), "ok");
+
+    auto after = pool.statistics();
+    BOOST_CHECK_EQUAL(after.discarded - before.discarded, 1U);
+    BOOST_CHECK_EQUAL(after.connects - before.connects, 1U);
+    pool.clear();
+}
+
+/// Sprawdza czy pula ogranicza liczbę bezczynnych połączeń hosta i współdzieli je między wątkami.
+BOOST_AUTO_TEST_CASE(SharedBetweenThreads)
+{
+    LocalServer server("9363", [](const Http::Request& request)
+    {
+        return Http::Response(Http::ResponseStatus::Ok, request.uri().raw(), "text/plain");
+    });
+
+    Utility::ConnectionPool pool(Utility::ConnectionPool::Limits(2));
+    const int threads = 4, downloads = 25;
+    std::atomic<int> failures(0);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        workers.emplace_back([&pool, &failures, i]
+        {
+            for (int j = 0; j < downloads; ++j)
+            {
+                auto connection = pool.acquire("127.0.0.1", "9363", false);
+                auto path = "/" + std::to_string(i) + "/" + std::to_string(j);
+                const auto request = "GET " + path + " HTTP/1.1\r\nHost: 127.0.0.1\r\n\r\n";
+                connection.socket().write(Tcp::MakeBuffer(request));
+
+                std::vector<unsigned char> buffer;
+                auto& socket = connection.socket();
+                Utility::fetchData(buffer, [&socket](std::pair<char*, int>& b) { return socket.readSome(b); });
+                failures += ToString(buffer) != path;
+                connection.release();
+            }
+        });
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    auto statistics = pool.statistics();
+    BOOST_CHECK_EQUAL(failures, 0);
+    BOOST_CHECK_EQUAL(statistics.connects + statistics.reuses, static_cast<std::size_t>(threads * downloads));
+    BOOST_CHECK(statistics.connects <= static_cast<std::size_t>(threads * downloads) / 2);
+    BOOST_CHECK(pool.idle() <= 2U);
+}
+
+/// Sprawdza czy ciało zostanie przekazane odbiorcy fragmentami, także gdy koniec nagłówka dzielony jest między odczyty.
+BOOST_AUTO_TEST_CASE(StreamingConsumer)
+{
+    std::string body;
+    int calls = 0;
+    auto consumer = [&body, &calls](const unsigned char* data, std::size_t size)
+    {
+        body.append(reinterpret_cast<const char*>(data), size);
+        ++calls;
+    };
+
+    Utility::fetchData(consumer, Chunks({ "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r", "\n01234", "56789" }));
+    BOOST_CHECK_EQUAL(body, "0123456789");
+    BOOST_CHECK_EQUAL(calls, 2);
+
+    body.clear();
+    Utility::fetchData(consumer, Chunks({ "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n", "5\r\nhel", "lo\r\n0\r\n\r\n" }));
+    BOOST_CHECK_EQUAL(body, "hello");
+
+    BOOST_CHECK_THROW(Utility::fetchData(consumer, Chunks({ "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhelloXX0\r\n\r\n" })), std::runtime_error);
+}
+
+/// Sprawdza czy nagłówek przekraczający bufor odbiorczy zostanie odrzucony.
+BOOST_AUTO_TEST_CASE(HeaderTooLarge)
+{
+    std::size_t sent = 0;
+    auto endless = [&sent](std::pair<char*, int>& buffer) -> int
+    {
+        if (sent > (1U << 20))
+            return 0;
+        std::memset(buffer.first, 'x', buffer.second);
+        if (sent == 0)
+            std::memcpy(buffer.first, "HTTP/1.1 200 OK\r\nX: ", 20);
+        sent += buffer.second;
+        return buffer.second;
+    };
+
+    std::vector<unsigned char> buffer;
+    try
+    {
+        Utility::fetchData(buffer, endless);
+        BOOST_ERROR("oversized header accepted");
+    }
+    catch (const std::runtime_error& error)
+    {
+        BOOST_CHECK_EQUAL(error.what(), std::string("Response header too large"));
+    }
+    BOOST_CHECK(sent < (1U << 20));
+}
+
+/// Sprawdza czy duży plik zostanie przekazany odbiorcy fragmentami nie większymi niż bufor odbiorczy oraz zapisany do pliku.
+BOOST_AUTO_TEST_CASE(LargeDownload)
+{
+    std::string large(4 << 20, '\0');
+    for (std::size_t i = 0; i < large.size(); ++i)
+        large[i] = static_cast<char>('a' + i % 26);
+    LocalServer server("9364", [&large](const Http::Request& request)
+    {
+        if (request.uri().raw() == "/missing")
+            return Http::Response(Http::ResponseStatus::NotFound, "", "text/plain");
+        return Http::Response(Http::ResponseStatus::Ok, large, "application/octet-stream");
+    });
+
+    std::string body;
+    std::size_t largest = 0;
+    Utility::dlFileToConsumer("http://127.0.0.1:9364/large", [&body, &largest](const unsigned char* data, std::size_t size)
+    {
+        body.append(reinterpret_cast<const char*>(data), size);
+        largest = std::max(largest, size);
+    });
+    BOOST_CHECK(body == large);
+    BOOST_CHECK(largest <= 64U * 1024U);
+
+    const auto path = "/tmp/patr-download-" + std::to_string(::getpid());
+    Utility::dlFileToFile("http://127.0.0.1:9364/large", path);
+    std::ifstream file(path, std::ios::binary);
+    BOOST_CHECK(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()) == large);
+    file.close();
+    std::remove(path.c_str());
+
+    BOOST_CHECK_THROW(Utility::dlFileToFile("http://127.0.0.1:9364/missing", path), std::runtime_error);
+    BOOST_CHECK(!std::ifstream(path).good());
+    Utility::ConnectionPool::Shared().clear();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+namespace
+{
+    /// Zlicza zapytania obsługiwane równocześnie przez serwer.
+    struct Concurrency
+    {
+        /// Zwraca handler odpowiadający ścieżką zapytania po czasie delay.
+        Http::Server::RequestHandler handler(std::chrono::milliseconds delay)
+        {
+            return [this, delay](const Http::Request& request)
+            {
+                auto now = ++current;
+                for (auto seen = highest.load(); now > seen && !highest.compare_exchange_weak(seen, now);)
+                    ;
+                std::this_thread::sleep_for(delay);
+                --current;
+                if (request.uri().raw() == "/missing")
+                    return Http::Response(Http::ResponseStatus::NotFound, "", "text/plain");
+                return Http::Response(Http::ResponseStatus::Ok, request.uri().raw(), "text/plain");
+            };
+        }
+
+        std::atomic<int> current{ 0 };
+        std::atomic<int> highest{ 0 };
+    };
+
+    /// Wynik pobrania przekazany przez funkcję zwrotną.
+    struct Result
+    {
+        std::string data;
+        bool failed;
+        std::thread::id thread;
+    };
+
+    /// Zleca pobranie, którego wynik można odebrać z przyszłości.
+    std::future<Result> Schedule(Utility::Downloader& downloader, const std::string& url)
+    {
+        auto promise = std::make_shared<std::promise<Result>>();
+        downloader.download(url, [promise](std::vector<unsigned char>& data, std::exception_ptr error)
+        {
+            promise->set_value(Result{ ToString(data), error != nullptr, std::this_thread::get_id() });
+        });
+        return promise->get_future();
+    }
+}
+
+/// Testy asynchronicznego pobierania plików.
+BOOST_AUTO_TEST_SUITE(AsyncDownload)
+
+/// Sprawdza czy zlecenie wraca natychmiast, a wynik przekazywany jest z innego wątku.
+BOOST_AUTO_TEST_CASE(Callback)
+{
+    Concurrency server;
+    LocalServer local("9365", server.handler(std::chrono::milliseconds(100)), 4);
+    Utility::Downloader downloader;
+
+    auto start = std::chrono::steady_clock::now();
+    auto found = Schedule(downloader, "http://127.0.0.1:9365/image");
+    auto missing = Schedule(downloader, "http://127.0.0.1:9365/missing");
+    auto refused = Schedule(downloader, "http://127.0.0.1:9399/image");
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(50));
+
+    auto result = found.get();
+    BOOST_CHECK_EQUAL(result.data, "/image");
+    BOOST_CHECK(!result.failed);
+    BOOST_CHECK(result.thread != std::this_thread::get_id());
+    BOOST_CHECK(missing.get().failed);
+    BOOST_CHECK(refused.get().failed);
+    BOOST_CHECK_EQUAL(downloader.statistics().failed, 2U);
+}
+
+/// Sprawdza czy liczba równoczesnych pobrań nie przekracza ograniczenia hosta.
+BOOST_AUTO_TEST_CASE(PerHostLimit)
+{
+    Concurrency server;
+    LocalServer local("9366", server.handler(std::chrono::milliseconds(20)), 8);
+    Utility::Downloader downloader(Utility::Downloader::Limits(2, 8));
+
+    std::vector<std::future<Result>> results;
+    for (int i = 0; i < 12; ++i)
+        results.push_back(Schedule(downloader, "http://127.0.0.1:9366/" + std::to_string(i)));
+    for (int i = 0; i < 12; ++i)
+        BOOST_CHECK_EQUAL(results[i].get().data, "/" + std::to_string(i));
+
+    auto statistics = downloader.statistics();
+    BOOST_CHECK(server.highest <= 2);
+    BOOST_CHECK_EQUAL(statistics.started, 12U);
+    BOOST_CHECK_EQUAL(statistics.peak, 2U);
+    BOOST_CHECK(statistics.queued >= 10U);
+}
+
+/// Sprawdza czy ograniczenie łączne obejmuje wszystkie hosty, a każdy z nich otrzymuje wolne miejsca.
+BOOST_AUTO_TEST_CASE(TotalLimit)
+{
+    Concurrency first, second;
+    LocalServer firstLocal("9367", first.handler(std::chrono::milliseconds(20)), 8);
+    LocalServer secondLocal("9368", second.handler(std::chrono::milliseconds(20)), 8);
+    Utility::Downloader downloader(Utility::Downloader::Limits(2, 3));
+
+    std::vector<std::future<Result>> results;
+    for (int i = 0; i < 10; ++i)
+    {
+        results.push_back(Schedule(downloader, "http://127.0.0.1:9367/" + std::to_string(i)));
+        results.push_back(Schedule(downloader, "http://127.0.0.1:9368/" + std::to_string(i)));
+    }
+    for (auto& result : results)
+        BOOST_CHECK(!result.get().failed);
+
+    BOOST_CHECK(first.highest <= 2);
+    BOOST_CHECK(second.highest <= 2);
+    BOOST_CHECK(first.highest + second.highest >= 3);
+    BOOST_CHECK_EQUAL(downloader.statistics().peak, 3U);
+}
+
+/// Sprawdza czy zniszczenie obiektu dokończy trwające pobranie, a oczekujące zakończy błędem.
+BOOST_AUTO_TEST_CASE(Shutdown)
+{
+    Concurrency server;
+    LocalServer local("9369", server.handler(std::chrono::milliseconds(100)), 4);
+    std::vector<std::future<Result>> results;
+    {
+        Utility::Downloader downloader(Utility::Downloader::Limits(1, 1));
+        for (int i = 0; i < 3; ++i)
+            results.push_back(Schedule(downloader, "http://127.0.0.1:9369/" + std::to_string(i)));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+
+    auto first = results[0].get();
+    BOOST_CHECK_EQUAL(first.data, "/0");
+    BOOST_CHECK(results[1].get().failed);
+    BOOST_CHECK(results[2].get().failed);
+}
+
+/// Sprawdza czy dlFileAsync korzysta ze wspólnego obiektu.
+BOOST_AUTO_TEST_CASE(SharedDownloader)
+{
+    Concurrency server;
+    LocalServer local("9370", server.handler(std::chrono::milliseconds(0)));
+    auto before = Utility::Downloader::Shared().statistics().started;
+
+    std::promise<std::string> result;
+    Utility::dlFileAsync("http://127.0.0.1:9370/text", [&result](std::vector<unsigned char>& data, std::exception_ptr error)
+    {
+        if (error)
+            result.set_exception(error);
+        else
+            result.set_value(ToString(data));
+    });
+    BOOST_CHECK_EQUAL(result.get_future().get(), "/text");
+    BOOST_CHECK_EQUAL(Utility::Downloader::Shared().statistics().started - before, 1U);
+}
+
+/// Sprawdza czy kolejne pobrania z hosta wykorzystują połączenie trwałe reaktora.
+BOOST_AUTO_TEST_CASE(KeepAlive)
+{
+    Concurrency server;
+    LocalServer local("9371", server.handler(std::chrono::milliseconds(0)), 2);
+    Utility::Downloader downloader;
+
+    for (int i = 0; i < 5; ++i)
+        BOOST_CHECK_EQUAL(Schedule(downloader, "http://127.0.0.1:9371/" + std::to_string(i)).get().data, "/" + std::to_string(i));
+    BOOST_CHECK_EQUAL(downloader.statistics().connects, 1U);
+}
+
+/// Sprawdza czy pobranie podąża za przekierowaniem, a dlFileAsync zwraca przyszły wynik.
+BOOST_AUTO_TEST_CASE(Redirect)
+{
+    LocalServer local("9372", [](const Http::Request& request)
+    {
+        if (request.uri().raw() != "/moved")
+            return Http::Response(Http::ResponseStatus::Ok, request.uri().raw(), "text/plain");
+        Http::Response response(Http::ResponseStatus::Found, "", "text/plain");
+        response.headers.emplace_back("Location", "http://127.0.0.1:9372/target");
+        return response;
+    }, 2);
+
+    BOOST_CHECK_EQUAL(ToString(Utility::dlFileAsync("http://127.0.0.1:9372/moved").get()), "/target");
+    BOOST_CHECK_THROW(Utility::dlFileAsync("http://127.0.0.1:9399/refused").get(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()